@@ -33,6 +33,9 @@
 #include "VosVideo.Data/SdpAnswerMsg.h"
 #include "VosVideo.Data/RtbcDeviceErrorOutMsg.h"
 #include "VosVideo.Data/IceCandidateResponseMsg.h"
+#include "VosVideo.Data/DeviceWorkerStatusMsg.h"
+#include "VosVideo.Data/ArchivePlaybackMsg.h"
+#include "VosVideo.Data/MetricsReportMsg.h"
 
 #include "CameraDeviceManager.h"
 #include "CameraVideoCapturer.h"
@@ -61,13 +64,17 @@ CameraDeviceManager::CameraDeviceManager(std::shared_ptr<CommunicationManager> c
 										std::shared_ptr<vosvideo::devicemanagement::DeviceConfigurationManager> devConfMgr,
 										std::shared_ptr<vosvideo::communication::PubSubService> pubSubService, 
 										std::shared_ptr<vosvideo::usermanagement::UserManager> userMgr, 
-									    std::shared_ptr<vosvideo::configuration::ConfigurationManager> configMgr) : 
+									    std::shared_ptr<vosvideo::configuration::ConfigurationManager> configMgr,
+									    std::shared_ptr<vosvideo::archive::ArchiveVolumes> volumes) : 
 	commManager_(commManager),
 	pubSubService_(pubSubService),
 	devConfMgr_(devConfMgr),
 	userMgr_(userMgr),
-	configMgr_(configMgr)
+	configMgr_(configMgr),
+	volumes_(volumes)
 {
+	workerPool_.reset(new DeviceWorkerPool(pubSubService_, configMgr_->GetWorkerPoolSize(), configMgr_->IsLoggerOn()));
+
 	vector<TypeInfoWrapper> interestedTypes;
 
 	TypeInfoWrapper typeInfo = typeid(WebRtcIceCandidateMsg);	
@@ -88,6 +95,15 @@ CameraDeviceManager::CameraDeviceManager(std::shared_ptr<CommunicationManager> c
 	typeInfo = typeid(IceCandidateResponseMsg);
 	interestedTypes.push_back(typeInfo);
 
+	typeInfo = typeid(DeviceWorkerStatusMsg);
+	interestedTypes.push_back(typeInfo);
+
+	typeInfo = typeid(ArchivePlaybackMsg);
+	interestedTypes.push_back(typeInfo);
+
+	typeInfo = typeid(MetricsReportMsg);
+	interestedTypes.push_back(typeInfo);
+
 	pubSubService_->Subscribe(interestedTypes, *this);
 
 	Init();
@@ -101,8 +117,15 @@ void CameraDeviceManager::OnMessageReceived(const shared_ptr<ReceivedData> recei
 	wstring msgBody = receivedMessage->ToString();
 	int devId;
 
+	// Offers carry receive time to worker, call setup is traced from the moment rtbcserver got it
+	if (dynamic_pointer_cast<LiveVideoOfferMsg>(receivedMessage))
+	{
+		msgBody = receivedMessage->ToStringWithReceivedTime();
+	}
+
 	if(dynamic_pointer_cast<LiveVideoOfferMsg>(receivedMessage) ||
-	   dynamic_pointer_cast<WebRtcIceCandidateMsg>(receivedMessage))
+	   dynamic_pointer_cast<WebRtcIceCandidateMsg>(receivedMessage) ||
+	   dynamic_pointer_cast<ArchivePlaybackMsg>(receivedMessage))
 	{
 		shared_ptr<MediaInfo> msgPtr = dynamic_pointer_cast<MediaInfo>(receivedMessage);
 		auto mediaObj = msgPtr->GetMediaInfo();
@@ -140,6 +163,38 @@ void CameraDeviceManager::OnMessageReceived(const shared_ptr<ReceivedData> recei
 		string smsg = StringUtil::ToString(receivedMessage->ToString());
 		commManager_->WebsocketSend(smsg);
 	}
+	else if(dynamic_pointer_cast<DeviceWorkerStatusMsg>(receivedMessage))
+	{
+		auto statusMsg = dynamic_pointer_cast<DeviceWorkerStatusMsg>(receivedMessage);
+		if (statusMsg->GetStatus() == DeviceWorkerStatus::CameraStarted)
+		{
+			lock_guard<std::mutex> lock(mutex_);
+			auto iter = cameraProcess_.find(statusMsg->GetCameraId());
+			if (iter != cameraProcess_.end())
+			{
+				iter->second->OnCameraStarted();
+			}
+		}
+	}
+	else if(dynamic_pointer_cast<MetricsReportMsg>(receivedMessage))
+	{
+		auto reportMsg = dynamic_pointer_cast<MetricsReportMsg>(receivedMessage);
+		// Worker series get camera label here, worker itself doesn't care which camera it runs
+		string cameraLabel = "idle";
+		{
+			lock_guard<std::mutex> lock(mutex_);
+			for (const auto& cp : cameraProcess_)
+			{
+				if (cp.second->GetWorkerName() == reportMsg->GetWorkerName())
+				{
+					cameraLabel = cp.second->GetMetricsLabel();
+					break;
+				}
+			}
+		}
+		metrics::LabelSet labels = { { "camera", cameraLabel } };
+		metrics::MetricsRegistry::Instance().MergeRemote(StringUtil::ToString(reportMsg->GetWorkerName()), labels, reportMsg->GetSamples());
+	}
 }
 
 void CameraDeviceManager::PassMessage(web::json::value& mediaObj, const wstring& payload)
@@ -163,6 +218,7 @@ void CameraDeviceManager::Shutdown()
 	{
 		p.second->Shutdown();
 	});
+	workerPool_->Shutdown();
 
 	Terminate();
 }
@@ -173,10 +229,41 @@ CameraDeviceManager::~CameraDeviceManager()
 
 void CameraDeviceManager::AddIpCam(web::json::value& camParms)
 {
-	auto conf = CameraConfMsg::CreateFromDto(configMgr_->GetArchivePath(), camParms);
+	auto conf = CameraConfMsg::CreateFromDto(GetRecordingFolder(camParms), camParms);
+	SetArchiveParameters(conf);
 	CreatePlayerProcess(conf);
 }
 
+std::wstring CameraDeviceManager::GetRecordingFolder(const web::json::value& camParms)
+{
+	wstring cameraName;
+	if (camParms.has_field(U("DeviceName")) && camParms.at(U("DeviceName")).is_string())
+	{
+		cameraName = camParms.at(U("DeviceName")).as_string();
+	}
+	// Placement is sticky, so unchanged camera gets equal configuration
+	return volumes_->Assign(cameraName);
+}
+
+void CameraDeviceManager::SetArchiveParameters(CameraConfMsg& conf)
+{
+	conf.SetArchiveRoots(volumes_->GetRoots());
+
+	CameraFsyncMode fsyncMode = CameraFsyncMode::INTERVAL;
+	switch (configMgr_->GetRecordingFsync())
+	{
+	case vosvideo::configuration::RecordingFsyncPolicy::Never:
+		fsyncMode = CameraFsyncMode::NEVER;
+		break;
+	case vosvideo::configuration::RecordingFsyncPolicy::OnClose:
+		fsyncMode = CameraFsyncMode::ONCLOSE;
+		break;
+	default:
+		break;
+	}
+	conf.SetFsyncParameters(fsyncMode, configMgr_->GetRecordingFsyncInterval());
+}
+
 void CameraDeviceManager::GetDeviceIdFromJson(int& camId, const web::json::value& camParms)
 {
 	camId = camParms.at(U("DeviceId")).as_integer();
@@ -206,7 +293,8 @@ void CameraDeviceManager::OnCameraUpdate(web::json::value& camArr)
 		// Changed CHANGED accordingly
 		// On next step all this flags get turned to PROCESSED
 		// Next time if processed flag found it means camera was removed
-		auto ipConf = CameraConfMsg::CreateFromDto(configMgr_->GetArchivePath(), a);
+		auto ipConf = CameraConfMsg::CreateFromDto(GetRecordingFolder(a), a);
+		SetArchiveParameters(ipConf);
 		int camId = ipConf.GetCameraId();
 		auto iter = cameraConfs_.find(camId);
 
@@ -301,7 +389,8 @@ void CameraDeviceManager::CreatePlayerProcess(CameraConfMsg& conf)
 		return;
 	}
 
-	std::shared_ptr<CameraPlayerProcess> cp(new CameraPlayerProcess(pubSubService_, conf, configMgr_->IsLoggerOn()));
+	std::shared_ptr<CameraPlayerProcess> cp(new CameraPlayerProcess(workerPool_, conf));
+	cp->ConnectToWorkerLostSignal(boost::bind(&CameraDeviceManager::OnWorkerLost, this, _1));
 	int cameraId = conf.GetCameraId();
 	cameraProcess_.insert(make_pair(cameraId, cp));
 }
@@ -310,25 +399,54 @@ bool CameraDeviceManager::Init()
 {
 	auto callback = new call<CameraDeviceManager*>([this](CameraDeviceManager*)
 	{
-		this->ReconnectCamera();
+		this->SuperviseCameras();
 	});
 
-	reconnectTimer_ = new Concurrency::timer<CameraDeviceManager*>(reconnectTimeout_, 0, callback, true);
+	reconnectTimer_ = new Concurrency::timer<CameraDeviceManager*>(supervisionPeriod_, 0, callback, true);
 	reconnectTimer_->start();
 	return true;
 }
 
-void CameraDeviceManager::ReconnectCamera()
+void CameraDeviceManager::SuperviseCameras()
 {
-	lock_guard<std::mutex> lock(mutex_);
+	// Restart of one camera may wait for a new worker, it shouldn't hold up messages of others
+	vector<shared_ptr<CameraPlayerProcess>> processes;
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		for (const auto& cp : cameraProcess_)
+		{
+			processes.push_back(cp.second);
+		}
+	}
 
-	for (const auto& cp : cameraProcess_)
+	for (const auto& cp : processes)
 	{
-		// Internally check if process is dead
-		cp.second->Reconnect();
+		// Internally check if process is dead or hung
+		cp->Supervise();
 	}
 }
 
+void CameraDeviceManager::OnWorkerLost(int cameraId)
+{
+	// Don't restart on notification thread, restart destroys the watcher which fired notification
+	concurrency::create_task([this, cameraId]()
+	{
+		shared_ptr<CameraPlayerProcess> process;
+		{
+			lock_guard<std::mutex> lock(mutex_);
+			auto iter = cameraProcess_.find(cameraId);
+			if (iter != cameraProcess_.end())
+			{
+				process = iter->second;
+			}
+		}
+		if (process)
+		{
+			process->Supervise();
+		}
+	});
+}
+
 void CameraDeviceManager::DeletePlayerProcess(int devId)
 {
 	LOG_TRACE("Shutdown camera with id: " << devId);
@@ -9,9 +9,11 @@
 #include "VosVideo.DeviceManagement/DeviceConfigurationManager.h"
 #include "VosVideo.UserManagement/UserManager.h"
 #include "VosVideo.Data/CameraConfMsg.h"
+#include "VosVideo.MediaManagement/ArchiveVolumes.h"
 #include "VosVideo.Communication/CommunicationManager.h"
 #include "VosVideo.CameraPlayer/CameraPlayerBase.h"
 #include "CameraPlayerProcess.h"
+#include "DeviceWorkerPool.h"
 #include "CameraException.h"
 
 namespace vosvideo
@@ -26,7 +28,8 @@ namespace vosvideo
 								std::shared_ptr<vosvideo::devicemanagement::DeviceConfigurationManager> devConfMgr,
 								std::shared_ptr<vosvideo::communication::PubSubService> pubsubService, 
 							    std::shared_ptr<vosvideo::usermanagement::UserManager> userMgr,
-							    std::shared_ptr<vosvideo::configuration::ConfigurationManager> configMgr);
+							    std::shared_ptr<vosvideo::configuration::ConfigurationManager> configMgr,
+							    std::shared_ptr<vosvideo::archive::ArchiveVolumes> volumes);
 
 			virtual ~CameraDeviceManager();
 
@@ -62,9 +65,15 @@ namespace vosvideo
 			std::shared_ptr<vosvideo::devicemanagement::DeviceConfigurationManager> devConfMgr_;
 			std::shared_ptr<vosvideo::usermanagement::UserManager> userMgr_;
 			std::shared_ptr<vosvideo::configuration::ConfigurationManager> configMgr_;
+			std::shared_ptr<vosvideo::archive::ArchiveVolumes> volumes_;
 			std::shared_ptr<vosvideo::communication::PubSubService> pubSubService_;
+			std::shared_ptr<DeviceWorkerPool> workerPool_;
 
 			virtual bool GetAudioDevices(bool input, std::vector<cricket::Device>* devs);
+			// Archive root camera records to, taken from camera name
+			std::wstring GetRecordingFolder(const web::json::value& camParms);
+			// Archive roots and recording durability settings common to all cameras
+			void SetArchiveParameters(vosvideo::data::CameraConfMsg& conf);
 			// Shortcut for real notification
 			void NotifyAllUsers(const vosvideo::data::CameraConfMsg& conf, const CameraException& e);
 
@@ -74,15 +83,17 @@ namespace vosvideo
 			void DeletePlayerProcess(int devId);
 			void CreatePlayerProcess(vosvideo::data::CameraConfMsg& conf);
 			vosvideo::data::CameraConfMsg CreateCameraConfFromJson(const web::json::value& camParms);
-			// Try to recreate camera id it has status stopped. It gives us chance dynamically add-remove cameras
-			void ReconnectCamera();
+			// Checks camera processes and restarts lost ones. It gives us chance dynamically add-remove cameras
+			void SuperviseCameras();
+			// Called from system thread once deviceworker exits unexpectedly
+			void OnWorkerLost(int cameraId);
 			void PassMessage(web::json::value& json, const std::wstring& payload );
 			Concurrency::timer<CameraDeviceManager*>* reconnectTimer_ = nullptr; 
 			CameraPlayersMap cameraPlayers_;
 			CameraPlayerProcessMap cameraProcess_;
 			CameraConfsMap cameraConfs_;
 			std::mutex mutex_;
-			const static int reconnectTimeout_ = 60000; // 1 min
+			const static int supervisionPeriod_ = 1000; // 1 sec
 		};
 	}
 }
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "VosVideo.GSCameraPlayer/GSCameraPlayer.h"
+#include "VosVideo.GSCameraPlayer/GSArchivePlayer.h"
 #include "VosVideo.GSCameraPlayer/GSCameraPlayerBootstrapper.h"
 #include "CameraPlayerFactory.h"
 
@@ -30,4 +31,9 @@ void CameraPlayerFactory::Shutdown()
 CameraPlayerBase* CameraPlayerFactory::CreateCameraPlayer()
 {
 	return new GSCameraPlayer();
+}
+
+ArchivePlayerBase* CameraPlayerFactory::CreateArchivePlayer(const std::wstring& fileName)
+{
+	return new GSArchivePlayer(fileName);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "VosVideo.CameraPlayer/CameraPlayerBase.h"
+#include "VosVideo.CameraPlayer/ArchivePlayerBase.h"
 
 namespace vosvideo
 {
@@ -14,6 +15,8 @@ namespace vosvideo
 			static void Init(int* argc, char **argv[]);
 			static void Shutdown();
 			static vosvideo::cameraplayer::CameraPlayerBase* CreateCameraPlayer();
+			// Player of one recording, file name is resolved inside camera recording folder
+			static vosvideo::cameraplayer::ArchivePlayerBase* CreateArchivePlayer(const std::wstring& fileName);
 		};
 	}
 }
\ No newline at end of file
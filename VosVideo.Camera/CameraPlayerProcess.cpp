@@ -1,68 +1,187 @@
 #include "stdafx.h"
-#include <Poco/Process.h>
-#include "VosVideo.Communication/InterprocessCommEngine.h"
-#include "VosVideo.Communication.InterprocessQueue/InterprocessQueueEngine.h"
 #include "VosVideo.Data/ShutdownCameraProcessRequestMsg.h"
 #include "CameraPlayerProcess.h"
+#include "CameraException.h"
 
 using namespace std;
+using namespace util;
+using namespace metrics;
 using namespace vosvideo::camera;
 using namespace vosvideo::communication;
 
-CameraPlayerProcess::CameraPlayerProcess(std::shared_ptr<PubSubService> pubSubService, vosvideo::data::CameraConfMsg& conf, bool isLoggerOn) : 
-	conf_(conf), pubSubService_(pubSubService), isLoggerOn_(isLoggerOn)
+CameraPlayerProcess::CameraPlayerProcess(std::shared_ptr<DeviceWorkerPool> workerPool, vosvideo::data::CameraConfMsg& conf) : 
+	conf_(conf), workerPool_(workerPool), lastStartTime_(0), generation_(0), isWorkerLost_(false), isStopping_(false)
 {
+	LabelSet labels = { { "camera", GetMetricsLabel() } };
+	restartsMetric_ = MetricsRegistry::Instance().GetCounter("vosvideo_worker_restarts_total", "Restarts of deviceworker lost by camera", labels);
+	startTimeMetric_ = MetricsRegistry::Instance().GetHistogram("vosvideo_camera_start_seconds", "Time from camera start request till worker opened camera", labels);
 	Init();
 }
 
 CameraPlayerProcess::~CameraPlayerProcess()
 {
+	isStopping_ = true;
+	exitWatcher_.reset();
+	if (worker_)
+	{
+		DeviceWorkerPool::Retire(worker_);
+	}
+	MetricsRegistry::Instance().RemoveSeries("camera", GetMetricsLabel());
 }
 
 void CameraPlayerProcess::Init()
 {
 	auto cameraId = conf_.GetCameraId();
-	auto cameraName = conf_.GetCameraName();
 	LOG_TRACE("Create camera player process for camera: " << cameraId);
 
-	shared_ptr<InterprocessCommEngine> iqe(new InterprocessQueueEngine(pubSubService_, to_wstring(cameraId)));
-	duplexChannel_.reset(new InterprocessComm(iqe));
-	duplexChannel_->OpenAsParent();
-	// Pass first message, configuration
+	startRequestedAt_ = std::chrono::steady_clock::now();
+	isStartPending_ = true;
+
+	worker_ = workerPool_->Acquire();
+	isWarmStart_ = worker_->IsReady;
+	duplexChannel_ = worker_->DuplexChannel;
+	pid_ = worker_->Pid;
+
+	auto now = std::chrono::steady_clock::now();
+	workerStartedAt_ = now;
+	lastBeatAt_ = now;
+	lastBeats_ = 0;
+	isStopping_ = false;
+	isWorkerLost_ = false;
+	uint32_t generation = ++generation_;
+	exitWatcher_.reset(new ProcessExitWatcher(pid_, [this, generation]
+	{
+		this->OnWorkerExited(generation);
+	}));
+
+	// Worker waits for configuration as first message
 	duplexChannel_->Send(conf_.ToString());
+	LOG_TRACE("Camera " << cameraId << " assigned to deviceworker " << StringUtil::ToString(worker_->Name) << ". Process Id: " << pid_);
+}
 
-	// start process and give it deice Id as starting point
-	Poco::Process::Args args;
-	args.push_back("-deviceid=" + to_string(cameraId));
-	args.push_back("-debug");
-	if (isLoggerOn_)
+void CameraPlayerProcess::Supervise()
+{
+	lock_guard<std::mutex> lock(superviseMutex_);
+	if (isStopping_)
 	{
-		args.push_back("-logging=true");
+		return;
 	}
-	
-	Poco::ProcessHandle ph = Poco::Process::launch("deviceworker.exe", args);
-	pid_ = ph.id();
-	LOG_TRACE("Camera player process for camera: " << cameraId << " started. Process Id: " << pid_);
-	ReceiveAsync();
+
+	auto now = std::chrono::steady_clock::now();
+	if (!isWorkerLost_)
+	{
+		// Safety net in case exit notification didn't come
+		if (!IsAlive())
+		{
+			isWorkerLost_ = true;
+		}
+		else
+		{
+			CheckHeartbeat(now);
+			return;
+		}
+	}
+
+	if (now < nextRestartAt_)
+	{
+		return;
+	}
+
+	Restart();
 }
 
-void CameraPlayerProcess::Reconnect()
+void CameraPlayerProcess::Restart()
 {
-	if (!IsAlive())
+	auto now = std::chrono::steady_clock::now();
+	// Worker worked long enough, it is not crash loop
+	if (now - workerStartedAt_ > stableRunTime_)
+	{
+		restartAttempts_ = 0;
+	}
+
+	LOG_WARNING("deviceworker process for camera " << conf_.GetCameraId() << " is gone. Restart attempt: " << restartAttempts_ + 1);
+	// Worker exited or was killed, its queue has no reader
+	isStopping_ = true;
+	isRecovery_ = true;
+	restartAttempts_++;
+	restartsMetric_->Increment();
+	nextRestartAt_ = now + GetRestartBackoff();
+	// Lost worker's queues are never reused, new worker comes with its own
+	if (worker_)
+	{
+		DeviceWorkerPool::Retire(worker_);
+	}
+
+	try
 	{
-		LOG_TRACE("deviceworker process is gone. Cleaning environment and restart.");
-		Shutdown();
 		Init();
 	}
-	else
+	catch (CameraException&)
 	{
-		LOG_TRACE("deviceworker process is alive.");
+		// Already logged, next supervision round tries again after backoff
+		isStopping_ = false;
+		isWorkerLost_ = true;
 	}
 }
 
+void CameraPlayerProcess::CheckHeartbeat(std::chrono::steady_clock::time_point now)
+{
+	if (!worker_->Heartbeat)
+	{
+		return;
+	}
+
+	uint64_t beats = worker_->Heartbeat->GetBeats();
+	if (beats != lastBeats_)
+	{
+		lastBeats_ = beats;
+		lastBeatAt_ = now;
+		return;
+	}
+
+	auto limit = (beats == 0) ? startupGrace_ : hangTimeout_;
+	if (now - lastBeatAt_ > limit)
+	{
+		LOG_ERROR("deviceworker process " << pid_ << " for camera " << conf_.GetCameraId() << " stopped heartbeat, terminating it.");
+		isWorkerLost_ = true;
+		exitWatcher_->Kill();
+	}
+}
+
+void CameraPlayerProcess::OnWorkerExited(uint32_t generation)
+{
+	if (isStopping_ || generation != generation_)
+	{
+		return;
+	}
+
+	isWorkerLost_ = true;
+	workerLostSignal_(conf_.GetCameraId());
+}
+
+std::chrono::milliseconds CameraPlayerProcess::GetRestartBackoff() const
+{
+	// First restart is immediate, every next one waits twice longer: 250ms, 500ms, 1s ... up to maxBackoff_
+	auto backoff = minBackoff_;
+	for (uint32_t i = 1; i < restartAttempts_ && backoff < maxBackoff_; ++i)
+	{
+		backoff *= 2;
+	}
+	return std::min(backoff, maxBackoff_);
+}
+
+void CameraPlayerProcess::ConnectToWorkerLostSignal(boost::function<void(int)> subscriber)
+{
+	workerLostSignal_.connect(subscriber);
+}
+
 bool CameraPlayerProcess::IsAlive()
 {
 	HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid_);
+	if (process == nullptr)
+	{
+		return false;
+	}
 	DWORD ret = WaitForSingleObject(process, 0);
 	CloseHandle(process);
 	return ret == WAIT_TIMEOUT;
@@ -70,6 +189,13 @@ bool CameraPlayerProcess::IsAlive()
 
 void CameraPlayerProcess::Shutdown()
 {
+	lock_guard<std::mutex> lock(superviseMutex_);
+	isStopping_ = true;
+	if (isWorkerLost_)
+	{
+		LOG_TRACE("deviceworker is lost, shutdown request is not sent");
+		return;
+	}
 	LOG_TRACE("Send Shutdown to deviceworker.");
 	vosvideo::data::ShutdownCameraProcessRequestMsg shutdownReq;
 	duplexChannel_->Send(shutdownReq.ToString());
@@ -80,12 +206,33 @@ void CameraPlayerProcess::Send(const std::wstring& msg)
 	duplexChannel_->Send(msg);
 }
 
-void CameraPlayerProcess::Receive()
+void CameraPlayerProcess::OnCameraStarted()
+{
+	if (!isStartPending_)
+	{
+		return;
+	}
+	isStartPending_ = false;
+
+	auto elapsed = std::chrono::steady_clock::now() - startRequestedAt_;
+	lastStartTime_ = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+	startTimeMetric_->Record(elapsed);
+	LOG_TRACE("Camera " << conf_.GetCameraId() << (isRecovery_ ? " recovered" : " started") << " in " << lastStartTime_.count() << 
+		" ms on " << (isWarmStart_ ? "warm" : "cold") << " deviceworker");
+}
+
+std::chrono::milliseconds CameraPlayerProcess::GetLastStartTime() const
+{
+	return lastStartTime_;
+}
+
+std::wstring CameraPlayerProcess::GetWorkerName() const
 {
-	duplexChannel_->Receive();
+	return worker_ ? worker_->Name : wstring();
 }
 
-void CameraPlayerProcess::ReceiveAsync()
+std::string CameraPlayerProcess::GetMetricsLabel() const
 {
-	return duplexChannel_->ReceiveAsync();
+	wstring cameraName = conf_.GetCameraName();
+	return cameraName.empty() ? std::to_string(conf_.GetCameraId()) : StringUtil::ToString(cameraName);
 }
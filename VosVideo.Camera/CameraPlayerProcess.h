@@ -1,7 +1,13 @@
 #pragma once
-#include <Poco/Process.h>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <boost/signals2.hpp>
+#include "VosVideo.Common/Metrics.h"
 #include "VosVideo.Communication/InterprocessComm.h"
 #include "VosVideo.Data/CameraConfMsg.h"
+#include "DeviceWorkerPool.h"
+#include "ProcessExitWatcher.h"
 
 namespace vosvideo
 {
@@ -10,28 +16,74 @@ namespace vosvideo
 		class CameraPlayerProcess
 		{
 		public:
-			CameraPlayerProcess(std::shared_ptr<vosvideo::communication::PubSubService> pubsubService, 
-				vosvideo::data::CameraConfMsg& conf, 
-				bool isLoggerOn);
+			CameraPlayerProcess(std::shared_ptr<DeviceWorkerPool> workerPool, 
+				vosvideo::data::CameraConfMsg& conf);
 			virtual ~CameraPlayerProcess();
 
-			void Reconnect();
+			// Checks worker heartbeat and restarts lost worker once its backoff is over.
+			// Must be called periodically and right after worker lost notification.
+			void Supervise();
 			void Send(const std::wstring& msg);
-			// Stops the process
+			// Stops the process, lost worker is not asked to
 			void Shutdown();
+			// Worker reported that camera is opened, finishes start time measurement
+			void OnCameraStarted();
+			// Time from camera start (or restart) request till camera opened by worker
+			std::chrono::milliseconds GetLastStartTime() const;
+			// Worker currently running the camera
+			std::wstring GetWorkerName() const;
+			// Value of "camera" label of metrics, camera name or id if it has no name
+			std::string GetMetricsLabel() const;
+
+			// Fired from system thread when worker process exits unexpectedly, argument is camera id
+			void ConnectToWorkerLostSignal(boost::function<void(int)> subscriber);
 
 		private:
 			// Check if spawned process alive
 			bool IsAlive();
 			void Init();
-			void Receive();
-			void ReceiveAsync();
+			void Restart();
+			void CheckHeartbeat(std::chrono::steady_clock::time_point now);
+			void OnWorkerExited(uint32_t generation);
+			std::chrono::milliseconds GetRestartBackoff() const;
 
-			std::shared_ptr<vosvideo::communication::PubSubService> pubSubService_;
+			std::shared_ptr<DeviceWorkerPool> workerPool_;
+			std::shared_ptr<DeviceWorker> worker_;
 			std::shared_ptr<vosvideo::communication::InterprocessComm> duplexChannel_;
+			std::unique_ptr<ProcessExitWatcher> exitWatcher_;
 			vosvideo::data::CameraConfMsg conf_;
 			int32_t pid_ = -1;
-			bool isLoggerOn_ = false;
+			std::chrono::steady_clock::time_point startRequestedAt_;
+			std::chrono::milliseconds lastStartTime_;
+			bool isRecovery_ = false;
+			bool isWarmStart_ = false;
+			bool isStartPending_ = false;
+
+			boost::signals2::signal<void(int)> workerLostSignal_;
+			// Incremented for every new worker, so late exit notification of previous worker is ignored
+			std::atomic<uint32_t> generation_;
+			std::atomic<bool> isWorkerLost_;
+			std::atomic<bool> isStopping_;
+			uint64_t lastBeats_ = 0;
+			std::chrono::steady_clock::time_point lastBeatAt_;
+			std::chrono::steady_clock::time_point workerStartedAt_;
+			std::chrono::steady_clock::time_point nextRestartAt_;
+			uint32_t restartAttempts_ = 0;
+
+			// Supervision runs from timer and from lost worker notification
+			std::mutex superviseMutex_;
+
+			std::shared_ptr<metrics::Counter> restartsMetric_;
+			std::shared_ptr<metrics::Histogram> startTimeMetric_;
+
+			// Worker started and stopped beating
+			const std::chrono::milliseconds hangTimeout_ = std::chrono::milliseconds(10000);
+			// Worker never beat yet, it still initializes
+			const std::chrono::milliseconds startupGrace_ = std::chrono::milliseconds(30000);
+			// Worker which lived that long is not in crash loop, backoff starts over
+			const std::chrono::milliseconds stableRunTime_ = std::chrono::milliseconds(60000);
+			const std::chrono::milliseconds minBackoff_ = std::chrono::milliseconds(250);
+			const std::chrono::milliseconds maxBackoff_ = std::chrono::milliseconds(30000);
 		};
 	}
 }
@@ -0,0 +1,234 @@
+#include "stdafx.h"
+#include <Poco/Process.h>
+#include "VosVideo.Communication/TypeInfoWrapper.h"
+#include "VosVideo.Communication.InterprocessQueue/InterprocessQueueEngine.h"
+#include "VosVideo.Data/DeviceWorkerStatusMsg.h"
+#include "VosVideo.Data/ShutdownCameraProcessRequestMsg.h"
+#include "DeviceWorkerPool.h"
+#include "CameraException.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::camera;
+using namespace vosvideo::communication;
+using namespace vosvideo::data;
+
+DeviceWorkerPool::DeviceWorkerPool(std::shared_ptr<PubSubService> pubSubService, uint32_t poolSize, bool isLoggerOn) :
+	pubSubService_(pubSubService), poolSize_(poolSize), isLoggerOn_(isLoggerOn), refillTask_(concurrency::task_from_result())
+{
+	vector<TypeInfoWrapper> interestedTypes;
+	TypeInfoWrapper typeInfo = typeid(DeviceWorkerStatusMsg);
+	interestedTypes.push_back(typeInfo);
+	pubSubService_->Subscribe(interestedTypes, *this);
+
+	LOG_TRACE("Create deviceworker pool with " << poolSize_ << " idle workers");
+	RefillAsync();
+}
+
+DeviceWorkerPool::~DeviceWorkerPool()
+{
+	Shutdown();
+}
+
+std::shared_ptr<DeviceWorker> DeviceWorkerPool::Acquire()
+{
+	shared_ptr<DeviceWorker> worker;
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		// Prefer workers which already reported they are ready, they are at the front
+		while (!idleWorkers_.empty())
+		{
+			auto candidate = idleWorkers_.front();
+			idleWorkers_.pop_front();
+			if (IsAlive(candidate->Pid))
+			{
+				worker = candidate;
+				break;
+			}
+			LOG_WARNING("Idle deviceworker " << StringUtil::ToString(candidate->Name) << " is gone, skipped.");
+			launchedWorkers_.erase(candidate->Name);
+			Retire(candidate);
+		}
+	}
+
+	if (worker)
+	{
+		LOG_TRACE("Acquired warm deviceworker " << StringUtil::ToString(worker->Name) << ", ready: " << worker->IsReady);
+	}
+	else
+	{
+		LOG_TRACE("No idle deviceworker in pool, launching new one.");
+		worker = Launch();
+	}
+
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		launchedWorkers_.erase(worker->Name);
+	}
+
+	RefillAsync();
+	return worker;
+}
+
+void DeviceWorkerPool::Shutdown()
+{
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		if (inShutdown_)
+		{
+			return;
+		}
+		inShutdown_ = true;
+	}
+
+	refillTask_.wait();
+
+	lock_guard<std::mutex> lock(mutex_);
+	ShutdownCameraProcessRequestMsg shutdownReq;
+	for (const auto& worker : idleWorkers_)
+	{
+		LOG_TRACE("Send Shutdown to idle deviceworker " << StringUtil::ToString(worker->Name));
+		worker->DuplexChannel->Send(shutdownReq.ToString());
+		// Pending shutdown request is flushed before queues are removed
+		Retire(worker);
+	}
+	idleWorkers_.clear();
+	launchedWorkers_.clear();
+}
+
+void DeviceWorkerPool::Retire(const std::shared_ptr<DeviceWorker>& worker)
+{
+	if (worker->DuplexChannel)
+	{
+		worker->DuplexChannel->Close();
+	}
+	worker->Heartbeat.reset();
+}
+
+void DeviceWorkerPool::OnMessageReceived(std::shared_ptr<ReceivedData> receivedMessage)
+{
+	auto statusMsg = dynamic_pointer_cast<DeviceWorkerStatusMsg>(receivedMessage);
+	if (!statusMsg || statusMsg->GetStatus() != DeviceWorkerStatus::Ready)
+	{
+		return;
+	}
+
+	lock_guard<std::mutex> lock(mutex_);
+	auto iter = launchedWorkers_.find(statusMsg->GetWorkerName());
+	if (iter == launchedWorkers_.end())
+	{
+		return;
+	}
+
+	auto worker = iter->second;
+	worker->IsReady = true;
+	auto initTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - worker->LaunchedAt);
+	LOG_TRACE("Deviceworker " << StringUtil::ToString(worker->Name) << " initialized in " << initTime.count() << " ms");
+
+	// Move ready worker in front of ones still initializing
+	auto idleIter = std::find(idleWorkers_.begin(), idleWorkers_.end(), worker);
+	if (idleIter != idleWorkers_.end())
+	{
+		idleWorkers_.erase(idleIter);
+		auto firstNotReady = std::find_if(idleWorkers_.begin(), idleWorkers_.end(), [](const shared_ptr<DeviceWorker>& w){ return !w->IsReady; });
+		idleWorkers_.insert(firstNotReady, worker);
+	}
+}
+
+std::shared_ptr<DeviceWorker> DeviceWorkerPool::Launch()
+{
+	shared_ptr<DeviceWorker> worker(new DeviceWorker());
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		worker->Name = L"dw" + to_wstring(GetCurrentProcessId()) + L"_" + to_wstring(nextWorkerId_++);
+		launchedWorkers_.insert(make_pair(worker->Name, worker));
+	}
+
+	try
+	{
+		shared_ptr<InterprocessCommEngine> iqe(new InterprocessQueueEngine(pubSubService_, worker->Name));
+		worker->DuplexChannel.reset(new InterprocessComm(iqe));
+		worker->DuplexChannel->OpenAsParent();
+		worker->Heartbeat.reset(new InterprocessHeartbeat(worker->Name + L"_hb", true));
+
+		// Queue name is the only thing worker knows before it gets camera configuration
+		Poco::Process::Args args;
+		args.push_back("-deviceid=" + StringUtil::ToString(worker->Name));
+		// Idle worker exits by itself if we are gone before it got camera
+		args.push_back("-parentpid=" + to_string(GetCurrentProcessId()));
+		args.push_back("-debug");
+		if (isLoggerOn_)
+		{
+			args.push_back("-logging=true");
+		}
+
+		worker->LaunchedAt = std::chrono::steady_clock::now();
+		Poco::ProcessHandle ph = Poco::Process::launch("deviceworker.exe", args);
+		worker->Pid = ph.id();
+		worker->DuplexChannel->ReceiveAsync();
+	}
+	catch (std::exception& e)
+	{
+		// boost interprocess_exception and Poco exceptions both derive from std::exception
+		{
+			lock_guard<std::mutex> lock(mutex_);
+			launchedWorkers_.erase(worker->Name);
+		}
+		Retire(worker);
+		throw CameraException(string("Failed to launch deviceworker: ") + e.what());
+	}
+
+	LOG_TRACE("Deviceworker " << StringUtil::ToString(worker->Name) << " launched. Process Id: " << worker->Pid);
+	return worker;
+}
+
+void DeviceWorkerPool::RefillAsync()
+{
+	lock_guard<std::mutex> lock(mutex_);
+	if (inRefill_ || inShutdown_ || idleWorkers_.size() >= poolSize_)
+	{
+		return;
+	}
+	inRefill_ = true;
+
+	refillTask_ = concurrency::create_task([this]()
+	{
+		for (;;)
+		{
+			{
+				lock_guard<std::mutex> lock(mutex_);
+				if (inShutdown_ || idleWorkers_.size() >= poolSize_)
+				{
+					inRefill_ = false;
+					return;
+				}
+			}
+
+			try
+			{
+				auto worker = Launch();
+				lock_guard<std::mutex> lock(mutex_);
+				idleWorkers_.push_back(worker);
+			}
+			catch (CameraException&)
+			{
+				// Already logged, camera start falls back to cold launch
+				lock_guard<std::mutex> lock(mutex_);
+				inRefill_ = false;
+				return;
+			}
+		}
+	});
+}
+
+bool DeviceWorkerPool::IsAlive(int32_t pid)
+{
+	HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+	if (process == nullptr)
+	{
+		return false;
+	}
+	DWORD ret = WaitForSingleObject(process, 0);
+	CloseHandle(process);
+	return ret == WAIT_TIMEOUT;
+}
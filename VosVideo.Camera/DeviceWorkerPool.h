@@ -0,0 +1,63 @@
+#pragma once
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <ppltasks.h>
+#include "VosVideo.Communication/PubSubService.h"
+#include "VosVideo.Communication/InterprocessComm.h"
+#include "VosVideo.Communication/MessageReceiver.h"
+#include "VosVideo.Communication.InterprocessQueue/InterprocessHeartbeat.h"
+
+namespace vosvideo
+{
+	namespace camera
+	{
+		// Running deviceworker process with opened duplex channel, not yet bound to camera
+		struct DeviceWorker
+		{
+			std::wstring Name;
+			std::shared_ptr<vosvideo::communication::InterprocessComm> DuplexChannel;
+			std::shared_ptr<vosvideo::communication::InterprocessHeartbeat> Heartbeat;
+			int32_t Pid = -1;
+			std::chrono::steady_clock::time_point LaunchedAt;
+			// Worker reported that COM, GStreamer, WebRTC and SSL are initialized
+			bool IsReady = false;
+		};
+
+		// Keeps several idle deviceworker processes initialized in advance, 
+		// so camera start and restart doesn't wait for process initialization
+		class DeviceWorkerPool final : public vosvideo::communication::MessageReceiver
+		{
+		public:
+			DeviceWorkerPool(std::shared_ptr<vosvideo::communication::PubSubService> pubSubService, uint32_t poolSize, bool isLoggerOn);
+			virtual ~DeviceWorkerPool();
+
+			// Takes idle worker from pool, launches new one if pool is empty. 
+			// Pool gets refilled in background.
+			std::shared_ptr<DeviceWorker> Acquire();
+			// Stops all idle workers
+			void Shutdown();
+			// Removes queues and heartbeat of worker which is torn down or replaced,
+			// they are named shared memory and outlive both processes otherwise
+			static void Retire(const std::shared_ptr<DeviceWorker>& worker);
+
+			virtual void OnMessageReceived(std::shared_ptr<vosvideo::data::ReceivedData> receivedMessage) override;
+
+		private:
+			std::shared_ptr<DeviceWorker> Launch();
+			void RefillAsync();
+			static bool IsAlive(int32_t pid);
+
+			std::shared_ptr<vosvideo::communication::PubSubService> pubSubService_;
+			std::deque<std::shared_ptr<DeviceWorker>> idleWorkers_;
+			std::unordered_map<std::wstring, std::shared_ptr<DeviceWorker>> launchedWorkers_;
+			concurrency::task<void> refillTask_;
+			std::mutex mutex_;
+			uint32_t poolSize_;
+			uint32_t nextWorkerId_ = 0;
+			bool isLoggerOn_ = false;
+			bool inRefill_ = false;
+			bool inShutdown_ = false;
+		};
+	}
+}
@@ -0,0 +1,141 @@
+#include "stdafx.h"
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#endif
+#include "ProcessExitWatcher.h"
+
+using namespace std;
+using namespace vosvideo::camera;
+
+#ifdef _WIN32
+
+ProcessExitWatcher::ProcessExitWatcher(int32_t pid, std::function<void()> onExit) : 
+	pid_(pid), onExit_(onExit)
+{
+	process_ = OpenProcess(SYNCHRONIZE | PROCESS_TERMINATE, FALSE, pid_);
+	if (process_ == nullptr)
+	{
+		LOG_WARNING("Can't open process " << pid_ << ", considered as exited. Error: " << GetLastError());
+		onExit_();
+		return;
+	}
+
+	if (!RegisterWaitForSingleObject(&wait_, process_, &ProcessExitWatcher::OnProcessSignaled, this, INFINITE, WT_EXECUTEONLYONCE))
+	{
+		LOG_ERROR("Failed to register wait for process " << pid_ << ". Error: " << GetLastError());
+		wait_ = nullptr;
+	}
+}
+
+ProcessExitWatcher::~ProcessExitWatcher()
+{
+	if (wait_ != nullptr)
+	{
+		// Blocks until running callback is finished
+		UnregisterWaitEx(wait_, INVALID_HANDLE_VALUE);
+	}
+
+	if (process_ != nullptr)
+	{
+		CloseHandle(process_);
+	}
+}
+
+void ProcessExitWatcher::Kill()
+{
+	if (process_ != nullptr)
+	{
+		TerminateProcess(process_, 1);
+	}
+}
+
+void CALLBACK ProcessExitWatcher::OnProcessSignaled(PVOID context, BOOLEAN timedOut)
+{
+	ProcessExitWatcher* self = static_cast<ProcessExitWatcher*>(context);
+	LOG_TRACE("Process " << self->pid_ << " exited.");
+	self->onExit_();
+}
+
+#else
+
+ProcessExitWatcher::ProcessExitWatcher(int32_t pid, std::function<void()> onExit) : 
+	pid_(pid), onExit_(onExit)
+{
+	if (pipe(cancelFds_) != 0)
+	{
+		cancelFds_[0] = cancelFds_[1] = -1;
+	}
+
+	watchThr_ = std::thread([this]
+	{
+		this->WatchLoop();
+	});
+}
+
+ProcessExitWatcher::~ProcessExitWatcher()
+{
+	if (cancelFds_[1] != -1)
+	{
+		char c = 0;
+		write(cancelFds_[1], &c, 1);
+	}
+	watchThr_.join();
+
+	if (cancelFds_[0] != -1)
+	{
+		close(cancelFds_[0]);
+		close(cancelFds_[1]);
+	}
+}
+
+void ProcessExitWatcher::Kill()
+{
+	kill(pid_, SIGKILL);
+}
+
+void ProcessExitWatcher::WatchLoop()
+{
+	int pidFd = -1;
+#ifdef SYS_pidfd_open
+	pidFd = static_cast<int>(syscall(SYS_pidfd_open, pid_, 0));
+#endif
+
+	for (;;)
+	{
+		pollfd fds[2];
+		int nfds = 0;
+		fds[nfds++] = { cancelFds_[0], POLLIN, 0 };
+		if (pidFd != -1)
+		{
+			fds[nfds++] = { pidFd, POLLIN, 0 };
+		}
+
+		// Without pidfd fall back to waitpid with short poll interval
+		int ret = poll(fds, nfds, pidFd != -1 ? -1 : 100);
+		if (ret > 0 && (fds[0].revents & POLLIN))
+		{
+			break;
+		}
+
+		int status;
+		pid_t res = waitpid(pid_, &status, WNOHANG);
+		if (res == pid_ || (res == -1 && errno == ECHILD))
+		{
+			LOG_TRACE("Process " << pid_ << " exited.");
+			onExit_();
+			break;
+		}
+	}
+
+	if (pidFd != -1)
+	{
+		close(pidFd);
+	}
+}
+
+#endif
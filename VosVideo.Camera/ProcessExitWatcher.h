@@ -0,0 +1,39 @@
+#pragma once
+#include <functional>
+#ifndef _WIN32
+#include <thread>
+#endif
+
+namespace vosvideo
+{
+	namespace camera
+	{
+		// Calls back once watched process exits. Uses wait handle on Windows and pidfd (waitpid as fallback) on Linux,
+		// so exit is noticed immediately instead of by polling.
+		// Callback runs on a system thread, it must be short and must not destroy the watcher.
+		class ProcessExitWatcher final
+		{
+		public:
+			ProcessExitWatcher(int32_t pid, std::function<void()> onExit);
+			~ProcessExitWatcher();
+
+			// Forcefully terminates watched process, exit callback follows
+			void Kill();
+
+		private:
+#ifdef _WIN32
+			static void CALLBACK OnProcessSignaled(PVOID context, BOOLEAN timedOut);
+
+			HANDLE process_ = nullptr;
+			HANDLE wait_ = nullptr;
+#else
+			void WatchLoop();
+
+			std::thread watchThr_;
+			int cancelFds_[2];
+#endif
+			int32_t pid_;
+			std::function<void()> onExit_;
+		};
+	}
+}
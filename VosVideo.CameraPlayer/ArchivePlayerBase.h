@@ -0,0 +1,19 @@
+#pragma once
+#include "CameraPlayerBase.h"
+
+namespace vosvideo
+{
+	namespace cameraplayer
+	{
+		// Plays one recording of camera through the same capturer interface as live player.
+		// Recording is given by file name, player looks for it in recording folder of CameraConfMsg passed to OpenURL.
+		class ArchivePlayerBase : public CameraPlayerBase
+		{
+		public:
+			// Position is milliseconds from recording start, playback resumes from key frame preceding it
+			virtual int32_t Seek(int64_t position) = 0;
+			// Supported rates are 1, 2 and 4
+			virtual int32_t SetRate(int32_t rate) = 0;
+		};
+	}
+}
@@ -0,0 +1,412 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <boost/date_time/c_local_time_adjustor.hpp>
+#include "AsyncLogQueue.h"
+#include "AsyncLogRing.h"
+
+using namespace std;
+using namespace loggers;
+
+namespace
+{
+	const size_t textCapacity = LogSlot::TextCapacity;
+	const std::chrono::milliseconds writerIdle(10);
+	const std::chrono::seconds dropReportInterval(1);
+
+	// Keeps record text inline while it fits, longer text moves to heap
+	class RecordBuffer final : public std::streambuf
+	{
+	public:
+		void Reset()
+		{
+			spill_.clear();
+			isSpilled_ = false;
+			setp(buffer_, buffer_ + textCapacity);
+		}
+
+		bool IsSpilled() const
+		{
+			return isSpilled_;
+		}
+
+		const char* GetData() const
+		{
+			return pbase();
+		}
+
+		size_t GetSize() const
+		{
+			return pptr() - pbase();
+		}
+
+		std::string* TakeSpilled()
+		{
+			spill_.append(pbase(), pptr());
+			setp(buffer_, buffer_ + textCapacity);
+			return new std::string(std::move(spill_));
+		}
+
+	protected:
+		virtual int_type overflow(int_type ch) override
+		{
+			spill_.append(pbase(), pptr());
+			isSpilled_ = true;
+			setp(buffer_, buffer_ + textCapacity);
+			if (!traits_type::eq_int_type(ch, traits_type::eof()))
+			{
+				spill_.push_back(traits_type::to_char_type(ch));
+			}
+			return traits_type::not_eof(ch);
+		}
+
+	private:
+		char buffer_[textCapacity];
+		std::string spill_;
+		bool isSpilled_ = false;
+	};
+
+	class LogRegistry final
+	{
+	public:
+		// Process may exit without logger being destroyed, running writer must not outlive registry
+		~LogRegistry()
+		{
+			Stop();
+		}
+
+		std::shared_ptr<LogRing> Register()
+		{
+			auto ring = std::make_shared<LogRing>();
+			std::lock_guard<std::mutex> lock(mutex_);
+			rings_.push_back(ring);
+			return ring;
+		}
+
+		// Called by exiting thread. Empty ring is freed at once, otherwise writer frees it once it's written.
+		void Unregister(const std::shared_ptr<LogRing>& ring)
+		{
+			ring->SetOrphan();
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (ring->IsDone())
+			{
+				auto it = std::find(rings_.begin(), rings_.end(), ring);
+				if (it != rings_.end())
+				{
+					removedDropped_ += ring->GetDropped();
+					rings_.erase(it);
+				}
+			}
+		}
+
+		void Start()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (writerThr_.joinable())
+			{
+				return;
+			}
+			stop_ = false;
+			writerThr_ = std::thread([this]
+			{
+				WriterLoop();
+			});
+		}
+
+		void Stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (!writerThr_.joinable())
+				{
+					return;
+				}
+				stop_ = true;
+			}
+			stopCond_.notify_all();
+			writerThr_.join();
+		}
+
+		uint64_t GetDroppedCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			uint64_t dropped = removedDropped_;
+			for (const auto& ring : rings_)
+			{
+				dropped += ring->GetDropped();
+			}
+			return dropped;
+		}
+
+		size_t GetRingCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return rings_.size();
+		}
+
+		static void WriteRecord(severity_level level, const char* function, const std::string& text, 
+			const std::thread::id& threadId, std::chrono::system_clock::time_point time)
+		{
+			auto sinceEpoch = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+			boost::posix_time::ptime utc = boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1)) +
+				boost::posix_time::microseconds(sinceEpoch);
+
+			logging::attribute_set recordAttrs;
+			recordAttrs.insert("Severity", attrs::constant<severity_level>(level));
+			recordAttrs.insert("TimeStamp", attrs::constant<boost::posix_time::ptime>(
+				boost::date_time::c_local_adjustor<boost::posix_time::ptime>::utc_to_local(utc)));
+			recordAttrs.insert("ThreadID", attrs::constant<std::thread::id>(threadId));
+			recordAttrs.insert("Function", attrs::constant<std::string>(function ? function : ""));
+
+			logging::record rec = logging::core::get()->open_record(recordAttrs);
+			if (rec)
+			{
+				logging::record_ostream strm(rec);
+				strm << text;
+				strm.flush();
+				logging::core::get()->push_record(boost::move(rec));
+			}
+		}
+
+	private:
+		void WriterLoop()
+		{
+			uint64_t reportedDropped = 0;
+			auto lastReport = std::chrono::steady_clock::now();
+			for (;;)
+			{
+				size_t written = DrainAll();
+				if (written > 0)
+				{
+					// One flush per batch instead of one per record
+					logging::core::get()->flush();
+				}
+
+				auto now = std::chrono::steady_clock::now();
+				if (now - lastReport >= dropReportInterval)
+				{
+					lastReport = now;
+					uint64_t dropped = GetDroppedCount();
+					if (dropped != reportedDropped)
+					{
+						WriteRecord(vv_warning, "AsyncLogQueue", std::to_string(dropped - reportedDropped) + " log records dropped, " +
+							std::to_string(dropped) + " in total", std::this_thread::get_id(), std::chrono::system_clock::now());
+						logging::core::get()->flush();
+						reportedDropped = dropped;
+					}
+				}
+
+				std::unique_lock<std::mutex> lock(mutex_);
+				if (stop_)
+				{
+					break;
+				}
+				if (written == 0)
+				{
+					stopCond_.wait_for(lock, writerIdle, [this] { return stop_; });
+				}
+			}
+
+			DrainAll();
+			logging::core::get()->flush();
+		}
+
+		size_t DrainAll()
+		{
+			vector<shared_ptr<LogRing>> rings;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				rings = rings_;
+			}
+
+			size_t written = 0;
+			for (const auto& ring : rings)
+			{
+				written += ring->Drain([this](const LogSlot& slot, const std::thread::id& threadId)
+				{
+					string text = slot.LongText ? *slot.LongText : string(slot.Text, slot.Size);
+					auto time = std::chrono::system_clock::time_point(std::chrono::microseconds(slot.Time));
+					WriteRecord(slot.Level, slot.Function, text, threadId, time);
+				});
+			}
+
+			// Rings of finished threads go once everything they had is written
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (auto it = rings_.begin(); it != rings_.end(); )
+			{
+				if ((*it)->IsDone())
+				{
+					removedDropped_ += (*it)->GetDropped();
+					it = rings_.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			return written;
+		}
+
+		std::mutex mutex_;
+		vector<shared_ptr<LogRing>> rings_;
+		uint64_t removedDropped_ = 0;
+		std::thread writerThr_;
+		std::condition_variable stopCond_;
+		bool stop_ = false;
+	};
+
+	LogRegistry& GetRegistry()
+	{
+		static LogRegistry registry;
+		return registry;
+	}
+}
+
+namespace loggers
+{
+	class AsyncLogThread final
+	{
+	public:
+		AsyncLogThread() : Stream(&Buffer), Ring(GetRegistry().Register())
+		{
+		}
+
+		~AsyncLogThread()
+		{
+			GetRegistry().Unregister(Ring);
+		}
+
+		RecordBuffer Buffer;
+		std::ostream Stream;
+		std::shared_ptr<LogRing> Ring;
+		int Depth = 0;
+	};
+}
+
+namespace
+{
+	AsyncLogThread& GetThreadLog()
+	{
+		thread_local AsyncLogThread threadLog;
+		return threadLog;
+	}
+}
+
+std::atomic<int> AsyncLogQueue::minSeverity_(AsyncLogQueue::disabled_);
+
+void AsyncLogQueue::Start(severity_level minSeverity)
+{
+	GetRegistry().Start();
+	minSeverity_.store(minSeverity, std::memory_order_relaxed);
+}
+
+void AsyncLogQueue::Stop()
+{
+	minSeverity_.store(disabled_, std::memory_order_relaxed);
+	GetRegistry().Stop();
+}
+
+void AsyncLogQueue::SetMinSeverity(severity_level minSeverity)
+{
+	// Writer may be stopping meanwhile, then few records more are queued and never written
+	if (minSeverity_.load(std::memory_order_relaxed) != disabled_)
+	{
+		minSeverity_.store(minSeverity, std::memory_order_relaxed);
+	}
+}
+
+uint64_t AsyncLogQueue::GetDroppedCount()
+{
+	return GetRegistry().GetDroppedCount();
+}
+
+size_t AsyncLogQueue::GetThreadCount()
+{
+	return GetRegistry().GetRingCount();
+}
+
+AsyncLogRecorder::AsyncLogRecorder(severity_level level, const char* function) :
+	level_(level),
+	function_(function),
+	time_(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
+{
+	AsyncLogThread& threadLog = GetThreadLog();
+	// Errors are never dropped, Commit writes them right away if ring is still full
+	if (level < vv_error && threadLog.Ring->IsFull())
+	{
+		threadLog.Ring->CountDrop();
+		return;
+	}
+
+	thread_ = &threadLog;
+	if (threadLog.Depth++ == 0)
+	{
+		threadLog.Buffer.Reset();
+		threadLog.Stream.clear();
+		stream_ = &threadLog.Stream;
+	}
+	else
+	{
+		// Arguments of outer record are still being formatted into thread's buffer
+		nested_.reset(new std::ostringstream());
+		stream_ = nested_.get();
+	}
+}
+
+AsyncLogRecorder::~AsyncLogRecorder()
+{
+	if (thread_)
+	{
+		--thread_->Depth;
+	}
+}
+
+void AsyncLogRecorder::Commit()
+{
+	if (!thread_)
+	{
+		return;
+	}
+
+	string nestedText;
+	const char* text = nullptr;
+	size_t size = 0;
+	std::string* longText = nullptr;
+	if (nested_)
+	{
+		nestedText = nested_->str();
+		if (nestedText.size() > textCapacity)
+		{
+			longText = new std::string(std::move(nestedText));
+		}
+		else
+		{
+			text = nestedText.data();
+			size = nestedText.size();
+		}
+	}
+	else if (thread_->Buffer.IsSpilled())
+	{
+		longText = thread_->Buffer.TakeSpilled();
+	}
+	else
+	{
+		text = thread_->Buffer.GetData();
+		size = thread_->Buffer.GetSize();
+	}
+
+	if (level_ >= vv_error && thread_->Ring->IsFull())
+	{
+		// Written ahead of records still queued by this thread, sinks are thread safe
+		std::unique_ptr<std::string> ownedText(longText);
+		auto time = std::chrono::system_clock::time_point(std::chrono::microseconds(time_));
+		LogRegistry::WriteRecord(level_, function_, longText ? *longText : string(text, size), std::this_thread::get_id(), time);
+		logging::core::get()->flush();
+		return;
+	}
+	thread_->Ring->Push(time_, level_, function_, text, size, longText);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include "LoggersCommon.h"
+
+namespace loggers
+{
+	class AsyncLogThread;
+
+	// Log records are formatted on caller's thread into that thread's own ring and handed to sinks
+	// by background writer. Ring has single producer and single consumer, so logging takes no lock,
+	// allocates nothing for usual record and never waits for disk. Record which doesn't fit into
+	// full ring is dropped and counted, writer reports drops into the log itself. Error and critical
+	// records are not dropped, with full ring they are written to sinks from caller's thread.
+	class AsyncLogQueue final
+	{
+	public:
+		// Records made before start are skipped, it's the case when logging is off
+		static void Start(severity_level minSeverity);
+		// Writes pending records, then stops writer
+		static void Stop();
+		// Checked by LOG_* macros before arguments are touched, relaxed load costs as much as plain one
+		static bool IsEnabled(severity_level level)
+		{
+			return static_cast<int>(level) >= minSeverity_.load(std::memory_order_relaxed);
+		}
+		// Takes effect while writer is running
+		static void SetMinSeverity(severity_level minSeverity);
+		// Records lost because ring of their thread was full
+		static uint64_t GetDroppedCount();
+		// Threads with ring, finished thread counts until its records are written
+		static size_t GetThreadCount();
+
+	private:
+		// Above any severity while writer is stopped
+		static const int disabled_ = vv_critical + 1;
+		static std::atomic<int> minSeverity_;
+	};
+
+	// Record being made by LOG_* macro
+	class AsyncLogRecorder final
+	{
+	public:
+		AsyncLogRecorder(severity_level level, const char* function);
+		~AsyncLogRecorder();
+
+		// False if record will be dropped, its arguments are not formatted then
+		bool IsActive() const
+		{
+			return stream_ != nullptr;
+		}
+		std::ostream& Stream()
+		{
+			return *stream_;
+		}
+		void Commit();
+
+	private:
+		AsyncLogRecorder(const AsyncLogRecorder&) = delete;
+		AsyncLogRecorder& operator=(const AsyncLogRecorder&) = delete;
+
+		severity_level level_;
+		const char* function_;
+		int64_t time_;
+		AsyncLogThread* thread_ = nullptr;
+		std::ostream* stream_ = nullptr;
+		// Record made while formatting another one on the same thread
+		std::unique_ptr<std::ostringstream> nested_;
+	};
+}
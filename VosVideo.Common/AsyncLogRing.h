@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include "LoggersCommon.h"
+
+namespace loggers
+{
+	struct LogSlot
+	{
+		static const size_t TextCapacity = 224;
+
+		// Microseconds from Unix epoch
+		int64_t Time;
+		severity_level Level;
+		const char* Function;
+		uint32_t Size;
+		// Text longer than inline buffer, owned by slot until written
+		std::string* LongText;
+		char Text[TextCapacity];
+	};
+
+	// Records of one logging thread waiting for writer, owning thread is the only producer and writer the only consumer.
+	// Ring is allocated by thread's first record and freed when thread exits, its slots are reused meanwhile.
+	// 32 KB per logging thread; writer drains rings every few milliseconds, longer text goes to heap.
+	class LogRing final
+	{
+	public:
+		static const uint32_t Capacity = 128;
+
+		LogRing() : slots_(new LogSlot[Capacity]), head_(0), tail_(0), dropped_(0), isOrphan_(false), threadId_(std::this_thread::get_id())
+		{
+		}
+
+		~LogRing()
+		{
+			for (uint32_t i = tail_.load(); i != head_.load(); ++i)
+			{
+				delete slots_[i % Capacity].LongText;
+			}
+		}
+
+		// Producer side
+		bool IsFull() const
+		{
+			return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire) >= Capacity;
+		}
+
+		void CountDrop()
+		{
+			// Only owning thread writes, readers take any recent value
+			dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		// Takes ownership of longText, text is copied unless longText is given
+		bool Push(int64_t time, severity_level level, const char* function, const char* text, size_t size, std::string* longText)
+		{
+			if (IsFull())
+			{
+				CountDrop();
+				delete longText;
+				return false;
+			}
+
+			uint32_t head = head_.load(std::memory_order_relaxed);
+			LogSlot& slot = slots_[head % Capacity];
+			slot.Time = time;
+			slot.Level = level;
+			slot.Function = function;
+			slot.LongText = longText;
+			slot.Size = static_cast<uint32_t>(longText ? 0 : size);
+			if (!longText)
+			{
+				memcpy(slot.Text, text, size);
+			}
+			head_.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		void SetOrphan()
+		{
+			isOrphan_.store(true, std::memory_order_release);
+		}
+
+		// Consumer side, writer is called with slot and id of owning thread
+		template <typename Writer>
+		size_t Drain(Writer writer)
+		{
+			uint32_t tail = tail_.load(std::memory_order_relaxed);
+			uint32_t head = head_.load(std::memory_order_acquire);
+			for (uint32_t i = tail; i != head; ++i)
+			{
+				LogSlot& slot = slots_[i % Capacity];
+				writer(slot, threadId_);
+				delete slot.LongText;
+				slot.LongText = nullptr;
+			}
+			tail_.store(head, std::memory_order_release);
+			return head - tail;
+		}
+
+		// Owning thread is gone and everything it logged is written
+		bool IsDone() const
+		{
+			return isOrphan_.load(std::memory_order_acquire) &&
+				head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+		}
+
+		uint64_t GetDropped() const
+		{
+			return dropped_.load(std::memory_order_relaxed);
+		}
+
+	private:
+		LogRing(const LogRing&) = delete;
+		LogRing& operator=(const LogRing&) = delete;
+
+		std::unique_ptr<LogSlot[]> slots_;
+		std::atomic<uint32_t> head_;
+		std::atomic<uint32_t> tail_;
+		std::atomic<uint64_t> dropped_;
+		std::atomic<bool> isOrphan_;
+		std::thread::id threadId_;
+	};
+}
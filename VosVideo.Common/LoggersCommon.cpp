@@ -25,8 +25,8 @@ LoggersCommon::~LoggersCommon()
 {
 	if (_pSink != nullptr)
 	{
-		_pSink->stop();
-		_pSink->feed_records();
+		logging::core::get()->remove_sink(_pSink);
+		_pSink->flush();
 	}
 }
 
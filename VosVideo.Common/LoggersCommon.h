@@ -70,7 +70,8 @@ namespace loggers
 		std::string _logPrefix;
 
 		static const int _minFreeSpaceSize = 50;
-		using text_sink = sinks::asynchronous_sink< sinks::text_file_backend >;
+		// Records come from AsyncLogQueue writer thread only, sink itself doesn't queue them again
+		using text_sink = sinks::synchronous_sink< sinks::text_file_backend >;
 		boost::shared_ptr< text_sink > _pSink;
 		const std::string _loggerSeparator = ";";
 		const std::string _fNamePattern = "%Y-%m-%d_%H-%M-%S";
@@ -0,0 +1,479 @@
+#include "stdafx.h"
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+#include "Metrics.h"
+
+using namespace std;
+using namespace metrics;
+
+namespace
+{
+	uint32_t GetMostSignificantBit(uint64_t value)
+	{
+		uint32_t bit = 0;
+		for (uint32_t shift = 32; shift > 0; shift /= 2)
+		{
+			if (value >> shift)
+			{
+				value >>= shift;
+				bit += shift;
+			}
+		}
+		return bit;
+	}
+
+	const char* GetTypeName(MetricType type)
+	{
+		switch (type)
+		{
+		case MetricType::Counter:
+			return "counter";
+		case MetricType::Gauge:
+			return "gauge";
+		default:
+			return "histogram";
+		}
+	}
+}
+
+Histogram::Histogram() : sum_(0)
+{
+	for (auto& bucket : buckets_)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+void Histogram::Record(uint64_t valueUs)
+{
+	buckets_[GetBucketIndex(valueUs)].fetch_add(1, std::memory_order_relaxed);
+	sum_.fetch_add(valueUs, std::memory_order_relaxed);
+}
+
+void Histogram::Record(std::chrono::steady_clock::duration elapsed)
+{
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+	Record(us > 0 ? static_cast<uint64_t>(us) : 0);
+}
+
+void Histogram::Fill(MetricSample& sample) const
+{
+	sample.Buckets.clear();
+	sample.Count = 0;
+	for (uint32_t i = 0; i < bucketCount_; ++i)
+	{
+		uint64_t count = buckets_[i].load(std::memory_order_relaxed);
+		if (count > 0)
+		{
+			sample.Buckets.push_back(make_pair(i, count));
+			// Counted from buckets, so total always matches them while recording goes on
+			sample.Count += count;
+		}
+	}
+	sample.Sum = sum_.load(std::memory_order_relaxed);
+}
+
+uint32_t Histogram::GetBucketIndex(uint64_t valueUs)
+{
+	const uint64_t maxValue = (1ULL << maxValueBits_) - 1;
+	if (valueUs > maxValue)
+	{
+		valueUs = maxValue;
+	}
+	if (valueUs < (2ULL << subBucketBits_))
+	{
+		return static_cast<uint32_t>(valueUs);
+	}
+
+	uint32_t shift = GetMostSignificantBit(valueUs) - subBucketBits_;
+	return (shift << subBucketBits_) + static_cast<uint32_t>(valueUs >> shift);
+}
+
+uint64_t Histogram::GetBucketUpperBound(uint32_t index)
+{
+	if (index < (2U << subBucketBits_))
+	{
+		return index;
+	}
+
+	uint32_t shift = (index >> subBucketBits_) - 1;
+	uint64_t subBucket = index - (shift << subBucketBits_);
+	return ((subBucket + 1) << shift) - 1;
+}
+
+const std::chrono::seconds MetricsRegistry::remoteTimeout_(30);
+const std::vector<uint64_t> MetricsRegistry::exportBucketBounds_ =
+{
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000
+};
+
+MetricsRegistry::MetricsRegistry()
+{
+}
+
+MetricsRegistry& MetricsRegistry::Instance()
+{
+	static MetricsRegistry registry;
+	return registry;
+}
+
+std::shared_ptr<Counter> MetricsRegistry::GetCounter(const std::string& name, const std::string& help, const LabelSet& labels)
+{
+	lock_guard<std::mutex> lock(mutex_);
+	auto& series = GetSeries(name, help, MetricType::Counter, labels);
+	if (!series.CounterMetric)
+	{
+		series.CounterMetric = make_shared<Counter>();
+	}
+	return series.CounterMetric;
+}
+
+std::shared_ptr<Gauge> MetricsRegistry::GetGauge(const std::string& name, const std::string& help, const LabelSet& labels)
+{
+	lock_guard<std::mutex> lock(mutex_);
+	auto& series = GetSeries(name, help, MetricType::Gauge, labels);
+	if (!series.GaugeMetric)
+	{
+		series.GaugeMetric = make_shared<Gauge>();
+	}
+	return series.GaugeMetric;
+}
+
+std::shared_ptr<Histogram> MetricsRegistry::GetHistogram(const std::string& name, const std::string& help, const LabelSet& labels)
+{
+	lock_guard<std::mutex> lock(mutex_);
+	auto& series = GetSeries(name, help, MetricType::Histogram, labels);
+	if (!series.HistogramMetric)
+	{
+		series.HistogramMetric = make_shared<Histogram>();
+	}
+	return series.HistogramMetric;
+}
+
+void MetricsRegistry::RemoveSeries(const std::string& labelName, const std::string& labelValue)
+{
+	auto label = make_pair(labelName, labelValue);
+	lock_guard<std::mutex> lock(mutex_);
+	for (auto iter = series_.begin(); iter != series_.end();)
+	{
+		const auto& labels = iter->second.Meta.Labels;
+		if (std::find(labels.begin(), labels.end(), label) != labels.end())
+		{
+			iter = series_.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+uint32_t MetricsRegistry::AddCollector(Collector collector)
+{
+	lock_guard<std::mutex> lock(collectorsMutex_);
+	uint32_t id = nextCollectorId_++;
+	collectors_.push_back(make_pair(id, collector));
+	return id;
+}
+
+void MetricsRegistry::RemoveCollector(uint32_t id)
+{
+	lock_guard<std::mutex> lock(collectorsMutex_);
+	collectors_.erase(std::remove_if(collectors_.begin(), collectors_.end(), [id](const pair<uint32_t, Collector>& c)
+	{
+		return c.first == id;
+	}), collectors_.end());
+}
+
+std::vector<MetricSample> MetricsRegistry::Snapshot()
+{
+	vector<MetricSample> samples;
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		samples.reserve(series_.size());
+		for (const auto& s : series_)
+		{
+			MetricSample sample = s.second.Meta;
+			switch (sample.Type)
+			{
+			case MetricType::Counter:
+				sample.Value = static_cast<int64_t>(s.second.CounterMetric->Get());
+				break;
+			case MetricType::Gauge:
+				sample.Value = s.second.GaugeMetric->Get();
+				break;
+			case MetricType::Histogram:
+				s.second.HistogramMetric->Fill(sample);
+				break;
+			}
+			samples.push_back(std::move(sample));
+		}
+	}
+
+	size_t collectedFrom = samples.size();
+	{
+		lock_guard<std::mutex> lock(collectorsMutex_);
+		for (const auto& c : collectors_)
+		{
+			c.second(samples);
+		}
+	}
+	for (size_t i = collectedFrom; i < samples.size(); ++i)
+	{
+		samples[i].Labels = Normalize(samples[i].Labels);
+	}
+	return samples;
+}
+
+void MetricsRegistry::MergeRemote(const std::string& source, const LabelSet& labels, const std::vector<MetricSample>& samples,
+	std::chrono::steady_clock::time_point now)
+{
+	lock_guard<std::mutex> lock(mutex_);
+	ExpireRemote(now);
+
+	for (const auto& sample : samples)
+	{
+		RemoteSeries remote;
+		remote.Sample = sample;
+		remote.UpdatedAt = now;
+		for (const auto& label : labels)
+		{
+			auto& sampleLabels = remote.Sample.Labels;
+			if (std::find_if(sampleLabels.begin(), sampleLabels.end(), [&label](const pair<string, string>& l) { return l.first == label.first; }) == sampleLabels.end())
+			{
+				sampleLabels.push_back(label);
+			}
+		}
+		remote.Sample.Labels = Normalize(remote.Sample.Labels);
+		remote_[source + '\n' + MakeKey(remote.Sample.Name, remote.Sample.Labels)] = std::move(remote);
+	}
+}
+
+void MetricsRegistry::WritePrometheus(std::ostream& out)
+{
+	auto samples = Snapshot();
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		ExpireRemote(std::chrono::steady_clock::now());
+		for (const auto& r : remote_)
+		{
+			samples.push_back(r.second.Sample);
+		}
+	}
+
+	// Key starts with name, so series of one metric follow each other
+	map<string, MetricSample> merged;
+	for (auto& sample : samples)
+	{
+		string key = MakeKey(sample.Name, sample.Labels);
+		auto iter = merged.find(key);
+		if (iter == merged.end())
+		{
+			merged.insert(make_pair(key, std::move(sample)));
+		}
+		else if (iter->second.Type == sample.Type)
+		{
+			MergeSample(iter->second, sample);
+		}
+	}
+
+	auto precision = out.precision(12);
+	const string* currentName = nullptr;
+	for (const auto& m : merged)
+	{
+		const MetricSample& sample = m.second;
+		if (!currentName || *currentName != sample.Name)
+		{
+			currentName = &sample.Name;
+			out << "# HELP " << sample.Name << " ";
+			WriteEscaped(out, sample.Help, false);
+			out << "\n# TYPE " << sample.Name << " " << GetTypeName(sample.Type) << "\n";
+		}
+
+		if (sample.Type != MetricType::Histogram)
+		{
+			out << sample.Name;
+			WriteLabels(out, sample.Labels);
+			out << " " << sample.Value << "\n";
+			continue;
+		}
+
+		size_t bucket = 0;
+		uint64_t cumulative = 0;
+		for (auto bound : exportBucketBounds_)
+		{
+			while (bucket < sample.Buckets.size() && Histogram::GetBucketUpperBound(sample.Buckets[bucket].first) <= bound)
+			{
+				cumulative += sample.Buckets[bucket].second;
+				++bucket;
+			}
+			ostringstream le;
+			le.precision(12);
+			le << static_cast<double>(bound) / 1000000;
+			out << sample.Name << "_bucket";
+			WriteLabels(out, sample.Labels, "le", le.str());
+			out << " " << cumulative << "\n";
+		}
+		out << sample.Name << "_bucket";
+		WriteLabels(out, sample.Labels, "le", "+Inf");
+		out << " " << sample.Count << "\n";
+		out << sample.Name << "_sum";
+		WriteLabels(out, sample.Labels);
+		out << " " << static_cast<double>(sample.Sum) / 1000000 << "\n";
+		out << sample.Name << "_count";
+		WriteLabels(out, sample.Labels);
+		out << " " << sample.Count << "\n";
+	}
+	out.precision(precision);
+}
+
+MetricSample MetricsRegistry::MakeSample(const std::string& name, const std::string& help, MetricType type, const LabelSet& labels, int64_t value)
+{
+	MetricSample sample;
+	sample.Name = name;
+	sample.Help = help;
+	sample.Type = type;
+	sample.Labels = labels;
+	sample.Value = value;
+	return sample;
+}
+
+MetricsRegistry::Series& MetricsRegistry::GetSeries(const std::string& name, const std::string& help, MetricType type, const LabelSet& labels)
+{
+	LabelSet normalized = Normalize(labels);
+	string key = MakeKey(name, normalized);
+	auto iter = series_.find(key);
+	if (iter != series_.end())
+	{
+		if (iter->second.Meta.Type != type)
+		{
+			throw std::runtime_error("Metric " + name + " is already registered with another type");
+		}
+		return iter->second;
+	}
+
+	Series& series = series_[key];
+	series.Meta.Name = name;
+	series.Meta.Help = help;
+	series.Meta.Type = type;
+	series.Meta.Labels = normalized;
+	return series;
+}
+
+void MetricsRegistry::ExpireRemote(std::chrono::steady_clock::time_point now)
+{
+	for (auto iter = remote_.begin(); iter != remote_.end();)
+	{
+		if (now - iter->second.UpdatedAt > remoteTimeout_)
+		{
+			iter = remote_.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+LabelSet MetricsRegistry::Normalize(const LabelSet& labels)
+{
+	LabelSet normalized = labels;
+	std::sort(normalized.begin(), normalized.end());
+	return normalized;
+}
+
+std::string MetricsRegistry::MakeKey(const std::string& name, const LabelSet& labels)
+{
+	// Separator sorts before any character of name, so "a" series don't interleave with "a_b" ones
+	string key = name;
+	for (const auto& label : labels)
+	{
+		key += '\x01';
+		key += label.first;
+		key += '=';
+		key += label.second;
+	}
+	return key;
+}
+
+void MetricsRegistry::MergeSample(MetricSample& target, const MetricSample& source)
+{
+	if (target.Type != MetricType::Histogram)
+	{
+		target.Value += source.Value;
+		return;
+	}
+
+	// Both bucket lists are ordered by index
+	vector<pair<uint32_t, uint64_t>> buckets;
+	buckets.reserve(target.Buckets.size() + source.Buckets.size());
+	size_t i = 0;
+	size_t j = 0;
+	while (i < target.Buckets.size() || j < source.Buckets.size())
+	{
+		if (j == source.Buckets.size() || (i < target.Buckets.size() && target.Buckets[i].first < source.Buckets[j].first))
+		{
+			buckets.push_back(target.Buckets[i++]);
+		}
+		else if (i == target.Buckets.size() || source.Buckets[j].first < target.Buckets[i].first)
+		{
+			buckets.push_back(source.Buckets[j++]);
+		}
+		else
+		{
+			buckets.push_back(make_pair(target.Buckets[i].first, target.Buckets[i].second + source.Buckets[j].second));
+			++i;
+			++j;
+		}
+	}
+	target.Buckets.swap(buckets);
+	target.Count += source.Count;
+	target.Sum += source.Sum;
+}
+
+void MetricsRegistry::WriteLabels(std::ostream& out, const LabelSet& labels, const char* extraName, const std::string& extraValue)
+{
+	if (labels.empty() && !extraName)
+	{
+		return;
+	}
+
+	out << "{";
+	bool isFirst = true;
+	for (const auto& label : labels)
+	{
+		out << (isFirst ? "" : ",") << label.first << "=\"";
+		WriteEscaped(out, label.second, true);
+		out << "\"";
+		isFirst = false;
+	}
+	if (extraName)
+	{
+		out << (isFirst ? "" : ",") << extraName << "=\"" << extraValue << "\"";
+	}
+	out << "}";
+}
+
+void MetricsRegistry::WriteEscaped(std::ostream& out, const std::string& text, bool isLabelValue)
+{
+	for (char c : text)
+	{
+		if (c == '\\')
+		{
+			out << "\\\\";
+		}
+		else if (c == '\n')
+		{
+			out << "\\n";
+		}
+		else if (c == '"' && isLabelValue)
+		{
+			out << "\\\"";
+		}
+		else
+		{
+			out << c;
+		}
+	}
+}
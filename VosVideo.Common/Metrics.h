@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <functional>
+#include <unordered_map>
+
+namespace metrics
+{
+	// Label name and value pairs, order doesn't matter
+	typedef std::vector<std::pair<std::string, std::string>> LabelSet;
+
+	enum class MetricType
+	{
+		Counter = 0,
+		Gauge = 1,
+		// Durations in microseconds, exported in seconds
+		Histogram = 2
+	};
+
+	// Value of one series at the moment of snapshot, in this form series travel between processes
+	struct MetricSample
+	{
+		std::string Name;
+		std::string Help;
+		MetricType Type = MetricType::Counter;
+		LabelSet Labels;
+		// Counter and gauge
+		int64_t Value = 0;
+		// Histogram only, non-empty buckets as bucket index and count
+		std::vector<std::pair<uint32_t, uint64_t>> Buckets;
+		uint64_t Count = 0;
+		uint64_t Sum = 0;
+	};
+
+	class Counter final
+	{
+	public:
+		Counter() : value_(0) {}
+
+		void Increment(uint64_t delta = 1)
+		{
+			value_.fetch_add(delta, std::memory_order_relaxed);
+		}
+		uint64_t Get() const
+		{
+			return value_.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<uint64_t> value_;
+	};
+
+	class Gauge final
+	{
+	public:
+		Gauge() : value_(0) {}
+
+		void Set(int64_t value)
+		{
+			value_.store(value, std::memory_order_relaxed);
+		}
+		void Add(int64_t delta)
+		{
+			value_.fetch_add(delta, std::memory_order_relaxed);
+		}
+		int64_t Get() const
+		{
+			return value_.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<int64_t> value_;
+	};
+
+	// Log-linear buckets in the manner of HdrHistogram: values below 32 us have own bucket, every next
+	// power of two range is split into 16 buckets. So any value up to 12 days is kept with 6% precision,
+	// recording is a bucket index computation and relaxed increments, no lock and no allocation.
+	class Histogram final
+	{
+	public:
+		Histogram();
+
+		void Record(uint64_t valueUs);
+		void Record(std::chrono::steady_clock::duration elapsed);
+		void Fill(MetricSample& sample) const;
+
+		static uint32_t GetBucketIndex(uint64_t valueUs);
+		// Largest value which falls into bucket
+		static uint64_t GetBucketUpperBound(uint32_t index);
+
+		static const uint32_t subBucketBits_ = 4;
+		static const uint32_t maxValueBits_ = 40;
+		static const uint32_t bucketCount_ = (maxValueBits_ - subBucketBits_ + 1) << subBucketBits_;
+
+	private:
+		std::array<std::atomic<uint64_t>, bucketCount_> buckets_;
+		std::atomic<uint64_t> sum_;
+	};
+
+	// Process wide set of metrics. Series is created once by name and labels and then updated through
+	// returned object, which costs an atomic add. Text for Prometheus is made on request only.
+	class MetricsRegistry final
+	{
+	public:
+		// Adds samples of stats kept elsewhere, called every time metrics are read
+		typedef std::function<void(std::vector<MetricSample>&)> Collector;
+
+		static MetricsRegistry& Instance();
+
+		// Same name and labels give the same object, so it can be looked up instead of being passed around
+		std::shared_ptr<Counter> GetCounter(const std::string& name, const std::string& help, const LabelSet& labels = LabelSet());
+		std::shared_ptr<Gauge> GetGauge(const std::string& name, const std::string& help, const LabelSet& labels = LabelSet());
+		std::shared_ptr<Histogram> GetHistogram(const std::string& name, const std::string& help, const LabelSet& labels = LabelSet());
+		// Series carrying label, like all series of a closed peer connection, are not exported any more
+		void RemoveSeries(const std::string& labelName, const std::string& labelValue);
+
+		uint32_t AddCollector(Collector collector);
+		// Collector is not running and won't be called once this returns
+		void RemoveCollector(uint32_t id);
+
+		// Local series and samples of collectors
+		std::vector<MetricSample> Snapshot();
+		// Samples reported by another process, labels are added to every sample which doesn't have them.
+		// Sample replaces previous one of the same series and source, series not reported for remoteTimeout_ is dropped.
+		// Report time is taken as now unless given.
+		void MergeRemote(const std::string& source, const LabelSet& labels, const std::vector<MetricSample>& samples,
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+		// Prometheus text format 0.0.4 of local and remote series. Equal series of different sources are summed,
+		// histograms are exported with coarse fixed buckets, full resolution stays for merging only.
+		void WritePrometheus(std::ostream& out);
+
+		static MetricSample MakeSample(const std::string& name, const std::string& help, MetricType type, const LabelSet& labels, int64_t value);
+
+	private:
+		struct Series
+		{
+			MetricSample Meta;
+			std::shared_ptr<Counter> CounterMetric;
+			std::shared_ptr<Gauge> GaugeMetric;
+			std::shared_ptr<Histogram> HistogramMetric;
+		};
+
+		struct RemoteSeries
+		{
+			MetricSample Sample;
+			std::chrono::steady_clock::time_point UpdatedAt;
+		};
+
+		MetricsRegistry();
+		MetricsRegistry(const MetricsRegistry&) = delete;
+		MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+		// Must be called under mutex_, throws if series exists with another type
+		Series& GetSeries(const std::string& name, const std::string& help, MetricType type, const LabelSet& labels);
+		// Must be called under mutex_
+		void ExpireRemote(std::chrono::steady_clock::time_point now);
+
+		static LabelSet Normalize(const LabelSet& labels);
+		static std::string MakeKey(const std::string& name, const LabelSet& labels);
+		static void MergeSample(MetricSample& target, const MetricSample& source);
+		static void WriteLabels(std::ostream& out, const LabelSet& labels, const char* extraName = nullptr, const std::string& extraValue = std::string());
+		static void WriteEscaped(std::ostream& out, const std::string& text, bool isLabelValue);
+
+		std::mutex mutex_;
+		std::unordered_map<std::string, Series> series_;
+		std::unordered_map<std::string, RemoteSeries> remote_;
+
+		// Held while collectors run, so removed one can't be in the middle of a call
+		std::mutex collectorsMutex_;
+		std::vector<std::pair<uint32_t, Collector>> collectors_;
+		uint32_t nextCollectorId_ = 1;
+
+		static const std::chrono::seconds remoteTimeout_;
+		// Upper bounds of exported histogram buckets, microseconds
+		static const std::vector<uint64_t> exportBucketBounds_;
+	};
+}
@@ -1,9 +1,11 @@
 #include "StdAfx.h"
 #include <process.h>
+#include <thread>
 #include <boost/thread.hpp>
 #include <boost/log/sinks/sync_frontend.hpp>
 #include "SeverityLogger.h"
 #include "StringUtil.h"
+#include "Metrics.h"
 
 using namespace std;
 using namespace loggers;
@@ -32,9 +34,10 @@ SeverityLogger::SeverityLogger(
 		keywords::min_free_space = _minFreeSpaceSize * 1024 * 1024
 	));
 
-	// Ok, we're ready to add the sink to the logging library
+	// Ok, we're ready to add the sink to the logging library.
+	// Only AsyncLogQueue writer feeds the sink, it flushes once per batch of records.
 	logging::core::get()->add_sink(_pSink);
-	_pSink->locked_backend()->auto_flush(true);
+	_pSink->locked_backend()->auto_flush(false);
 
 	// Each logging record may have a number of attributes in addition to the
 	// message body itself. By setting up formatter we define which of them
@@ -44,16 +47,12 @@ SeverityLogger::SeverityLogger(
 		expr::stream
 		<< expr::format_date_time< boost::posix_time::ptime >("TimeStamp", "%Y-%m-%d %H:%M:%S.%f") << _loggerSeparator 
 		<< "[" << expr::attr< severity_level >("Severity") << "]"<< _loggerSeparator 
-		<< "[" << boost::this_thread::get_id() << "]" << _loggerSeparator
-		<< "[" << expr::format_named_scope("Scope", keywords::format = "%n", keywords::iteration = expr::reverse) << "]" << _loggerSeparator
+		<< "[" << expr::attr< std::thread::id >("ThreadID") << "]" << _loggerSeparator
+		<< "[" << expr::attr< std::string >("Function") << "]" << _loggerSeparator
 		<< expr::smessage
 	); // here goes the log record text
 
-	// And similarly add a time stamp
-	logging::core::get()->add_global_attribute("TimeStamp", attrs::local_clock());
-
-	// Let's also track the execution scope from which the records are made
-	logging::core::get()->add_global_attribute("Scope", attrs::named_scope());
+	// Time stamp, thread and function are taken when record is made, they come with the record
 
 	// Now we can set the filter. A filter is essentially a functor that returns
 	// boolean value that tells whether to write the record or not.
@@ -62,5 +61,20 @@ SeverityLogger::SeverityLogger(
 #ifndef _DEBUG // filter out debug level
 	_pSink->set_filter(expr::attr< severity_level >("Severity") > vv_debug); // Write records with "debug" severity also
 #endif
+
+	// Everything above compile time floor until configuration narrows it
+	AsyncLogQueue::Start(vv_debug);
+
+	metricsCollectorId_ = metrics::MetricsRegistry::Instance().AddCollector([](std::vector<metrics::MetricSample>& samples)
+	{
+		samples.push_back(metrics::MetricsRegistry::MakeSample("vosvideo_log_dropped_total", "Log records lost because logging thread's ring was full", 
+			metrics::MetricType::Counter, metrics::LabelSet(), static_cast<int64_t>(AsyncLogQueue::GetDroppedCount())));
+	});
+}
+
+SeverityLogger::~SeverityLogger()
+{
+	metrics::MetricsRegistry::Instance().RemoveCollector(metricsCollectorId_);
+	AsyncLogQueue::Stop();
 }
 
@@ -18,5 +18,11 @@ namespace loggers
 			const std::wstring& wlogPrefix,
 			int nLogFileSizeInMb = 50, 
 			int nMaxRollBackFileLimit = 50);
+		// Writes records still queued
+		virtual ~SeverityLogger();
+
+	private:
+		// Exports count of records lost in full log rings
+		uint32_t metricsCollectorId_ = 0;
 	};
 }
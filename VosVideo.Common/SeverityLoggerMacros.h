@@ -1,47 +1,38 @@
 #pragma once
 
-#include <cassert>
-#include <iostream>
-#include <fstream>
-#include <boost/shared_ptr.hpp>
-#include <boost/log/common.hpp>
-#include <boost/log/attributes.hpp>
-#include <boost/log/sinks.hpp>
-#include <boost/core/null_deleter.hpp>
-#include <boost/log/attributes/scoped_attribute.hpp>
-#include "LoggersCommon.h"
-
-#define LOG_TRACE(txt) \
-do { \
-	BOOST_LOG_NAMED_SCOPE(__FUNCTION__); \
-	src::severity_logger< severity_level > slg; \
-	BOOST_LOG_SEV(slg, vv_trace) << txt; \
-}while (0);
+#include "AsyncLogQueue.h"
 
-#define LOG_DEBUG(txt) \
-do { \
-	BOOST_LOG_NAMED_SCOPE(__FUNCTION__); \
-	src::severity_logger< severity_level > slg; \
-	BOOST_LOG_SEV(slg, vv_debug) << txt; \
-}while (0);
+// Records below compile time floor are compiled out, debug records are kept in debug build only.
+// Define VV_LOG_MIN_SEVERITY in project settings to change it.
+#ifndef VV_LOG_MIN_SEVERITY
+#ifdef _DEBUG
+#define VV_LOG_MIN_SEVERITY vv_debug
+#else
+#define VV_LOG_MIN_SEVERITY vv_trace
+#endif
+#endif
 
-#define LOG_WARNING(txt) \
+// Record is formatted on calling thread and written by AsyncLogQueue writer.
+// Arguments are not evaluated when severity is filtered out or record can't be queued.
+#define LOG_SEVERITY(level, txt) \
 do { \
-	BOOST_LOG_NAMED_SCOPE(__FUNCTION__); \
-	src::severity_logger< severity_level > slg; \
-	BOOST_LOG_SEV(slg, vv_warning) << txt; \
+	if (level >= VV_LOG_MIN_SEVERITY && loggers::AsyncLogQueue::IsEnabled(level)) \
+	{ \
+		loggers::AsyncLogRecorder vvLogRecorder(level, __FUNCTION__); \
+		if (vvLogRecorder.IsActive()) \
+		{ \
+			vvLogRecorder.Stream() << txt; \
+			vvLogRecorder.Commit(); \
+		} \
+	} \
 }while (0);
 
-#define LOG_ERROR(txt) \
-do{ \
-	BOOST_LOG_NAMED_SCOPE(__FUNCTION__); \
-	src::severity_logger< severity_level > slg; \
-	BOOST_LOG_SEV(slg, vv_error) << txt; \
-}while (0);
+#define LOG_TRACE(txt) LOG_SEVERITY(vv_trace, txt)
 
-#define LOG_CRITICAL(txt) \
-do { \
-	BOOST_LOG_NAMED_SCOPE(__FUNCTION__); \
-	src::severity_logger< severity_level > slg; \
-	BOOST_LOG_SEV(slg, vv_critical) << txt; \
-}while (0);
\ No newline at end of file
+#define LOG_DEBUG(txt) LOG_SEVERITY(vv_debug, txt)
+
+#define LOG_WARNING(txt) LOG_SEVERITY(vv_warning, txt)
+
+#define LOG_ERROR(txt) LOG_SEVERITY(vv_error, txt)
+
+#define LOG_CRITICAL(txt) LOG_SEVERITY(vv_critical, txt)
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "stdafx.h"
+#include <sstream>
+#include "VosVideo.Common/Metrics.h"
+#include "CbMetricsHttpServer.h"
+
+using namespace std;
+using namespace util;
+using namespace web::http;
+using namespace web::http::experimental::listener;
+using vosvideo::communication::casablanca::CbMetricsHttpServer;
+
+const std::wstring CbMetricsHttpServer::urlPrefix_ = L"metrics";
+
+CbMetricsHttpServer::CbMetricsHttpServer(uint32_t port) : port_(port)
+{
+}
+
+CbMetricsHttpServer::~CbMetricsHttpServer()
+{
+	Close();
+}
+
+void CbMetricsHttpServer::Open()
+{
+	wstring url = L"http://localhost:" + std::to_wstring(port_) + L"/" + urlPrefix_;
+	listener_.reset(new http_listener(url));
+	listener_->support(methods::GET, std::bind(&CbMetricsHttpServer::HandleGet, this, std::placeholders::_1));
+
+	try
+	{
+		listener_->open().wait();
+		LOG_TRACE("Metrics HTTP server is listening on " << StringUtil::ToString(url));
+	}
+	catch (std::exception& ex)
+	{
+		LOG_ERROR("Metrics HTTP server failed to listen on " << StringUtil::ToString(url) << ": " << ex.what());
+		listener_.reset();
+	}
+}
+
+void CbMetricsHttpServer::Close()
+{
+	if (!listener_)
+	{
+		return;
+	}
+
+	try
+	{
+		listener_->close().wait();
+	}
+	catch (std::exception& ex)
+	{
+		LOG_WARNING("Metrics HTTP server close failed: " << ex.what());
+	}
+	listener_.reset();
+}
+
+void CbMetricsHttpServer::HandleGet(http_request request)
+{
+	if (!uri::split_path(request.relative_uri().path()).empty())
+	{
+		request.reply(status_codes::NotFound);
+		return;
+	}
+
+	ostringstream body;
+	metrics::MetricsRegistry::Instance().WritePrometheus(body);
+
+	http_response response(status_codes::OK);
+	response.set_body(body.str(), "text/plain; version=0.0.4");
+	request.reply(response);
+}
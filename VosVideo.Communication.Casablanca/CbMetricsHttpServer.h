@@ -0,0 +1,31 @@
+#pragma once
+#include <cpprest/http_listener.h>
+
+namespace vosvideo
+{
+	namespace communication
+	{
+		namespace casablanca
+		{
+			// Local HTTP endpoint for Prometheus scraper.
+			//   GET /metrics - metrics of this process and of deviceworkers reporting to it, text format 0.0.4
+			class CbMetricsHttpServer final
+			{
+			public:
+				CbMetricsHttpServer(uint32_t port);
+				~CbMetricsHttpServer();
+
+				void Open();
+				void Close();
+
+			private:
+				void HandleGet(web::http::http_request request);
+
+				uint32_t port_;
+				std::unique_ptr<web::http::experimental::listener::http_listener> listener_;
+
+				static const std::wstring urlPrefix_;
+			};
+		}
+	}
+}
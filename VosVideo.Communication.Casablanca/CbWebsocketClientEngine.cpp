@@ -1,4 +1,7 @@
 #include "stdafx.h"
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
 #include "Vosvideo.Communication/WebsocketClientException.h"
 #include "CbWebsocketClientEngine.h"
 
@@ -10,20 +13,70 @@ using namespace web::web_sockets::client;
 
 const string CbWebsocketClientEngine::Closed = "closed";
 
+#ifdef _DEBUG
+namespace
+{
+	// Set on receive thread only, so allocations of other threads are not counted
+	thread_local std::atomic<uint64_t>* receiveAllocations = nullptr;
+	_CRT_ALLOC_HOOK previousAllocHook = nullptr;
+	std::once_flag allocHookInstalled;
+
+	int __cdecl CountReceiveAllocations(int allocType, void* userData, size_t size, int blockType, long requestNumber, 
+		const unsigned char* fileName, int lineNumber)
+	{
+		if (allocType == _HOOK_ALLOC && receiveAllocations != nullptr)
+		{
+			(*receiveAllocations)++;
+		}
+		return previousAllocHook ? previousAllocHook(allocType, userData, size, blockType, requestNumber, fileName, lineNumber) : TRUE;
+	}
+}
+#endif
+
 CbWebsocketClientEngine::CbWebsocketClientEngine(std::shared_ptr<PubSubService> pubsubService) : 
-	WebsocketClientEngine(pubsubService)
+	WebsocketClientEngine(pubsubService), isClosing_(false), receivedMessages_(0), bufferReallocations_(0), allocations_(0), 
+	problemTask_(pplx::task_from_result())
 {
+#ifdef _DEBUG
+	std::call_once(allocHookInstalled, []
+	{
+		previousAllocHook = _CrtSetAllocHook(&CountReceiveAllocations);
+	});
+#endif
+	outQueue_.reset(new OutboundMessageQueue([this](const std::string& msg)
+	{
+		this->SendImpl(msg);
+	}));
 }
 
 CbWebsocketClientEngine::~CbWebsocketClientEngine()
 {
+	outQueue_->Stop();
+	pplx::task<void> problemTask;
+	{
+		lock_guard<std::mutex> lock(connectionMutex_);
+		CloseClient();
+		problemTask = problemTask_;
+	}
+	// Problem handler could reconnect meanwhile
+	problemTask.wait();
+
+	lock_guard<std::mutex> lock(connectionMutex_);
+	CloseClient();
+	problemTask_.wait();
 }
 
 void CbWebsocketClientEngine::Connect(std::wstring const& wUri)
 {
-	client_.reset(new web::web_sockets::client::websocket_client());
+	lock_guard<std::mutex> lock(connectionMutex_);
+	// Reconnect, previous receive loop has to go away together with its client
+	CloseClient();
 
-	client_->connect(wUri).then([=](pplx::task<void> end_task)
+	auto client = std::make_shared<web::web_sockets::client::websocket_client>();
+	std::atomic_store(&client_, client);
+	isClosing_ = false;
+
+	client->connect(wUri).then([=](pplx::task<void> end_task)
 	{
 		try
 		{
@@ -34,7 +87,7 @@ void CbWebsocketClientEngine::Connect(std::wstring const& wUri)
 			throw WebsocketClientException(StringUtil::ToString(wUri), "Failed to connect WebSocket server.");
 		}
 
-		client_->receive().then([=](websocket_incoming_message msg) 
+		client->receive().then([=](websocket_incoming_message msg) 
 		{
 			if (msg.extract_string().get() == CbWebsocketClientEngine::Closed)
 			{
@@ -46,99 +99,189 @@ void CbWebsocketClientEngine::Connect(std::wstring const& wUri)
 		pubSubService_->Publish(dto);
 
 		//Start listening for incoming messages
-		StartListeningForMessages();
+		StartListeningForMessages(client);
 	}).wait();
 }
 
+// Can be called from any thread, message goes to outbound queue which keeps order and applies backpressure
 void CbWebsocketClientEngine::Send(std::string const& msg)
 {
+	outQueue_->Push(msg);
+}
+
+void CbWebsocketClientEngine::SendImpl(const std::string& msg)
+{
+	// Client is replaced on reconnect
+	auto client = std::atomic_load(&client_);
+	if (!client)
+	{
+		throw WebsocketClientException("", "WebSocket is not connected.");
+	}
+
 	websocket_outgoing_message outgoingMsg = websocket_outgoing_message();
 	outgoingMsg.set_utf8_message(msg);
-	client_->send(outgoingMsg);
+	// Next message is not sent till this one is taken by transport
+	client->send(outgoingMsg).wait();
 }
 
 void CbWebsocketClientEngine::Close()
 {
-	client_->close();
+	lock_guard<std::mutex> lock(connectionMutex_);
+	CloseClient();
 }
 
-void CbWebsocketClientEngine::StartListeningForMessages()
+void CbWebsocketClientEngine::CloseClient()
 {
-	auto background_context = Concurrency::task_continuation_context::use_default();
-
-	//As long as the internal task return true this task will continue to get invoked over and over again.
-	create_task([=]() 
+	isClosing_ = true;
+	auto client = std::atomic_load(&client_);
+	if (client)
 	{
-		AsyncDoWhile([=]()
+		try
 		{
-			return client_->receive().then([=](pplx::task<websocket_incoming_message> inMsgTask)
-			{
-				websocket_incoming_message inMsg = inMsgTask.get();
-
-				return inMsg.extract_string().then([=](pplx::task<std::string> strTask) 
-				{
-					std::string payload = strTask.get();
-					std::shared_ptr<vosvideo::data::WebSocketMessageParser> msgParser(new vosvideo::data::WebSocketMessageParser(payload));
-					LOG_TRACE("Received message with payload:" << payload);
-
-					auto dto = dtoFactory_.Create(msgParser->GetMessageType());
-					dto->Init(msgParser);
-					pubSubService_->Publish(dto);
-				}, 
-					background_context);
-
-			}).then([=](pplx::task<void> end_task)
-			{
-				try
-				{
-					// Return true to continue the asynchronous loop.
-					end_task.get();
-					return true;
-				}
-				catch (websocket_exception& ex)
-				{
-					LOG_ERROR("Websocket Connection failed with a websocket_exception, Error code: "
-						<< ex.error_code() << " Message: " << ex.what());
-					connectionProblemSignal_();
-					return false;
-				}
-				catch (...)
-				{
-					LOG_ERROR("Websocket Connection failed with no error code");
-					throw std::exception("Websocket Connection failed with no error code");
-				}
-
-				// We are here means we encountered some exception.
-				// Return false to break the asynchronous loop.
-				return false;
-			});
-		});
-	}, background_context);
+			client->close().wait();
+		}
+		catch (std::exception& ex)
+		{
+			// Broken connection can't be closed gracefully, receive loop is over anyway
+			LOG_TRACE("Websocket close failed: " << ex.what());
+		}
+	}
+	StopListeningForMessages();
 }
 
-pplx::task<void> CbWebsocketClientEngine::AsyncDoWhile(std::function<pplx::task<bool>(void)> func)
+OutboundQueueStats CbWebsocketClientEngine::GetSendStats()
 {
-	return DoWhileImpl(func).then([](bool){});
+	return outQueue_->GetStats();
 }
 
-pplx::task<bool> CbWebsocketClientEngine::DoWhileIteration(std::function<pplx::task<bool>(void)> func)
+ReceiveLoopStats CbWebsocketClientEngine::GetReceiveStats() const
 {
-	pplx::task_completion_event<bool> ev;
+	ReceiveLoopStats stats;
+	stats.Messages = receivedMessages_.load();
+	stats.BufferReallocations = bufferReallocations_.load();
+	stats.Allocations = allocations_.load();
+	return stats;
+}
 
-	func().then([=](bool task_completed)
+void CbWebsocketClientEngine::StartListeningForMessages(std::shared_ptr<websocket_client> client)
+{
+	if (receiveThr_.joinable())
+	{
+		// Only left by Close called from message handler on receive thread itself
+		throw WebsocketClientException("", "Websocket can't be reconnected from its receive thread.");
+	}
+	receiveThr_ = std::thread([this, client]
 	{
-		ev.set(task_completed);
+		this->ReceiveLoop(client);
 	});
-
-	return pplx::create_task(ev);
 }
 
-pplx::task<bool> CbWebsocketClientEngine::DoWhileImpl(std::function<pplx::task<bool>(void)> func)
+void CbWebsocketClientEngine::StopListeningForMessages()
 {
-	return DoWhileIteration(func).then([=](bool continue_next_iteration) -> pplx::task < bool >
+	if (!receiveThr_.joinable())
 	{
-		return ((continue_next_iteration) ? DoWhileImpl(func) : pplx::task_from_result(false));
-	});
+		return;
+	}
+
+	// Message handler closed connection, loop ends once handler returns and thread is joined by next Close or dtor
+	if (receiveThr_.get_id() == std::this_thread::get_id())
+	{
+		return;
+	}
+	receiveThr_.join();
 }
+
+// Plain loop instead of recursive continuation chain. Per message only the receive task 
+// is created by cpprest, payload is copied into reused buffer and parsed in place.
+void CbWebsocketClientEngine::ReceiveLoop(std::shared_ptr<websocket_client> client)
+{
+	std::string payload;
+	bool isBroken = false;
+	LOG_TRACE("Websocket receive loop started.");
+#ifdef _DEBUG
+	receiveAllocations = &allocations_;
+#endif
+
+	for (;;)
+	{
+		websocket_incoming_message inMsg;
+		try
+		{
+			inMsg = client->receive().get();
+		}
+		catch (websocket_exception& ex)
+		{
+			if (!isClosing_)
+			{
+				LOG_ERROR("Websocket Connection failed with a websocket_exception, Error code: "
+					<< ex.error_code() << " Message: " << ex.what());
+				isBroken = true;
+			}
+			break;
+		}
+		catch (std::exception& ex)
+		{
+			if (!isClosing_)
+			{
+				LOG_ERROR("Websocket Connection failed: " << ex.what());
+				isBroken = true;
+			}
+			break;
+		}
 
+		if (inMsg.message_type() == websocket_message_type::close)
+		{
+			LOG_TRACE("Websocket close frame received.");
+			break;
+		}
 
+		size_t len = inMsg.length();
+		if (payload.capacity() < len)
+		{
+			bufferReallocations_++;
+		}
+		payload.resize(len);
+
+		// Body is already buffered in memory, copy it without going through async read
+		auto body = inMsg.body().streambuf();
+		size_t copied = (len > 0) ? body.scopy(reinterpret_cast<uint8_t*>(&payload[0]), len) : 0;
+		if (copied < len)
+		{
+			copied += body.getn(reinterpret_cast<uint8_t*>(&payload[copied]), len - copied).get();
+			payload.resize(copied);
+		}
+		receivedMessages_++;
+
+		try
+		{
+			LOG_TRACE("Received message with payload:" << payload);
+			std::shared_ptr<vosvideo::data::WebSocketMessageParser> msgParser(new vosvideo::data::WebSocketMessageParser(payload));
+			auto dto = dtoFactory_.Create(msgParser->GetMessageType());
+			dto->Init(msgParser);
+			pubSubService_->Publish(dto);
+		}
+		catch (std::exception& ex)
+		{
+			// Broken message must not kill connection
+			LOG_ERROR("Failed to process websocket message: " << ex.what());
+		}
+	}
+
+#ifdef _DEBUG
+	receiveAllocations = nullptr;
+#endif
+	LOG_TRACE("Websocket receive loop finished. Messages: " << receivedMessages_ << " buffer reallocations: " << bufferReallocations_ << 
+		" allocations: " << allocations_);
+
+	if (isBroken)
+	{
+		// Handler reconnects, which joins this thread, so it can't run here
+		problemTask_ = pplx::create_task([this]
+		{
+			if (!isClosing_)
+			{
+				connectionProblemSignal_();
+			}
+		});
+	}
+}
@@ -2,8 +2,12 @@
 #include <cpprest/containerstream.h>
 #include <cpprest/streams.h>
 #include <cpprest/ws_client.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
 #include "VosVideo.Communication/WebsocketClientEngine.h"
 #include "VosVideo.Communication/MessageReceiver.h"
+#include "VosVideo.Communication/OutboundMessageQueue.h"
 #include "VosVideo.Data/DtoFactory.h"
 
 namespace vosvideo
@@ -12,6 +16,15 @@ namespace vosvideo
 	{
 		namespace casablanca
 		{
+			struct ReceiveLoopStats
+			{
+				uint64_t Messages = 0;
+				// Receive buffer is reused, it grows only when bigger message comes
+				uint64_t BufferReallocations = 0;
+				// Heap allocations made on receive thread, counted by CRT allocation hook in debug builds only
+				uint64_t Allocations = 0;
+			};
+
 			class CbWebsocketClientEngine final : public WebsocketClientEngine
 			{
 			public:
@@ -23,15 +36,34 @@ namespace vosvideo
 				virtual void Send(std::string const& msg) override;
 				virtual void Close() override;
 
+				OutboundQueueStats GetSendStats();
+				ReceiveLoopStats GetReceiveStats() const;
+
 				const static std::string Closed;
 			private:
-				void StartListeningForMessages();
-				pplx::task<void> AsyncDoWhile(std::function<pplx::task<bool>(void)> func);
-				pplx::task<bool> DoWhileIteration(std::function<pplx::task<bool>(void)> func);
-				pplx::task<bool> DoWhileImpl(std::function<pplx::task<bool>(void)> func);
+				// Must be called under connectionMutex_
+				void StartListeningForMessages(std::shared_ptr<web::web_sockets::client::websocket_client> client);
+				// Must be called under connectionMutex_. Closes current client and waits till its receive loop is over.
+				void CloseClient();
+				void StopListeningForMessages();
+				// Runs on receiveThr_ till connection is closed or broken
+				void ReceiveLoop(std::shared_ptr<web::web_sockets::client::websocket_client> client);
+				// Runs on outbound queue writer thread only
+				void SendImpl(const std::string& msg);
 
 				std::shared_ptr<web::web_sockets::client::websocket_client> client_;
 				vosvideo::data::DtoFactory dtoFactory_;
+				std::unique_ptr<OutboundMessageQueue> outQueue_;
+				std::thread receiveThr_;
+				// Guards client_ swap and receive thread start and join, Connect and Close can come from different threads
+				std::mutex connectionMutex_;
+				// Connection problem is reported off receive thread, so handler may reconnect and join it
+				pplx::task<void> problemTask_;
+				// Connection is closed on purpose, receive loop must not report it as a problem
+				std::atomic<bool> isClosing_;
+				std::atomic<uint64_t> receivedMessages_;
+				std::atomic<uint64_t> bufferReallocations_;
+				std::atomic<uint64_t> allocations_;
 			};
 		}
 	}
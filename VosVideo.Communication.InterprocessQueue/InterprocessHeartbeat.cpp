@@ -0,0 +1,98 @@
+#include "stdafx.h"
+#include <new>
+#include <memory>
+#include "InterprocessHeartbeat.h"
+
+using namespace std;
+using namespace util;
+using namespace boost::interprocess;
+using namespace vosvideo::communication;
+
+InterprocessHeartbeat::InterprocessHeartbeat(const std::wstring& name, bool create) : 
+	name_(StringUtil::ToString(name)), isOwner_(create)
+{
+	try
+	{
+		if (isOwner_)
+		{
+			shared_memory_object::remove(name_.c_str());
+			shm_.reset(new shared_memory_object(create_only, name_.c_str(), read_write));
+			shm_->truncate(sizeof(std::atomic<uint64_t>));
+			region_.reset(new mapped_region(*shm_, read_write));
+			beats_ = new (region_->get_address()) std::atomic<uint64_t>(0);
+		}
+		else
+		{
+			shm_.reset(new shared_memory_object(open_only, name_.c_str(), read_write));
+			region_.reset(new mapped_region(*shm_, read_write));
+			beats_ = static_cast<std::atomic<uint64_t>*>(region_->get_address());
+		}
+	}
+	catch(interprocess_exception &ex)
+	{
+		LOG_CRITICAL("Failed to open heartbeat " << name_ << ": " << ex.what());
+		throw;
+	}
+}
+
+InterprocessHeartbeat::~InterprocessHeartbeat()
+{
+	StopBeating();
+	region_.reset();
+	shm_.reset();
+	if (isOwner_)
+	{
+		shared_memory_object::remove(name_.c_str());
+	}
+}
+
+void InterprocessHeartbeat::Beat()
+{
+	beats_->fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t InterprocessHeartbeat::GetBeats() const
+{
+	return beats_->load(std::memory_order_relaxed);
+}
+
+void InterprocessHeartbeat::StartBeating(std::chrono::milliseconds period, Probe probe)
+{
+	LOG_TRACE("Start heartbeat " << name_ << " with period " << period.count() << " ms");
+	beatThr_ = std::thread([this, period, probe]
+	{
+		// Shared with answer callback, which may come after heartbeat is gone
+		auto isAnswered = std::make_shared<std::atomic<bool>>(false);
+		auto answer = [isAnswered]
+		{
+			isAnswered->store(true);
+		};
+		probe(answer);
+
+		// Hung process never answers, so beats stop, while stop request is served within the wait
+		unique_lock<std::mutex> lock(mutex_);
+		while (!stopCond_.wait_for(lock, period, [this]{ return stopBeating_; }))
+		{
+			if (isAnswered->exchange(false))
+			{
+				lock.unlock();
+				Beat();
+				probe(answer);
+				lock.lock();
+			}
+		}
+	});
+}
+
+void InterprocessHeartbeat::StopBeating()
+{
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		stopBeating_ = true;
+	}
+	stopCond_.notify_one();
+	if (beatThr_.joinable())
+	{
+		beatThr_.join();
+	}
+}
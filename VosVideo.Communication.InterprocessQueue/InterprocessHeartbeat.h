@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace vosvideo
+{
+	namespace communication
+	{
+		// Counter in shared memory, child increments it, parent watches that it keeps moving.
+		// Catches workers which are alive from OS point of view but don't do any work.
+		class InterprocessHeartbeat final
+		{
+		public:
+			// Parent creates heartbeat segment, child opens existing one
+			InterprocessHeartbeat(const std::wstring& name, bool create);
+			~InterprocessHeartbeat();
+
+			void Beat();
+			uint64_t GetBeats() const;
+
+			// Child side, beats periodically while process answers probes. Probe must not block, it calls
+			// given callback once process proved responsive; next probe is made only after previous was answered.
+			typedef std::function<void(std::function<void()>)> Probe;
+			void StartBeating(std::chrono::milliseconds period, Probe probe);
+			void StopBeating();
+
+		private:
+			std::string name_;
+			bool isOwner_ = false;
+			std::unique_ptr<boost::interprocess::shared_memory_object> shm_;
+			std::unique_ptr<boost::interprocess::mapped_region> region_;
+			std::atomic<uint64_t>* beats_ = nullptr;
+
+			std::thread beatThr_;
+			std::mutex mutex_;
+			std::condition_variable stopCond_;
+			bool stopBeating_ = false;
+		};
+	}
+}
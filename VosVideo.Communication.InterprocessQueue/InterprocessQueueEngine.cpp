@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include "VosVideo.Data/DtoParseException.h"
 #include "VosVideo.Data/WebSocketMessageParser.h"
 #include "VosVideo.Data/DtoFactory.h"
@@ -7,30 +8,75 @@
 
 using namespace std;
 using namespace util;
+using namespace metrics;
 using namespace boost::interprocess;
 using namespace vosvideo::data;
 using namespace vosvideo::communication;
 
 string InterprocessQueueEngine::stopMsg_ = "stop";
+const std::chrono::milliseconds InterprocessQueueEngine::batchWindow_(2);
+const std::chrono::milliseconds InterprocessQueueEngine::sendTimeout_(2000);
+const std::chrono::milliseconds InterprocessQueueEngine::sendRetryPeriod_(50);
 
 
 InterprocessQueueEngine::InterprocessQueueEngine(std::shared_ptr<PubSubService> pubsubService, const std::wstring& queueNamePrefix) : 
-	InterprocessCommEngine(pubsubService), openAsParent_(true), isReceiveThr_(false)
+	InterprocessCommEngine(pubsubService), openAsParent_(true), isReceiveThr_(false), receivedMessages_(0), receivedTransfers_(0)
 {
 	queueToParentName_ = StringUtil::ToString(queueNamePrefix);
 	queueFromParentName_ = queueToParentName_;
 	queueToParentName_ += "_to_parent";
 	queueFromParentName_ += "_from_parent";
+
+	flushThr_ = std::thread([this]
+	{
+		this->FlushLoop();
+	});
 }
 
 
 InterprocessQueueEngine::~InterprocessQueueEngine()
 {
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		stopFlush_ = true;
+	}
+	flushCond_.notify_one();
+	flushThr_.join();
+
 	if (isReceiveThr_)
 	{
 		StopReceive();
 		receiveThr_.join();
 	}
+
+	auto stats = GetBatchStats();
+	LOG_TRACE("IPC batching for " << queueToParentName_ << ": sent " << stats.SentMessages << " messages in " << stats.SentTransfers << 
+		" transfers, received " << stats.ReceivedMessages << " messages in " << stats.ReceivedTransfers << " transfers, max batch " << stats.MaxBatchSize);
+
+	MetricsRegistry::Instance().RemoveSeries("queue", queueToParentName_);
+	MetricsRegistry::Instance().RemoveSeries("queue", queueFromParentName_);
+}
+
+void InterprocessQueueEngine::CreateMetrics()
+{
+	auto& registry = MetricsRegistry::Instance();
+	LabelSet sendLabels = { { "queue", GetSendQueueName() } };
+	LabelSet receiveLabels = { { "queue", GetReceiveQueueName() } };
+	lock_guard<std::mutex> lock(mutex_);
+	sendLatencyMetric_ = registry.GetHistogram("vosvideo_ipc_send_latency_seconds", "Time oldest message of interprocess transfer waited till it was put into queue", sendLabels);
+	sentMetric_ = registry.GetCounter("vosvideo_ipc_sent_messages_total", "Messages sent to interprocess queue", sendLabels);
+	receivedMetric_ = registry.GetCounter("vosvideo_ipc_received_messages_total", "Messages received from interprocess queue", receiveLabels);
+	depthMetric_ = registry.GetGauge("vosvideo_ipc_queue_depth", "Transfers left in interprocess queue after receiving one", receiveLabels);
+}
+
+const std::string& InterprocessQueueEngine::GetSendQueueName() const
+{
+	return openAsParent_ ? queueFromParentName_ : queueToParentName_;
+}
+
+const std::string& InterprocessQueueEngine::GetReceiveQueueName() const
+{
+	return openAsParent_ ? queueToParentName_ : queueFromParentName_;
 }
 
 void InterprocessQueueEngine::OpenAsParent()
@@ -43,6 +89,7 @@ void InterprocessQueueEngine::OpenAsParent()
 		LOG_TRACE("Create queues from parent process: " <<  queueFromParentName_ << " and " << queueToParentName_);
 		mqFromParent_.reset(new boost::interprocess::message_queue(boost::interprocess::create_only, queueFromParentName_.c_str(), 1000, maxMsgSize_));
 		mqToParent_.reset(new boost::interprocess::message_queue(boost::interprocess::create_only, queueToParentName_.c_str(), 1000, maxMsgSize_));
+		CreateMetrics();
 	}
 	catch(interprocess_exception &ex)
 	{
@@ -61,6 +108,7 @@ void InterprocessQueueEngine::OpenAsChild()
 		LOG_TRACE("Queue: " << queueFromParentName_  << " successfully opened");
 		mqToParent_.reset(new message_queue(open_only, queueToParentName_.c_str()));
 		LOG_TRACE("Queue: " << queueToParentName_ << " successfully opened");
+		CreateMetrics();
 	}
 	catch(interprocess_exception &ex)
 	{
@@ -69,26 +117,41 @@ void InterprocessQueueEngine::OpenAsChild()
 	}
 }
 
+// Messages are not sent right away, they are accumulated for a short batch window and 
+// coalesced into a single queue transfer, so a burst of ICE candidates costs one wakeup of the peer.
 void InterprocessQueueEngine::Send(const std::string& smsg)
 {
 	lock_guard<std::mutex> lock(mutex_);
-	try
+	if (openAsParent_)
 	{
-		if (openAsParent_)
-		{
-			LOG_TRACE("Send message from parent process to child, size: " << smsg.size() << " body: " << smsg);
-			mqFromParent_->send(smsg.data(), smsg.size(), 0);
-		}
-		else
-		{
-			LOG_TRACE("Send message from child process to parent, size: " << smsg.size() << " body: " << smsg);
-			mqToParent_->send(smsg.data(), smsg.size(), 0);
-		}
+		LOG_TRACE("Send message from parent process to child, size: " << smsg.size() << " body: " << smsg);
 	}
-	catch(interprocess_exception &ex)
+	else
 	{
-		LOG_CRITICAL(ex.what());
+		LOG_TRACE("Send message from child process to parent, size: " << smsg.size() << " body: " << smsg);
+	}
+
+	size_t framedSize = batchHeaderSize_ + smsg.size();
+	if (1 + framedSize > static_cast<size_t>(maxMsgSize_))
+	{
+		// Can't be framed, keep ordering and send it alone
+		FlushPending();
+		PostTransfer(string(smsg), 1, std::chrono::steady_clock::now());
+		return;
 	}
+
+	if (1 + pendingSize_ + framedSize > static_cast<size_t>(maxMsgSize_))
+	{
+		FlushPending();
+	}
+
+	if (pending_.empty())
+	{
+		pendingSince_ = std::chrono::steady_clock::now();
+		flushCond_.notify_one();
+	}
+	pending_.push_back(smsg);
+	pendingSize_ += framedSize;
 }
 
 void InterprocessQueueEngine::Send(const std::wstring& wmsg)
@@ -108,6 +171,222 @@ void InterprocessQueueEngine::ReceiveAsync()
 	});
 }
 
+InterprocessBatchStats InterprocessQueueEngine::GetBatchStats()
+{
+	lock_guard<std::mutex> lock(mutex_);
+	InterprocessBatchStats stats = stats_;
+	stats.ReceivedMessages = receivedMessages_.load();
+	stats.ReceivedTransfers = receivedTransfers_.load();
+	return stats;
+}
+
+void InterprocessQueueEngine::FlushLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (!stopFlush_)
+	{
+		if (!unsent_.empty())
+		{
+			// Retry without blocking, senders are waiting for mutex_
+			SendUnsent(std::chrono::milliseconds(0));
+		}
+
+		if (pending_.empty())
+		{
+			if (unsent_.empty())
+			{
+				flushCond_.wait(lock);
+			}
+			else
+			{
+				flushCond_.wait_for(lock, sendRetryPeriod_);
+			}
+			continue;
+		}
+
+		auto deadline = pendingSince_ + batchWindow_;
+		if (std::chrono::steady_clock::now() < deadline)
+		{
+			flushCond_.wait_until(lock, deadline);
+			continue;
+		}
+
+		FlushPending();
+	}
+	FlushPending();
+	if (!unsent_.empty() && !SendUnsent(sendTimeout_))
+	{
+		LOG_ERROR("Interprocess queue " << GetSendQueueName() << " is closing, " << unsent_.size() << " transfers are not sent");
+	}
+}
+
+void InterprocessQueueEngine::FlushPending()
+{
+	if (pending_.empty())
+	{
+		return;
+	}
+
+	// Single message has nothing to coalesce, it is sent as is to avoid framing overhead
+	size_t msgCount = pending_.size();
+	PostTransfer(PackTransfer(pending_), msgCount, pendingSince_);
+
+	pending_.clear();
+	pendingSize_ = 0;
+}
+
+void InterprocessQueueEngine::PostTransfer(std::string&& transfer, size_t msgCount, std::chrono::steady_clock::time_point since)
+{
+	if (isFailed_)
+	{
+		LOG_ERROR("Interprocess queue " << GetSendQueueName() << " failed, transfer of " << msgCount << " messages is not sent");
+		return;
+	}
+
+	UnsentTransfer unsent = { std::move(transfer), msgCount, since };
+	unsent_.push_back(std::move(unsent));
+	// Only the first waiting transfer blocks the sender, rest are retried by flush thread
+	if (!SendUnsent(unsent_.size() == 1 ? sendTimeout_ : std::chrono::milliseconds(0)) && unsent_.size() == 1)
+	{
+		LOG_WARNING("Interprocess queue " << GetSendQueueName() << " stayed full for " << sendTimeout_.count() << " ms, transfer waits for retry");
+	}
+}
+
+bool InterprocessQueueEngine::SendUnsent(std::chrono::milliseconds timeout)
+{
+	auto mq = openAsParent_ ? mqFromParent_ : mqToParent_;
+	while (!unsent_.empty())
+	{
+		if (!mq)
+		{
+			// Queues are not opened yet, transfers wait for them
+			return false;
+		}
+
+		const auto& transfer = unsent_.front();
+		bool isSent = false;
+		try
+		{
+			if (timeout.count() > 0)
+			{
+				auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(timeout.count());
+				isSent = mq->timed_send(transfer.Data.data(), transfer.Data.size(), 0, deadline);
+			}
+			else
+			{
+				isSent = mq->try_send(transfer.Data.data(), transfer.Data.size(), 0);
+			}
+		}
+		catch(interprocess_exception &ex)
+		{
+			Fail(ex.what());
+			return false;
+		}
+
+		if (!isSent)
+		{
+			if (unsent_.size() > maxUnsentTransfers_)
+			{
+				Fail(std::to_string(unsent_.size()) + " transfers are waiting for room in queue");
+			}
+			return false;
+		}
+
+		stats_.SentMessages += transfer.MessageCount;
+		stats_.SentTransfers++;
+		stats_.MaxBatchSize = std::max(stats_.MaxBatchSize, static_cast<uint32_t>(transfer.MessageCount));
+		if (sendLatencyMetric_)
+		{
+			sendLatencyMetric_->Record(std::chrono::steady_clock::now() - transfer.Since);
+			sentMetric_->Increment(transfer.MessageCount);
+		}
+		unsent_.pop_front();
+		// Later transfers went after this one, they don't wait again
+		timeout = std::chrono::milliseconds(0);
+	}
+	return true;
+}
+
+void InterprocessQueueEngine::Fail(const std::string& reason)
+{
+	if (isFailed_)
+	{
+		return;
+	}
+	isFailed_ = true;
+
+	size_t lostMessages = 0;
+	for (const auto& transfer : unsent_)
+	{
+		lostMessages += transfer.MessageCount;
+	}
+	unsent_.clear();
+	LOG_CRITICAL("Interprocess queue " << GetSendQueueName() << " failed: " << reason << ". " << lostMessages << " messages are not sent, receiving stops.");
+
+	auto mq = openAsParent_ ? mqToParent_ : mqFromParent_;
+	if (mq)
+	{
+		try
+		{
+			StopReceive();
+		}
+		catch(interprocess_exception &ex)
+		{
+			LOG_CRITICAL(ex.what());
+		}
+	}
+}
+
+std::string InterprocessQueueEngine::PackTransfer(const std::vector<std::string>& msgs)
+{
+	if (msgs.size() == 1)
+	{
+		return msgs[0];
+	}
+
+	size_t size = 1;
+	for (const auto& msg : msgs)
+	{
+		size += batchHeaderSize_ + msg.size();
+	}
+
+	string transfer;
+	transfer.reserve(size);
+	transfer.push_back(batchMarker_);
+	for (const auto& msg : msgs)
+	{
+		uint32_t len = static_cast<uint32_t>(msg.size());
+		transfer.append(reinterpret_cast<const char*>(&len), batchHeaderSize_);
+		transfer.append(msg);
+	}
+	return transfer;
+}
+
+void InterprocessQueueEngine::UnpackTransfer(const std::string& transfer, std::vector<std::string>& msgs)
+{
+	msgs.clear();
+	if (transfer.empty() || transfer[0] != batchMarker_)
+	{
+		msgs.push_back(transfer);
+		return;
+	}
+
+	size_t pos = 1;
+	while (pos + batchHeaderSize_ <= transfer.size())
+	{
+		uint32_t len;
+		memcpy(&len, transfer.data() + pos, batchHeaderSize_);
+		pos += batchHeaderSize_;
+		if (len > transfer.size() - pos)
+		{
+			LOG_ERROR("Truncated batch transfer, size: " << transfer.size());
+			break;
+		}
+		msgs.emplace_back(transfer, pos, len);
+		pos += len;
+	}
+}
+
 // Send STOP message to self
 void InterprocessQueueEngine::StopReceive()
 {
@@ -126,6 +405,8 @@ void InterprocessQueueEngine::StopReceive()
 void InterprocessQueueEngine::Receive()
 {
 	string smsg;
+	vector<string> msgs;
+	vector<shared_ptr<ReceivedData>> dtos;
 	DtoFactory dtoFactory;
 	LOG_TRACE("Started to receive messages from " << queueToParentName_ << ", " << queueFromParentName_);
 
@@ -164,16 +445,48 @@ void InterprocessQueueEngine::Receive()
 			break;
 		}
 
-		std::shared_ptr<WebSocketMessageParser> msgParser(new WebSocketMessageParser(smsg));
-		auto dto = dtoFactory.Create(msgParser->GetMessageType());
-		dto->Init(msgParser);
-		pubSubService_->Publish(dto);
+		UnpackTransfer(smsg, msgs);
+		receivedTransfers_++;
+		receivedMessages_ += msgs.size();
+		if (receivedMetric_)
+		{
+			receivedMetric_->Increment(msgs.size());
+			depthMetric_->Set((openAsParent_ ? mqToParent_ : mqFromParent_)->get_num_msg());
+		}
+
+		// Whole transfer goes to subscribers as one batch
+		dtos.clear();
+		for (const auto& msg : msgs)
+		{
+			try
+			{
+				std::shared_ptr<WebSocketMessageParser> msgParser(new WebSocketMessageParser(msg));
+				auto dto = dtoFactory.Create(msgParser->GetMessageType());
+				dto->Init(msgParser);
+				dtos.push_back(dto);
+			}
+			catch (DtoParseException&)
+			{
+				// Already logged, skip just this message, rest of batch is still valid
+			}
+		}
+		pubSubService_->Publish(dtos);
 	}
 	LOG_TRACE("Finished to receive messages from " << queueToParentName_ << ", " << queueFromParentName_);
 }
 
 void InterprocessQueueEngine::Close()
 {
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		FlushPending();
+		if (!unsent_.empty() && !SendUnsent(sendTimeout_))
+		{
+			LOG_ERROR("Interprocess queue " << GetSendQueueName() << " is closing, " << unsent_.size() << " transfers are not sent");
+			unsent_.clear();
+		}
+	}
+
 	if (openAsParent_)
 	{
 		LOG_TRACE("In parent process remove interprocess queues: " << queueFromParentName_ << " and " << queueToParentName_);
@@ -1,13 +1,28 @@
 #pragma once
 #include <mutex>
 #include <thread>  
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <deque>
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include "VosVideo.Common/Metrics.h"
 #include "VosVideo.Communication/InterprocessCommEngine.h"
 
 namespace vosvideo
 {
 	namespace communication
 	{
+		// Counters describing how well outgoing messages are coalesced into queue transfers
+		struct InterprocessBatchStats
+		{
+			uint64_t SentMessages = 0;
+			uint64_t SentTransfers = 0;
+			uint64_t ReceivedMessages = 0;
+			uint64_t ReceivedTransfers = 0;
+			uint32_t MaxBatchSize = 0;
+		};
+
 		class InterprocessQueueEngine final : public InterprocessCommEngine
 		{
 		public:
@@ -23,7 +38,30 @@ namespace vosvideo
 			virtual void StopReceive() override;
 			virtual void Close() override;
 
+			InterprocessBatchStats GetBatchStats();
+
+			// Transfer of several messages starts with marker, every message follows prefixed by its length.
+			// Single message goes unframed. Messages of truncated transfer which are complete are kept.
+			static std::string PackTransfer(const std::vector<std::string>& msgs);
+			static void UnpackTransfer(const std::string& transfer, std::vector<std::string>& msgs);
+
 		private:
+			// Runs in flushThr_, sends pending batch once batch window is over
+			void FlushLoop();
+			// Must be called under mutex_
+			void FlushPending();
+			// Must be called under mutex_. Transfer goes after the ones peer had no room for yet.
+			void PostTransfer(std::string&& transfer, size_t msgCount, std::chrono::steady_clock::time_point since);
+			// Must be called under mutex_. Sends waiting transfers in order, true if none is left.
+			bool SendUnsent(std::chrono::milliseconds timeout);
+			// Must be called under mutex_. Peer doesn't drain its queue, further transfers are not sent
+			// and receiving stops, so owner of the engine tears the channel down.
+			void Fail(const std::string& reason);
+			// Called once queues are opened, series are labeled by queue name
+			void CreateMetrics();
+			const std::string& GetSendQueueName() const;
+			const std::string& GetReceiveQueueName() const;
+
 			std::shared_ptr<boost::interprocess::message_queue> mqFromParent_;
 			std::shared_ptr<boost::interprocess::message_queue> mqToParent_;
 			bool openAsParent_ = false;
@@ -34,6 +72,42 @@ namespace vosvideo
 			bool isReceiveThr_ = false;
 			std::mutex mutex_;
 			static std::string stopMsg_;
+
+			// Outgoing messages waiting to be coalesced into one transfer
+			std::vector<std::string> pending_;
+			size_t pendingSize_ = 0;
+			std::chrono::steady_clock::time_point pendingSince_;
+			std::condition_variable flushCond_;
+			std::thread flushThr_;
+			bool stopFlush_ = false;
+			// Transfers waiting for room in peer's queue, control and signaling messages are never dropped
+			struct UnsentTransfer
+			{
+				std::string Data;
+				size_t MessageCount;
+				std::chrono::steady_clock::time_point Since;
+			};
+			std::deque<UnsentTransfer> unsent_;
+			bool isFailed_ = false;
+			InterprocessBatchStats stats_;
+			// Updated from receiving thread without taking mutex_, it could be held by blocked send
+			std::atomic<uint64_t> receivedMessages_;
+			std::atomic<uint64_t> receivedTransfers_;
+
+			// Oldest message of transfer waited in batch and in blocked send
+			std::shared_ptr<metrics::Histogram> sendLatencyMetric_;
+			std::shared_ptr<metrics::Counter> sentMetric_;
+			std::shared_ptr<metrics::Counter> receivedMetric_;
+			std::shared_ptr<metrics::Gauge> depthMetric_;
+
+			static const char batchMarker_ = '\x1e';
+			static const size_t batchHeaderSize_ = sizeof(uint32_t);
+			static const std::chrono::milliseconds batchWindow_;
+			// Sender waits that long for room in peer's queue, then transfer waits in unsent_ and is retried
+			static const std::chrono::milliseconds sendTimeout_;
+			static const std::chrono::milliseconds sendRetryPeriod_;
+			// Peer which let that many transfers pile up is hung, engine fails
+			static const size_t maxUnsentTransfers_ = 1000;
 		};
 	}
 }
@@ -42,3 +42,8 @@ void InterprocessComm::ReceiveAsync()
 	engine_->ReceiveAsync();
 }
 
+void InterprocessComm::Close()
+{
+	engine_->Close();
+}
+
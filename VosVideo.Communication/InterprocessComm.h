@@ -17,6 +17,8 @@ namespace vosvideo
 			void Send(const std::wstring& msg);
 			void Receive();
 			void ReceiveAsync();
+			// Remove queues if parent
+			void Close();
 
 		private:
 			std::shared_ptr<InterprocessCommEngine> engine_;
@@ -0,0 +1,55 @@
+#include "stdafx.h"
+#include "VosVideo.Common/Metrics.h"
+#include "VosVideo.Data/MetricsReportMsg.h"
+#include "MetricsReporter.h"
+
+using namespace std;
+using namespace metrics;
+using namespace vosvideo::data;
+using namespace vosvideo::communication;
+
+MetricsReporter::MetricsReporter(std::shared_ptr<InterprocessComm> channel, const std::wstring& workerName, std::chrono::milliseconds period) :
+	channel_(channel), workerName_(workerName), period_(period)
+{
+}
+
+MetricsReporter::~MetricsReporter()
+{
+	Stop();
+}
+
+void MetricsReporter::Start()
+{
+	reportThr_ = std::thread([this]
+	{
+		unique_lock<std::mutex> lock(mutex_);
+		while (!stopCond_.wait_for(lock, period_, [this]{ return stop_; }))
+		{
+			lock.unlock();
+			Report();
+			lock.lock();
+		}
+	});
+}
+
+void MetricsReporter::Stop()
+{
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	stopCond_.notify_one();
+	if (reportThr_.joinable())
+	{
+		reportThr_.join();
+	}
+}
+
+void MetricsReporter::Report()
+{
+	auto samples = MetricsRegistry::Instance().Snapshot();
+	for (const auto& report : MetricsReportMsg::Split(workerName_, samples, maxReportSize_))
+	{
+		channel_->Send(report.ToString());
+	}
+}
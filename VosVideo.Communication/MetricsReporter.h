@@ -0,0 +1,39 @@
+#pragma once
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "InterprocessComm.h"
+
+namespace vosvideo
+{
+	namespace communication
+	{
+		// Child side of metrics aggregation, periodically sends snapshot of process metrics to parent.
+		// Parent keeps last reported values and exports them together with its own ones.
+		class MetricsReporter final
+		{
+		public:
+			MetricsReporter(std::shared_ptr<InterprocessComm> channel, const std::wstring& workerName, std::chrono::milliseconds period);
+			~MetricsReporter();
+
+			void Start();
+			void Stop();
+
+		private:
+			void Report();
+
+			std::shared_ptr<InterprocessComm> channel_;
+			std::wstring workerName_;
+			std::chrono::milliseconds period_;
+
+			std::thread reportThr_;
+			std::mutex mutex_;
+			std::condition_variable stopCond_;
+			bool stop_ = false;
+
+			// Interprocess queue message is limited to 20 KB
+			static const size_t maxReportSize_ = 16 * 1024;
+		};
+	}
+}
@@ -0,0 +1,253 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "VosVideo.Data/MsgTypes.h"
+#include "OutboundMessageQueue.h"
+
+using namespace std;
+using namespace metrics;
+using namespace vosvideo::data;
+using namespace vosvideo::communication;
+
+OutboundMessageQueue::OutboundMessageQueue(SendFunc sendFunc, size_t softLimitBytes) : 
+	sendFunc_(sendFunc), softLimitBytes_(softLimitBytes), hardLimitBytes_(softLimitBytes * 2)
+{
+	auto& registry = MetricsRegistry::Instance();
+	sendLatencyMetric_ = registry.GetHistogram("vosvideo_websocket_send_latency_seconds", "Time from websocket message queued till taken by transport");
+	depthMetric_ = registry.GetGauge("vosvideo_websocket_send_queue_depth", "Websocket messages waiting to be sent");
+	droppedMetric_ = registry.GetCounter("vosvideo_websocket_send_dropped_total", "Websocket messages dropped by full send queue");
+
+	writerThr_ = std::thread([this]
+	{
+		this->WriterLoop();
+	});
+}
+
+OutboundMessageQueue::~OutboundMessageQueue()
+{
+	Stop();
+}
+
+bool OutboundMessageQueue::Push(const std::string& msg)
+{
+	MessageClass msgClass;
+	string coalesceKey;
+	Classify(msg, msgClass, coalesceKey);
+
+	lock_guard<std::mutex> lock(mutex_);
+	if (stop_)
+	{
+		return false;
+	}
+	stats_.Enqueued++;
+
+	// Newer state replaces one still waiting in queue, position in queue is kept
+	if (msgClass == MessageClass::Superseded)
+	{
+		auto iter = coalescable_.find(coalesceKey);
+		if (iter != coalescable_.end())
+		{
+			bytes_ = bytes_ - iter->second->Msg.size() + msg.size();
+			iter->second->Msg = msg;
+			stats_.Coalesced++;
+			return true;
+		}
+	}
+
+	if (!MakeRoom(msg.size()))
+	{
+		bool isCritical = msgClass == MessageClass::Critical;
+		if (!isCritical || bytes_ + msg.size() > hardLimitBytes_)
+		{
+			stats_.Dropped++;
+			droppedMetric_->Increment();
+			LOG_ERROR("Outbound websocket queue is full, message dropped. Queue size: " << bytes_ << " bytes, " << queue_.size() << " messages");
+			return false;
+		}
+	}
+
+	shared_ptr<Entry> entry(new Entry());
+	entry->Msg = msg;
+	entry->Class = msgClass;
+	entry->CoalesceKey = coalesceKey;
+	entry->EnqueuedAt = std::chrono::steady_clock::now();
+	queue_.push_back(entry);
+	depthMetric_->Set(queue_.size());
+	bytes_ += msg.size();
+	if (msgClass == MessageClass::Superseded)
+	{
+		coalescable_[coalesceKey] = entry;
+	}
+
+	if (!isCongested_ && bytes_ > softLimitBytes_ / 2)
+	{
+		isCongested_ = true;
+		LOG_WARNING("Outbound websocket queue is congested: " << bytes_ << " bytes, " << queue_.size() << " messages");
+	}
+
+	queueCond_.notify_one();
+	return true;
+}
+
+void OutboundMessageQueue::Stop()
+{
+	{
+		lock_guard<std::mutex> lock(mutex_);
+		if (stop_)
+		{
+			return;
+		}
+		stop_ = true;
+	}
+	queueCond_.notify_one();
+	writerThr_.join();
+
+	auto stats = GetStats();
+	LOG_TRACE("Outbound websocket queue stopped. Enqueued: " << stats.Enqueued << " sent: " << stats.Sent << " coalesced: " << stats.Coalesced << 
+		" dropped: " << stats.Dropped << " failed: " << stats.SendFailed << " unsent: " << stats.Depth << 
+		" avg latency us: " << (stats.Sent > 0 ? stats.TotalLatency.count() / stats.Sent : 0) << " max latency us: " << stats.MaxLatency.count());
+}
+
+OutboundQueueStats OutboundMessageQueue::GetStats()
+{
+	lock_guard<std::mutex> lock(mutex_);
+	OutboundQueueStats stats = stats_;
+	stats.Depth = queue_.size();
+	stats.Bytes = bytes_;
+	return stats;
+}
+
+void OutboundMessageQueue::WriterLoop()
+{
+	unique_lock<std::mutex> lock(mutex_);
+	for (;;)
+	{
+		queueCond_.wait(lock, [this]{ return stop_ || !queue_.empty(); });
+		if (stop_)
+		{
+			break;
+		}
+
+		auto entry = queue_.front();
+		queue_.pop_front();
+		depthMetric_->Set(queue_.size());
+		bytes_ -= entry->Msg.size();
+		if (entry->Class == MessageClass::Superseded)
+		{
+			coalescable_.erase(entry->CoalesceKey);
+		}
+
+		lock.unlock();
+		bool isSent = true;
+		try
+		{
+			sendFunc_(entry->Msg);
+		}
+		catch (std::exception& e)
+		{
+			LOG_ERROR("Failed to send websocket message: " << e.what());
+			isSent = false;
+		}
+		auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - entry->EnqueuedAt);
+		lock.lock();
+
+		if (isSent)
+		{
+			stats_.Sent++;
+			stats_.TotalLatency += latency;
+			stats_.MaxLatency = std::max(stats_.MaxLatency, latency);
+			sendLatencyMetric_->Record(latency);
+		}
+		else
+		{
+			stats_.SendFailed++;
+		}
+
+		if (isCongested_ && bytes_ < softLimitBytes_ / 4)
+		{
+			isCongested_ = false;
+			LOG_WARNING("Outbound websocket queue recovered from congestion, last send latency us: " << latency.count());
+		}
+	}
+}
+
+bool OutboundMessageQueue::MakeRoom(size_t bytes)
+{
+	// Evict oldest droppable messages first, then superseded notifications
+	for (auto evictClass : { MessageClass::Droppable, MessageClass::Superseded })
+	{
+		auto iter = queue_.begin();
+		while (bytes_ + bytes > softLimitBytes_ && iter != queue_.end())
+		{
+			if ((*iter)->Class == evictClass)
+			{
+				bytes_ -= (*iter)->Msg.size();
+				if (evictClass == MessageClass::Superseded)
+				{
+					coalescable_.erase((*iter)->CoalesceKey);
+				}
+				iter = queue_.erase(iter);
+				stats_.Dropped++;
+				droppedMetric_->Increment();
+			}
+			else
+			{
+				++iter;
+			}
+		}
+	}
+
+	return bytes_ + bytes <= softLimitBytes_;
+}
+
+// Messages are built by CommunicationManager::CreateWebsocketMessageString, so peer and type are 
+// taken from envelope without parsing whole json
+void OutboundMessageQueue::Classify(const std::string& msg, MessageClass& msgClass, std::string& coalesceKey) const
+{
+	msgClass = MessageClass::Critical;
+
+	string toPeer;
+	string type;
+	if (!ExtractField(msg, "\"tp\":\"", '"', toPeer) || !ExtractField(msg, "\"mt\":", ',', type))
+	{
+		return;
+	}
+
+	int msgType = atoi(type.c_str());
+	switch (static_cast<MsgType>(msgType))
+	{
+	case MsgType::IceCandidateAnswerMsg:
+		msgClass = MessageClass::Droppable;
+		break;
+	case MsgType::RtbcInfoMsg:
+	case MsgType::DeviceDiscoveryOutMsg:
+		// Only latest snapshot is interesting for peer
+		msgClass = MessageClass::Superseded;
+		coalesceKey = toPeer + "|" + type;
+		break;
+	case MsgType::RtbcDeviceErrorOutMsg:
+	case MsgType::LiveVideoErrorMsg:
+		// Error for each device matters, only identical repeats are collapsed
+		msgClass = MessageClass::Superseded;
+		coalesceKey = toPeer + "|" + type + "|" + to_string(std::hash<string>()(msg));
+		break;
+	default:
+		break;
+	}
+}
+
+bool OutboundMessageQueue::ExtractField(const std::string& msg, const std::string& prefix, char terminator, std::string& value)
+{
+	size_t start = msg.find(prefix);
+	if (start == string::npos)
+	{
+		return false;
+	}
+	start += prefix.size();
+	size_t end = msg.find(terminator, start);
+	if (end == string::npos)
+	{
+		return false;
+	}
+	value.assign(msg, start, end - start);
+	return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include "VosVideo.Common/Metrics.h"
+
+namespace vosvideo
+{
+	namespace communication
+	{
+		struct OutboundQueueStats
+		{
+			uint64_t Enqueued = 0;
+			uint64_t Sent = 0;
+			uint64_t Coalesced = 0;
+			uint64_t Dropped = 0;
+			uint64_t SendFailed = 0;
+			size_t Depth = 0;
+			size_t Bytes = 0;
+			// Time from Push till message handed over to transport
+			std::chrono::microseconds TotalLatency = std::chrono::microseconds(0);
+			std::chrono::microseconds MaxLatency = std::chrono::microseconds(0);
+		};
+
+		// Single writer queue for outgoing signaling messages. 
+		// Keeps order, limits memory and under congestion replaces superseded notifications
+		// and drops oldest trickle ICE candidates, SDP is never dropped while under hard limit.
+		class OutboundMessageQueue final
+		{
+		public:
+			// Blocking send, throws on failure
+			using SendFunc = std::function<void(const std::string&)>;
+
+			OutboundMessageQueue(SendFunc sendFunc, size_t softLimitBytes = 1024 * 1024);
+			~OutboundMessageQueue();
+
+			// Returns false if message was dropped
+			bool Push(const std::string& msg);
+			// Stops writer, messages not sent yet are discarded
+			void Stop();
+			OutboundQueueStats GetStats();
+
+		private:
+			enum class MessageClass
+			{
+				Critical,     // SDP and everything unknown
+				Droppable,    // Trickle ICE, peer survives loss of some candidates
+				Superseded    // State notification, only latest one per peer matters
+			};
+
+			struct Entry
+			{
+				std::string Msg;
+				std::string CoalesceKey;
+				MessageClass Class;
+				std::chrono::steady_clock::time_point EnqueuedAt;
+			};
+
+			void WriterLoop();
+			// Must be called under mutex_
+			bool MakeRoom(size_t bytes);
+			void Classify(const std::string& msg, MessageClass& msgClass, std::string& coalesceKey) const;
+			static bool ExtractField(const std::string& msg, const std::string& prefix, char terminator, std::string& value);
+
+			SendFunc sendFunc_;
+			std::deque<std::shared_ptr<Entry>> queue_;
+			// Pending entries which newer message of same key can replace
+			std::unordered_map<std::string, std::shared_ptr<Entry>> coalescable_;
+			size_t bytes_ = 0;
+			size_t softLimitBytes_;
+			size_t hardLimitBytes_;
+			bool isCongested_ = false;
+			bool stop_ = false;
+			OutboundQueueStats stats_;
+			std::mutex mutex_;
+			std::condition_variable queueCond_;
+			std::thread writerThr_;
+
+			std::shared_ptr<metrics::Histogram> sendLatencyMetric_;
+			std::shared_ptr<metrics::Gauge> depthMetric_;
+			std::shared_ptr<metrics::Counter> droppedMetric_;
+		};
+	}
+}
@@ -6,13 +6,21 @@ using namespace std;
 using namespace vosvideo::communication;
 using namespace concurrency;
 
+PubSubService::PubSubService() : subscribercount_(0)
+{
+	dispatchLatencyMetric_ = metrics::MetricsRegistry::Instance().GetHistogram("vosvideo_pubsub_dispatch_latency_seconds", 
+		"Time from message publishing till subscriber started to handle it");
+}
+
 void PubSubService::Publish(shared_ptr<vosvideo::data::ReceivedData> receivedData)
 {
 	LOG_TRACE("Publishing data: " << receivedData->ToString());
 
+	auto publishedAt = std::chrono::steady_clock::now();
+	auto dispatchLatency = dispatchLatencyMetric_;
 	for(auto s : subscriptions_)
 	{
-		concurrency::task<void> publishTask([receivedData, s]()
+		concurrency::task<void> publishTask([receivedData, s, publishedAt, dispatchLatency]()
 		{
 			auto types = s->GetTypes();
 			for (const auto& type : types)
@@ -20,6 +28,7 @@ void PubSubService::Publish(shared_ptr<vosvideo::data::ReceivedData> receivedDat
 				if (type.Get() == typeid(*receivedData))
 				{
 					MessageReceiver& receiver = s->GetMessageReceiver();
+					dispatchLatency->Record(std::chrono::steady_clock::now() - publishedAt);
 					try
 					{
 						receiver.OnMessageReceived(receivedData);
@@ -37,6 +46,54 @@ void PubSubService::Publish(shared_ptr<vosvideo::data::ReceivedData> receivedDat
 	}
 }
 
+void PubSubService::Publish(const vector<shared_ptr<vosvideo::data::ReceivedData>>& receivedBatch)
+{
+	if (receivedBatch.empty())
+	{
+		return;
+	}
+
+	if (receivedBatch.size() == 1)
+	{
+		Publish(receivedBatch.front());
+		return;
+	}
+
+	LOG_TRACE("Publishing batch of " << receivedBatch.size() << " messages");
+
+	auto publishedAt = std::chrono::steady_clock::now();
+	auto dispatchLatency = dispatchLatencyMetric_;
+	for(auto s : subscriptions_)
+	{
+		concurrency::task<void> publishTask([receivedBatch, s, publishedAt, dispatchLatency]()
+		{
+			auto types = s->GetTypes();
+			for (const auto& receivedData : receivedBatch)
+			{
+				LOG_TRACE("Publishing data: " << receivedData->ToString());
+				for (const auto& type : types)
+				{
+					if (type.Get() == typeid(*receivedData))
+					{
+						MessageReceiver& receiver = s->GetMessageReceiver();
+						dispatchLatency->Record(std::chrono::steady_clock::now() - publishedAt);
+						try
+						{
+							receiver.OnMessageReceived(receivedData);
+						}
+						catch (...)
+						{
+#ifdef _DEBUG
+							LOG_DEBUG("Calling windows debugger.");
+							__asm int 3;
+#endif
+						}
+					}
+				}
+			}
+		});
+	}
+}
 
 std::shared_ptr<PubSubSubscription> PubSubService::Subscribe(std::vector<TypeInfoWrapper> types, MessageReceiver& messageReceiver)
 {
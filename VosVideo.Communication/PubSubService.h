@@ -3,6 +3,7 @@
 #include "PubSubSubscription.h"
 #include "MessageReceiver.h"
 #include "TypeInfoWrapper.h"
+#include "VosVideo.Common/Metrics.h"
 
 
 namespace vosvideo
@@ -12,17 +13,21 @@ namespace vosvideo
 		class PubSubService final
 		{
 		public:
-			PubSubService() : subscribercount_(0){};
+			PubSubService();
 			virtual ~PubSubService(){};
 
 			int GetSubscriberCount(){ return subscribercount_;}
 
 			void Publish(std::shared_ptr<vosvideo::data::ReceivedData> receivedData);	
+			// Delivers whole batch to every subscriber in one task, keeps order of messages inside the batch
+			void Publish(const std::vector<std::shared_ptr<vosvideo::data::ReceivedData>>& receivedBatch);
 			std::shared_ptr<PubSubSubscription> Subscribe(std::vector<TypeInfoWrapper> types, MessageReceiver& messageReceiver);
 			void UnSubscribe(std::shared_ptr<PubSubSubscription> subscription);
 		private:
 			int subscribercount_;
 			std::vector<std::shared_ptr<PubSubSubscription>> subscriptions_;
+			// From Publish till subscriber got the message, shared by all instances
+			std::shared_ptr<metrics::Histogram> dispatchLatencyMetric_;
 		};
 	}
 }
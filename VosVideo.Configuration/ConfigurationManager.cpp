@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include <Shlobj.h>
 #include <unordered_map>
+#include <cmath>
 #include <boost/format.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
@@ -8,6 +9,7 @@
 #include <boost/foreach.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
+#include <boost/algorithm/string/trim.hpp>
 
 #include "ConfigurationParserException.h"
 #include "ConfigurationManager.h"
@@ -18,17 +20,28 @@ using namespace boost::property_tree::xml_parser;
 using namespace boost::filesystem;
 using boost::property_tree::ptree;
 using vosvideo::configuration::ConfigurationManager;
+using vosvideo::configuration::ArchivePlacementPolicy;
+using vosvideo::configuration::RecordingFsyncPolicy;
 using boost::format;
 
 ConfigurationManager::ConfigurationManager()
+{
+	ReadConfiguration(GetConfigurationFilePath());
+}
+
+ConfigurationManager::ConfigurationManager(const std::wstring& configFilePath)
+{
+	ReadConfiguration(configFilePath);
+}
+
+void ConfigurationManager::ReadConfiguration(const std::wstring& configFilePath)
 {
 	ptree pt;
 	string confFilePath;
 
 	try
 	{
-		wstring wconfFilePath = GetConfigurationFilePath();
-		confFilePath = StringUtil::ToString(wconfFilePath);
+		confFilePath = StringUtil::ToString(configFilePath);
 
 		LOG_TRACE("Open configuration file: " << confFilePath);
 		read_xml(confFilePath, pt);
@@ -67,7 +80,19 @@ ConfigurationManager::ConfigurationManager()
 				tmpPair[0] != siteIdKey_ && 
 				tmpPair[0] != siteNameKey_ && 
 				tmpPair[0] != loggerKey_ &&
-				tmpPair[0] != archivePathKey_)
+				tmpPair[0] != logLevelKey_ &&
+				tmpPair[0] != archivePathKey_ &&
+				tmpPair[0] != workerPoolSizeKey_ &&
+				tmpPair[0] != archiveHttpPortKey_ &&
+				tmpPair[0] != metricsHttpPortKey_ &&
+				tmpPair[0] != archiveQuotaKey_ &&
+				tmpPair[0] != reservedDiskSpaceKey_ &&
+				tmpPair[0] != retentionMinimumKey_ &&
+				tmpPair[0].compare(0, retentionMinimumKey_.size() + 1, retentionMinimumKey_ + L".") != 0 &&
+				tmpPair[0] != archivePlacementKey_ &&
+				tmpPair[0] != recordingFsyncKey_ &&
+				tmpPair[0] != recordingFsyncIntervalKey_ &&
+				tmpPair[0].compare(0, archivePinKey_.size() + 1, archivePinKey_ + L".") != 0)
 			{
 				//exception
 				throw ConfigurationParserException("Unknown key is found. Key is case sensitive. Check your configuration file.");
@@ -133,7 +158,47 @@ wstring ConfigurationManager::GetSiteId() const
 
 wstring ConfigurationManager::GetArchivePath() const
 {
-	return FindConfValue(archivePathKey_);
+	auto roots = GetArchivePaths();
+	return roots.empty() ? L"" : roots.front();
+}
+
+vector<wstring> ConfigurationManager::GetArchivePaths() const
+{
+	vector<wstring> tokens;
+	StringUtil::Tokenize(FindConfValue(archivePathKey_), tokens, wstring(L";"));
+
+	vector<wstring> roots;
+	for (auto& token : tokens)
+	{
+		boost::algorithm::trim(token);
+		if (!token.empty() && std::find(roots.begin(), roots.end(), token) == roots.end())
+		{
+			roots.push_back(token);
+		}
+	}
+	return roots;
+}
+
+vosvideo::configuration::ArchivePlacementPolicy ConfigurationManager::GetArchivePlacement() const
+{
+	wstring wsVal = FindConfValue(archivePlacementKey_);
+	std::transform(wsVal.begin(), wsVal.end(), wsVal.begin(), ::tolower);
+	if (wsVal == L"roundrobin")
+	{
+		return ArchivePlacementPolicy::RoundRobin;
+	}
+	if (!wsVal.empty() && wsVal != L"leastused")
+	{
+		LOG_WARNING("Wrong value of " << StringUtil::ToString(archivePlacementKey_) << ", default is used.");
+	}
+	return ArchivePlacementPolicy::LeastUsed;
+}
+
+wstring ConfigurationManager::GetArchivePin(const std::wstring& cameraName) const
+{
+	wstring pin = FindConfValue(archivePinKey_ + L"." + cameraName);
+	boost::algorithm::trim(pin);
+	return pin;
 }
 
 bool ConfigurationManager::IsLoggerOn() const
@@ -143,6 +208,202 @@ bool ConfigurationManager::IsLoggerOn() const
 	return (wsVal == L"true");
 }
 
+severity_level ConfigurationManager::GetLogLevel() const
+{
+	wstring wsVal = FindConfValue(logLevelKey_);
+	std::transform(wsVal.begin(), wsVal.end(), wsVal.begin(), ::tolower);
+	// Default keeps what build compiles in, debug records of debug build are written as they always were
+	if (wsVal.empty())
+	{
+		return VV_LOG_MIN_SEVERITY;
+	}
+	if (wsVal == L"trace")
+	{
+		return vv_trace;
+	}
+	if (wsVal == L"debug")
+	{
+		return vv_debug;
+	}
+	if (wsVal == L"warning")
+	{
+		return vv_warning;
+	}
+	if (wsVal == L"error")
+	{
+		return vv_error;
+	}
+	if (wsVal == L"critical")
+	{
+		return vv_critical;
+	}
+	LOG_WARNING("Wrong value of " << StringUtil::ToString(logLevelKey_) << ", default is used.");
+	return VV_LOG_MIN_SEVERITY;
+}
+
+uint32_t ConfigurationManager::GetWorkerPoolSize() const
+{
+	wstring wsVal = FindConfValue(workerPoolSizeKey_);
+	if (wsVal.empty())
+	{
+		return defaultWorkerPoolSize_;
+	}
+
+	try
+	{
+		return static_cast<uint32_t>(std::stoul(wsVal));
+	}
+	catch (std::exception&)
+	{
+		LOG_WARNING("Wrong value of " << StringUtil::ToString(workerPoolSizeKey_) << ", default is used.");
+		return defaultWorkerPoolSize_;
+	}
+}
+
+uint32_t ConfigurationManager::GetArchiveHttpPort() const
+{
+	return GetPort(archiveHttpPortKey_, defaultArchiveHttpPort_);
+}
+
+uint32_t ConfigurationManager::GetMetricsHttpPort() const
+{
+	return GetPort(metricsHttpPortKey_, defaultMetricsHttpPort_);
+}
+
+vosvideo::configuration::RecordingFsyncPolicy ConfigurationManager::GetRecordingFsync() const
+{
+	wstring wsVal = FindConfValue(recordingFsyncKey_);
+	std::transform(wsVal.begin(), wsVal.end(), wsVal.begin(), ::tolower);
+	if (wsVal == L"never")
+	{
+		return RecordingFsyncPolicy::Never;
+	}
+	if (wsVal == L"onclose")
+	{
+		return RecordingFsyncPolicy::OnClose;
+	}
+	if (!wsVal.empty() && wsVal != L"interval")
+	{
+		LOG_WARNING("Wrong value of " << StringUtil::ToString(recordingFsyncKey_) << ", default is used.");
+	}
+	return RecordingFsyncPolicy::Interval;
+}
+
+uint32_t ConfigurationManager::GetRecordingFsyncInterval() const
+{
+	wstring wsVal = FindConfValue(recordingFsyncIntervalKey_);
+	if (wsVal.empty())
+	{
+		return defaultRecordingFsyncIntervalMs_;
+	}
+
+	try
+	{
+		uint32_t intervalMs = static_cast<uint32_t>(std::stoul(wsVal));
+		if (intervalMs == 0)
+		{
+			throw std::out_of_range("interval");
+		}
+		return intervalMs;
+	}
+	catch (std::exception&)
+	{
+		LOG_WARNING("Wrong value of " << StringUtil::ToString(recordingFsyncIntervalKey_) << ", default is used.");
+		return defaultRecordingFsyncIntervalMs_;
+	}
+}
+
+uint32_t ConfigurationManager::GetPort(const std::wstring& wKey, uint32_t defaultPort) const
+{
+	wstring wsVal = FindConfValue(wKey);
+	if (wsVal.empty())
+	{
+		return defaultPort;
+	}
+
+	try
+	{
+		uint32_t port = static_cast<uint32_t>(std::stoul(wsVal));
+		if (port > 65535)
+		{
+			throw std::out_of_range("port");
+		}
+		return port;
+	}
+	catch (std::exception&)
+	{
+		LOG_WARNING("Wrong value of " << StringUtil::ToString(wKey) << ", default is used.");
+		return defaultPort;
+	}
+}
+
+uint64_t ConfigurationManager::GetArchiveQuota() const
+{
+	return GetGigabytes(archiveQuotaKey_, 0);
+}
+
+uint64_t ConfigurationManager::GetReservedDiskSpace() const
+{
+	return GetGigabytes(reservedDiskSpaceKey_, defaultReservedDiskSpaceGb_);
+}
+
+uint64_t ConfigurationManager::GetRetentionMinimum(const std::wstring& cameraName) const
+{
+	wstring key = retentionMinimumKey_ + L"." + cameraName;
+	wstring wsVal = FindConfValue(key);
+	if (wsVal.empty())
+	{
+		key = retentionMinimumKey_;
+		wsVal = FindConfValue(key);
+	}
+	if (wsVal.empty())
+	{
+		return 0;
+	}
+
+	try
+	{
+		const uint64_t nsInHour = 3600ULL * 1000000000ULL;
+		return ParseAmount(wsVal, nsInHour);
+	}
+	catch (std::exception&)
+	{
+		LOG_WARNING("Wrong value of " << StringUtil::ToString(key) << ", no minimum retention is used.");
+		return 0;
+	}
+}
+
+uint64_t ConfigurationManager::GetGigabytes(const std::wstring& wKey, uint64_t defaultGb) const
+{
+	const uint64_t bytesInGb = 1024ULL * 1024ULL * 1024ULL;
+	wstring wsVal = FindConfValue(wKey);
+	if (wsVal.empty())
+	{
+		return defaultGb * bytesInGb;
+	}
+
+	try
+	{
+		return ParseAmount(wsVal, bytesInGb);
+	}
+	catch (std::exception&)
+	{
+		LOG_WARNING("Wrong value of " << StringUtil::ToString(wKey) << ", default is used.");
+		return defaultGb * bytesInGb;
+	}
+}
+
+uint64_t ConfigurationManager::ParseAmount(const std::wstring& wsVal, uint64_t unit)
+{
+	// Conversion of negative or out of range double to uint64_t is undefined
+	const double amount = std::stod(wsVal) * unit;
+	if (!std::isfinite(amount) || amount < 0.0 || amount >= 18446744073709551616.0)
+	{
+		throw std::out_of_range("amount");
+	}
+	return static_cast<uint64_t>(amount);
+}
+
 wstring ConfigurationManager::FindConfValue(const wstring& wKey) const
 {
 	unordered_map<wstring, wstring>::const_iterator iter = keyValConf_.find(wKey);
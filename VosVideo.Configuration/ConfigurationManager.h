@@ -4,20 +4,70 @@ namespace vosvideo
 {
 	namespace configuration
 	{
+		// How camera without pinned archive root gets one
+		enum class ArchivePlacementPolicy
+		{
+			RoundRobin,
+			// Root which would fill last with current write rates
+			LeastUsed
+		};
+
+		// When recording files are flushed from OS cache to disk
+		enum class RecordingFsyncPolicy
+		{
+			Never,
+			// Once file is complete
+			OnClose,
+			// Periodically and on close
+			Interval
+		};
+
 		class ConfigurationManager final
 		{
 		public:
 			ConfigurationManager();
+			// Reads given configuration file instead of the installed one
+			explicit ConfigurationManager(const std::wstring& configFilePath);
 			virtual ~ConfigurationManager();
 			std::wstring GetRestServiceUri() const;
 			std::wstring GetWebSiteUri() const;
 			std::wstring GetWebsocketUri() const;
 			std::wstring GetSiteId() const;
+			// First archive root, catalog cache and placement state are kept there
 			std::wstring GetArchivePath() const;
+			// ArchivePath may list several roots separated with ';', usually one per disk
+			std::vector<std::wstring> GetArchivePaths() const;
+			ArchivePlacementPolicy GetArchivePlacement() const;
+			// Root camera must record to, empty if camera is not pinned
+			std::wstring GetArchivePin(const std::wstring& cameraName) const;
 			bool IsLoggerOn() const;
+			// Least severe records written, debug, trace, warning, error or critical.
+			// Default is compile time floor, so debug build keeps debug records.
+			severity_level GetLogLevel() const;
+			// Number of idle deviceworker processes kept ready for camera start
+			uint32_t GetWorkerPoolSize() const;
+			// Port of local archive playback server, 0 disables it
+			uint32_t GetArchiveHttpPort() const;
+			// Port of local Prometheus metrics endpoint, 0 disables it
+			uint32_t GetMetricsHttpPort() const;
+			// Bytes all recordings may take together, 0 means only reserved disk space is kept
+			uint64_t GetArchiveQuota() const;
+			// Bytes left free on archive disk
+			uint64_t GetReservedDiskSpace() const;
+			// Nanoseconds camera recordings are kept even if quota is exceeded, camera value overrides common one
+			uint64_t GetRetentionMinimum(const std::wstring& cameraName) const;
+			// Never, OnClose or Interval, default is Interval
+			RecordingFsyncPolicy GetRecordingFsync() const;
+			// Milliseconds between syncs of recording file when Interval policy is used
+			uint32_t GetRecordingFsyncInterval() const;
 
 		private:
+			void ReadConfiguration(const std::wstring& configFilePath);
 			std::wstring FindConfValue(const std::wstring& wKey) const;
+			uint64_t GetGigabytes(const std::wstring& wKey, uint64_t defaultGb) const;
+			uint32_t GetPort(const std::wstring& wKey, uint32_t defaultPort) const;
+			// Number of units written as decimal value, throws if it's negative, not a number or too big
+			static uint64_t ParseAmount(const std::wstring& wsVal, uint64_t unit);
 			std::wstring GetConfigurationFilePath();
 
 			std::unordered_map<std::wstring, std::wstring> keyValConf_;
@@ -29,7 +79,25 @@ namespace vosvideo
 			const std::wstring siteIdKey_ = L"SiteId";
 			const std::wstring siteNameKey_ = L"SiteName";
 			const std::wstring loggerKey_ = L"Logging";
+			const std::wstring logLevelKey_ = L"LogLevel";
 			const std::wstring archivePathKey_ = L"ArchivePath";
+			const std::wstring archivePlacementKey_ = L"ArchivePlacement";
+			// Camera name goes after dot, e.g. ArchivePin.Camera1
+			const std::wstring archivePinKey_ = L"ArchivePin";
+			const std::wstring workerPoolSizeKey_ = L"WorkerPoolSize";
+			const uint32_t defaultWorkerPoolSize_ = 2;
+			const std::wstring archiveHttpPortKey_ = L"ArchiveHttpPort";
+			const uint32_t defaultArchiveHttpPort_ = 8090;
+			const std::wstring metricsHttpPortKey_ = L"MetricsHttpPort";
+			const uint32_t defaultMetricsHttpPort_ = 9102;
+			const std::wstring archiveQuotaKey_ = L"ArchiveQuotaGB";
+			const std::wstring reservedDiskSpaceKey_ = L"ReservedDiskSpaceGB";
+			const uint64_t defaultReservedDiskSpaceGb_ = 10;
+			// Camera value uses key with camera name after dot, e.g. RetentionMinHours.Camera1
+			const std::wstring retentionMinimumKey_ = L"RetentionMinHours";
+			const std::wstring recordingFsyncKey_ = L"RecordingFsync";
+			const std::wstring recordingFsyncIntervalKey_ = L"RecordingFsyncIntervalMs";
+			const uint32_t defaultRecordingFsyncIntervalMs_ = 5000;
 			const std::wstring instDir_ = L"VosVideoServer";
 		};
 	}
@@ -0,0 +1,28 @@
+#include "stdafx.h"
+#include "ArchiveCatalogAnswerMsg.h"
+
+using namespace std;
+using namespace vosvideo::data;
+
+ArchiveCatalogAnswerMsg::ArchiveCatalogAnswerMsg(const std::wstring& requestId, const std::wstring& cameraName, uint32_t page,
+	const web::json::value& segments, const std::wstring& nextCursor, bool isLast)
+{
+	// Trick, local static goes to base class static
+	msgType_ = msgType;
+
+	jObj_[L"rid"] = web::json::value::string(requestId);
+	jObj_[L"cam"] = web::json::value::string(cameraName);
+	jObj_[L"page"] = web::json::value::number(page);
+	jObj_[L"segments"] = segments;
+	jObj_[L"cursor"] = web::json::value::string(nextCursor);
+	jObj_[L"last"] = web::json::value::boolean(isLast);
+}
+
+ArchiveCatalogAnswerMsg::~ArchiveCatalogAnswerMsg()
+{
+}
+
+void ArchiveCatalogAnswerMsg::GetAsJsonString(std::wstring& jsonStr)
+{
+	jsonStr = jObj_.serialize();
+}
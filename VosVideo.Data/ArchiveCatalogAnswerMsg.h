@@ -0,0 +1,23 @@
+#pragma once
+#include "SendData.h"
+
+namespace vosvideo
+{
+	namespace data
+	{
+		// One page of answer to ArchiveCatalogRequestMsg, big answers are sent as several messages
+		class ArchiveCatalogAnswerMsg : public SendData
+		{
+		public:
+			ArchiveCatalogAnswerMsg(const std::wstring& requestId, const std::wstring& cameraName, uint32_t page,
+				const web::json::value& segments, const std::wstring& nextCursor, bool isLast);
+			virtual ~ArchiveCatalogAnswerMsg();
+
+			virtual void GetAsJsonString(std::wstring& jsonStr) override;
+
+		private:
+			static const MsgType msgType = MsgType::ArchiveCatalogAnswerMsg;
+			web::json::value jObj_;
+		};
+	}
+}
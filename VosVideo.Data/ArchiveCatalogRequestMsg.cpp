@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include <algorithm>
 #include "ArchiveCatalogRequestMsg.h"
 
 using namespace std;
@@ -13,17 +14,106 @@ ArchiveCatalogRequestMsg::~ArchiveCatalogRequestMsg()
 {
 }
 
+void ArchiveCatalogRequestMsg::Init(std::shared_ptr<WebSocketMessageParser> parser)
+{
+	ReceivedData::Init(parser);
+	web::json::value obj;
+	parser->GetPayload(obj);
+	FromJsonValue(obj);
+}
+
 web::json::value ArchiveCatalogRequestMsg::ToJsonValue() const
 {
 	web::json::value jObj;
+	jObj[L"rid"] = web::json::value::string(requestId_);
+	jObj[L"cam"] = web::json::value::string(cameraName_);
+	jObj[L"from"] = web::json::value::number(from_);
+	jObj[L"to"] = web::json::value::number(to_);
+	jObj[L"cursor"] = web::json::value::string(cursor_);
+	jObj[L"limit"] = web::json::value::number(pageSize_);
+	jObj[L"pages"] = web::json::value::number(maxPages_);
 	return jObj;
 }
 
 void ArchiveCatalogRequestMsg::FromJsonValue(const web::json::value& obj )
 {
+	if (!obj.is_object())
+	{
+		return;
+	}
+
+	if (obj.has_field(U("rid")) && obj.at(U("rid")).is_string())
+	{
+		requestId_ = obj.at(U("rid")).as_string();
+	}
+
+	if (obj.has_field(U("cam")) && obj.at(U("cam")).is_string())
+	{
+		cameraName_ = obj.at(U("cam")).as_string();
+	}
+
+	if (obj.has_field(U("from")) && obj.at(U("from")).is_number())
+	{
+		from_ = std::max<int64_t>(obj.at(U("from")).as_number().to_int64(), 0);
+	}
+
+	if (obj.has_field(U("to")) && obj.at(U("to")).is_number())
+	{
+		to_ = std::max<int64_t>(obj.at(U("to")).as_number().to_int64(), 0);
+	}
+
+	if (obj.has_field(U("cursor")) && obj.at(U("cursor")).is_string())
+	{
+		cursor_ = obj.at(U("cursor")).as_string();
+	}
+
+	if (obj.has_field(U("limit")) && obj.at(U("limit")).is_number())
+	{
+		pageSize_ = std::min<uint32_t>(std::max(obj.at(U("limit")).as_integer(), 1), maxPageSize_);
+	}
+
+	if (obj.has_field(U("pages")) && obj.at(U("pages")).is_number())
+	{
+		maxPages_ = std::min<uint32_t>(std::max(obj.at(U("pages")).as_integer(), 1), maxMaxPages_);
+	}
 }
 
 std::wstring ArchiveCatalogRequestMsg::ToString() const
 {
-	return L"";
+	return ToJsonValue().serialize();
+}
+
+std::wstring ArchiveCatalogRequestMsg::GetRequestId() const
+{
+	return requestId_;
+}
+
+std::wstring ArchiveCatalogRequestMsg::GetCameraName() const
+{
+	return cameraName_;
+}
+
+int64_t ArchiveCatalogRequestMsg::GetFrom() const
+{
+	return from_;
+}
+
+int64_t ArchiveCatalogRequestMsg::GetTo() const
+{
+	return to_;
+}
+
+std::wstring ArchiveCatalogRequestMsg::GetCursor() const
+{
+	return cursor_;
+}
+
+uint32_t ArchiveCatalogRequestMsg::GetPageSize() const
+{
+	return pageSize_;
+}
+
+uint32_t ArchiveCatalogRequestMsg::GetMaxPages() const
+{
+	return maxPages_;
 }
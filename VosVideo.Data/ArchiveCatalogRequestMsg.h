@@ -5,15 +5,41 @@ namespace vosvideo
 {
 	namespace data
 	{
+		// Asks for recordings of one camera overlapping time range, answered with ArchiveCatalogAnswerMsg pages.
+		// Times are milliseconds from Unix epoch, cursor is taken from previous answer to continue listing.
 		class ArchiveCatalogRequestMsg final : public ReceivedData
 		{
 		public:
 			ArchiveCatalogRequestMsg();
 			virtual ~ArchiveCatalogRequestMsg();
 
+			virtual void Init(std::shared_ptr<WebSocketMessageParser> parser) override;
 			virtual web::json::value ToJsonValue() const override;
 			virtual void FromJsonValue(const web::json::value& obj) override;
 			virtual std::wstring ToString() const override;
+
+			std::wstring GetRequestId() const;
+			std::wstring GetCameraName() const;
+			int64_t GetFrom() const;
+			// Zero means no upper limit
+			int64_t GetTo() const;
+			std::wstring GetCursor() const;
+			uint32_t GetPageSize() const;
+			uint32_t GetMaxPages() const;
+
+		private:
+			std::wstring requestId_;
+			std::wstring cameraName_;
+			int64_t from_ = 0;
+			int64_t to_ = 0;
+			std::wstring cursor_;
+			uint32_t pageSize_ = defaultPageSize_;
+			uint32_t maxPages_ = defaultMaxPages_;
+
+			static const uint32_t defaultPageSize_ = 100;
+			static const uint32_t maxPageSize_ = 1000;
+			static const uint32_t defaultMaxPages_ = 10;
+			static const uint32_t maxMaxPages_ = 50;
 		};
 	}
 }
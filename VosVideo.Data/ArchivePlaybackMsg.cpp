@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "ArchivePlaybackMsg.h"
+
+using namespace std;
+using namespace vosvideo::data;
+
+ArchivePlaybackMsg::ArchivePlaybackMsg()
+{
+}
+
+ArchivePlaybackMsg::~ArchivePlaybackMsg()
+{
+}
+
+void ArchivePlaybackMsg::Init(std::shared_ptr<WebSocketMessageParser> parser)
+{
+	ReceivedData::Init(parser);
+	FromJsonValue(ToJsonValue());
+}
+
+void ArchivePlaybackMsg::FromJsonValue(const web::json::value& obj )
+{
+	if (!obj.is_object())
+	{
+		return;
+	}
+
+	if (obj.has_field(U("media_info")))
+	{
+		mediaInfo_ = obj.at(U("media_info"));
+	}
+
+	if (obj.has_field(U("pos")) && obj.at(U("pos")).is_number())
+	{
+		hasPosition_ = true;
+		position_ = std::max<int64_t>(obj.at(U("pos")).as_number().to_int64(), 0);
+	}
+
+	if (obj.has_field(U("rate")) && obj.at(U("rate")).is_number())
+	{
+		rate_ = obj.at(U("rate")).as_integer();
+	}
+
+	if (obj.has_field(U("pause")) && obj.at(U("pause")).is_boolean())
+	{
+		hasPause_ = true;
+		isPause_ = obj.at(U("pause")).as_bool();
+	}
+}
+
+web::json::value ArchivePlaybackMsg::GetMediaInfo()
+{
+	return mediaInfo_;
+}
+
+bool ArchivePlaybackMsg::HasPosition() const
+{
+	return hasPosition_;
+}
+
+int64_t ArchivePlaybackMsg::GetPosition() const
+{
+	return position_;
+}
+
+int32_t ArchivePlaybackMsg::GetRate() const
+{
+	return rate_;
+}
+
+bool ArchivePlaybackMsg::HasPause() const
+{
+	return hasPause_;
+}
+
+bool ArchivePlaybackMsg::IsPause() const
+{
+	return isPause_;
+}
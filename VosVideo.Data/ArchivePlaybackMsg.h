@@ -0,0 +1,39 @@
+#pragma once
+#include "MediaInfo.h"
+#include "ReceivedData.h"
+
+namespace vosvideo
+{
+	namespace data
+	{
+		// Controls recording played over WebRTC, routed to device worker by media_info DeviceId.
+		// Position is milliseconds from recording start, every field is optional.
+		class ArchivePlaybackMsg final : public ReceivedData, public MediaInfo
+		{
+		public:
+			ArchivePlaybackMsg();
+			virtual ~ArchivePlaybackMsg();
+
+			virtual void Init(std::shared_ptr<WebSocketMessageParser> parser) override;
+			virtual void FromJsonValue(const web::json::value& obj) override;
+
+			// from MediaInfoMsg interface
+			virtual web::json::value GetMediaInfo() override;
+
+			bool HasPosition() const;
+			int64_t GetPosition() const;
+			// Zero when rate is not changed
+			int32_t GetRate() const;
+			bool HasPause() const;
+			bool IsPause() const;
+
+		private:
+			web::json::value mediaInfo_;
+			bool hasPosition_ = false;
+			int64_t position_ = 0;
+			int32_t rate_ = 0;
+			bool hasPause_ = false;
+			bool isPause_ = false;
+		};
+	}
+}
@@ -110,6 +110,22 @@ void CameraConfMsg::SetFields(const web::json::value& json)
 	if (json.at(U("archivePath")).is_string())
 		_archivePath = json.at(U("archivePath")).as_string();
 
+	if (json.has_field(U("archiveRoots")) && json.at(U("archiveRoots")).is_array())
+	{
+		_archiveRoots.clear();
+		for (const auto& root : json.at(U("archiveRoots")).as_array())
+		{
+			if (root.is_string())
+				_archiveRoots.push_back(root.as_string());
+		}
+	}
+
+	if (json.has_field(U("fsyncMode")) && json.at(U("fsyncMode")).is_number())
+		_fsyncMode = static_cast<CameraFsyncMode>(json.at(U("fsyncMode")).as_integer());
+
+	if (json.has_field(U("fsyncIntervalMs")) && json.at(U("fsyncIntervalMs")).is_number())
+		_fsyncIntervalMs = json.at(U("fsyncIntervalMs")).as_number().to_uint32();
+
 	if (json.at(U("isRecordingEnabled")).is_boolean())
 		_isRecordingEnabled = json.at(U("isRecordingEnabled")).as_bool();
 
@@ -190,6 +206,28 @@ void CameraConfMsg::GetFileSinkParameters(
 	recordingMode = _recordingMode;
 }
 
+void CameraConfMsg::SetArchiveRoots(const std::vector<std::wstring>& archiveRoots)
+{
+	_archiveRoots = archiveRoots;
+}
+
+std::vector<std::wstring> CameraConfMsg::GetArchiveRoots() const
+{
+	return _archiveRoots;
+}
+
+void CameraConfMsg::SetFsyncParameters(CameraFsyncMode fsyncMode, uint32_t fsyncIntervalMs)
+{
+	_fsyncMode = fsyncMode;
+	_fsyncIntervalMs = fsyncIntervalMs;
+}
+
+void CameraConfMsg::GetFsyncParameters(CameraFsyncMode& fsyncMode, uint32_t& fsyncIntervalMs) const
+{
+	fsyncMode = _fsyncMode;
+	fsyncIntervalMs = _fsyncIntervalMs;
+}
+
 void CameraConfMsg::SetUris(const wstring& audiouri, const wstring& videouri)
 {
 	_audiouri = audiouri;
@@ -233,10 +271,18 @@ web::json::value CameraConfMsg::ToJsonValue() const
 	jObj[L"cameraId"] = web::json::value::number(_cameraId);
 	jObj[L"cameraName"] = web::json::value::string(_cameraName);
 	jObj[L"archivePath"] = web::json::value::string(_archivePath);
+	web::json::value archiveRoots = web::json::value::array(_archiveRoots.size());
+	for (size_t i = 0; i < _archiveRoots.size(); ++i)
+	{
+		archiveRoots[i] = web::json::value::string(_archiveRoots[i]);
+	}
+	jObj[L"archiveRoots"] = archiveRoots;
 	jObj[L"recordLen"] = web::json::value::number(_recordLen);
 	jObj[L"maxFilesNum"] = web::json::value::number(_maxFilesNum);
 	jObj[L"isRecordingEnabled"] = web::json::value::boolean(_isRecordingEnabled);
 	jObj[L"recordingMode"] = web::json::value::number(static_cast<int>(_recordingMode));
+	jObj[L"fsyncMode"] = web::json::value::number(static_cast<int>(_fsyncMode));
+	jObj[L"fsyncIntervalMs"] = web::json::value::number(_fsyncIntervalMs);
 	jObj[L"videouri"] = web::json::value::string(_videouri);
 	jObj[L"audiouri"] = web::json::value::string(_audiouri);
 	jObj[L"username"] = web::json::value::string(_username);
@@ -263,10 +309,13 @@ bool CameraConfMsg::operator==(const CameraConfMsg &other) const
 		_cameraId == other._cameraId       &&
 		_cameraName == other._cameraName   &&
 		_archivePath == other._archivePath     &&
+		_archiveRoots == other._archiveRoots   &&
 		_recordLen == other._recordLen     &&
 		_isRecordingEnabled == other._isRecordingEnabled &&
 		_maxFilesNum == other._maxFilesNum &&
 		_recordingMode == other._recordingMode &&
+		_fsyncMode == other._fsyncMode &&
+		_fsyncIntervalMs == other._fsyncIntervalMs &&
 		_videouri == other._videouri &&
 		_audiouri == other._audiouri &&
 		_username == other._username &&
@@ -287,10 +336,13 @@ CameraConfMsg& CameraConfMsg::operator=(const CameraConfMsg& other)
 		_cameraId    = other._cameraId;
 		_cameraName  = other._cameraName;
 		_archivePath = other._archivePath;
+		_archiveRoots = other._archiveRoots;
 		_isRecordingEnabled = other._isRecordingEnabled;
 		_recordLen   = other._recordLen;
 		_maxFilesNum = other._maxFilesNum;
 		_recordingMode = other._recordingMode;
+		_fsyncMode = other._fsyncMode;
+		_fsyncIntervalMs = other._fsyncIntervalMs;
 		_videouri    = other._videouri;
 		_audiouri    = other._audiouri;
 		_username    = other._username;
@@ -1,5 +1,5 @@
 #pragma once
-
+#include <vector>
 #include "ReceivedData.h"
 
 namespace vosvideo
@@ -20,6 +20,14 @@ namespace vosvideo
 			ONSCHEDULER
 		};
 
+		// When recording files are flushed from OS cache to disk
+		enum class CameraFsyncMode
+		{
+			NEVER,
+			ONCLOSE,
+			INTERVAL
+		};
+
 		class CameraConfMsg final : public ReceivedData
 		{
 		public:
@@ -42,6 +50,12 @@ namespace vosvideo
 				uint32_t& recordLen, 
 				uint32_t& maxFilesNum,
 				CameraRecordingMode& recordingMode) const;
+			// All archive roots, recordings of camera stay on previous root once it's moved
+			void SetArchiveRoots(const std::vector<std::wstring>& archiveRoots);
+			std::vector<std::wstring> GetArchiveRoots() const;
+			// Interval is used by INTERVAL mode only
+			void SetFsyncParameters(CameraFsyncMode fsyncMode, uint32_t fsyncIntervalMs);
+			void GetFsyncParameters(CameraFsyncMode& fsyncMode, uint32_t& fsyncIntervalMs) const;
 
 			void SetUris(const std::wstring& audiouri, const std::wstring& videouri);
 			void GetUris(std::wstring& audiouri, std::wstring& videouri) const;
@@ -62,6 +76,7 @@ namespace vosvideo
 
 			static const int32_t DEFAULT_REC_LEN = 60;
 			static const int32_t DEFAULT_MAX_FILES_NUM = 10;
+			static const uint32_t DEFAULT_FSYNC_INTERVAL_MS = 5000;
 		private:
 			void SetFields(const web::json::value& json);
 
@@ -73,8 +88,11 @@ namespace vosvideo
 			CameraType _cameraType = CameraType::UNKNOWN;
 			// Camera can have multiple modes and conditions when recording to the file is started
 			CameraRecordingMode _recordingMode = CameraRecordingMode::PERMANENT;
+			CameraFsyncMode _fsyncMode = CameraFsyncMode::INTERVAL;
+			uint32_t _fsyncIntervalMs = DEFAULT_FSYNC_INTERVAL_MS;
 			std::wstring _cameraName;
 			std::wstring _archivePath;
+			std::vector<std::wstring> _archiveRoots;
 			std::wstring _videouri;
 			std::wstring _audiouri;
 			std::wstring _username;
@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "DeviceWorkerStatusMsg.h"
+
+using namespace std;
+using namespace vosvideo::data;
+
+DeviceWorkerStatusMsg::DeviceWorkerStatusMsg()
+{
+}
+
+DeviceWorkerStatusMsg::DeviceWorkerStatusMsg(const wstring& workerName, DeviceWorkerStatus status, int cameraId) :
+	workerName_(workerName), status_(status), cameraId_(cameraId)
+{
+}
+
+DeviceWorkerStatusMsg::~DeviceWorkerStatusMsg()
+{
+}
+
+void DeviceWorkerStatusMsg::Init(std::shared_ptr<WebSocketMessageParser> parser)
+{
+	ReceivedData::Init(parser);
+	web::json::value obj;
+	parser->GetPayload(obj);
+	FromJsonValue(obj);
+}
+
+void DeviceWorkerStatusMsg::FromJsonValue(const web::json::value& obj)
+{
+	if (obj.has_field(U("w")) && obj.at(U("w")).is_string())
+	{
+		workerName_ = obj.at(U("w")).as_string();
+	}
+
+	if (obj.has_field(U("s")) && obj.at(U("s")).is_number())
+	{
+		status_ = static_cast<DeviceWorkerStatus>(obj.at(U("s")).as_integer());
+	}
+
+	if (obj.has_field(U("c")) && obj.at(U("c")).is_number())
+	{
+		cameraId_ = obj.at(U("c")).as_integer();
+	}
+}
+
+web::json::value DeviceWorkerStatusMsg::ToJsonValue() const
+{
+	web::json::value jObj;
+	jObj[L"mt"] = web::json::value::number(static_cast<int>(MsgType::DeviceWorkerStatusMsg));
+	jObj[L"w"] = web::json::value::string(workerName_);
+	jObj[L"s"] = web::json::value::number(static_cast<int>(status_));
+	jObj[L"c"] = web::json::value::number(cameraId_);
+	return jObj;
+}
+
+wstring DeviceWorkerStatusMsg::ToString() const
+{
+	return ToJsonValue().serialize();
+}
+
+wstring DeviceWorkerStatusMsg::GetWorkerName() const
+{
+	return workerName_;
+}
+
+DeviceWorkerStatus DeviceWorkerStatusMsg::GetStatus() const
+{
+	return status_;
+}
+
+int DeviceWorkerStatusMsg::GetCameraId() const
+{
+	return cameraId_;
+}
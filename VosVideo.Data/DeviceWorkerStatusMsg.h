@@ -0,0 +1,37 @@
+#pragma once
+#include "ReceivedData.h"
+
+namespace vosvideo
+{
+	namespace data
+	{
+		enum class DeviceWorkerStatus
+		{
+			Ready = 0,          // Worker finished initialization and waits for camera configuration
+			CameraStarted = 1   // Worker got configuration and opened camera
+		};
+
+		// Sent by deviceworker process to parent to report its life cycle
+		class DeviceWorkerStatusMsg final : public ReceivedData
+		{
+		public:
+			DeviceWorkerStatusMsg();
+			DeviceWorkerStatusMsg(const std::wstring& workerName, DeviceWorkerStatus status, int cameraId = -1);
+			virtual ~DeviceWorkerStatusMsg();
+
+			virtual void Init(std::shared_ptr<WebSocketMessageParser> parser) override;
+			virtual void FromJsonValue(const web::json::value& obj) override;
+			virtual web::json::value ToJsonValue() const override;
+			virtual std::wstring ToString() const override;
+
+			std::wstring GetWorkerName() const;
+			DeviceWorkerStatus GetStatus() const;
+			int GetCameraId() const;
+
+		private:
+			std::wstring workerName_;
+			DeviceWorkerStatus status_ = DeviceWorkerStatus::Ready;
+			int cameraId_ = -1;
+		};
+	}
+}
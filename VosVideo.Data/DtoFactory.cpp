@@ -12,6 +12,9 @@
 #include "DeletePeerConnectionRequestMsg.h"
 #include "ArchiveCatalogRequestMsg.h"
 #include "ShutdownCameraProcessRequestMsg.h"
+#include "DeviceWorkerStatusMsg.h"
+#include "ArchivePlaybackMsg.h"
+#include "MetricsReportMsg.h"
 
 using namespace boost;
 using namespace std;
@@ -35,6 +38,9 @@ namespace vosvideo
 			factories_[MsgType::SdpAnswerMsg] =  boost::factory<SdpAnswerMsg*>();			
 			factories_[MsgType::IceCandidateAnswerMsg] =  boost::factory<IceCandidateResponseMsg*>();			
 			factories_[MsgType::ShutdownCameraProcessRequestMsg] = boost::factory<ShutdownCameraProcessRequestMsg*>();
+			factories_[MsgType::DeviceWorkerStatusMsg] = boost::factory<DeviceWorkerStatusMsg*>();
+			factories_[MsgType::ArchivePlaybackMsg] = boost::factory<ArchivePlaybackMsg*>();
+			factories_[MsgType::MetricsReportMsg] = boost::factory<MetricsReportMsg*>();
 		}
 
 		DtoFactory::~DtoFactory()
@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "MetricsReportMsg.h"
+
+using namespace std;
+using namespace util;
+using namespace metrics;
+using namespace vosvideo::data;
+
+MetricsReportMsg::MetricsReportMsg()
+{
+}
+
+MetricsReportMsg::MetricsReportMsg(const wstring& workerName, const vector<MetricSample>& samples) :
+	workerName_(workerName), samples_(samples)
+{
+}
+
+MetricsReportMsg::~MetricsReportMsg()
+{
+}
+
+void MetricsReportMsg::Init(std::shared_ptr<WebSocketMessageParser> parser)
+{
+	ReceivedData::Init(parser);
+	web::json::value obj;
+	parser->GetPayload(obj);
+	FromJsonValue(obj);
+}
+
+void MetricsReportMsg::FromJsonValue(const web::json::value& obj)
+{
+	if (obj.has_field(U("w")) && obj.at(U("w")).is_string())
+	{
+		workerName_ = obj.at(U("w")).as_string();
+	}
+
+	samples_.clear();
+	if (obj.has_field(U("m")) && obj.at(U("m")).is_array())
+	{
+		for (const auto& jSample : obj.at(U("m")).as_array())
+		{
+			if (jSample.is_object())
+			{
+				samples_.push_back(SampleFromJson(jSample));
+			}
+		}
+	}
+}
+
+web::json::value MetricsReportMsg::ToJsonValue() const
+{
+	web::json::value jObj;
+	jObj[L"mt"] = web::json::value::number(static_cast<int>(MsgType::MetricsReportMsg));
+	jObj[L"w"] = web::json::value::string(workerName_);
+	web::json::value jSamples = web::json::value::array(samples_.size());
+	for (size_t i = 0; i < samples_.size(); ++i)
+	{
+		jSamples[i] = SampleToJson(samples_[i]);
+	}
+	jObj[L"m"] = jSamples;
+	return jObj;
+}
+
+wstring MetricsReportMsg::ToString() const
+{
+	return ToJsonValue().serialize();
+}
+
+wstring MetricsReportMsg::GetWorkerName() const
+{
+	return workerName_;
+}
+
+const vector<MetricSample>& MetricsReportMsg::GetSamples() const
+{
+	return samples_;
+}
+
+vector<MetricsReportMsg> MetricsReportMsg::Split(const wstring& workerName, const vector<MetricSample>& samples, size_t maxSize)
+{
+	// Envelope with worker name and array brackets
+	const size_t envelopeSize = 32 + workerName.size();
+	vector<MetricsReportMsg> reports;
+	vector<MetricSample> part;
+	size_t partSize = envelopeSize;
+	for (const auto& sample : samples)
+	{
+		size_t sampleSize = SampleToJson(sample).serialize().size() + 1;
+		if (envelopeSize + sampleSize > maxSize)
+		{
+			LOG_WARNING("Metric " << sample.Name << " doesn't fit into report, skipped");
+			continue;
+		}
+		if (partSize + sampleSize > maxSize)
+		{
+			reports.push_back(MetricsReportMsg(workerName, part));
+			part.clear();
+			partSize = envelopeSize;
+		}
+		part.push_back(sample);
+		partSize += sampleSize;
+	}
+	if (!part.empty())
+	{
+		reports.push_back(MetricsReportMsg(workerName, part));
+	}
+	return reports;
+}
+
+web::json::value MetricsReportMsg::SampleToJson(const MetricSample& sample)
+{
+	web::json::value jSample;
+	jSample[L"n"] = web::json::value::string(StringUtil::ToWstring(sample.Name));
+	jSample[L"h"] = web::json::value::string(StringUtil::ToWstring(sample.Help));
+	jSample[L"t"] = web::json::value::number(static_cast<int>(sample.Type));
+
+	web::json::value jLabels = web::json::value::object();
+	for (const auto& label : sample.Labels)
+	{
+		jLabels[StringUtil::ToWstring(label.first)] = web::json::value::string(StringUtil::ToWstring(label.second));
+	}
+	jSample[L"l"] = jLabels;
+
+	if (sample.Type != MetricType::Histogram)
+	{
+		jSample[L"v"] = web::json::value::number(sample.Value);
+		return jSample;
+	}
+
+	// Bucket index and count pairs flattened, histogram usually has a few dozens non-empty buckets
+	web::json::value jBuckets = web::json::value::array(sample.Buckets.size() * 2);
+	for (size_t i = 0; i < sample.Buckets.size(); ++i)
+	{
+		jBuckets[2 * i] = web::json::value::number(sample.Buckets[i].first);
+		jBuckets[2 * i + 1] = web::json::value::number(sample.Buckets[i].second);
+	}
+	jSample[L"b"] = jBuckets;
+	jSample[L"c"] = web::json::value::number(sample.Count);
+	jSample[L"s"] = web::json::value::number(sample.Sum);
+	return jSample;
+}
+
+MetricSample MetricsReportMsg::SampleFromJson(const web::json::value& obj)
+{
+	MetricSample sample;
+	if (obj.has_field(U("n")) && obj.at(U("n")).is_string())
+	{
+		sample.Name = StringUtil::ToString(obj.at(U("n")).as_string());
+	}
+	if (obj.has_field(U("h")) && obj.at(U("h")).is_string())
+	{
+		sample.Help = StringUtil::ToString(obj.at(U("h")).as_string());
+	}
+	if (obj.has_field(U("t")) && obj.at(U("t")).is_number())
+	{
+		sample.Type = static_cast<MetricType>(obj.at(U("t")).as_integer());
+	}
+	if (obj.has_field(U("l")) && obj.at(U("l")).is_object())
+	{
+		for (const auto& label : obj.at(U("l")).as_object())
+		{
+			if (label.second.is_string())
+			{
+				sample.Labels.push_back(make_pair(StringUtil::ToString(label.first), StringUtil::ToString(label.second.as_string())));
+			}
+		}
+	}
+	if (obj.has_field(U("v")) && obj.at(U("v")).is_number())
+	{
+		sample.Value = obj.at(U("v")).as_number().to_int64();
+	}
+	if (obj.has_field(U("b")) && obj.at(U("b")).is_array())
+	{
+		const auto& jBuckets = obj.at(U("b")).as_array();
+		for (size_t i = 0; i + 1 < jBuckets.size(); i += 2)
+		{
+			if (jBuckets.at(i).is_number() && jBuckets.at(i + 1).is_number())
+			{
+				sample.Buckets.push_back(make_pair(jBuckets.at(i).as_number().to_uint32(), jBuckets.at(i + 1).as_number().to_uint64()));
+			}
+		}
+	}
+	if (obj.has_field(U("c")) && obj.at(U("c")).is_number())
+	{
+		sample.Count = obj.at(U("c")).as_number().to_uint64();
+	}
+	if (obj.has_field(U("s")) && obj.at(U("s")).is_number())
+	{
+		sample.Sum = obj.at(U("s")).as_number().to_uint64();
+	}
+	return sample;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "VosVideo.Common/Metrics.h"
+#include "ReceivedData.h"
+
+namespace vosvideo
+{
+	namespace data
+	{
+		// Sent by deviceworker process to parent with current values of its metrics
+		class MetricsReportMsg final : public ReceivedData
+		{
+		public:
+			MetricsReportMsg();
+			MetricsReportMsg(const std::wstring& workerName, const std::vector<metrics::MetricSample>& samples);
+			virtual ~MetricsReportMsg();
+
+			virtual void Init(std::shared_ptr<WebSocketMessageParser> parser) override;
+			virtual void FromJsonValue(const web::json::value& obj) override;
+			virtual web::json::value ToJsonValue() const override;
+			virtual std::wstring ToString() const override;
+
+			std::wstring GetWorkerName() const;
+			const std::vector<metrics::MetricSample>& GetSamples() const;
+
+			// Reports of at most maxSize bytes each, so every one fits into one interprocess queue message
+			static std::vector<MetricsReportMsg> Split(const std::wstring& workerName, const std::vector<metrics::MetricSample>& samples, size_t maxSize);
+
+		private:
+			static web::json::value SampleToJson(const metrics::MetricSample& sample);
+			static metrics::MetricSample SampleFromJson(const web::json::value& obj);
+
+			std::wstring workerName_;
+			std::vector<metrics::MetricSample> samples_;
+		};
+	}
+}
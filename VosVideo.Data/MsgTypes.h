@@ -18,6 +18,9 @@ namespace vosvideo
 			DeviceDiscoveryMsg,
 			CameraConfMsg,
 			ShutdownCameraProcessRequestMsg,
+			DeviceWorkerStatusMsg,
+			ArchivePlaybackMsg,
+			MetricsReportMsg,
 			SdpAnswerMsg = 101,
 			IceCandidateAnswerMsg,
 			LiveVideoErrorMsg,
@@ -51,6 +54,9 @@ namespace vosvideo
 				{ MsgType::DeviceDiscoveryMsg, "DeviceDiscoveryMsg" },
 				{ MsgType::CameraConfMsg, "CameraConfMsg" },
 				{ MsgType::ShutdownCameraProcessRequestMsg, "ShutdownCameraProcessRequestMsg" },
+				{ MsgType::DeviceWorkerStatusMsg, "DeviceWorkerStatusMsg" },
+				{ MsgType::ArchivePlaybackMsg, "ArchivePlaybackMsg" },
+				{ MsgType::MetricsReportMsg, "MetricsReportMsg" },
 				{ MsgType::SdpAnswerMsg, "SdpAnswerMsg" },
 				{ MsgType::IceCandidateAnswerMsg, "IceCandidateAnswerMsg" },
 				{ MsgType::LiveVideoErrorMsg, "LiveVideoErrorMsg" },
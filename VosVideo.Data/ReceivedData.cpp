@@ -43,6 +43,16 @@ wstring ReceivedData::ToString() const
 	return msg;
 }
 
+wstring ReceivedData::ToStringWithReceivedTime() const
+{
+	return _parser ? _parser->GetMessageWithReceivedTime() : L"";
+}
+
+int64_t ReceivedData::GetReceivedTime() const
+{
+	return _parser ? _parser->GetReceivedTime() : 0;
+}
+
 web::json::value ReceivedData::ToJsonValue() const
 {
 	web::json::value jObj;
@@ -18,6 +18,10 @@ namespace vosvideo
 			virtual std::wstring GetPayload();
 			// Takes whole message, for serialization and retransmit 
 			virtual std::wstring ToString() const;
+			// Whole message keeping time it was received, so deviceworker can tell how long delivery took
+			std::wstring ToStringWithReceivedTime() const;
+			// Unix time in microseconds message came from websocket
+			int64_t GetReceivedTime() const;
 
 			virtual std::wstring GetFromPeer();
 			virtual std::wstring GetToPeer();
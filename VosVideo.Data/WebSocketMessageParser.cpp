@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include <chrono>
 #include "DtoParseException.h"
 #include "WebSocketMessageParser.h"
 
@@ -14,16 +15,27 @@ WebSocketMessageParser::WebSocketMessageParser(const string& msg)
 	messageType_ = GetMessageType(jpayload);
 
 	if(messageType_  != MsgType::CameraConfMsg && 
-		messageType_ != MsgType::ShutdownCameraProcessRequestMsg)
+		messageType_ != MsgType::ShutdownCameraProcessRequestMsg &&
+		messageType_ != MsgType::DeviceWorkerStatusMsg &&
+		messageType_ != MsgType::MetricsReportMsg)
 	{
 		fromPeer_ = jpayload.at(U("fp")).as_string();
 		toPeer_ = jpayload.at(U("tp")).as_string();
 		jpayload_ = jpayload.at(U("m"));
+		if (jpayload.has_field(U("rt")))
+		{
+			receivedTime_ = jpayload.at(U("rt")).as_number().to_int64();
+		}
 	}
 	else
 	{
 		jpayload_ = jpayload;
 	}
+
+	if (receivedTime_ == 0)
+	{
+		receivedTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
 }
 
 MsgType WebSocketMessageParser::GetMessageType(const web::json::value& jpayload)
@@ -51,6 +63,18 @@ std::wstring WebSocketMessageParser::GetMessage()
 	return originalMsg_;
 }
 
+int64_t WebSocketMessageParser::GetReceivedTime()
+{
+	return receivedTime_;
+}
+
+std::wstring WebSocketMessageParser::GetMessageWithReceivedTime()
+{
+	web::json::value jmessage = web::json::value::parse(originalMsg_);
+	jmessage[U("rt")] = web::json::value::number(receivedTime_);
+	return jmessage.serialize();
+}
+
 std::wstring WebSocketMessageParser::GetToPeer()
 {
 	return toPeer_;
@@ -19,6 +19,9 @@ namespace vosvideo
 			void GetPayload(std::wstring& message);
 			void GetPayload(web::json::value& jmessage);
 			std::wstring GetMessage();
+			// Unix time in microseconds message came from websocket, travels with message passed to deviceworker
+			int64_t GetReceivedTime();
+			std::wstring GetMessageWithReceivedTime();
 
 		private:
 			MsgType GetMessageType(const web::json::value& jpayload);
@@ -28,6 +31,7 @@ namespace vosvideo
 			std::wstring fromPeer_;
 			std::wstring toPeer_;
 			std::wstring originalMsg_;
+			int64_t receivedTime_ = 0;
 		};
 	}
 }
\ No newline at end of file
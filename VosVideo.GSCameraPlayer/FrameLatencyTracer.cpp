@@ -0,0 +1,273 @@
+#include "stdafx.h"
+#include <sstream>
+#include "FrameLatencyTracer.h"
+
+using namespace std;
+using namespace util;
+using namespace metrics;
+using vosvideo::cameraplayer::FrameLatencyTracer;
+using vosvideo::cameraplayer::FrameStage;
+using vosvideo::cameraplayer::FrameTrace;
+
+const std::chrono::milliseconds FrameLatencyTracer::latencyThreshold_(500);
+const std::chrono::seconds FrameLatencyTracer::dumpInterval_(60);
+
+namespace
+{
+	struct FrameTraceMeta
+	{
+		GstMeta Meta;
+		FrameTrace Trace;
+	};
+
+	const GstMetaInfo* GetFrameTraceMetaInfo();
+
+	GType GetFrameTraceMetaApiType()
+	{
+		static volatile gsize type = 0;
+		static const gchar* tags[] = { nullptr };
+		if (g_once_init_enter(&type))
+		{
+			GType newType = gst_meta_api_type_register("VosVideoFrameTraceMetaAPI", tags);
+			g_once_init_leave(&type, newType);
+		}
+		return static_cast<GType>(type);
+	}
+
+	gboolean CbFrameTraceMetaInit(GstMeta* meta, gpointer params, GstBuffer* buffer)
+	{
+		reinterpret_cast<FrameTraceMeta*>(meta)->Trace = FrameTrace();
+		return TRUE;
+	}
+
+	// Trace has no tags, so elements keep it on copied, scaled and converted frames alike
+	gboolean CbFrameTraceMetaTransform(GstBuffer* dest, GstMeta* meta, GstBuffer* buffer, GQuark type, gpointer data)
+	{
+		auto copy = reinterpret_cast<FrameTraceMeta*>(gst_buffer_add_meta(dest, GetFrameTraceMetaInfo(), nullptr));
+		if (!copy)
+		{
+			return FALSE;
+		}
+		copy->Trace = reinterpret_cast<FrameTraceMeta*>(meta)->Trace;
+		return TRUE;
+	}
+
+	const GstMetaInfo* GetFrameTraceMetaInfo()
+	{
+		static const GstMetaInfo* info = nullptr;
+		if (g_once_init_enter(&info))
+		{
+			const GstMetaInfo* newInfo = gst_meta_register(GetFrameTraceMetaApiType(), "VosVideoFrameTraceMeta", sizeof(FrameTraceMeta),
+				CbFrameTraceMetaInit, nullptr, CbFrameTraceMetaTransform);
+			g_once_init_leave(&info, newInfo);
+		}
+		return info;
+	}
+}
+
+FrameLatencyTracer::FrameLatencyTracer(const std::wstring& camName) : camName_(StringUtil::ToString(camName))
+{
+	auto& registry = MetricsRegistry::Instance();
+	for (size_t i = static_cast<size_t>(FrameStage::Decoded); i < stageMetrics_.size(); i++)
+	{
+		stageMetrics_[i] = registry.GetHistogram("vosvideo_frame_stage_latency_seconds", "Time sampled frame took to reach stage from previous one",
+			{ { "stage", GetStageName(static_cast<FrameStage>(i)) } });
+	}
+	totalMetric_ = registry.GetHistogram("vosvideo_frame_latency_seconds", "Time from capture of sampled frame till it was handed to WebRTC");
+}
+
+void FrameLatencyTracer::Attach(GstElement* pipeline, GstElement* firstElement, GstElement* tee)
+{
+	pipeline_ = pipeline;
+
+	GstPad* pad = gst_element_get_static_pad(firstElement, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, CbDecodedProbe, this, nullptr);
+	gst_object_unref(pad);
+	pad = gst_element_get_static_pad(tee, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, CbConvertedProbe, this, nullptr);
+	gst_object_unref(pad);
+}
+
+GstPadProbeReturn FrameLatencyTracer::CbDecodedProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	static_cast<FrameLatencyTracer*>(data)->OnDecoded(info);
+	return GST_PAD_PROBE_OK;
+}
+
+void FrameLatencyTracer::OnDecoded(GstPadProbeInfo* info)
+{
+	if (framesSeen_++ % sampleInterval_ != 0)
+	{
+		return;
+	}
+
+	// Decoder may still hold the frame, meta goes to writable copy sharing its memory
+	GstBuffer* buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+	GST_PAD_PROBE_INFO_DATA(info) = buffer;
+	auto meta = reinterpret_cast<FrameTraceMeta*>(gst_buffer_add_meta(buffer, GetFrameTraceMetaInfo(), nullptr));
+	if (!meta)
+	{
+		return;
+	}
+
+	int64_t now = ToMicroseconds(std::chrono::steady_clock::now());
+	FrameTrace& trace = meta->Trace;
+	trace.Sequence = framesSeen_ - 1;
+	trace.Pts = GST_BUFFER_PTS(buffer);
+	trace.StageTimes[static_cast<size_t>(FrameStage::Decoded)] = now;
+	trace.StageTimes[static_cast<size_t>(FrameStage::Captured)] = now;
+
+	// Live sources start segment at zero, so PTS is running time frame was captured at
+	GstClock* clock = gst_element_get_clock(pipeline_);
+	if (clock)
+	{
+		if (GST_CLOCK_TIME_IS_VALID(trace.Pts))
+		{
+			GstClockTime clockNow = gst_clock_get_time(clock);
+			GstClockTime captured = gst_element_get_base_time(pipeline_) + trace.Pts;
+			if (clockNow > captured)
+			{
+				trace.StageTimes[static_cast<size_t>(FrameStage::Captured)] = now - static_cast<int64_t>((clockNow - captured) / GST_USECOND);
+			}
+		}
+		gst_object_unref(clock);
+	}
+}
+
+GstPadProbeReturn FrameLatencyTracer::CbConvertedProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	if (!GetTrace(buffer))
+	{
+		return GST_PAD_PROBE_OK;
+	}
+
+	// Converter may still hold the frame, so sampled one gets writable copy sharing its memory.
+	// Tee hands the copy to both branches, trace is written before they get it.
+	buffer = gst_buffer_make_writable(buffer);
+	GST_PAD_PROBE_INFO_DATA(info) = buffer;
+	FrameTrace* trace = GetTrace(buffer);
+	if (trace)
+	{
+		trace->StageTimes[static_cast<size_t>(FrameStage::Converted)] = ToMicroseconds(std::chrono::steady_clock::now());
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+void FrameLatencyTracer::OnDelivered(GstBuffer* buffer, std::chrono::steady_clock::time_point pulledAt)
+{
+	FrameTrace* sharedTrace = GetTrace(buffer);
+	if (!sharedTrace)
+	{
+		return;
+	}
+
+	FrameTrace trace = *sharedTrace;
+	trace.StageTimes[static_cast<size_t>(FrameStage::AppSink)] = ToMicroseconds(pulledAt);
+	trace.StageTimes[static_cast<size_t>(FrameStage::Delivered)] = ToMicroseconds(std::chrono::steady_clock::now());
+	Finish(trace);
+}
+
+void FrameLatencyTracer::Finish(const FrameTrace& trace)
+{
+	int64_t previous = trace.StageTimes[static_cast<size_t>(FrameStage::Captured)];
+	for (size_t i = static_cast<size_t>(FrameStage::Decoded); i < trace.StageTimes.size(); i++)
+	{
+		int64_t stageTime = trace.StageTimes[i];
+		if (stageTime == 0)
+		{
+			continue;
+		}
+		stageMetrics_[i]->Record(static_cast<uint64_t>(std::max<int64_t>(stageTime - previous, 0)));
+		previous = stageTime;
+	}
+	int64_t totalUs = std::max<int64_t>(previous - trace.StageTimes[static_cast<size_t>(FrameStage::Captured)], 0);
+	totalMetric_->Record(static_cast<uint64_t>(totalUs));
+
+	std::vector<FrameTrace> dump;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (flightRecord_.size() == flightRecordSize_)
+		{
+			flightRecord_.pop_front();
+		}
+		flightRecord_.push_back(trace);
+
+		if (totalUs > std::chrono::duration_cast<std::chrono::microseconds>(latencyThreshold_).count())
+		{
+			auto now = std::chrono::steady_clock::now();
+			if (!isDumped_ || now - lastDump_ >= dumpInterval_)
+			{
+				dump.assign(flightRecord_.begin(), flightRecord_.end());
+				isDumped_ = true;
+				lastDump_ = now;
+			}
+		}
+	}
+
+	if (!dump.empty())
+	{
+		DumpFlightRecord(totalUs, dump);
+	}
+}
+
+void FrameLatencyTracer::DumpFlightRecord(int64_t totalUs, const std::vector<FrameTrace>& traces) const
+{
+	std::ostringstream text;
+	text << "Camera " << camName_ << " frame latency " << totalUs / 1000 << " ms is over " << latencyThreshold_.count()
+		<< " ms, last " << traces.size() << " sampled frames, stage times in us from capture:";
+	for (const auto& trace : traces)
+	{
+		int64_t captured = trace.StageTimes[static_cast<size_t>(FrameStage::Captured)];
+		text << "\n  frame " << trace.Sequence << " pts " << (GST_CLOCK_TIME_IS_VALID(trace.Pts) ? static_cast<int64_t>(trace.Pts / GST_USECOND) : -1);
+		for (size_t i = static_cast<size_t>(FrameStage::Decoded); i < trace.StageTimes.size(); i++)
+		{
+			text << " " << GetStageName(static_cast<FrameStage>(i)) << " ";
+			if (trace.StageTimes[i] == 0)
+			{
+				text << "-";
+			}
+			else
+			{
+				text << trace.StageTimes[i] - captured;
+			}
+		}
+	}
+	LOG_WARNING(text.str());
+}
+
+std::vector<FrameTrace> FrameLatencyTracer::GetFlightRecord()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return std::vector<FrameTrace>(flightRecord_.begin(), flightRecord_.end());
+}
+
+const char* FrameLatencyTracer::GetStageName(FrameStage stage)
+{
+	switch (stage)
+	{
+	case FrameStage::Captured:
+		return "captured";
+	case FrameStage::Decoded:
+		return "decoded";
+	case FrameStage::Converted:
+		return "converted";
+	case FrameStage::AppSink:
+		return "appsink";
+	case FrameStage::Delivered:
+		return "delivered";
+	default:
+		return "unknown";
+	}
+}
+
+FrameTrace* FrameLatencyTracer::GetTrace(GstBuffer* buffer)
+{
+	auto meta = reinterpret_cast<FrameTraceMeta*>(gst_buffer_get_meta(buffer, GetFrameTraceMetaApiType()));
+	return meta ? &meta->Trace : nullptr;
+}
+
+int64_t FrameLatencyTracer::ToMicroseconds(std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
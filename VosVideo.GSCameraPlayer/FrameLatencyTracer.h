@@ -0,0 +1,84 @@
+#pragma once
+#include <array>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <gst/gst.h>
+#include "VosVideo.Common/Metrics.h"
+
+namespace vosvideo
+{
+	namespace cameraplayer
+	{
+		enum class FrameStage
+		{
+			// Estimated from buffer running time, includes network and jitter buffer
+			Captured = 0,
+			// Raw frame left source
+			Decoded,
+			// Scaled and converted frame reached tee
+			Converted,
+			// Pulled by real-time branch
+			AppSink,
+			// IncomingFrame of every WebRTC capturer returned
+			Delivered,
+			Count
+		};
+
+		struct FrameTrace
+		{
+			uint64_t Sequence = 0;
+			GstClockTime Pts = GST_CLOCK_TIME_NONE;
+			// Steady clock microseconds, 0 if stage was not reached
+			std::array<int64_t, static_cast<size_t>(FrameStage::Count)> StageTimes = {};
+		};
+
+		// Follows sampled frames from camera source to WebRTC. Trace travels with buffer as GstMeta,
+		// so it survives copies made by converter and rate elements. Time between stages goes to histograms,
+		// last traces are kept in flight recorder which is written to log once frame is late.
+		class FrameLatencyTracer final
+		{
+		public:
+			FrameLatencyTracer(const std::wstring& camName);
+
+			// Probes frames entering first element of common part of pipeline and entering tee which ends it
+			void Attach(GstElement* pipeline, GstElement* firstElement, GstElement* tee);
+			// Called from appsink handler once buffer pulled at given time was handed to capturers.
+			// Recording branch shares the buffer, so trace is finished on a copy.
+			void OnDelivered(GstBuffer* buffer, std::chrono::steady_clock::time_point pulledAt);
+
+			std::vector<FrameTrace> GetFlightRecord();
+
+			static const char* GetStageName(FrameStage stage);
+
+		private:
+			static GstPadProbeReturn CbDecodedProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+			static GstPadProbeReturn CbConvertedProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+			static FrameTrace* GetTrace(GstBuffer* buffer);
+			static int64_t ToMicroseconds(std::chrono::steady_clock::time_point time);
+
+			void OnDecoded(GstPadProbeInfo* info);
+			void Finish(const FrameTrace& trace);
+			// Writes traces as a single log record, so mutex_ is not held while it's formatted
+			void DumpFlightRecord(int64_t totalUs, const std::vector<FrameTrace>& traces) const;
+
+			std::string camName_;
+			GstElement* pipeline_ = nullptr;
+			// Touched by source streaming thread only
+			uint64_t framesSeen_ = 0;
+
+			std::array<std::shared_ptr<metrics::Histogram>, static_cast<size_t>(FrameStage::Count)> stageMetrics_;
+			std::shared_ptr<metrics::Histogram> totalMetric_;
+
+			std::mutex mutex_;
+			std::deque<FrameTrace> flightRecord_;
+			std::chrono::steady_clock::time_point lastDump_;
+			bool isDumped_ = false;
+
+			static const uint64_t sampleInterval_ = 10;
+			static const size_t flightRecordSize_ = 100;
+			static const std::chrono::milliseconds latencyThreshold_;
+			static const std::chrono::seconds dumpInterval_;
+		};
+	}
+}
@@ -0,0 +1,498 @@
+#include "stdafx.h"
+#include <boost/filesystem.hpp>
+#include "VosVideo.MediaFile/MediaSegmentIndex.h"
+#include "GSArchivePlayer.h"
+
+using namespace std;
+using namespace vosvideo::cameraplayer;
+using vosvideo::mediafile::MediaSegmentIndex;
+namespace fs = boost::filesystem;
+
+
+GSArchivePlayer::GSArchivePlayer(const std::wstring& fileName) : 
+	_state(PlayerState::Closed),
+	_fileName(fileName)
+{
+	LOG_TRACE("GSArchivePlayer created for " << util::StringUtil::ToString(fileName));
+}
+
+GSArchivePlayer::~GSArchivePlayer()
+{
+	LOG_TRACE("GSArchivePlayer destroying archive player");
+	DestroyPipeline();
+}
+
+int32_t GSArchivePlayer::OpenURL(vosvideo::data::CameraConfMsg& cameraConf)
+{
+	lock_guard<std::mutex> lock(_controlMutex);
+	if (_state != PlayerState::Closed)
+	{
+		return -1;
+	}
+
+	bool isRecordingEnabled = false;
+	std::wstring recordingFolder;
+	uint32_t recordingLength = 0;
+	uint32_t maxFilesNum = 0;
+	vosvideo::data::CameraRecordingMode recordingMode;
+	cameraConf.GetFileSinkParameters(isRecordingEnabled, recordingFolder, recordingLength, maxFilesNum, recordingMode);
+	// Camera type stays unknown, recordings have no sound and peer connection must not open microphone for them
+	_deviceId = cameraConf.GetCameraId();
+
+	// Camera's current folder is looked into first, it holds recent recordings
+	std::vector<std::wstring> archiveRoots = cameraConf.GetArchiveRoots();
+	archiveRoots.insert(archiveRoots.begin(), recordingFolder);
+	_filePath = ResolvePath(archiveRoots, _fileName);
+	if (_filePath.empty())
+	{
+		LOG_ERROR("Recording " << util::StringUtil::ToString(_fileName) << " is not found in archive");
+		return -1;
+	}
+
+	_state = PlayerState::OpenPending;
+	if (!CreatePipeline() || !Preroll())
+	{
+		DestroyPipeline();
+		_state = PlayerState::Closed;
+		return -1;
+	}
+
+	_state = PlayerState::Paused;
+	return 0;
+}
+
+void GSArchivePlayer::GetWebRtcCapability(webrtc::VideoCaptureCapability& webRtcCapability)
+{
+	webRtcCapability.width = GSArchivePlayer::FRAME_WIDTH;
+	webRtcCapability.height = GSArchivePlayer::FRAME_HEIGHT;
+	webRtcCapability.videoType = webrtc::VideoType::kI420;
+	// Fast playback delivers frames faster than camera recorded them
+	webRtcCapability.maxFPS = GSArchivePlayer::FRAMERATE_NUMERATOR * GSArchivePlayer::MAX_RATE;
+}
+
+int32_t GSArchivePlayer::Play()
+{
+	lock_guard<std::mutex> lock(_controlMutex);
+	if (!_pipeline)
+	{
+		return -1;
+	}
+
+	// Finished or stopped playback starts over
+	if (_state == PlayerState::Stopped)
+	{
+		if (!Preroll() || !DoSeek(0))
+		{
+			return -1;
+		}
+		_state = PlayerState::Paused;
+	}
+
+	_isPausedByUser = false;
+	UpdatePlayingState();
+	return 0;
+}
+
+int32_t GSArchivePlayer::Pause()
+{
+	lock_guard<std::mutex> lock(_controlMutex);
+	if (!_pipeline)
+	{
+		return -1;
+	}
+
+	_isPausedByUser = true;
+	UpdatePlayingState();
+	return 0;
+}
+
+int32_t GSArchivePlayer::Stop()
+{
+	lock_guard<std::mutex> lock(_controlMutex);
+	if (!_pipeline)
+	{
+		return -1;
+	}
+
+	gst_element_set_state(_pipeline, GST_STATE_READY);
+	_state = PlayerState::Stopped;
+	return 0;
+}
+
+int32_t GSArchivePlayer::Shutdown()
+{
+	lock_guard<std::mutex> lock(_controlMutex);
+	DestroyPipeline();
+	_state = PlayerState::Closed;
+	return 0;
+}
+
+PlayerState GSArchivePlayer::GetState(std::shared_ptr<vosvideo::data::SendData>& lastErrMsg) const
+{
+	return _state;
+}
+
+PlayerState GSArchivePlayer::GetState() const
+{
+	return _state;
+}
+
+void GSArchivePlayer::SetExternalCapturer(webrtc::VideoCaptureExternal* captureObserver)
+{
+	{
+		boost::unique_lock<boost::shared_mutex> lock(_mutex);
+		_webRtcVideoCapturers.insert(std::make_pair(reinterpret_cast<uint32_t>(captureObserver), captureObserver));
+	}
+
+	lock_guard<std::mutex> lock(_controlMutex);
+	UpdatePlayingState();
+}
+
+void GSArchivePlayer::RemoveExternalCapturers()
+{
+	{
+		boost::unique_lock<boost::shared_mutex> lock(_mutex);
+		_webRtcVideoCapturers.clear();
+	}
+
+	lock_guard<std::mutex> lock(_controlMutex);
+	UpdatePlayingState();
+}
+
+void GSArchivePlayer::RemoveExternalCapturer(webrtc::VideoCaptureExternal* captureObserver)
+{
+	{
+		boost::unique_lock<boost::shared_mutex> lock(_mutex);
+		_webRtcVideoCapturers.erase(reinterpret_cast<uint32_t>(captureObserver));
+	}
+
+	lock_guard<std::mutex> lock(_controlMutex);
+	UpdatePlayingState();
+}
+
+uint32_t GSArchivePlayer::GetDeviceId() const
+{
+	return _deviceId;
+}
+
+int32_t GSArchivePlayer::Seek(int64_t position)
+{
+	lock_guard<std::mutex> lock(_controlMutex);
+	if (!_pipeline || position < 0)
+	{
+		return -1;
+	}
+
+	if (_state == PlayerState::Stopped)
+	{
+		if (!Preroll())
+		{
+			return -1;
+		}
+		_state = PlayerState::Paused;
+	}
+
+	bool isFound = false;
+	GstClockTime keyFrameTime = FindKeyFrameTime(static_cast<GstClockTime>(position) * GST_MSECOND, isFound);
+	if (!DoSeek(keyFrameTime))
+	{
+		return -1;
+	}
+
+	UpdatePlayingState();
+	return 0;
+}
+
+int32_t GSArchivePlayer::SetRate(int32_t rate)
+{
+	if (rate != 1 && rate != 2 && rate != 4)
+	{
+		LOG_WARNING("Unsupported playback rate " << rate);
+		return -1;
+	}
+
+	lock_guard<std::mutex> lock(_controlMutex);
+	if (!_pipeline)
+	{
+		return -1;
+	}
+	if (rate == _rate)
+	{
+		return 0;
+	}
+	_rate = rate;
+
+	if (_state == PlayerState::Stopped)
+	{
+		// Applied with next seek
+		return 0;
+	}
+
+	// Rate can only be changed by flushing seek, playback continues from key frame preceding current position
+	gint64 position = 0;
+	if (!gst_element_query_position(_pipeline, GST_FORMAT_TIME, &position))
+	{
+		position = 0;
+	}
+
+	bool isFound = false;
+	GstClockTime keyFrameTime = FindKeyFrameTime(static_cast<GstClockTime>(position), isFound);
+	return DoSeek(keyFrameTime) ? 0 : -1;
+}
+
+bool GSArchivePlayer::CreatePipeline()
+{
+	_pipeline = gst_pipeline_new("archiveplayer");
+	GstElement* fileSource = gst_element_factory_make("filesrc", "archivesource");
+	GstElement* decoder = gst_element_factory_make("decodebin", "archivedecoder");
+	_videoConverter = gst_element_factory_make("videoconvert", "archiveconverter");
+	GstElement* videoScale = gst_element_factory_make("videoscale", "archivescale");
+	GstElement* videoScaleCapsFilter = gst_element_factory_make("capsfilter", "archivescalefilter");
+	_appSink = gst_element_factory_make("appsink", "archivesink");
+
+	if (!_pipeline || !fileSource || !decoder || !_videoConverter || !videoScale || !videoScaleCapsFilter || !_appSink)
+	{
+		LOG_ERROR("Unable to create archive player elements");
+		for (auto element : { fileSource, decoder, _videoConverter, videoScale, videoScaleCapsFilter, _appSink })
+		{
+			if (element)
+			{
+				gst_object_unref(element);
+			}
+		}
+		_videoConverter = nullptr;
+		_appSink = nullptr;
+		return false;
+	}
+
+	string filePath = util::StringUtil::ToString(_filePath);
+	g_object_set(fileSource, "location", filePath.c_str(), nullptr);
+
+	GstCaps* videoScaleCaps = gst_caps_new_simple(
+		"video/x-raw",
+		"format", G_TYPE_STRING, "I420",
+		"width", G_TYPE_INT, GSArchivePlayer::FRAME_WIDTH,
+		"height", G_TYPE_INT, GSArchivePlayer::FRAME_HEIGHT,
+		nullptr);
+	g_object_set(videoScaleCapsFilter, "caps", videoScaleCaps, nullptr);
+	gst_caps_unref(videoScaleCaps);
+
+	// Sink is synchronized to clock, it paces frames according to playback rate
+	g_object_set(_appSink, "emit-signals", TRUE, "sync", TRUE, "max-buffers", 1, nullptr);
+	g_signal_connect(_appSink, "new-sample", G_CALLBACK(CbNewSampleHandler), this);
+
+	gst_bin_add_many(GST_BIN(_pipeline), fileSource, decoder, _videoConverter, videoScale, videoScaleCapsFilter, _appSink, nullptr);
+	if (!gst_element_link(fileSource, decoder) ||
+		!gst_element_link_many(_videoConverter, videoScale, videoScaleCapsFilter, _appSink, nullptr))
+	{
+		LOG_ERROR("Unable to link archive player elements");
+		return false;
+	}
+	g_signal_connect(decoder, "pad-added", G_CALLBACK(CbPadAdded), this);
+
+	GstBus* bus = gst_element_get_bus(_pipeline);
+	gst_bus_set_sync_handler(bus, CbBusSyncHandler, this, nullptr);
+	gst_object_unref(bus);
+	return true;
+}
+
+void GSArchivePlayer::DestroyPipeline()
+{
+	if (_pipeline)
+	{
+		gst_element_set_state(_pipeline, GST_STATE_NULL);
+		gst_object_unref(_pipeline);
+		_pipeline = nullptr;
+		_videoConverter = nullptr;
+		_appSink = nullptr;
+	}
+}
+
+bool GSArchivePlayer::Preroll()
+{
+	if (gst_element_set_state(_pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE ||
+		gst_element_get_state(_pipeline, nullptr, nullptr, GSArchivePlayer::PREROLL_TIMEOUT) != GST_STATE_CHANGE_SUCCESS)
+	{
+		LOG_ERROR("Unable to open recording " << util::StringUtil::ToString(_filePath));
+		return false;
+	}
+	return true;
+}
+
+bool GSArchivePlayer::DoSeek(GstClockTime position)
+{
+	if (!gst_element_seek(_pipeline, static_cast<gdouble>(_rate), GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+		GST_SEEK_TYPE_SET, static_cast<gint64>(position), GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE))
+	{
+		LOG_ERROR("Seek to " << position / GST_MSECOND << " ms failed");
+		return false;
+	}
+	return true;
+}
+
+GstClockTime GSArchivePlayer::FindKeyFrameTime(GstClockTime position, bool& isFound) const
+{
+	isFound = false;
+	try
+	{
+		MediaSegmentIndex index(MediaSegmentIndex::GetIndexPath(_filePath));
+		auto entry = index.FindKeyFrame(static_cast<int64_t>(position));
+		if (entry != nullptr)
+		{
+			isFound = true;
+			return static_cast<GstClockTime>(entry->TimeCode);
+		}
+	}
+	catch (std::exception&)
+	{
+		// Without index decoder starts from the position, frames before next key frame are corrupted
+	}
+	return position;
+}
+
+void GSArchivePlayer::UpdatePlayingState()
+{
+	if (!_pipeline || _state == PlayerState::Stopped || _state == PlayerState::Closed)
+	{
+		return;
+	}
+
+	bool hasCapturers;
+	{
+		boost::shared_lock<boost::shared_mutex> lock(_mutex);
+		hasCapturers = !_webRtcVideoCapturers.empty();
+	}
+
+	// Nobody watches, no reason to decode
+	if (hasCapturers && !_isPausedByUser)
+	{
+		gst_element_set_state(_pipeline, GST_STATE_PLAYING);
+		_state = PlayerState::Started;
+	}
+	else
+	{
+		gst_element_set_state(_pipeline, GST_STATE_PAUSED);
+		_state = PlayerState::Paused;
+	}
+}
+
+std::wstring GSArchivePlayer::ResolvePath(const std::vector<std::wstring>& archiveRoots, const std::wstring& fileName)
+{
+	if (fileName.empty() || fileName == L"." || fileName == L".." ||
+		fileName.find_first_of(L"/\\:") != std::wstring::npos)
+	{
+		return L"";
+	}
+
+	// Camera moved to another root leaves its older recordings where they were written
+	for (const auto& root : archiveRoots)
+	{
+		if (root.empty())
+		{
+			continue;
+		}
+
+		boost::system::error_code ec;
+		fs::path filePath = fs::path(root) / fileName;
+		if (!fs::is_regular_file(filePath, ec))
+		{
+			continue;
+		}
+		// Link inside root must not lead out of archive
+		fs::path realPath = fs::canonical(filePath, ec);
+		if (ec || !fs::equivalent(realPath.parent_path(), root, ec))
+		{
+			LOG_WARNING("Recording " << util::StringUtil::ToString(filePath.wstring()) << " points outside of archive root");
+			continue;
+		}
+		return filePath.wstring();
+	}
+	return L"";
+}
+
+void GSArchivePlayer::CbPadAdded(GstElement* element, GstPad* pad, gpointer data)
+{
+	GSArchivePlayer* player = static_cast<GSArchivePlayer*>(data);
+	GstCaps* caps = gst_pad_get_current_caps(pad);
+	if (!caps)
+	{
+		caps = gst_pad_query_caps(pad, nullptr);
+	}
+
+	// Recording could have sound as well, only video goes to WebRTC
+	const gchar* mediaType = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+	if (g_str_has_prefix(mediaType, "video/"))
+	{
+		GstPad* sinkPad = gst_element_get_static_pad(player->_videoConverter, "sink");
+		if (!gst_pad_is_linked(sinkPad) && gst_pad_link(pad, sinkPad) != GST_PAD_LINK_OK)
+		{
+			LOG_ERROR("Unable to link decoded video of recording");
+		}
+		gst_object_unref(sinkPad);
+	}
+	gst_caps_unref(caps);
+}
+
+GstFlowReturn GSArchivePlayer::CbNewSampleHandler(GstElement* sink, GSArchivePlayer* player)
+{
+	GstSample* sample = nullptr;
+	g_signal_emit_by_name(sink, "pull-sample", &sample);
+	if (!sample)
+	{
+		return GST_FLOW_ERROR;
+	}
+
+	GstMapInfo info;
+	GstBuffer* buffer = gst_sample_get_buffer(sample);
+	if (!gst_buffer_map(buffer, &info, GST_MAP_READ))
+	{
+		gst_sample_unref(sample);
+		return GST_FLOW_ERROR;
+	}
+
+	webrtc::VideoCaptureCapability webRtcCap;
+	webRtcCap.width = GSArchivePlayer::FRAME_WIDTH;
+	webRtcCap.height = GSArchivePlayer::FRAME_HEIGHT;
+	webRtcCap.maxFPS = GSArchivePlayer::FRAMERATE_NUMERATOR * GSArchivePlayer::MAX_RATE;
+	webRtcCap.videoType = webrtc::VideoType::kI420;
+
+	{
+		boost::shared_lock<boost::shared_mutex> lock(player->_mutex);
+		for (const auto& cap : player->_webRtcVideoCapturers)
+		{
+			cap.second->IncomingFrame(info.data, info.size, webRtcCap);
+		}
+	}
+
+	gst_buffer_unmap(buffer, &info);
+	gst_sample_unref(sample);
+	return GST_FLOW_OK;
+}
+
+GstBusSyncReply GSArchivePlayer::CbBusSyncHandler(GstBus* bus, GstMessage* msg, gpointer data)
+{
+	GSArchivePlayer* player = static_cast<GSArchivePlayer*>(data);
+
+	switch (GST_MESSAGE_TYPE(msg))
+	{
+	case GST_MESSAGE_EOS:
+		LOG_TRACE("Recording " << util::StringUtil::ToString(player->_fileName) << " played to the end");
+		player->_state = PlayerState::Stopped;
+		break;
+	case GST_MESSAGE_ERROR:
+	{
+		GError* err = nullptr;
+		gchar* debugInfo = nullptr;
+		gst_message_parse_error(msg, &err, &debugInfo);
+		LOG_ERROR("Archive playback error from " << GST_OBJECT_NAME(msg->src) << ": " << err->message);
+		g_clear_error(&err);
+		g_free(debugInfo);
+		player->_state = PlayerState::Stopped;
+		break;
+	}
+	default:
+		break;
+	}
+	// Nobody runs main loop for this pipeline, messages are not queued
+	return GST_BUS_DROP;
+}
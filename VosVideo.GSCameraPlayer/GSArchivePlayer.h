@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <boost/thread/shared_mutex.hpp>
+#include <gst/gst.h>
+#include "VosVideo.CameraPlayer/ArchivePlayerBase.h"
+
+namespace vosvideo
+{
+	namespace cameraplayer
+	{
+		// Decodes recording and hands raw frames to WebRTC capturers the same way live pipeline does.
+		// Frames are paced by pipeline clock, so playback rate is applied with seek event.
+		class GSArchivePlayer : public vosvideo::cameraplayer::ArchivePlayerBase
+		{
+		public:
+			GSArchivePlayer(const std::wstring& fileName);
+			virtual ~GSArchivePlayer();
+
+			int32_t OpenURL(vosvideo::data::CameraConfMsg&) override;
+
+			void GetWebRtcCapability(webrtc::VideoCaptureCapability& webRtcCapability) override;
+			int32_t Play() override;
+			int32_t Pause() override;
+			int32_t Stop() override;
+			int32_t Shutdown() override;
+
+			PlayerState GetState(std::shared_ptr<vosvideo::data::SendData>& lastErrMsg) const  override;
+			PlayerState GetState() const override;
+
+			void SetExternalCapturer(webrtc::VideoCaptureExternal* captureObserver) override;
+			void RemoveExternalCapturers() override;
+			void RemoveExternalCapturer(webrtc::VideoCaptureExternal* captureObserver) override;
+
+			uint32_t GetDeviceId() const override;
+
+			int32_t Seek(int64_t position) override;
+			int32_t SetRate(int32_t rate) override;
+
+		private:
+			bool CreatePipeline();
+			void DestroyPipeline();
+			// Moves pipeline to PAUSED and waits until first frame is decoded
+			bool Preroll();
+			// Flushing seek with current rate, position is on recording time line
+			bool DoSeek(GstClockTime position);
+			// Key frame at or before position taken from segment index, position itself if there is no index
+			GstClockTime FindKeyFrameTime(GstClockTime position, bool& isFound) const;
+			// Must be called under _controlMutex
+			void UpdatePlayingState();
+
+			// Recording must be plain file name inside one of archive roots, anything else is rejected
+			static std::wstring ResolvePath(const std::vector<std::wstring>& archiveRoots, const std::wstring& fileName);
+			static void CbPadAdded(GstElement* element, GstPad* pad, gpointer data);
+			static GstFlowReturn CbNewSampleHandler(GstElement* sink, GSArchivePlayer* player);
+			static GstBusSyncReply CbBusSyncHandler(GstBus* bus, GstMessage* msg, gpointer data);
+
+			std::atomic<PlayerState> _state;
+			int _deviceId = 0;
+			std::wstring _fileName;
+			std::wstring _filePath;
+			int32_t _rate = 1;
+			bool _isPausedByUser = false;
+			std::mutex _controlMutex;
+
+			GstElement* _pipeline = nullptr;
+			GstElement* _videoConverter = nullptr;
+			GstElement* _appSink = nullptr;
+
+			boost::shared_mutex _mutex;
+			std::unordered_map<uint32_t, webrtc::VideoCaptureExternal*> _webRtcVideoCapturers;
+
+			static const int FRAME_WIDTH = 528;
+			static const int FRAME_HEIGHT = 384;
+			static const int FRAMERATE_NUMERATOR = 10;
+			static const int MAX_RATE = 4;
+			static const GstClockTime PREROLL_TIMEOUT = 5 * GST_SECOND;
+		};
+	}
+}
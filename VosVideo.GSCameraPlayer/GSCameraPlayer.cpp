@@ -74,6 +74,20 @@ int32_t GSCameraPlayer::OpenURL(vosvideo::data::CameraConfMsg& cameraConf)
 			_deviceName);
 	}
 
+	vosvideo::data::CameraFsyncMode fsyncMode;
+	uint32_t fsyncIntervalMs = 0;
+	cameraConf.GetFsyncParameters(fsyncMode, fsyncIntervalMs);
+	FsyncPolicy fsync = FsyncPolicy::Interval;
+	if (fsyncMode == vosvideo::data::CameraFsyncMode::NEVER)
+	{
+		fsync = FsyncPolicy::Never;
+	}
+	else if (fsyncMode == vosvideo::data::CameraFsyncMode::ONCLOSE)
+	{
+		fsync = FsyncPolicy::OnClose;
+	}
+	_pipeline->SetFsyncPolicy(fsync, std::chrono::milliseconds(fsyncIntervalMs));
+
 	_pipeline->Create();
 
 	////Need to convert to std::string due to LOG_TRACE not working with std::wstring
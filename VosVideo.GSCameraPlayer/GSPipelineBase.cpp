@@ -4,9 +4,16 @@
 #include <gst/base/gstbaseparse.h>
 #include <boost/format.hpp>
 #include "GSPipelineBase.h"
+#include "RecordingSink.h"
 
 using namespace util;
+using namespace metrics;
 using vosvideo::cameraplayer::GSPipelineBase;
+using vosvideo::cameraplayer::FrameLatencyTracer;
+using vosvideo::cameraplayer::MotionDetector;
+using vosvideo::cameraplayer::RecordingSink;
+using vosvideo::cameraplayer::RecordingWriter;
+using vosvideo::cameraplayer::RecordingWriterStats;
 using boost::wformat;
 
 GSPipelineBase* _this;
@@ -17,14 +24,219 @@ BOOL WINAPI EndProcessHandler(int32_t type)
 	return true;
 }
 
+const std::chrono::seconds GSPipelineBase::FINALIZE_TIMEOUT(5);
+
 // Need it only to finalize file recording. Called on app close only
 void GSPipelineBase::StopPipeline()
 {
+	if (!_isRecordingEnabled || !_pipeline || !_teeFilePad)
+	{
+		return;
+	}
+
+	auto started = std::chrono::steady_clock::now();
 	GstPad *filesink = gst_element_get_static_pad(_queueRecord, "sink");
 	gst_pad_unlink(_teeFilePad, filesink);
 	gst_object_unref(filesink);
 	gst_element_send_event(_x264encoder, gst_event_new_eos());
-	std::this_thread::sleep_for(std::chrono::seconds(10));
+
+	// Bus watch reports when muxer wrote the tail, fragments before it are on disk already
+	std::unique_lock<std::mutex> lock(_finalizeMutex);
+	if (_finalizeCond.wait_for(lock, FINALIZE_TIMEOUT, [this] { return _isRecordingFinalized; }))
+	{
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+		LOG_TRACE("Recording finalized in " << elapsed.count() << " ms");
+	}
+	else
+	{
+		LOG_WARNING("Recording was not finalized in " << FINALIZE_TIMEOUT.count() << " s, last fragment may be lost");
+	}
+	if (_motionDetector)
+	{
+		_motionDetector->CloseAll(MotionDetector::GetNow());
+	}
+
+	auto stats = GetRecordingStats();
+	LOG_DEBUG("Camera " << StringUtil::ToString(_camName) << " recording I/O: " << stats.WrittenBytes << " bytes in " << stats.Writes 
+		<< " writes, max write " << stats.MaxWriteLatencyUs << " us, max fsync " << stats.MaxFsyncLatencyUs << " us, max queue " 
+		<< stats.MaxQueuedBytes << " bytes, " << stats.BlockedWrites << " blocked writes");
+}
+
+RecordingWriterStats GSPipelineBase::GetRecordingStats()
+{
+	return _recordingWriter ? _recordingWriter->GetStats() : RecordingWriterStats();
+}
+
+void GSPipelineBase::OnRecordingFinalized()
+{
+	{
+		std::lock_guard<std::mutex> lock(_finalizeMutex);
+		_isRecordingFinalized = true;
+	}
+	_finalizeCond.notify_all();
+}
+
+GstPadProbeReturn GSPipelineBase::CbRecordedFrameProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	GSPipelineBase* pipelineBase = (GSPipelineBase*)data;
+	if (!pipelineBase->_isRecordedVideoInfoSet)
+	{
+		GstCaps* caps = gst_pad_get_current_caps(pad);
+		if (!caps)
+		{
+			return GST_PAD_PROBE_OK;
+		}
+		pipelineBase->_isRecordedVideoInfoSet = gst_video_info_from_caps(&pipelineBase->_recordedVideoInfo, caps);
+		gst_caps_unref(caps);
+		if (!pipelineBase->_isRecordedVideoInfoSet)
+		{
+			return GST_PAD_PROBE_OK;
+		}
+	}
+
+	GstVideoFrame frame;
+	if (gst_video_frame_map(&frame, &pipelineBase->_recordedVideoInfo, GST_PAD_PROBE_INFO_BUFFER(info), GST_MAP_READ))
+	{
+		// Luma is the first plane of every YUV format recording branch gets
+		pipelineBase->_motionDetector->OnFrame(
+			static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)),
+			GST_VIDEO_FRAME_WIDTH(&frame),
+			GST_VIDEO_FRAME_HEIGHT(&frame),
+			GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0),
+			MotionDetector::GetNow());
+		gst_video_frame_unmap(&frame);
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+void GSPipelineBase::OnFragmentMessage(GstMessage* msg)
+{
+	const GstStructure* s = gst_message_get_structure(msg);
+	const gchar* location = gst_structure_get_string(s, "location");
+	if (!_motionDetector || !location)
+	{
+		return;
+	}
+
+	std::wstring path = StringUtil::ToWstring(location);
+	if (gst_structure_has_name(s, "splitmuxsink-fragment-opened"))
+	{
+		_motionDetector->OnRecordingOpened(path, MotionDetector::GetNow());
+	}
+	else
+	{
+		_motionDetector->OnRecordingClosed(path, MotionDetector::GetNow());
+	}
+}
+
+void GSPipelineBase::CreateMetrics()
+{
+	auto& registry = MetricsRegistry::Instance();
+	_framesInMetric = registry.GetCounter("vosvideo_frames_in_total", "Frames decoded from camera source");
+	_framesOutMetric = registry.GetCounter("vosvideo_frames_out_total", "Frames handed to WebRTC capturers, once per capturer");
+	_framesDroppedMetric = registry.GetCounter("vosvideo_frames_dropped_total", "Real-time frames which could not be handed to WebRTC");
+	_convertTimeMetric = registry.GetHistogram("vosvideo_convert_time_seconds", "Time frame spent in color converter");
+	_encodeTimeMetric = registry.GetHistogram("vosvideo_encode_time_seconds", "Time frame spent in recording encoder");
+	_latencyTracer.reset(new FrameLatencyTracer(_camName));
+}
+
+void GSPipelineBase::AddMetricsProbes()
+{
+	GstPad* pad = gst_element_get_static_pad(_videoConverter, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, CbConvertSinkProbe, this, nullptr);
+	gst_object_unref(pad);
+	pad = gst_element_get_static_pad(_videoConverter, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, CbConvertSrcProbe, this, nullptr);
+	gst_object_unref(pad);
+	_latencyTracer->Attach(_pipeline, _videoConverter, _tee);
+
+	if (!_isRecordingEnabled)
+	{
+		return;
+	}
+	pad = gst_element_get_static_pad(_x264encoder, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, CbEncodeSinkProbe, this, nullptr);
+	gst_object_unref(pad);
+	pad = gst_element_get_static_pad(_x264encoder, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, CbEncodeSrcProbe, this, nullptr);
+	gst_object_unref(pad);
+	if (_metricsCollectorId)
+	{
+		return;
+	}
+
+	// Writer keeps its own totals, they are read when metrics are requested
+	_metricsCollectorId = MetricsRegistry::Instance().AddCollector([this](std::vector<MetricSample>& samples)
+	{
+		auto stats = GetRecordingStats();
+		samples.push_back(MetricsRegistry::MakeSample("vosvideo_recording_written_bytes_total", "Bytes written to recording files", 
+			MetricType::Counter, LabelSet(), stats.WrittenBytes));
+		samples.push_back(MetricsRegistry::MakeSample("vosvideo_recording_blocked_writes_total", "Times encoder waited for full recording queue", 
+			MetricType::Counter, LabelSet(), stats.BlockedWrites));
+		samples.push_back(MetricsRegistry::MakeSample("vosvideo_recording_write_errors_total", "Failed recording writes", 
+			MetricType::Counter, LabelSet(), stats.Errors));
+		samples.push_back(MetricsRegistry::MakeSample("vosvideo_recording_queued_bytes", "Recording bytes waiting for I/O thread", 
+			MetricType::Gauge, LabelSet(), stats.QueuedBytes));
+	});
+}
+
+GstPadProbeReturn GSPipelineBase::CbConvertSinkProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	GSPipelineBase* pipelineBase = (GSPipelineBase*)data;
+	pipelineBase->_framesInMetric->Increment();
+	pipelineBase->_convertStartedAt = std::chrono::steady_clock::now();
+	return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GSPipelineBase::CbConvertSrcProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	GSPipelineBase* pipelineBase = (GSPipelineBase*)data;
+	pipelineBase->_convertTimeMetric->Record(std::chrono::steady_clock::now() - pipelineBase->_convertStartedAt);
+	return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GSPipelineBase::CbEncodeSinkProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	GSPipelineBase* pipelineBase = (GSPipelineBase*)data;
+	GstClockTime pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+	if (!GST_CLOCK_TIME_IS_VALID(pts))
+	{
+		return GST_PAD_PROBE_OK;
+	}
+
+	std::lock_guard<std::mutex> lock(pipelineBase->_encodeMutex);
+	if (pipelineBase->_encodeStartedAt.size() == MAX_ENCODING_FRAMES)
+	{
+		pipelineBase->_encodeStartedAt.pop_front();
+	}
+	pipelineBase->_encodeStartedAt.emplace_back(pts, std::chrono::steady_clock::now());
+	return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GSPipelineBase::CbEncodeSrcProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+	GSPipelineBase* pipelineBase = (GSPipelineBase*)data;
+	GstClockTime pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+	auto now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(pipelineBase->_encodeMutex);
+	auto& started = pipelineBase->_encodeStartedAt;
+	for (auto iter = started.begin(); iter != started.end(); ++iter)
+	{
+		if (iter->first == pts)
+		{
+			pipelineBase->_encodeTimeMetric->Record(now - iter->second);
+			started.erase(iter);
+			break;
+		}
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+bool GSPipelineBase::IsFileSinkMessage(GstMessage* msg)
+{
+	GstObject* src = GST_MESSAGE_SRC(msg);
+	return _fileSink && (src == GST_OBJECT(_fileSink) || gst_object_has_as_ancestor(src, GST_OBJECT(_fileSink)));
 }
 
 GSPipelineBase::GSPipelineBase(
@@ -46,11 +258,16 @@ GSPipelineBase::GSPipelineBase(
 	_appThread->detach();
 	_this = this;
 	SetConsoleCtrlHandler((PHANDLER_ROUTINE)EndProcessHandler, TRUE);
+	CreateMetrics();
 }
 
 GSPipelineBase::~GSPipelineBase()
 {
 	LOG_TRACE("GSPipelineBase destroying camera player");
+	if (_metricsCollectorId)
+	{
+		MetricsRegistry::Instance().RemoveCollector(_metricsCollectorId);
+	}
 
 	g_main_loop_unref(_mainLoop);
 
@@ -68,6 +285,12 @@ void GSPipelineBase::GetWebRtcCapability(webrtc::VideoCaptureCapability& webRtcC
 	webRtcCapability.maxFPS = GSPipelineBase::FRAMERATE_NUMERATOR;
 }
 
+void GSPipelineBase::SetFsyncPolicy(FsyncPolicy fsync, std::chrono::milliseconds fsyncInterval)
+{
+	_fsync = fsync;
+	_fsyncInterval = fsyncInterval;
+}
+
 void GSPipelineBase::Create()
 {
 	//Only create a new pipeline if one isn't created yet
@@ -281,8 +504,39 @@ gboolean GSPipelineBase::CreatePipeline(gpointer data)
 	gst_base_parse_set_pts_interpolation((GstBaseParse*)pipelineBase->_h264parser, true);
 	gst_base_parse_set_infer_ts((GstBaseParse*)pipelineBase->_h264parser, true);
 
-	// Configure file sink
+	// Configure file sink. Fragmented mp4 keeps everything written before crash playable,
+	// on EOS muxer only appends fragment random access table.
 	pipelineBase->_fileSink = gst_element_factory_make("splitmuxsink", "filesink");
+	GstElement* muxer = gst_element_factory_make("mp4mux", "mp4mux");
+	if (muxer)
+	{
+		g_object_set(muxer, "fragment-duration", GSPipelineBase::FRAGMENT_DURATION_MS, nullptr);
+		g_object_set(pipelineBase->_fileSink, "muxer", muxer, nullptr);
+	}
+	else
+	{
+		LOG_WARNING("Unable to create mp4mux element, recordings will not be fragmented");
+	}
+	if (pipelineBase->_isRecordingEnabled)
+	{
+		// Writes go through camera's own I/O thread, disk stalls don't back up encoder
+		RecordingWriter::Options writerOptions;
+		writerOptions.Fsync = pipelineBase->_fsync;
+		writerOptions.FsyncInterval = pipelineBase->_fsyncInterval;
+		writerOptions.PreallocateSize = GSPipelineBase::ESTIMATED_BYTES_PER_SECOND * pipelineBase->_recordingLength * 60;
+		if (writerOptions.PreallocateSize > GSPipelineBase::MAX_PREALLOCATE_SIZE)
+		{
+			writerOptions.PreallocateSize = GSPipelineBase::MAX_PREALLOCATE_SIZE;
+		}
+		pipelineBase->_recordingWriter = std::make_shared<RecordingWriter>(pipelineBase->_camName, writerOptions);
+		g_object_set(pipelineBase->_fileSink, "sink", RecordingSink::Create("recordingsink", pipelineBase->_recordingWriter), nullptr);
+
+		// Frames are already scaled down for recording, detection costs a pass over sampled luma
+		pipelineBase->_motionDetector.reset(new MotionDetector(pipelineBase->_camName));
+		GstPad* recordPad = gst_element_get_static_pad(pipelineBase->_queueRecord, "src");
+		gst_pad_add_probe(recordPad, GST_PAD_PROBE_TYPE_BUFFER, CbRecordedFrameProbe, pipelineBase, nullptr);
+		gst_object_unref(recordPad);
+	}
 	auto filePattern = boost::str(wformat(L"%1%\\%2%%3%.mp4") % pipelineBase->_recordingFolder % pipelineBase->_camName % L"%04d");
 	LOG_TRACE("Video file writer name pattern: " << filePattern);
 	g_object_set(pipelineBase->_fileSink, 
@@ -293,6 +547,7 @@ gboolean GSPipelineBase::CreatePipeline(gpointer data)
 	// Check if components properly built
 	if (!CheckFileWriterElements(pipelineBase))
 		return false;
+	pipelineBase->AddMetricsProbes();
 
 	pipelineBase->ConfigureCaps();
 
@@ -406,6 +661,31 @@ gboolean GSPipelineBase::CbBusWatchHandler(GstBus *bus, GstMessage *msg, gpointe
 	{
 		//_asm int 3;
 		g_print("End-Of-Stream reached.");
+		pipelineBase->OnRecordingFinalized();
+		break;
+	}
+	case GST_MESSAGE_ELEMENT:
+	{
+		if (gst_message_has_name(msg, "splitmuxsink-fragment-opened") || gst_message_has_name(msg, "splitmuxsink-fragment-closed"))
+		{
+			pipelineBase->OnFragmentMessage(msg);
+			break;
+		}
+		// Pipeline forwards EOS of every sink, file branch finishes before real-time one does
+		if (gst_message_has_name(msg, "GstBinForwarded"))
+		{
+			GstMessage* forwarded = nullptr;
+			gst_structure_get(gst_message_get_structure(msg), "message", GST_TYPE_MESSAGE, &forwarded, nullptr);
+			if (forwarded)
+			{
+				if (GST_MESSAGE_TYPE(forwarded) == GST_MESSAGE_EOS && pipelineBase->IsFileSinkMessage(forwarded))
+				{
+					LOG_TRACE("File sink reached End-Of-Stream");
+					pipelineBase->OnRecordingFinalized();
+				}
+				gst_message_unref(forwarded);
+			}
+		}
 		break;
 	}
 	case GST_MESSAGE_STATE_CHANGED:
@@ -529,6 +809,7 @@ GstFlowReturn GSPipelineBase::CbNewSampleHandler(GstElement *sink, GSPipelineBas
 	}
 	if (pipelineBase->_rawVideoType == webrtc::VideoType::kUnknown)
 	{
+		pipelineBase->_framesDroppedMetric->Increment();
 		return GST_FLOW_OK;
 	}
 
@@ -536,10 +817,13 @@ GstFlowReturn GSPipelineBase::CbNewSampleHandler(GstElement *sink, GSPipelineBas
 	g_signal_emit_by_name(sink, "pull-sample", &sample);
 	if (sample)
 	{
+		auto pulledAt = std::chrono::steady_clock::now();
 		GstMapInfo info;
 		GstBuffer* buffer = gst_sample_get_buffer(sample);
 		if (!gst_buffer_map(buffer, &info, GST_MAP_READ)) 
 		{
+			pipelineBase->_framesDroppedMetric->Increment();
+			gst_sample_unref(sample);
 			return GST_FLOW_ERROR;
 		}
 
@@ -559,7 +843,9 @@ GstFlowReturn GSPipelineBase::CbNewSampleHandler(GstElement *sink, GSPipelineBas
 			{
 				cap.second->IncomingFrame(data, size, webRtcCap);
 			}
+			pipelineBase->_framesOutMetric->Increment(pipelineBase->_webRtcVideoCapturers.size());
 		}
+		pipelineBase->_latencyTracer->OnDelivered(buffer, pulledAt);
 		gst_sample_unref(sample);
 		return GST_FLOW_OK;
 	}
@@ -1,10 +1,17 @@
 #pragma once
 #include <boost/thread/thread.hpp>
 #include <unordered_map>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include <webrtc/modules/video_capture/video_capture_defines.h>
 #include "VosVideo.Data/CameraConfMsg.h"
+#include "VosVideo.Common/Metrics.h"
+#include "RecordingWriter.h"
+#include "MotionDetector.h"
+#include "FrameLatencyTracer.h"
 
 namespace vosvideo
 {
@@ -21,15 +28,20 @@ namespace vosvideo
 				const std::wstring& camName);
 			~GSPipelineBase();
 
+			// How recording files are synced to disk, takes effect for pipeline created afterwards
+			void SetFsyncPolicy(FsyncPolicy fsync, std::chrono::milliseconds fsyncInterval);
 			virtual void Create();
 			virtual void StartVideo();
 			virtual void StopVideo();
 
+			// Finishes current recording, returns once file is written or finalize timeout passed
 			void StopPipeline();
 			void GetWebRtcCapability(webrtc::VideoCaptureCapability& webRtcCapability);
 			void AddExternalCapturer(webrtc::VideoCaptureExternal* externalCapturer);
 			void RemoveExternalCapturer(webrtc::VideoCaptureExternal* externalCapturer);
 			void RemoveAllExternalCapturers();
+			// Write latency and queue depth of camera recording
+			RecordingWriterStats GetRecordingStats();
 
 		protected:
 			virtual GstElement* CreateSource() = 0;
@@ -70,11 +82,19 @@ namespace vosvideo
 			std::wstring _camName;
 			uint32_t _recordingLength;
 			uint32_t _maxFilesNum;
+			FsyncPolicy _fsync = FsyncPolicy::Interval;
+			std::chrono::milliseconds _fsyncInterval = std::chrono::milliseconds(5000);
 
 			static const int FRAME_WIDTH = 528;
 			static const int FRAME_HEIGHT = 384;
 			static const int FRAMERATE_NUMERATOR = 10;
 			static const int FRAMERATE_DENOMINATOR = 1;
+			// Recording is fragmented mp4, fragment is playable as soon as it's written
+			static const int FRAGMENT_DURATION_MS = 1000;
+			static const std::chrono::seconds FINALIZE_TIMEOUT;
+			// x264enc default bitrate is 2048 kbit/s, used to size preallocation of recording files
+			static const uint64_t ESTIMATED_BYTES_PER_SECOND = 2048 * 1024 / 8;
+			static const uint64_t MAX_PREALLOCATE_SIZE = 512 * 1024 * 1024;
 
 		private:
 			void AppThreadStart();
@@ -91,6 +111,20 @@ namespace vosvideo
 			// But this one called from object scope
 			bool CheckRealTimeElements();
 			void SetWebRtcRawVideoType();
+			// EOS reached file sink, called from bus watch
+			void OnRecordingFinalized();
+			// Recorded frames go to motion detection before encoder
+			static GstPadProbeReturn CbRecordedFrameProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+			// Splitmuxsink reports every recording file it opens and closes
+			void OnFragmentMessage(GstMessage* msg);
+			bool IsFileSinkMessage(GstMessage* msg);
+			// Camera label is added by parent process, series here are unlabeled
+			void CreateMetrics();
+			void AddMetricsProbes();
+			static GstPadProbeReturn CbConvertSinkProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+			static GstPadProbeReturn CbConvertSrcProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+			static GstPadProbeReturn CbEncodeSinkProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+			static GstPadProbeReturn CbEncodeSrcProbe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
 
 			std::unique_ptr<std::thread> _appThread;
 
@@ -101,6 +135,29 @@ namespace vosvideo
 
 			boost::shared_mutex _mutex;
 			std::unordered_map<uint32_t, webrtc::VideoCaptureExternal*> _webRtcVideoCapturers;
+
+			std::mutex _finalizeMutex;
+			std::condition_variable _finalizeCond;
+			bool _isRecordingFinalized = false;
+
+			std::shared_ptr<RecordingWriter> _recordingWriter;
+			std::unique_ptr<MotionDetector> _motionDetector;
+			GstVideoInfo _recordedVideoInfo;
+			bool _isRecordedVideoInfoSet = false;
+
+			std::shared_ptr<metrics::Counter> _framesInMetric;
+			std::shared_ptr<metrics::Counter> _framesOutMetric;
+			std::shared_ptr<metrics::Counter> _framesDroppedMetric;
+			std::shared_ptr<metrics::Histogram> _convertTimeMetric;
+			std::shared_ptr<metrics::Histogram> _encodeTimeMetric;
+			uint32_t _metricsCollectorId = 0;
+			std::unique_ptr<FrameLatencyTracer> _latencyTracer;
+			// Converter works in place on streaming thread, buffer leaves it before next one comes
+			std::chrono::steady_clock::time_point _convertStartedAt;
+			// Encoder may hold frames, they are matched by PTS
+			std::mutex _encodeMutex;
+			std::deque<std::pair<GstClockTime, std::chrono::steady_clock::time_point>> _encodeStartedAt;
+			static const size_t MAX_ENCODING_FRAMES = 64;
 		};
 	}
 }
\ No newline at end of file
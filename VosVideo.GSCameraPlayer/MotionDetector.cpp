@@ -0,0 +1,202 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "VosVideo.MediaFile/MediaFileException.h"
+#include "MotionDetector.h"
+
+using namespace std;
+using namespace util;
+using vosvideo::cameraplayer::MotionDetector;
+using vosvideo::mediafile::MotionEvent;
+using vosvideo::mediafile::MotionTrack;
+
+MotionDetector::MotionDetector(const std::wstring& camName) :
+	camName_(camName)
+{
+	memset(&current_, 0, sizeof(current_));
+}
+
+MotionDetector::~MotionDetector()
+{
+}
+
+void MotionDetector::OnFrame(const uint8_t* luma, int width, int height, int stride, int64_t time)
+{
+	if (time - lastAnalyzed_ < analysisInterval_)
+	{
+		return;
+	}
+	lastAnalyzed_ = time;
+
+	const int sampledWidth = width / sampleStep_;
+	const int sampledHeight = height / sampleStep_;
+	if (sampledWidth < MotionEvent::GridColumns || sampledHeight < MotionEvent::GridRows)
+	{
+		return;
+	}
+
+	bool isFirst = (sampledWidth != previousWidth_ || sampledHeight != previousHeight_);
+	if (isFirst)
+	{
+		previous_.assign(sampledWidth * sampledHeight, 0);
+		previousWidth_ = sampledWidth;
+		previousHeight_ = sampledHeight;
+	}
+
+	uint32_t changed[MotionEvent::RegionCount] = {};
+	uint32_t total[MotionEvent::RegionCount] = {};
+	uint32_t changedAll = 0;
+	for (int y = 0; y < sampledHeight; ++y)
+	{
+		const uint8_t* row = luma + static_cast<size_t>(y) * sampleStep_ * stride;
+		uint8_t* prevRow = &previous_[static_cast<size_t>(y) * sampledWidth];
+		const int regionRow = y * MotionEvent::GridRows / sampledHeight;
+		for (int x = 0; x < sampledWidth; ++x)
+		{
+			uint8_t value = row[x * sampleStep_];
+			const int region = regionRow * MotionEvent::GridColumns + x * MotionEvent::GridColumns / sampledWidth;
+			++total[region];
+			if (std::abs(static_cast<int>(value) - prevRow[x]) > pixelThreshold_)
+			{
+				++changed[region];
+				++changedAll;
+			}
+			prevRow[x] = value;
+		}
+	}
+
+	if (isFirst)
+	{
+		return;
+	}
+
+	uint8_t levels[MotionEvent::RegionCount];
+	bool isMotion = false;
+	for (size_t i = 0; i < MotionEvent::RegionCount; ++i)
+	{
+		levels[i] = static_cast<uint8_t>(total[i] ? changed[i] * 100 / total[i] : 0);
+		isMotion = isMotion || levels[i] >= regionTrigger_;
+	}
+	uint8_t level = static_cast<uint8_t>(changedAll * 100 / (sampledWidth * sampledHeight));
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (isEventActive_ && time - lastMotion_ > holdPeriod_)
+	{
+		FinishEvent();
+	}
+	if (!isMotion)
+	{
+		return;
+	}
+
+	if (!isEventActive_)
+	{
+		memset(&current_, 0, sizeof(current_));
+		current_.Start = time;
+		isEventActive_ = true;
+	}
+	current_.End = time;
+	current_.Level = std::max(current_.Level, level);
+	for (size_t i = 0; i < MotionEvent::RegionCount; ++i)
+	{
+		current_.Regions[i] = std::max(current_.Regions[i], levels[i]);
+	}
+	lastMotion_ = time;
+}
+
+void MotionDetector::OnRecordingOpened(const std::wstring& path, int64_t time)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	recordings_[path] = time;
+}
+
+void MotionDetector::OnRecordingClosed(const std::wstring& path, int64_t time)
+{
+	vector<MotionEvent> events;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto recording = recordings_.find(path);
+		if (recording == recordings_.end())
+		{
+			return;
+		}
+		events = GetEvents(recording->second, time);
+		recordings_.erase(recording);
+
+		// Next recording starts after this one is closed
+		while (!finished_.empty() && finished_.front().End <= time)
+		{
+			finished_.pop_front();
+		}
+	}
+
+	// Empty track is written too, it tells recording was analyzed
+	try
+	{
+		MotionTrack::Write(MotionTrack::GetTrackPath(path), events);
+		LOG_TRACE("Camera " << StringUtil::ToString(camName_) << " recording " << StringUtil::ToString(path) << " has " << events.size() << " motion events");
+	}
+	catch (std::exception&)
+	{
+		// Logged by MediaFileException, recording itself is fine
+	}
+}
+
+void MotionDetector::CloseAll(int64_t time)
+{
+	vector<wstring> paths;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& recording : recordings_)
+		{
+			paths.push_back(recording.first);
+		}
+	}
+	for (const auto& path : paths)
+	{
+		OnRecordingClosed(path, time);
+	}
+}
+
+int64_t MotionDetector::GetNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void MotionDetector::FinishEvent()
+{
+	finished_.push_back(current_);
+	isEventActive_ = false;
+	if (finished_.size() > maxFinishedEvents_)
+	{
+		finished_.pop_front();
+	}
+}
+
+std::vector<MotionEvent> MotionDetector::GetEvents(int64_t from, int64_t to) const
+{
+	vector<MotionEvent> events;
+	auto addClipped = [&events, from, to](MotionEvent event)
+	{
+		if (event.End < from || event.Start >= to)
+		{
+			return;
+		}
+		// Event spanning two recordings is split between their tracks
+		event.Start = std::max(event.Start, from);
+		event.End = std::min(event.End, to);
+		events.push_back(event);
+	};
+
+	for (const auto& event : finished_)
+	{
+		addClipped(event);
+	}
+	if (isEventActive_)
+	{
+		addClipped(current_);
+	}
+	return events;
+}
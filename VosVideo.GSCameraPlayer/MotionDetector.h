@@ -0,0 +1,64 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "VosVideo.MediaFile/MotionTrack.h"
+
+namespace vosvideo
+{
+	namespace cameraplayer
+	{
+		// Finds motion in recorded frames by differencing subsampled luma of consecutive analyzed frames,
+		// changed pixels are counted per region of fixed grid. Frames with any region changed enough
+		// start or extend motion event, event ends after hold period without motion.
+		// Events are written as motion track next to every recording once it's closed.
+		// Frames come from streaming thread, recording notifications from bus watch.
+		class MotionDetector final
+		{
+		public:
+			MotionDetector(const std::wstring& camName);
+			~MotionDetector();
+
+			// Time is nanoseconds from Unix epoch
+			void OnFrame(const uint8_t* luma, int width, int height, int stride, int64_t time);
+			void OnRecordingOpened(const std::wstring& path, int64_t time);
+			// Writes track with events overlapping recording
+			void OnRecordingClosed(const std::wstring& path, int64_t time);
+			// Closes recordings which were not reported closed, on shutdown
+			void CloseAll(int64_t time);
+
+			static int64_t GetNow();
+
+		private:
+			// Must be called under mutex_
+			void FinishEvent();
+			std::vector<vosvideo::mediafile::MotionEvent> GetEvents(int64_t from, int64_t to) const;
+
+			std::wstring camName_;
+			std::mutex mutex_;
+
+			// Subsampled luma of previous analyzed frame
+			std::vector<uint8_t> previous_;
+			int previousWidth_ = 0;
+			int previousHeight_ = 0;
+			int64_t lastAnalyzed_ = 0;
+
+			bool isEventActive_ = false;
+			int64_t lastMotion_ = 0;
+			vosvideo::mediafile::MotionEvent current_;
+			std::deque<vosvideo::mediafile::MotionEvent> finished_;
+			// Open recordings with their start time
+			std::unordered_map<std::wstring, int64_t> recordings_;
+
+			// Every 4th pixel of every 4th row is compared
+			static const int sampleStep_ = 4;
+			static const int pixelThreshold_ = 24;
+			// Percent of region pixels that must change
+			static const int regionTrigger_ = 3;
+			static const int64_t analysisInterval_ = 200000000;
+			static const int64_t holdPeriod_ = 2000000000;
+			// Events of closed recordings are kept until they can't overlap next recording
+			static const size_t maxFinishedEvents_ = 4096;
+		};
+	}
+}
@@ -0,0 +1,207 @@
+#include "stdafx.h"
+#include <gst/base/gstbasesink.h>
+#include "RecordingSink.h"
+
+using namespace std;
+using namespace vosvideo::cameraplayer;
+
+namespace
+{
+	struct VvRecordingSink
+	{
+		GstBaseSink Parent;
+		gchar* Location;
+		std::shared_ptr<RecordingWriter>* Writer;
+		guint64 Position;
+	};
+
+	struct VvRecordingSinkClass
+	{
+		GstBaseSinkClass ParentClass;
+	};
+
+	enum
+	{
+		PROP_0,
+		PROP_LOCATION
+	};
+
+	GstStaticPadTemplate sinkTemplate = GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+}
+
+G_DEFINE_TYPE(VvRecordingSink, vv_recording_sink, GST_TYPE_BASE_SINK)
+
+#define VV_RECORDING_SINK(obj) (reinterpret_cast<VvRecordingSink*>(obj))
+
+static void vv_recording_sink_set_property(GObject* object, guint propId, const GValue* value, GParamSpec* pspec)
+{
+	VvRecordingSink* sink = VV_RECORDING_SINK(object);
+	switch (propId)
+	{
+	case PROP_LOCATION:
+		g_free(sink->Location);
+		sink->Location = g_value_dup_string(value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, propId, pspec);
+		break;
+	}
+}
+
+static void vv_recording_sink_get_property(GObject* object, guint propId, GValue* value, GParamSpec* pspec)
+{
+	VvRecordingSink* sink = VV_RECORDING_SINK(object);
+	switch (propId)
+	{
+	case PROP_LOCATION:
+		g_value_set_string(value, sink->Location);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, propId, pspec);
+		break;
+	}
+}
+
+static void vv_recording_sink_finalize(GObject* object)
+{
+	VvRecordingSink* sink = VV_RECORDING_SINK(object);
+	g_free(sink->Location);
+	delete sink->Writer;
+	G_OBJECT_CLASS(vv_recording_sink_parent_class)->finalize(object);
+}
+
+static gboolean vv_recording_sink_start(GstBaseSink* baseSink)
+{
+	VvRecordingSink* sink = VV_RECORDING_SINK(baseSink);
+	if (!sink->Writer || !sink->Location)
+	{
+		GST_ELEMENT_ERROR(baseSink, RESOURCE, NOT_FOUND, ("No file name specified for writing."), (nullptr));
+		return FALSE;
+	}
+
+	(*sink->Writer)->Open(util::StringUtil::ToWstring(sink->Location));
+	sink->Position = 0;
+	return TRUE;
+}
+
+static gboolean vv_recording_sink_stop(GstBaseSink* baseSink)
+{
+	VvRecordingSink* sink = VV_RECORDING_SINK(baseSink);
+	// Next file is opened while this one is still being written
+	(*sink->Writer)->Close();
+	return TRUE;
+}
+
+static GstFlowReturn vv_recording_sink_render(GstBaseSink* baseSink, GstBuffer* buffer)
+{
+	VvRecordingSink* sink = VV_RECORDING_SINK(baseSink);
+	GstMapInfo info;
+	if (!gst_buffer_map(buffer, &info, GST_MAP_READ))
+	{
+		return GST_FLOW_ERROR;
+	}
+
+	bool isOk = (*sink->Writer)->Write(sink->Position, info.data, info.size);
+	sink->Position += info.size;
+	gst_buffer_unmap(buffer, &info);
+
+	if (!isOk)
+	{
+		GST_ELEMENT_ERROR(baseSink, RESOURCE, WRITE, ("Error while writing to file \"%s\".", sink->Location), (nullptr));
+		return GST_FLOW_ERROR;
+	}
+	return GST_FLOW_OK;
+}
+
+static gboolean vv_recording_sink_event(GstBaseSink* baseSink, GstEvent* event)
+{
+	VvRecordingSink* sink = VV_RECORDING_SINK(baseSink);
+	switch (GST_EVENT_TYPE(event))
+	{
+	case GST_EVENT_SEGMENT:
+	{
+		// Muxer seeks back to update headers
+		const GstSegment* segment = nullptr;
+		gst_event_parse_segment(event, &segment);
+		if (segment->format == GST_FORMAT_BYTES)
+		{
+			sink->Position = segment->start;
+		}
+		break;
+	}
+	case GST_EVENT_EOS:
+		// EOS message means recording is complete, so it must not overtake queued writes
+		if (!(*sink->Writer)->Flush())
+		{
+			GST_ELEMENT_ERROR(baseSink, RESOURCE, WRITE, ("Error while writing to file \"%s\".", sink->Location), (nullptr));
+		}
+		break;
+	default:
+		break;
+	}
+	return GST_BASE_SINK_CLASS(vv_recording_sink_parent_class)->event(baseSink, event);
+}
+
+static gboolean vv_recording_sink_query(GstBaseSink* baseSink, GstQuery* query)
+{
+	VvRecordingSink* sink = VV_RECORDING_SINK(baseSink);
+	GstFormat format;
+	switch (GST_QUERY_TYPE(query))
+	{
+	case GST_QUERY_SEEKING:
+		// Muxer writes streamable file unless sink can seek
+		gst_query_parse_seeking(query, &format, nullptr, nullptr, nullptr);
+		gst_query_set_seeking(query, format, format == GST_FORMAT_BYTES || format == GST_FORMAT_DEFAULT, 0, -1);
+		return TRUE;
+	case GST_QUERY_POSITION:
+		gst_query_parse_position(query, &format, nullptr);
+		if (format == GST_FORMAT_BYTES || format == GST_FORMAT_DEFAULT)
+		{
+			gst_query_set_position(query, GST_FORMAT_BYTES, sink->Position);
+			return TRUE;
+		}
+		return FALSE;
+	default:
+		return GST_BASE_SINK_CLASS(vv_recording_sink_parent_class)->query(baseSink, query);
+	}
+}
+
+static void vv_recording_sink_class_init(VvRecordingSinkClass* klass)
+{
+	GObjectClass* objectClass = G_OBJECT_CLASS(klass);
+	GstElementClass* elementClass = GST_ELEMENT_CLASS(klass);
+	GstBaseSinkClass* baseSinkClass = GST_BASE_SINK_CLASS(klass);
+
+	objectClass->set_property = vv_recording_sink_set_property;
+	objectClass->get_property = vv_recording_sink_get_property;
+	objectClass->finalize = vv_recording_sink_finalize;
+
+	g_object_class_install_property(objectClass, PROP_LOCATION,
+		g_param_spec_string("location", "File Location", "Location of the file to write", nullptr,
+			static_cast<GParamFlags>(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+	gst_element_class_set_static_metadata(elementClass, "Recording sink", "Sink/File",
+		"Writes stream to file from background I/O thread", "VosVideo");
+	gst_element_class_add_pad_template(elementClass, gst_static_pad_template_get(&sinkTemplate));
+
+	baseSinkClass->start = vv_recording_sink_start;
+	baseSinkClass->stop = vv_recording_sink_stop;
+	baseSinkClass->render = vv_recording_sink_render;
+	baseSinkClass->event = vv_recording_sink_event;
+	baseSinkClass->query = vv_recording_sink_query;
+}
+
+static void vv_recording_sink_init(VvRecordingSink* sink)
+{
+	sink->Location = nullptr;
+	sink->Writer = nullptr;
+	sink->Position = 0;
+	gst_base_sink_set_sync(GST_BASE_SINK(sink), FALSE);
+}
+
+GstElement* RecordingSink::Create(const gchar* name, std::shared_ptr<RecordingWriter> writer)
+{
+	GstElement* element = GST_ELEMENT(g_object_new(vv_recording_sink_get_type(), "name", name, nullptr));
+	VV_RECORDING_SINK(element)->Writer = new std::shared_ptr<RecordingWriter>(writer);
+	return element;
+}
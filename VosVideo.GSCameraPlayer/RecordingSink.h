@@ -0,0 +1,22 @@
+#pragma once
+#include <memory>
+#include <gst/gst.h>
+#include "RecordingWriter.h"
+
+namespace vosvideo
+{
+	namespace cameraplayer
+	{
+		// Sink element for splitmuxsink which hands muxed data to RecordingWriter instead of writing it
+		// from streaming thread. Same as filesink it has "location" property set for every new file,
+		// supports byte seeks for header rewrite, and EOS passes it only after file is on disk.
+		class RecordingSink final
+		{
+		public:
+			static GstElement* Create(const gchar* name, std::shared_ptr<RecordingWriter> writer);
+
+		private:
+			RecordingSink();
+		};
+	}
+}
@@ -0,0 +1,402 @@
+#include "stdafx.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include "RecordingWriter.h"
+
+using namespace std;
+using namespace vosvideo::cameraplayer;
+
+namespace
+{
+	uint64_t ElapsedUs(std::chrono::steady_clock::time_point since)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+	}
+}
+
+RecordingWriter::RecordingWriter(const std::wstring& name, const Options& options) :
+	name_(name),
+	options_(options)
+{
+	chunk_.reserve(options_.ChunkSize);
+	ioThr_ = std::thread(&RecordingWriter::IoLoop, this);
+}
+
+RecordingWriter::~RecordingWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	queueCond_.notify_all();
+	drainCond_.notify_all();
+	ioThr_.join();
+	CloseFile();
+}
+
+void RecordingWriter::Open(const std::wstring& path)
+{
+	SubmitChunk();
+	Operation operation;
+	operation.Type = OperationType::Open;
+	operation.Path = path;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	Enqueue(std::move(operation), lock);
+}
+
+bool RecordingWriter::Write(uint64_t offset, const uint8_t* data, size_t size)
+{
+	while (size > 0)
+	{
+		// Muxer rewrites header by seeking back, that starts new chunk
+		if (!chunk_.empty() && offset != chunkOffset_ + chunk_.size())
+		{
+			SubmitChunk();
+		}
+		if (chunk_.empty())
+		{
+			chunkOffset_ = offset;
+			chunkSince_ = std::chrono::steady_clock::now();
+		}
+
+		// Fill chunk up to next aligned boundary
+		size_t room = options_.ChunkSize - static_cast<size_t>((chunkOffset_ + chunk_.size()) % options_.ChunkSize);
+		size_t part = std::min(room, size);
+		chunk_.insert(chunk_.end(), data, data + part);
+		data += part;
+		offset += part;
+		size -= part;
+
+		if (part == room)
+		{
+			SubmitChunk();
+		}
+	}
+
+	if (!chunk_.empty() && std::chrono::steady_clock::now() - chunkSince_ >= options_.MaxChunkAge)
+	{
+		SubmitChunk();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	return !isFailed_;
+}
+
+void RecordingWriter::Close()
+{
+	SubmitChunk();
+	Operation operation;
+	operation.Type = OperationType::Close;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	Enqueue(std::move(operation), lock);
+}
+
+bool RecordingWriter::Flush()
+{
+	SubmitChunk();
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	drainCond_.wait(lock, [this] { return stop_ || (queue_.empty() && !isBusy_); });
+	return !isFailed_;
+}
+
+RecordingWriterStats RecordingWriter::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void RecordingWriter::SubmitChunk()
+{
+	if (chunk_.empty())
+	{
+		return;
+	}
+
+	Operation operation;
+	operation.Type = OperationType::Write;
+	operation.Offset = chunkOffset_;
+	operation.Data.swap(chunk_);
+	chunk_.reserve(options_.ChunkSize);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (stats_.QueuedBytes >= options_.MaxQueuedBytes)
+	{
+		// Disk doesn't keep up, slow down producer rather than grow without limit
+		stats_.BlockedWrites++;
+		drainCond_.wait(lock, [this] { return stop_ || stats_.QueuedBytes < options_.MaxQueuedBytes; });
+	}
+	stats_.QueuedBytes += operation.Data.size();
+	stats_.MaxQueuedBytes = std::max(stats_.MaxQueuedBytes, stats_.QueuedBytes);
+	Enqueue(std::move(operation), lock);
+}
+
+void RecordingWriter::Enqueue(Operation&& operation, std::unique_lock<std::mutex>& lock)
+{
+	queue_.push_back(std::move(operation));
+	lock.unlock();
+	queueCond_.notify_one();
+}
+
+void RecordingWriter::IoLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		queueCond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+		if (queue_.empty())
+		{
+			break;
+		}
+
+		Operation operation = std::move(queue_.front());
+		queue_.pop_front();
+		isBusy_ = true;
+		lock.unlock();
+
+		bool isOk = Execute(operation);
+
+		lock.lock();
+		isBusy_ = false;
+		if (!isOk)
+		{
+			isFailed_ = true;
+			stats_.Errors++;
+		}
+		else if (operation.Type == OperationType::Open)
+		{
+			// Failure of previous file doesn't stop recording of next one
+			isFailed_ = false;
+		}
+		if (operation.Type == OperationType::Write)
+		{
+			stats_.QueuedBytes -= operation.Data.size();
+		}
+		drainCond_.notify_all();
+	}
+}
+
+bool RecordingWriter::Execute(Operation& operation)
+{
+	switch (operation.Type)
+	{
+	case OperationType::Open:
+	{
+		CloseFile();
+		return OpenFile(operation.Path);
+	}
+	case OperationType::Write:
+	{
+		auto started = std::chrono::steady_clock::now();
+		if (!WriteFileAt(operation.Offset, operation.Data))
+		{
+			return false;
+		}
+		uint64_t latency = ElapsedUs(started);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stats_.WrittenBytes += operation.Data.size();
+			stats_.Writes++;
+			stats_.TotalWriteLatencyUs += latency;
+			stats_.MaxWriteLatencyUs = std::max(stats_.MaxWriteLatencyUs, latency);
+		}
+		fileWrittenBytes_ += operation.Data.size();
+
+		if (options_.Fsync == FsyncPolicy::Interval && std::chrono::steady_clock::now() - lastSync_ >= options_.FsyncInterval)
+		{
+			return SyncFile();
+		}
+		return true;
+	}
+	case OperationType::Close:
+	{
+		bool isOk = true;
+		if (options_.Fsync != FsyncPolicy::Never)
+		{
+			isOk = SyncFile();
+		}
+		CloseFile();
+		return isOk;
+	}
+	}
+	return false;
+}
+
+#ifdef _WIN32
+
+bool RecordingWriter::OpenFile(const std::wstring& path)
+{
+	// Readers of growing recording and retention must be able to open and delete it
+	file_ = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		LOG_ERROR("Unable to create recording " << util::StringUtil::ToString(path) << ", error " << GetLastError());
+		return false;
+	}
+
+	path_ = path;
+	fileSize_ = 0;
+	fileWrittenBytes_ = 0;
+	lastSync_ = std::chrono::steady_clock::now();
+
+	if (options_.PreallocateSize > 0)
+	{
+		// Reserves clusters without moving end of file, unused part is released on close
+		FILE_ALLOCATION_INFO allocationInfo;
+		allocationInfo.AllocationSize.QuadPart = static_cast<LONGLONG>(options_.PreallocateSize);
+		if (!SetFileInformationByHandle(file_, FileAllocationInfo, &allocationInfo, sizeof(allocationInfo)))
+		{
+			LOG_WARNING("Unable to preallocate recording " << util::StringUtil::ToString(path) << ", error " << GetLastError());
+		}
+	}
+	return true;
+}
+
+bool RecordingWriter::WriteFileAt(uint64_t offset, const std::vector<uint8_t>& data)
+{
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+	overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	DWORD written = 0;
+	if (!WriteFile(file_, data.data(), static_cast<DWORD>(data.size()), &written, &overlapped) || written != data.size())
+	{
+		LOG_ERROR("Unable to write recording " << util::StringUtil::ToString(path_) << ", error " << GetLastError());
+		return false;
+	}
+	fileSize_ = std::max(fileSize_, offset + data.size());
+	return true;
+}
+
+bool RecordingWriter::SyncFile()
+{
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		return true;
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	if (!FlushFileBuffers(file_))
+	{
+		LOG_ERROR("Unable to flush recording " << util::StringUtil::ToString(path_) << ", error " << GetLastError());
+		return false;
+	}
+	lastSync_ = std::chrono::steady_clock::now();
+
+	uint64_t latency = ElapsedUs(started);
+	std::lock_guard<std::mutex> lock(mutex_);
+	stats_.Fsyncs++;
+	stats_.MaxFsyncLatencyUs = std::max(stats_.MaxFsyncLatencyUs, latency);
+	return true;
+}
+
+void RecordingWriter::CloseFile()
+{
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	CloseHandle(file_);
+	file_ = INVALID_HANDLE_VALUE;
+	LOG_TRACE("Camera " << util::StringUtil::ToString(name_) << " recording " << util::StringUtil::ToString(path_) << " closed, " << fileWrittenBytes_ << " bytes written");
+}
+
+#else
+
+bool RecordingWriter::OpenFile(const std::wstring& path)
+{
+	string filePath = util::StringUtil::ToString(path);
+	file_ = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (file_ < 0)
+	{
+		LOG_ERROR("Unable to create recording " << filePath << ", error " << errno);
+		return false;
+	}
+
+	path_ = path;
+	fileSize_ = 0;
+	fileWrittenBytes_ = 0;
+	lastSync_ = std::chrono::steady_clock::now();
+
+	// Keeps file size, allocated tail is cut on close
+	if (options_.PreallocateSize > 0 && fallocate(file_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(options_.PreallocateSize)) != 0)
+	{
+		LOG_WARNING("Unable to preallocate recording " << filePath << ", error " << errno);
+	}
+	return true;
+}
+
+bool RecordingWriter::WriteFileAt(uint64_t offset, const std::vector<uint8_t>& data)
+{
+	if (file_ < 0)
+	{
+		return false;
+	}
+
+	size_t done = 0;
+	while (done < data.size())
+	{
+		ssize_t written = pwrite(file_, data.data() + done, data.size() - done, static_cast<off_t>(offset + done));
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			LOG_ERROR("Unable to write recording " << util::StringUtil::ToString(path_) << ", error " << errno);
+			return false;
+		}
+		done += static_cast<size_t>(written);
+	}
+	fileSize_ = std::max(fileSize_, offset + data.size());
+	return true;
+}
+
+bool RecordingWriter::SyncFile()
+{
+	if (file_ < 0)
+	{
+		return true;
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	if (fdatasync(file_) != 0)
+	{
+		LOG_ERROR("Unable to flush recording " << util::StringUtil::ToString(path_) << ", error " << errno);
+		return false;
+	}
+	lastSync_ = std::chrono::steady_clock::now();
+
+	uint64_t latency = ElapsedUs(started);
+	std::lock_guard<std::mutex> lock(mutex_);
+	stats_.Fsyncs++;
+	stats_.MaxFsyncLatencyUs = std::max(stats_.MaxFsyncLatencyUs, latency);
+	return true;
+}
+
+void RecordingWriter::CloseFile()
+{
+	if (file_ < 0)
+	{
+		return;
+	}
+	// Blocks preallocated past end of file stay allocated until truncated
+	if (ftruncate(file_, static_cast<off_t>(fileSize_)) != 0)
+	{
+		LOG_WARNING("Unable to release preallocated space of " << util::StringUtil::ToString(path_));
+	}
+	close(file_);
+	file_ = -1;
+	LOG_TRACE("Camera " << util::StringUtil::ToString(name_) << " recording " << util::StringUtil::ToString(path_) << " closed, " << fileWrittenBytes_ << " bytes written");
+}
+
+#endif
@@ -0,0 +1,126 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+
+namespace vosvideo
+{
+	namespace cameraplayer
+	{
+		enum class FsyncPolicy
+		{
+			Never,          // Leave it to OS cache
+			OnClose,        // Sync once file is complete
+			Interval        // Sync periodically and on close
+		};
+
+		struct RecordingWriterStats
+		{
+			uint64_t WrittenBytes = 0;
+			uint64_t Writes = 0;
+			uint64_t TotalWriteLatencyUs = 0;
+			uint64_t MaxWriteLatencyUs = 0;
+			uint64_t Fsyncs = 0;
+			uint64_t MaxFsyncLatencyUs = 0;
+			uint64_t QueuedBytes = 0;
+			uint64_t MaxQueuedBytes = 0;
+			// Times streaming thread waited because queue was full
+			uint64_t BlockedWrites = 0;
+			uint64_t Errors = 0;
+		};
+
+		// Write-behind file writer of one camera. Streaming thread only copies data into chunks,
+		// file creation, writes and fsync run on writer's own I/O thread, so slow disk shows up as
+		// queue depth instead of stalling encoder. Files are preallocated to keep metadata updates
+		// out of the write path.
+		class RecordingWriter final
+		{
+		public:
+			struct Options
+			{
+				FsyncPolicy Fsync = FsyncPolicy::Interval;
+				std::chrono::milliseconds FsyncInterval = std::chrono::milliseconds(5000);
+				// Disk space reserved when file is created, file size is not changed by it
+				uint64_t PreallocateSize = 64 * 1024 * 1024;
+				// Writes are coalesced into chunks aligned to this size
+				size_t ChunkSize = 256 * 1024;
+				// Partially filled chunk is handed to I/O thread once it's that old
+				std::chrono::milliseconds MaxChunkAge = std::chrono::milliseconds(500);
+				// Streaming thread blocks when that much data waits for disk
+				uint64_t MaxQueuedBytes = 32 * 1024 * 1024;
+			};
+
+			RecordingWriter(const std::wstring& name, const Options& options);
+			~RecordingWriter();
+
+			// Following calls are made from streaming thread in file order.
+			// I/O errors are reported by next Write, it returns false once any operation failed.
+			void Open(const std::wstring& path);
+			bool Write(uint64_t offset, const uint8_t* data, size_t size);
+			void Close();
+			// Waits until everything queued reached the file
+			bool Flush();
+
+			RecordingWriterStats GetStats();
+
+		private:
+			enum class OperationType
+			{
+				Open,
+				Write,
+				Close
+			};
+
+			struct Operation
+			{
+				OperationType Type;
+				std::wstring Path;
+				uint64_t Offset = 0;
+				std::vector<uint8_t> Data;
+			};
+
+			void SubmitChunk();
+			// Must be called under mutex_
+			void Enqueue(Operation&& operation, std::unique_lock<std::mutex>& lock);
+			void IoLoop();
+			bool Execute(Operation& operation);
+
+			bool OpenFile(const std::wstring& path);
+			bool WriteFileAt(uint64_t offset, const std::vector<uint8_t>& data);
+			bool SyncFile();
+			void CloseFile();
+
+			std::wstring name_;
+			Options options_;
+
+			// Chunk being filled by streaming thread
+			std::vector<uint8_t> chunk_;
+			uint64_t chunkOffset_ = 0;
+			std::chrono::steady_clock::time_point chunkSince_;
+
+			std::mutex mutex_;
+			std::condition_variable queueCond_;
+			std::condition_variable drainCond_;
+			std::deque<Operation> queue_;
+			bool isBusy_ = false;
+			bool isFailed_ = false;
+			bool stop_ = false;
+			RecordingWriterStats stats_;
+			std::thread ioThr_;
+
+			// Owned by I/O thread
+#ifdef _WIN32
+			HANDLE file_ = INVALID_HANDLE_VALUE;
+#else
+			int file_ = -1;
+#endif
+			std::wstring path_;
+			uint64_t fileSize_ = 0;
+			uint64_t fileWrittenBytes_ = 0;
+			std::chrono::steady_clock::time_point lastSync_;
+		};
+	}
+}
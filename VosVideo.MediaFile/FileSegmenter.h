@@ -13,6 +13,8 @@ namespace vosvideo
 			virtual ~FileSegmenter(){}
 
 			virtual std::shared_ptr<MediaFileManifest> GetManifest() = 0;
+			// Picks up data appended to file since previous call, returns number of new manifest clusters
+			virtual size_t Update() { return 0; }
 		};
 	}
 }
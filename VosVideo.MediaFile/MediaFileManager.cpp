@@ -1,6 +1,11 @@
 #include "stdafx.h"
+#include <algorithm>
+#include <boost/filesystem/path.hpp>
+#include "WebmSegmenter.h"
+#include "Mp4Segmenter.h"
 #include "MediaFileManager.h"
 
+using namespace std;
 using namespace vosvideo::mediafile;
 
 MediaFileManager::MediaFileManager()
@@ -10,3 +15,37 @@ MediaFileManager::MediaFileManager()
 MediaFileManager::~MediaFileManager()
 {
 }
+
+std::shared_ptr<FileSegmenter> MediaFileManager::CreateSegmenter(const std::wstring& path)
+{
+	wstring ext = boost::filesystem::path(path).extension().wstring();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::towlower);
+
+	if (ext == L".webm")
+	{
+		return make_shared<WebmSegmenter>(path);
+	}
+	if (ext == L".mp4")
+	{
+		return make_shared<Mp4Segmenter>(path);
+	}
+	return nullptr;
+}
+
+bool MediaFileManager::BuildIndex(const std::wstring& path)
+{
+	auto segmenter = CreateSegmenter(path);
+	if (!segmenter)
+	{
+		return false;
+	}
+
+	auto manifest = segmenter->GetManifest();
+	if (!manifest || manifest->GetClusters().empty())
+	{
+		return false;
+	}
+
+	manifest->SaveIndex();
+	return true;
+}
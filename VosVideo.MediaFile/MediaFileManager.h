@@ -1,4 +1,5 @@
 #pragma once
+#include "FileSegmenter.h"
 
 namespace vosvideo
 {
@@ -9,6 +10,11 @@ namespace vosvideo
 		public:
 			MediaFileManager();
 			virtual ~MediaFileManager();
+
+			// Segmenter matching recording container, nullptr if format isn't supported
+			static std::shared_ptr<FileSegmenter> CreateSegmenter(const std::wstring& path);
+			// Writes binary segment index next to recording, returns false if recording has no clusters
+			static bool BuildIndex(const std::wstring& path);
 		};
 	}
 }
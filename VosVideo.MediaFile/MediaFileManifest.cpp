@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "MediaFileManifest.h"
+#include "MediaSegmentIndex.h"
 
 using namespace std;
 using namespace vosvideo::mediafile;
@@ -20,28 +21,62 @@ void MediaFileManifest::AddMediaCluster(const MediaCluster& cluster)
 
 std::wstring MediaFileManifest::ToJsonString()
 {
-	return L"";
+	return ToJsonObject().serialize();
 }
 
 web::json::value MediaFileManifest::ToJsonObject()
 {
 	web::json::value manifestObj;
-	manifestObj[L"total_size"] = web::json::value::number((double)totalSize_);
-	manifestObj[L"duration"] = web::json::value::number((double)duration_ns_);
+	manifestObj[L"total_size"] = web::json::value::number(totalSize_);
+	manifestObj[L"duration"] = web::json::value::number(duration_ns_);
 	manifestObj[L"filename"] = web::json::value::string(filename_);
 	vector<web::json::value> clustArr;
+	clustArr.reserve(clusters_.size());
 
 	for (auto& cl : clusters_)
 	{
-		int64_t timeCode, offset;
-		cl.GetClusterData(timeCode, offset);
 		web::json::value cluster;
-		cluster[L"timecode"] = web::json::value::number((double)timeCode);
-		cluster[L"offset"] = web::json::value::number((double)offset);
+		cluster[L"timecode"] = web::json::value::number(cl.GetTimeCode());
+		cluster[L"offset"] = web::json::value::number(cl.GetOffset());
+		cluster[L"keyframe"] = web::json::value::boolean(cl.IsKeyFrame());
 		clustArr.push_back(cluster);
 	}
 
 	manifestObj[L"clusters"] = web::json::value::array(clustArr);
-	auto str = manifestObj.serialize();
 	return manifestObj;
 }
+
+void MediaFileManifest::SaveIndex() const
+{
+	MediaSegmentIndex::Write(MediaSegmentIndex::GetIndexPath(filename_), *this);
+}
+
+const std::vector<MediaCluster>& MediaFileManifest::GetClusters() const
+{
+	return clusters_;
+}
+
+int64_t MediaFileManifest::GetTotalSize() const
+{
+	return totalSize_;
+}
+
+int64_t MediaFileManifest::GetDuration() const
+{
+	return duration_ns_;
+}
+
+const std::wstring& MediaFileManifest::GetFileName() const
+{
+	return filename_;
+}
+
+void MediaFileManifest::SetTotalSize(int64_t totalSize)
+{
+	totalSize_ = totalSize;
+}
+
+void MediaFileManifest::SetDuration(int64_t duration)
+{
+	duration_ns_ = duration;
+}
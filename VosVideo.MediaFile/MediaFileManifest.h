@@ -5,15 +5,21 @@ namespace vosvideo
 {
 	namespace mediafile
 	{
+		// Start of independently readable part of media file, time code is in nanoseconds from file start
 		class MediaCluster
 		{
 		public:
-			MediaCluster(int64_t timeCode, int64_t offset) : timeCode_(timeCode), offset_(offset){}
+			MediaCluster(int64_t timeCode, int64_t offset, bool isKeyFrame = true) : timeCode_(timeCode), offset_(offset), isKeyFrame_(isKeyFrame){}
 
-			void GetClusterData(int64_t& timeCode, int64_t& offset) { timeCode = timeCode_; offset = offset_; }
+			void GetClusterData(int64_t& timeCode, int64_t& offset) const { timeCode = timeCode_; offset = offset_; }
+			int64_t GetTimeCode() const { return timeCode_; }
+			int64_t GetOffset() const { return offset_; }
+			// Cluster starts with key frame, playback can begin from it
+			bool IsKeyFrame() const { return isKeyFrame_; }
 		private:
 			int64_t timeCode_;
 			int64_t offset_;
+			bool isKeyFrame_;
 		};
 
 		class MediaFileManifest
@@ -25,6 +31,15 @@ namespace vosvideo
 			void AddMediaCluster(const MediaCluster& cluster);
 			std::wstring ToJsonString();
 			web::json::value ToJsonObject();
+			// Writes binary index next to media file, see MediaSegmentIndex
+			void SaveIndex() const;
+
+			const std::vector<MediaCluster>& GetClusters() const;
+			int64_t GetTotalSize() const;
+			int64_t GetDuration() const;
+			const std::wstring& GetFileName() const;
+			void SetTotalSize(int64_t totalSize);
+			void SetDuration(int64_t duration);
 
 		private:
 			int64_t totalSize_;
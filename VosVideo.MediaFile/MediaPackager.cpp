@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <boost/format.hpp>
+#include "MediaPackager.h"
+
+using namespace std;
+using namespace vosvideo::mediafile;
+
+std::vector<MediaSegmentRange> MediaPackager::GetSegments(const MediaFileManifest& manifest)
+{
+	vector<MediaSegmentRange> segments;
+	const auto& clusters = manifest.GetClusters();
+
+	for (const auto& cl : clusters)
+	{
+		// Only key frame can start a segment, other clusters are appended to the current one
+		if (cl.IsKeyFrame() || segments.empty())
+		{
+			MediaSegmentRange segment;
+			segment.StartTime = cl.GetTimeCode();
+			segment.Offset = cl.GetOffset();
+			segment.Duration = 0;
+			segment.Size = 0;
+			segments.push_back(segment);
+		}
+	}
+
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		const bool isLast = (i + 1 == segments.size());
+		const int64_t endOffset = isLast ? manifest.GetTotalSize() : segments[i + 1].Offset;
+		const int64_t endTime = isLast ? manifest.GetDuration() : segments[i + 1].StartTime;
+		segments[i].Size = std::max<int64_t>(endOffset - segments[i].Offset, 0);
+		segments[i].Duration = std::max<int64_t>(endTime - segments[i].StartTime, 0);
+	}
+
+	// Drop empty tail, e.g. cluster header of recording which is still being written
+	while (!segments.empty() && segments.back().Size == 0)
+	{
+		segments.pop_back();
+	}
+
+	return segments;
+}
+
+int64_t MediaPackager::GetInitializationSize(const MediaFileManifest& manifest)
+{
+	const auto& clusters = manifest.GetClusters();
+	return clusters.empty() ? 0 : clusters.front().GetOffset();
+}
+
+std::string MediaPackager::CreateDashManifest(const MediaFileManifest& manifest, const std::string& mediaUrl, const std::string& mimeType)
+{
+	auto segments = GetSegments(manifest);
+	const int64_t initSize = GetInitializationSize(manifest);
+	const int64_t durationNs = std::max<int64_t>(manifest.GetDuration(), 1);
+	const int64_t bandwidth = static_cast<int64_t>(manifest.GetTotalSize() * 8 / (durationNs / 1e9));
+
+	std::ostringstream mpd;
+	mpd << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		<< "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" type=\"static\" profiles=\"urn:mpeg:dash:profile:full:2011\""
+		<< " minBufferTime=\"PT2S\" mediaPresentationDuration=\"" << FormatDuration(durationNs) << "\">\n"
+		<< " <Period start=\"PT0S\">\n"
+		<< "  <AdaptationSet mimeType=\"" << mimeType << "\" segmentAlignment=\"true\" startWithSAP=\"1\">\n"
+		<< "   <Representation id=\"0\" bandwidth=\"" << bandwidth << "\">\n"
+		<< "    <BaseURL>" << mediaUrl << "</BaseURL>\n"
+		<< "    <SegmentList timescale=\"1000\">\n";
+
+	if (initSize > 0)
+	{
+		mpd << "     <Initialization range=\"0-" << initSize - 1 << "\"/>\n";
+	}
+
+	mpd << "     <SegmentTimeline>\n";
+	for (const auto& segment : segments)
+	{
+		mpd << "      <S t=\"" << segment.StartTime / 1000000 << "\" d=\"" << segment.Duration / 1000000 << "\"/>\n";
+	}
+	mpd << "     </SegmentTimeline>\n";
+
+	for (const auto& segment : segments)
+	{
+		mpd << "     <SegmentURL mediaRange=\"" << segment.Offset << "-" << segment.Offset + segment.Size - 1 << "\"/>\n";
+	}
+
+	mpd << "    </SegmentList>\n"
+		<< "   </Representation>\n"
+		<< "  </AdaptationSet>\n"
+		<< " </Period>\n"
+		<< "</MPD>\n";
+
+	return mpd.str();
+}
+
+std::string MediaPackager::CreateHlsPlaylist(const MediaFileManifest& manifest, const std::string& mediaUrl)
+{
+	auto segments = GetSegments(manifest);
+	const int64_t initSize = GetInitializationSize(manifest);
+
+	int64_t maxDuration = 0;
+	for (const auto& segment : segments)
+	{
+		maxDuration = std::max(maxDuration, segment.Duration);
+	}
+
+	std::ostringstream m3u8;
+	m3u8 << "#EXTM3U\n"
+		<< "#EXT-X-VERSION:7\n"
+		<< "#EXT-X-PLAYLIST-TYPE:VOD\n"
+		<< "#EXT-X-INDEPENDENT-SEGMENTS\n"
+		<< "#EXT-X-TARGETDURATION:" << static_cast<int64_t>(std::ceil(maxDuration / 1e9)) << "\n"
+		<< "#EXT-X-MEDIA-SEQUENCE:0\n"
+		<< "#EXT-X-MAP:URI=\"" << mediaUrl << "\",BYTERANGE=\"" << initSize << "@0\"\n";
+
+	for (const auto& segment : segments)
+	{
+		m3u8 << boost::str(boost::format("#EXTINF:%.3f,\n") % (segment.Duration / 1e9))
+			<< "#EXT-X-BYTERANGE:" << segment.Size << "@" << segment.Offset << "\n"
+			<< mediaUrl << "\n";
+	}
+
+	m3u8 << "#EXT-X-ENDLIST\n";
+	return m3u8.str();
+}
+
+std::string MediaPackager::FormatDuration(int64_t durationNs)
+{
+	return boost::str(boost::format("PT%.3fS") % (durationNs / 1e9));
+}
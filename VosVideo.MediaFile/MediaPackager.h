@@ -0,0 +1,36 @@
+#pragma once
+#include "MediaFileManifest.h"
+
+namespace vosvideo
+{
+	namespace mediafile
+	{
+		// Byte range of recording which starts with key frame and can be played on its own
+		struct MediaSegmentRange
+		{
+			int64_t StartTime;
+			int64_t Duration;
+			int64_t Offset;
+			int64_t Size;
+		};
+
+		// Describes existing recording as adaptive streaming presentation.
+		// Segments are byte ranges of the original file, nothing is transcoded or copied.
+		class MediaPackager final
+		{
+		public:
+			// Splits manifest into key frame aligned segments
+			static std::vector<MediaSegmentRange> GetSegments(const MediaFileManifest& manifest);
+			// Size of file header preceding the first cluster, players need it before any segment
+			static int64_t GetInitializationSize(const MediaFileManifest& manifest);
+
+			// Static DASH MPD with SegmentList of media ranges, media URL is relative to MPD location
+			static std::string CreateDashManifest(const MediaFileManifest& manifest, const std::string& mediaUrl, const std::string& mimeType);
+			// HLS media playlist with EXT-X-BYTERANGE segments, valid for fragmented mp4 recordings only
+			static std::string CreateHlsPlaylist(const MediaFileManifest& manifest, const std::string& mediaUrl);
+
+		private:
+			static std::string FormatDuration(int64_t durationNs);
+		};
+	}
+}
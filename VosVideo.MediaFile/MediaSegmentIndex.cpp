@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "MediaFileException.h"
+#include "MediaSegmentIndex.h"
+
+using namespace std;
+using namespace util;
+using namespace boost::interprocess;
+using namespace vosvideo::mediafile;
+
+const char MediaSegmentIndex::magic_[4] = { 'V', 'V', 'I', 'X' };
+
+MediaSegmentIndex::MediaSegmentIndex(const std::wstring& indexPath)
+{
+	string path = StringUtil::ToString(indexPath);
+	const void* address = nullptr;
+#ifdef _WIN32
+	// Writer replaces index by moving it away, it can do it while we have it mapped
+	file_ = CreateFileW(indexPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER fileSize;
+	if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &fileSize))
+	{
+		DWORD err = GetLastError();
+		Unmap();
+		throw MediaFileException("Failed to open segment index " + path + ", error: " + std::to_string(err));
+	}
+	size_ = static_cast<size_t>(fileSize.QuadPart);
+	if (size_ >= sizeof(SegmentIndexHeader))
+	{
+		mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		view_ = (mapping_ != nullptr) ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view_ == nullptr)
+		{
+			DWORD err = GetLastError();
+			Unmap();
+			throw MediaFileException("Failed to map segment index " + path + ", error: " + std::to_string(err));
+		}
+		address = view_;
+	}
+#else
+	try
+	{
+		file_ = file_mapping(path.c_str(), read_only);
+		region_ = mapped_region(file_, read_only);
+	}
+	catch (interprocess_exception& ex)
+	{
+		throw MediaFileException("Failed to map segment index " + path + ": " + ex.what());
+	}
+	size_ = region_.get_size();
+	address = region_.get_address();
+#endif
+
+	if (size_ < sizeof(SegmentIndexHeader))
+	{
+		Unmap();
+		throw MediaFileException("Segment index " + path + " is truncated.");
+	}
+
+	header_ = static_cast<const SegmentIndexHeader*>(address);
+	if (memcmp(header_->Magic, magic_, sizeof(magic_)) != 0 || header_->Version != version_)
+	{
+		Unmap();
+		throw MediaFileException("Segment index " + path + " has unknown format.");
+	}
+
+	// Damaged count must not overflow size check
+	if (header_->EntryCount > (size_ - sizeof(SegmentIndexHeader)) / sizeof(SegmentIndexEntry))
+	{
+		Unmap();
+		throw MediaFileException("Segment index " + path + " is truncated.");
+	}
+
+	entries_ = reinterpret_cast<const SegmentIndexEntry*>(header_ + 1);
+}
+
+MediaSegmentIndex::~MediaSegmentIndex()
+{
+	Unmap();
+}
+
+void MediaSegmentIndex::Unmap()
+{
+#ifdef _WIN32
+	if (view_ != nullptr)
+	{
+		UnmapViewOfFile(view_);
+		view_ = nullptr;
+	}
+	if (mapping_ != nullptr)
+	{
+		CloseHandle(mapping_);
+		mapping_ = nullptr;
+	}
+	if (file_ != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+#endif
+}
+
+void MediaSegmentIndex::Write(const std::wstring& indexPath, const MediaFileManifest& manifest)
+{
+	const auto& clusters = manifest.GetClusters();
+
+	SegmentIndexHeader header;
+	memcpy(header.Magic, magic_, sizeof(magic_));
+	header.Version = version_;
+	header.EntryCount = clusters.size();
+	header.TotalSize = manifest.GetTotalSize();
+	header.DurationNs = manifest.GetDuration();
+
+	vector<SegmentIndexEntry> entries;
+	entries.reserve(clusters.size());
+	for (const auto& cl : clusters)
+	{
+		SegmentIndexEntry entry;
+		entry.TimeCode = cl.GetTimeCode();
+		entry.Offset = cl.GetOffset();
+		entry.Flags = cl.IsKeyFrame() ? KeyFrameFlag : 0;
+		entry.Reserved = 0;
+		entries.push_back(entry);
+	}
+
+	// Lookup relies on sorted time codes
+	std::stable_sort(entries.begin(), entries.end(), [](const SegmentIndexEntry& a, const SegmentIndexEntry& b)
+	{
+		return a.TimeCode < b.TimeCode;
+	});
+
+	// Readers never see half written index
+	boost::filesystem::path finalPath(indexPath);
+	boost::filesystem::path tmpPath(indexPath + L".tmp");
+	{
+		boost::filesystem::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			throw MediaFileException("Failed to create segment index " + StringUtil::ToString(tmpPath.wstring()));
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!entries.empty())
+		{
+			out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(SegmentIndexEntry));
+		}
+		if (!out)
+		{
+			throw MediaFileException("Failed to write segment index " + StringUtil::ToString(tmpPath.wstring()));
+		}
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::rename(tmpPath, finalPath, ec);
+	if (ec)
+	{
+		// Windows doesn't replace file which reader has mapped, but it lets to move it away. 
+		// Old index is deleted once last reader unmaps it.
+		boost::filesystem::path oldPath(indexPath + L"." + boost::filesystem::unique_path().wstring() + L".old");
+		boost::system::error_code moveEc;
+		boost::filesystem::rename(finalPath, oldPath, moveEc);
+		if (!moveEc)
+		{
+			boost::filesystem::rename(tmpPath, finalPath, ec);
+			boost::system::error_code removeEc;
+			boost::filesystem::remove(oldPath, removeEc);
+		}
+	}
+	if (ec)
+	{
+		boost::system::error_code removeEc;
+		boost::filesystem::remove(tmpPath, removeEc);
+		throw MediaFileException("Failed to replace segment index " + StringUtil::ToString(finalPath.wstring()) + ": " + ec.message());
+	}
+}
+
+std::wstring MediaSegmentIndex::GetIndexPath(const std::wstring& recordingPath)
+{
+	return recordingPath + L".vvidx";
+}
+
+uint64_t MediaSegmentIndex::GetEntryCount() const
+{
+	return header_->EntryCount;
+}
+
+int64_t MediaSegmentIndex::GetTotalSize() const
+{
+	return header_->TotalSize;
+}
+
+int64_t MediaSegmentIndex::GetDuration() const
+{
+	return header_->DurationNs;
+}
+
+const SegmentIndexEntry* MediaSegmentIndex::GetEntries() const
+{
+	return entries_;
+}
+
+const SegmentIndexEntry* MediaSegmentIndex::Find(int64_t timeCode) const
+{
+	const SegmentIndexEntry* end = entries_ + header_->EntryCount;
+	auto iter = std::upper_bound(entries_, end, timeCode, [](int64_t tc, const SegmentIndexEntry& entry)
+	{
+		return tc < entry.TimeCode;
+	});
+
+	return (iter == entries_) ? nullptr : iter - 1;
+}
+
+const SegmentIndexEntry* MediaSegmentIndex::FindKeyFrame(int64_t timeCode) const
+{
+	const SegmentIndexEntry* entry = Find(timeCode);
+	while (entry != nullptr && (entry->Flags & KeyFrameFlag) == 0)
+	{
+		entry = (entry == entries_) ? nullptr : entry - 1;
+	}
+	return entry;
+}
+
+std::shared_ptr<MediaFileManifest> MediaSegmentIndex::ToManifest(const std::wstring& recordingPath) const
+{
+	shared_ptr<MediaFileManifest> manifest(new MediaFileManifest(header_->TotalSize, header_->DurationNs, recordingPath));
+	for (uint64_t i = 0; i < header_->EntryCount; ++i)
+	{
+		manifest->AddMediaCluster(MediaCluster(entries_[i].TimeCode, entries_[i].Offset, (entries_[i].Flags & KeyFrameFlag) != 0));
+	}
+	return manifest;
+}
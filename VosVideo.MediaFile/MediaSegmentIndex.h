@@ -0,0 +1,79 @@
+#pragma once
+#ifndef _WIN32
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#endif
+#include "MediaFileManifest.h"
+
+namespace vosvideo
+{
+	namespace mediafile
+	{
+#pragma pack(push, 1)
+		struct SegmentIndexHeader
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint64_t EntryCount;
+			int64_t TotalSize;
+			int64_t DurationNs;
+		};
+
+		struct SegmentIndexEntry
+		{
+			int64_t TimeCode;
+			int64_t Offset;
+			uint32_t Flags;
+			uint32_t Reserved;
+		};
+#pragma pack(pop)
+
+		// Compact binary index of recording, stored next to it with .vvidx extension.
+		// Entries are sorted by time code, file is memory mapped on read, so lookup doesn't parse anything.
+		class MediaSegmentIndex final
+		{
+		public:
+			static const uint32_t KeyFrameFlag = 0x1;
+
+			// Maps existing index file, throws MediaFileException if it is missing or damaged
+			MediaSegmentIndex(const std::wstring& indexPath);
+			~MediaSegmentIndex();
+
+			// Writes index of given manifest, existing index gets replaced atomically even if reader has it mapped
+			static void Write(const std::wstring& indexPath, const MediaFileManifest& manifest);
+			static std::wstring GetIndexPath(const std::wstring& recordingPath);
+
+			uint64_t GetEntryCount() const;
+			int64_t GetTotalSize() const;
+			int64_t GetDuration() const;
+			const SegmentIndexEntry* GetEntries() const;
+
+			// Last entry with time code not greater than given one, nullptr if time code is before first entry
+			const SegmentIndexEntry* Find(int64_t timeCode) const;
+			// Same as Find, but returns entry which starts with key frame, place where playback can begin
+			const SegmentIndexEntry* FindKeyFrame(int64_t timeCode) const;
+
+			// Builds manifest back from index, for JSON export
+			std::shared_ptr<MediaFileManifest> ToManifest(const std::wstring& recordingPath) const;
+
+		private:
+			void Unmap();
+
+#ifdef _WIN32
+			// Mapped through Win32 directly, boost file_mapping takes narrow path only
+			HANDLE file_ = INVALID_HANDLE_VALUE;
+			HANDLE mapping_ = nullptr;
+			const void* view_ = nullptr;
+#else
+			boost::interprocess::file_mapping file_;
+			boost::interprocess::mapped_region region_;
+#endif
+			size_t size_ = 0;
+			const SegmentIndexHeader* header_ = nullptr;
+			const SegmentIndexEntry* entries_ = nullptr;
+
+			static const char magic_[4];
+			static const uint32_t version_ = 1;
+		};
+	}
+}
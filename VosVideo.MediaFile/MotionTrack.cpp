@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include "MediaFileException.h"
+#include "MotionTrack.h"
+
+using namespace std;
+using namespace vosvideo::mediafile;
+
+const char MotionTrack::magic_[4] = { 'V', 'V', 'M', 'T' };
+
+void MotionTrack::Write(const std::wstring& trackPath, std::vector<MotionEvent> events)
+{
+	std::stable_sort(events.begin(), events.end(), [](const MotionEvent& a, const MotionEvent& b)
+	{
+		return a.Start < b.Start;
+	});
+
+	MotionTrackHeader header;
+	memcpy(header.Magic, magic_, sizeof(magic_));
+	header.Version = version_;
+	header.EventCount = static_cast<uint32_t>(events.size());
+	header.GridColumns = MotionEvent::GridColumns;
+	header.GridRows = MotionEvent::GridRows;
+	header.Reserved = 0;
+
+	// Readers never see half written track
+	boost::filesystem::path finalPath(trackPath);
+	boost::filesystem::path tmpPath(trackPath + L".tmp");
+	{
+		std::ofstream out(tmpPath.string(), std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			throw MediaFileException("Failed to create motion track " + tmpPath.string());
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!events.empty())
+		{
+			out.write(reinterpret_cast<const char*>(events.data()), events.size() * sizeof(MotionEvent));
+		}
+		if (!out)
+		{
+			throw MediaFileException("Failed to write motion track " + tmpPath.string());
+		}
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::rename(tmpPath, finalPath, ec);
+	if (ec)
+	{
+		throw MediaFileException("Failed to replace motion track " + finalPath.string() + ": " + ec.message());
+	}
+}
+
+std::vector<MotionEvent> MotionTrack::Read(const std::wstring& trackPath)
+{
+	boost::filesystem::path path(trackPath);
+	std::ifstream in(path.string(), std::ios::binary);
+	if (!in)
+	{
+		throw MediaFileException("Failed to open motion track " + path.string());
+	}
+
+	MotionTrackHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		throw MediaFileException("Motion track " + path.string() + " is truncated.");
+	}
+	if (memcmp(header.Magic, magic_, sizeof(magic_)) != 0 || header.Version != version_ ||
+		header.GridColumns != MotionEvent::GridColumns || header.GridRows != MotionEvent::GridRows)
+	{
+		throw MediaFileException("Motion track " + path.string() + " has unknown format.");
+	}
+
+	vector<MotionEvent> events(header.EventCount);
+	if (!events.empty() && !in.read(reinterpret_cast<char*>(events.data()), events.size() * sizeof(MotionEvent)))
+	{
+		throw MediaFileException("Motion track " + path.string() + " is truncated.");
+	}
+	return events;
+}
+
+std::wstring MotionTrack::GetTrackPath(const std::wstring& recordingPath)
+{
+	return recordingPath + L".vvmot";
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+
+namespace vosvideo
+{
+	namespace mediafile
+	{
+#pragma pack(push, 1)
+		struct MotionTrackHeader
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint32_t EventCount;
+			uint8_t GridColumns;
+			uint8_t GridRows;
+			uint16_t Reserved;
+		};
+#pragma pack(pop)
+
+		// Motion interval, times are nanoseconds from Unix epoch.
+		// Levels are percent of changed pixels at the interval peak, whole frame and every grid region.
+		struct MotionEvent
+		{
+			static const uint8_t GridColumns = 4;
+			static const uint8_t GridRows = 4;
+			static const size_t RegionCount = GridColumns * GridRows;
+
+			int64_t Start;
+			int64_t End;
+			uint8_t Level;
+			uint8_t Reserved[7];
+			// Row by row, top left region first
+			uint8_t Regions[RegionCount];
+		};
+
+		// Motion intervals of recording, stored next to it with .vvmot extension.
+		// Written once when recording is closed, tens of bytes per event, so catalog reads it without touching video.
+		class MotionTrack final
+		{
+		public:
+			// Writes events sorted by start, existing track gets replaced atomically. Throws MediaFileException on failure.
+			static void Write(const std::wstring& trackPath, std::vector<MotionEvent> events);
+			// Throws MediaFileException if track is missing or damaged
+			static std::vector<MotionEvent> Read(const std::wstring& trackPath);
+			static std::wstring GetTrackPath(const std::wstring& recordingPath);
+
+		private:
+			static const char magic_[4];
+			static const uint32_t version_ = 1;
+		};
+	}
+}
@@ -0,0 +1,300 @@
+#include "stdafx.h"
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <share.h>
+#include "MediaFileException.h"
+#include "Mp4Segmenter.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::mediafile;
+
+Mp4Segmenter::Mp4Segmenter(const std::wstring& path) : FileSegmenter(path), path_(path)
+{
+	file_ = _wfsopen(path_.c_str(), L"rb", _SH_DENYNO);
+	if (file_ == nullptr)
+	{
+		throw MediaFileException("Filename is invalid or error while opening");
+	}
+
+	manifest_.reset(new MediaFileManifest(0, 0, path_));
+	Update();
+}
+
+Mp4Segmenter::~Mp4Segmenter()
+{
+	fclose(file_);
+}
+
+std::shared_ptr<MediaFileManifest> Mp4Segmenter::GetManifest()
+{
+	return manifest_;
+}
+
+size_t Mp4Segmenter::Update()
+{
+	if (isComplete_)
+	{
+		return 0;
+	}
+
+	struct _stati64 st;
+	if (_fstati64(_fileno(file_), &st) != 0)
+	{
+		return 0;
+	}
+	const int64_t available = st.st_size;
+
+	size_t added = 0;
+	vector<uint8_t> box;
+	while (nextBoxOffset_ + 8 <= available)
+	{
+		uint8_t header[16];
+		if (!ReadAt(nextBoxOffset_, header, 8))
+		{
+			break;
+		}
+
+		uint64_t boxSize = ReadUInt32(header);
+		size_t headerSize = 8;
+		if (boxSize == 1)
+		{
+			if (nextBoxOffset_ + 16 > available || !ReadAt(nextBoxOffset_ + 8, header + 8, 8))
+			{
+				break;
+			}
+			boxSize = ReadUInt64(header + 8);
+			headerSize = 16;
+		}
+
+		// Zero size box runs to the end of file, it's the last one
+		if (boxSize == 0)
+		{
+			isComplete_ = true;
+			break;
+		}
+
+		if (boxSize < headerSize)
+		{
+			LOG_WARNING("Stopped parsing " << StringUtil::ToString(path_) << " on damaged box at " << nextBoxOffset_);
+			isComplete_ = true;
+			break;
+		}
+
+		// Box isn't completely written yet, we'll get it with next update
+		if (nextBoxOffset_ + static_cast<int64_t>(boxSize) > available)
+		{
+			break;
+		}
+
+		const bool isMovie = memcmp(header + 4, "moov", 4) == 0;
+		const bool isFragment = memcmp(header + 4, "moof", 4) == 0;
+		if ((isMovie || isFragment) && boxSize <= maxBoxSize_)
+		{
+			box.resize(static_cast<size_t>(boxSize - headerSize));
+			if (!ReadAt(nextBoxOffset_ + headerSize, box.data(), box.size()))
+			{
+				break;
+			}
+
+			if (isMovie)
+			{
+				ParseMovie(box);
+			}
+			else
+			{
+				uint64_t decodeTime = 0;
+				bool isKeyFrame = true;
+				if (ParseFragment(box, decodeTime, isKeyFrame))
+				{
+					int64_t timeCode = (timeScale_ > 0) ? static_cast<int64_t>(decodeTime * 1000000000.0 / timeScale_) : 0;
+					manifest_->AddMediaCluster(MediaCluster(timeCode, nextBoxOffset_, isKeyFrame));
+					lastFragmentTime_ = timeCode;
+					++added;
+				}
+			}
+		}
+		else if (memcmp(header + 4, "mfra", 4) == 0)
+		{
+			// Random access box is written on finalization
+			isComplete_ = true;
+		}
+
+		nextBoxOffset_ += boxSize;
+	}
+
+	manifest_->SetTotalSize(nextBoxOffset_);
+	manifest_->SetDuration(movieDuration_ > 0 ? movieDuration_ : lastFragmentTime_);
+	return added;
+}
+
+bool Mp4Segmenter::ReadAt(int64_t offset, void* buffer, size_t size)
+{
+	if (_fseeki64(file_, offset, SEEK_SET) != 0)
+	{
+		return false;
+	}
+	return fread(buffer, 1, size, file_) == size;
+}
+
+void Mp4Segmenter::ParseMovie(const std::vector<uint8_t>& box)
+{
+	const uint8_t* data = box.data();
+	size_t size = box.size();
+
+	// Movie duration is zero while fragments are still being appended
+	size_t mvhdSize = 0;
+	const uint8_t* mvhd = FindBox(data, size, "mvhd", mvhdSize);
+	if (mvhd != nullptr && mvhdSize >= 32)
+	{
+		const bool v1 = mvhd[0] == 1;
+		const uint32_t scale = ReadUInt32(mvhd + (v1 ? 20 : 12));
+		const uint64_t duration = v1 ? ReadUInt64(mvhd + 24) : ReadUInt32(mvhd + 16);
+		if (scale > 0 && duration > 0 && duration != UINT32_MAX)
+		{
+			movieDuration_ = static_cast<int64_t>(duration * 1000000000.0 / scale);
+		}
+	}
+
+	// Fragments are indexed by video track, the first track is used when there is no video
+	const uint8_t* trak = nullptr;
+	size_t trakSize = 0;
+	size_t offset = 0;
+	while ((trak = FindBox(data + offset, size - offset, "trak", trakSize)) != nullptr)
+	{
+		offset = (trak - data) + trakSize;
+
+		size_t tkhdSize = 0, mdiaSize = 0, mdhdSize = 0, hdlrSize = 0;
+		const uint8_t* tkhd = FindBox(trak, trakSize, "tkhd", tkhdSize);
+		const uint8_t* mdia = FindBox(trak, trakSize, "mdia", mdiaSize);
+		if (tkhd == nullptr || mdia == nullptr || tkhdSize < 24)
+		{
+			continue;
+		}
+		const uint8_t* mdhd = FindBox(mdia, mdiaSize, "mdhd", mdhdSize);
+		const uint8_t* hdlr = FindBox(mdia, mdiaSize, "hdlr", hdlrSize);
+		if (mdhd == nullptr || mdhdSize < 24)
+		{
+			continue;
+		}
+
+		const uint32_t trackId = ReadUInt32(tkhd + (tkhd[0] == 1 ? 20 : 12));
+		const uint32_t timeScale = ReadUInt32(mdhd + (mdhd[0] == 1 ? 20 : 12));
+		const bool isVideo = hdlr != nullptr && hdlrSize >= 12 && memcmp(hdlr + 8, "vide", 4) == 0;
+
+		if (trackId_ == 0 || isVideo)
+		{
+			trackId_ = trackId;
+			timeScale_ = timeScale;
+		}
+		if (isVideo)
+		{
+			break;
+		}
+	}
+}
+
+bool Mp4Segmenter::ParseFragment(const std::vector<uint8_t>& box, uint64_t& decodeTime, bool& isKeyFrame) const
+{
+	const uint8_t* data = box.data();
+	size_t size = box.size();
+
+	const uint8_t* traf = nullptr;
+	size_t trafSize = 0;
+	size_t offset = 0;
+	while ((traf = FindBox(data + offset, size - offset, "traf", trafSize)) != nullptr)
+	{
+		offset = (traf - data) + trafSize;
+
+		size_t tfhdSize = 0, tfdtSize = 0, trunSize = 0;
+		const uint8_t* tfhd = FindBox(traf, trafSize, "tfhd", tfhdSize);
+		if (tfhd == nullptr || tfhdSize < 8)
+		{
+			continue;
+		}
+		if (trackId_ != 0 && ReadUInt32(tfhd + 4) != trackId_)
+		{
+			continue;
+		}
+
+		const uint8_t* tfdt = FindBox(traf, trafSize, "tfdt", tfdtSize);
+		if (tfdt != nullptr && tfdtSize >= 8)
+		{
+			decodeTime = (tfdt[0] == 1 && tfdtSize >= 12) ? ReadUInt64(tfdt + 4) : ReadUInt32(tfdt + 4);
+		}
+
+		// Sync flag of the first sample, from trun if it's there or from fragment defaults
+		isKeyFrame = true;
+		const uint32_t tfhdFlags = ReadUInt32(tfhd) & 0x00FFFFFF;
+		size_t defaultFlagsOffset = 8;
+		defaultFlagsOffset += (tfhdFlags & 0x01) ? 8 : 0;
+		defaultFlagsOffset += (tfhdFlags & 0x02) ? 4 : 0;
+		defaultFlagsOffset += (tfhdFlags & 0x08) ? 4 : 0;
+		defaultFlagsOffset += (tfhdFlags & 0x10) ? 4 : 0;
+		if ((tfhdFlags & 0x20) && tfhdSize >= defaultFlagsOffset + 4)
+		{
+			isKeyFrame = (ReadUInt32(tfhd + defaultFlagsOffset) & nonSyncSampleFlag_) == 0;
+		}
+
+		const uint8_t* trun = FindBox(traf, trafSize, "trun", trunSize);
+		if (trun != nullptr && trunSize >= 8)
+		{
+			const uint32_t trunFlags = ReadUInt32(trun) & 0x00FFFFFF;
+			size_t firstFlagsOffset = 8 + ((trunFlags & 0x01) ? 4 : 0);
+			if ((trunFlags & 0x04) && trunSize >= firstFlagsOffset + 4)
+			{
+				isKeyFrame = (ReadUInt32(trun + firstFlagsOffset) & nonSyncSampleFlag_) == 0;
+			}
+		}
+		return true;
+	}
+	return false;
+}
+
+const uint8_t* Mp4Segmenter::FindBox(const uint8_t* data, size_t size, const char* type, size_t& payloadSize)
+{
+	size_t pos = 0;
+	while (pos + 8 <= size)
+	{
+		uint64_t boxSize = ReadUInt32(data + pos);
+		size_t headerSize = 8;
+		if (boxSize == 1)
+		{
+			if (pos + 16 > size)
+			{
+				return nullptr;
+			}
+			boxSize = ReadUInt64(data + pos + 8);
+			headerSize = 16;
+		}
+		else if (boxSize == 0)
+		{
+			boxSize = size - pos;
+		}
+
+		if (boxSize < headerSize || pos + boxSize > size)
+		{
+			return nullptr;
+		}
+
+		if (memcmp(data + pos + 4, type, 4) == 0)
+		{
+			payloadSize = static_cast<size_t>(boxSize - headerSize);
+			return data + pos + headerSize;
+		}
+		pos += static_cast<size_t>(boxSize);
+	}
+	return nullptr;
+}
+
+uint32_t Mp4Segmenter::ReadUInt32(const uint8_t* data)
+{
+	return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+		(static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+}
+
+uint64_t Mp4Segmenter::ReadUInt64(const uint8_t* data)
+{
+	return (static_cast<uint64_t>(ReadUInt32(data)) << 32) | ReadUInt32(data + 4);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdio>
+#include "FileSegmenter.h"
+
+namespace vosvideo
+{
+	namespace mediafile
+	{
+		// Builds manifest of fragmented mp4 file from its top level boxes, every moof is a manifest cluster.
+		// Update() continues from the last complete box, so file still being recorded can be followed cheaply.
+		// Plain mp4 (single mdat + moov) gives manifest without clusters.
+		// Not thread safe, caller serializes Update() and manifest access.
+		class Mp4Segmenter : public FileSegmenter
+		{
+		public:
+			Mp4Segmenter(const std::wstring& path);
+			virtual ~Mp4Segmenter();
+
+			virtual std::shared_ptr<MediaFileManifest> GetManifest() override;
+			virtual size_t Update() override;
+
+		private:
+			bool ReadAt(int64_t offset, void* buffer, size_t size);
+			void ParseMovie(const std::vector<uint8_t>& box);
+			bool ParseFragment(const std::vector<uint8_t>& box, uint64_t& decodeTime, bool& isKeyFrame) const;
+
+			// Returns payload of the first child box of given type, nullptr if there is none
+			static const uint8_t* FindBox(const uint8_t* data, size_t size, const char* type, size_t& payloadSize);
+			static uint32_t ReadUInt32(const uint8_t* data);
+			static uint64_t ReadUInt64(const uint8_t* data);
+
+			std::wstring path_;
+			// Kept open between updates like webm reader, share mode lets recorder keep writing
+			FILE* file_ = nullptr;
+			std::shared_ptr<MediaFileManifest> manifest_;
+			// Offset of the first box not parsed yet
+			int64_t nextBoxOffset_ = 0;
+			uint32_t trackId_ = 0;
+			uint32_t timeScale_ = 0;
+			int64_t movieDuration_ = 0;
+			int64_t lastFragmentTime_ = 0;
+			bool isComplete_ = false;
+
+			static const uint32_t nonSyncSampleFlag_ = 0x00010000;
+			static const size_t maxBoxSize_ = 64 * 1024 * 1024;
+		};
+	}
+}
@@ -0,0 +1,108 @@
+#include "stdafx.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <share.h>
+#include "WebmFileReader.h"
+
+using namespace vosvideo::mediafile;
+
+WebmFileReader::WebmFileReader()
+{
+}
+
+WebmFileReader::~WebmFileReader()
+{
+	Close();
+}
+
+bool WebmFileReader::Open(const std::wstring& path)
+{
+	Close();
+	// Share mode lets recorder keep writing to the file while we read it
+	file_ = _wfsopen(path.c_str(), L"rb", _SH_DENYNO);
+	if (file_ == nullptr)
+	{
+		return false;
+	}
+	Refresh();
+	return true;
+}
+
+void WebmFileReader::Close()
+{
+	if (file_ != nullptr)
+	{
+		fclose(file_);
+		file_ = nullptr;
+	}
+	available_ = 0;
+}
+
+bool WebmFileReader::Refresh()
+{
+	if (file_ == nullptr)
+	{
+		return false;
+	}
+
+	struct _stati64 st;
+	if (_fstati64(_fileno(file_), &st) != 0)
+	{
+		return false;
+	}
+
+	bool grown = st.st_size > available_;
+	available_ = st.st_size;
+	return grown;
+}
+
+int WebmFileReader::Read(long long position, long length, unsigned char* buffer)
+{
+	if (file_ == nullptr || position < 0 || length < 0)
+	{
+		return -1;
+	}
+
+	if (length == 0)
+	{
+		return 0;
+	}
+
+	if (position + length > available_)
+	{
+		return -1;
+	}
+
+	if (_fseeki64(file_, position, SEEK_SET) != 0)
+	{
+		return -1;
+	}
+
+	const size_t size = fread(buffer, 1, length, file_);
+	return size == static_cast<size_t>(length) ? 0 : -1;
+}
+
+int WebmFileReader::Length(long long* total, long long* available)
+{
+	if (file_ == nullptr)
+	{
+		return -1;
+	}
+
+	if (total != nullptr)
+	{
+		*total = -1;
+	}
+
+	if (available != nullptr)
+	{
+		*available = available_;
+	}
+
+	return 0;
+}
+
+long long WebmFileReader::GetAvailable() const
+{
+	return available_;
+}
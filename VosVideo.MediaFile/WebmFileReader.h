@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdio>
+#include <libwebm/mkvparser.hpp>
+
+namespace vosvideo
+{
+	namespace mediafile
+	{
+		// mkvparser reader for file which can still be written by recorder.
+		// Unlike mkvparser::MkvReader it doesn't freeze file length on open, Refresh() picks up appended data.
+		// Total length is reported as unknown, so parser returns E_BUFFER_NOT_FULL on incomplete cluster instead of failing.
+		class WebmFileReader final : public mkvparser::IMkvReader
+		{
+		public:
+			WebmFileReader();
+			virtual ~WebmFileReader();
+
+			// Returns false if file can't be opened
+			bool Open(const std::wstring& path);
+			void Close();
+			// Re-reads file size, returns true if file has grown since last call
+			bool Refresh();
+
+			virtual int Read(long long position, long length, unsigned char* buffer) override;
+			virtual int Length(long long* total, long long* available) override;
+
+			long long GetAvailable() const;
+
+		private:
+			FILE* file_ = nullptr;
+			long long available_ = 0;
+		};
+	}
+}
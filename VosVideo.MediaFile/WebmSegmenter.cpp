@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include <algorithm>
 #include "MediaFileException.h"
 #include "WebmSegmenter.h"
 
@@ -9,57 +10,254 @@ using namespace mkvparser;
 
 WebmSegmenter::WebmSegmenter(const std::wstring& wpath) : FileSegmenter(wpath)
 {
-	// Get parser header info
-	string path = StringUtil::ToString(wpath);
-	if (reader_.Open(path.c_str()))
+	if (!reader_.Open(wpath))
 	{
 		throw MediaFileException("Filename is invalid or error while opening");
 	}
+
+	manifest_.reset(new MediaFileManifest(0, 0, wpath));
+	Update();
+}
+
+
+WebmSegmenter::~WebmSegmenter()
+{
+	reader_.Close();
+}
+
+std::shared_ptr<MediaFileManifest> WebmSegmenter::GetManifest()
+{
+	return manifest_;
+}
+
+size_t WebmSegmenter::Update()
+{
+	if (isComplete_)
+	{
+		return 0;
+	}
+
+	reader_.Refresh();
+	if (!segment_ && !ParseHeaders())
+	{
+		return 0;
+	}
+
+	size_t added = 0;
+	// Cues are written when recording is finalized, so they are present only in complete files
+	if (parsedClusters_ == 0)
+	{
+		added = IndexFromCues();
+	}
+
+	if (!isComplete_)
+	{
+		added += IndexNewClusters();
+	}
+
+	UpdateTotals();
+	return added;
+}
+
+bool WebmSegmenter::IsComplete() const
+{
+	return isComplete_;
+}
+
+bool WebmSegmenter::ParseHeaders()
+{
+	long long pos = 0;
 	EBMLHeader ebmlHeader;
-	int64_t pos = 0;
-	ebmlHeader.Parse(&reader_, pos);
-	shared_ptr<Segment> seg_ptr;
-	Segment* seg;
+	long long ret = ebmlHeader.Parse(&reader_, pos);
+	if (ret > 0 || ret == E_BUFFER_NOT_FULL)
+	{
+		return false;
+	}
+	if (ret < 0)
+	{
+		throw MediaFileException("EBMLHeader::Parse() failed.");
+	}
 
-	int64_t ret = Segment::CreateInstance(&reader_, pos, seg);
-	if (ret)
+	Segment* seg = nullptr;
+	ret = Segment::CreateInstance(&reader_, pos, seg);
+	if (ret > 0 || ret == E_BUFFER_NOT_FULL)
+	{
+		return false;
+	}
+	if (ret < 0 || seg == nullptr)
 	{
 		throw MediaFileException("Segment::CreateInstance() failed.");
 	}
 
-	seg_ptr.reset(seg);
+	unique_ptr<Segment> segment(seg);
+	ret = segment->ParseHeaders();
+	if (ret > 0 || ret == E_BUFFER_NOT_FULL)
+	{
+		return false;
+	}
+	if (ret < 0)
+	{
+		throw MediaFileException("Segment::ParseHeaders() failed.");
+	}
+
+	segment_ = std::move(segment);
+	return true;
+}
+
+size_t WebmSegmenter::IndexFromCues()
+{
+	const SeekHead* seekHead = segment_->GetSeekHead();
+	if (seekHead == nullptr)
+	{
+		return 0;
+	}
+
+	for (int i = 0; i < seekHead->GetCount(); ++i)
+	{
+		const SeekHead::Entry* entry = seekHead->GetEntry(i);
+		if (entry != nullptr && entry->id == libwebm::kMkvCues)
+		{
+			long long pos = 0;
+			long len = 0;
+			if (segment_->ParseCues(entry->pos, pos, len) < 0)
+			{
+				return 0;
+			}
+			break;
+		}
+	}
 
-	ret = seg_ptr->Load();
-	if (ret)
+	const Cues* cues = segment_->GetCues();
+	const Track* track = GetIndexTrack();
+	if (cues == nullptr || track == nullptr)
 	{
-		throw MediaFileException("Segment::Load() failed.");
+		return 0;
 	}
 
-	const unsigned long clusterCount = seg_ptr->GetCount();
-	if (clusterCount > 0)
+	while (cues->LoadCuePoint())
 	{
-		const SegmentInfo* const pSegmentInfo = seg_ptr->GetInfo();
-		int64_t duration_ns = pSegmentInfo->GetDuration();
-		const mkvparser::Cluster* pCluster = seg_ptr->GetFirst();
-		const mkvparser::Cues* const cues = seg_ptr->GetCues();
-		manifest_.reset(new MediaFileManifest(seg_ptr->m_size + seg_ptr->m_start, duration_ns, wpath));
+	}
 
-		do
+	size_t added = 0;
+	for (const CuePoint* cp = cues->GetFirst(); cp != nullptr; cp = cues->GetNext(cp))
+	{
+		const CuePoint::TrackPosition* tp = cp->Find(track);
+		if (tp != nullptr)
 		{
-			MediaCluster mc(pCluster->GetTimeCode(), pCluster->GetPosition() + seg_ptr->m_start);
-			manifest_->AddMediaCluster(mc);
-		} while ((pCluster = seg_ptr->GetNext(pCluster)) != &seg_ptr->m_eos);
+			manifest_->AddMediaCluster(MediaCluster(cp->GetTime(segment_.get()), tp->m_pos + segment_->m_start, true));
+			++added;
+		}
 	}
-	reader_.Close();
-}
-
-
-WebmSegmenter::~WebmSegmenter()
-{
-	reader_.Close();
-}
-
-std::shared_ptr<MediaFileManifest> WebmSegmenter::GetManifest()
-{
-	return manifest_;
-}
+
+	if (added > 0)
+	{
+		LOG_TRACE("Indexed " << added << " cue points of " << StringUtil::ToString(manifest_->GetFileName()));
+		isComplete_ = true;
+	}
+	return added;
+}
+
+size_t WebmSegmenter::IndexNewClusters()
+{
+	long status = 0;
+	for (;;)
+	{
+		long long pos = 0;
+		long len = 0;
+		status = segment_->LoadCluster(pos, len);
+		if (status != 0)
+		{
+			break;
+		}
+	}
+
+	// E_BUFFER_NOT_FULL means the next cluster is still being written, we'll get it with next update
+	if (status < 0 && status != E_BUFFER_NOT_FULL)
+	{
+		LOG_WARNING("Stopped parsing " << StringUtil::ToString(manifest_->GetFileName()) << " on damaged cluster, error " << status);
+	}
+
+	// Walk only fully loaded clusters, GetNext() would try to parse beyond them
+	size_t added = 0;
+	const unsigned long clusterCount = segment_->GetCount();
+	while (parsedClusters_ < clusterCount)
+	{
+		const Cluster* cluster = (lastCluster_ == nullptr) ? segment_->GetFirst() : segment_->GetNext(lastCluster_);
+		if (cluster == nullptr || cluster->EOS())
+		{
+			break;
+		}
+
+		MediaCluster mc(cluster->GetTime(), cluster->GetPosition() + segment_->m_start, IsKeyFrameCluster(cluster));
+		manifest_->AddMediaCluster(mc);
+		lastCluster_ = cluster;
+		++parsedClusters_;
+		++added;
+	}
+
+	if (status > 0)
+	{
+		isComplete_ = true;
+	}
+	return added;
+}
+
+void WebmSegmenter::UpdateTotals()
+{
+	if (segment_->m_size >= 0)
+	{
+		manifest_->SetTotalSize(segment_->m_size + segment_->m_start);
+	}
+	else
+	{
+		manifest_->SetTotalSize(reader_.GetAvailable());
+	}
+
+	// Duration is written on finalization, until then the last cluster is the best guess
+	const SegmentInfo* const info = segment_->GetInfo();
+	int64_t duration_ns = (info != nullptr) ? info->GetDuration() : -1;
+	if (duration_ns < 0 && lastCluster_ != nullptr)
+	{
+		duration_ns = lastCluster_->GetTime();
+	}
+	manifest_->SetDuration(std::max<int64_t>(duration_ns, 0));
+}
+
+const mkvparser::Track* WebmSegmenter::GetIndexTrack() const
+{
+	const Tracks* tracks = segment_->GetTracks();
+	if (tracks == nullptr)
+	{
+		return nullptr;
+	}
+
+	const Track* first = nullptr;
+	for (unsigned long i = 0; i < tracks->GetTracksCount(); ++i)
+	{
+		const Track* track = tracks->GetTrackByIndex(i);
+		if (track == nullptr)
+		{
+			continue;
+		}
+		if (track->GetType() == Track::kVideo)
+		{
+			return track;
+		}
+		if (first == nullptr)
+		{
+			first = track;
+		}
+	}
+	return first;
+}
+
+bool WebmSegmenter::IsKeyFrameCluster(const mkvparser::Cluster* cluster)
+{
+	const BlockEntry* entry = nullptr;
+	if (cluster->GetFirst(entry) < 0 || entry == nullptr || entry->EOS())
+	{
+		return false;
+	}
+	const Block* block = entry->GetBlock();
+	return block != nullptr && block->IsKey();
+}
@@ -1,12 +1,15 @@
 #pragma once
-// libwebm parser includes
-#include <libwebm/mkvreader.hpp>
 #include "FileSegmenter.h"
+#include "WebmFileReader.h"
 
 namespace vosvideo
 {
 	namespace mediafile
 	{
+		// Builds manifest of webm file without loading whole segment.
+		// Finished file with cues is indexed from cues only, otherwise clusters are parsed incrementally,
+		// every Update() continues from the last parsed cluster, so file still being recorded can be followed cheaply.
+		// Not thread safe, caller serializes Update() and manifest access.
 		class WebmSegmenter : public FileSegmenter
 		{
 		public:
@@ -14,9 +17,25 @@ namespace vosvideo
 			virtual ~WebmSegmenter();
 
 			std::shared_ptr<MediaFileManifest> GetManifest();
+			// Parses data appended since previous call, returns number of new manifest clusters
+			virtual size_t Update() override;
+			// Whole segment is indexed, further updates do nothing
+			bool IsComplete() const;
 
 		private:
-			mkvparser::MkvReader reader_;
+			// Returns false if file doesn't have complete headers yet
+			bool ParseHeaders();
+			size_t IndexFromCues();
+			size_t IndexNewClusters();
+			void UpdateTotals();
+			const mkvparser::Track* GetIndexTrack() const;
+			static bool IsKeyFrameCluster(const mkvparser::Cluster* cluster);
+
+			WebmFileReader reader_;
+			std::unique_ptr<mkvparser::Segment> segment_;
+			const mkvparser::Cluster* lastCluster_ = nullptr;
+			unsigned long parsedClusters_ = 0;
+			bool isComplete_ = false;
 			std::shared_ptr<MediaFileManifest> manifest_;
 		};
 	}
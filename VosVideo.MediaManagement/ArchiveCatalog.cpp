@@ -0,0 +1,138 @@
+#include "stdafx.h"
+#include "ArchiveCatalog.h"
+
+using namespace std;
+using namespace vosvideo::archive;
+
+ArchiveCatalog::ArchiveCatalog()
+{
+}
+
+ArchiveCatalog::~ArchiveCatalog()
+{
+}
+
+void ArchiveCatalog::Add(std::shared_ptr<VideoFile> videoFile)
+{
+	if (!videoFile->IsValid())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	const wstring path = videoFile->GetPath();
+	auto prev = paths_.find(path);
+	if (prev != paths_.end())
+	{
+		RemoveEntry(path, prev->second);
+	}
+
+	cameras_[videoFile->GetId()].insert(make_pair(videoFile->StartTime(), videoFile));
+	paths_[path] = make_pair(videoFile->GetId(), videoFile->StartTime());
+}
+
+bool ArchiveCatalog::Remove(const std::wstring& path)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto entry = paths_.find(path);
+	if (entry == paths_.end())
+	{
+		return false;
+	}
+
+	RemoveEntry(path, entry->second);
+	paths_.erase(entry);
+	return true;
+}
+
+void ArchiveCatalog::RemoveEntry(const std::wstring& path, const std::pair<std::wstring, uint64_t>& key)
+{
+	auto camera = cameras_.find(key.first);
+	if (camera == cameras_.end())
+	{
+		return;
+	}
+
+	// Other file of the same start time stays
+	auto files = camera->second.equal_range(key.second);
+	for (auto iter = files.first; iter != files.second; ++iter)
+	{
+		if (iter->second->GetPath() == path)
+		{
+			camera->second.erase(iter);
+			break;
+		}
+	}
+	if (camera->second.empty())
+	{
+		cameras_.erase(camera);
+	}
+}
+
+std::vector<std::wstring> ArchiveCatalog::GetCameras() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	vector<wstring> cameras;
+	cameras.reserve(cameras_.size());
+	for (const auto& camera : cameras_)
+	{
+		cameras.push_back(camera.first);
+	}
+	return cameras;
+}
+
+size_t ArchiveCatalog::GetCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return paths_.size();
+}
+
+ArchiveCatalogPage ArchiveCatalog::Query(const std::wstring& cameraName, uint64_t from, uint64_t to, uint64_t cursor, size_t limit) const
+{
+	ArchiveCatalogPage page;
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto camera = cameras_.find(cameraName);
+	if (camera == cameras_.end() || limit == 0)
+	{
+		return page;
+	}
+
+	const VideoEntriesMap& entries = camera->second;
+	VideoEntriesMap::const_iterator iter;
+	if (cursor != 0)
+	{
+		iter = entries.lower_bound(cursor);
+	}
+	else
+	{
+		// Only files started last before range can overlap its beginning
+		iter = entries.upper_bound(from);
+		if (iter != entries.begin())
+		{
+			auto started = entries.equal_range(std::prev(iter)->first);
+			for (auto prev = started.first; prev != started.second; ++prev)
+			{
+				if (prev->first + prev->second->Duration() > from)
+				{
+					iter = started.first;
+					break;
+				}
+			}
+		}
+	}
+
+	for (; iter != entries.end() && (to == 0 || iter->first < to); ++iter)
+	{
+		// Cursor is start time, page can end only where start time changes
+		if (page.Files.size() >= limit && iter->first != page.Files.back()->StartTime())
+		{
+			page.HasMore = true;
+			page.NextCursor = iter->first;
+			break;
+		}
+		page.Files.push_back(iter->second);
+	}
+
+	return page;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <mutex>
+#include "VideoFile.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		struct ArchiveCatalogPage
+		{
+			std::vector<std::shared_ptr<VideoFile>> Files;
+			bool HasMore = false;
+			// Start time of the first file of the next page
+			uint64_t NextCursor = 0;
+		};
+
+		// Recordings ordered by start time per camera, all times are nanoseconds from Unix epoch.
+		// Recordings of one camera don't overlap, recorder closes segment before opening the next one.
+		// Still two files may claim the same start time, e.g. a copy of recording, both are kept.
+		class ArchiveCatalog final
+		{
+		public:
+			// <beginning_time, VideoFile>, files of the same start time are kept in order they were added
+			typedef std::multimap<uint64_t, std::shared_ptr<VideoFile>> VideoEntriesMap;
+
+			ArchiveCatalog();
+			~ArchiveCatalog();
+
+			// Replaces previous entry of the same file
+			void Add(std::shared_ptr<VideoFile> videoFile);
+			bool Remove(const std::wstring& path);
+			std::vector<std::wstring> GetCameras() const;
+			size_t GetCount() const;
+
+			// Files overlapping [from, to) ordered by start time, to == 0 means no upper limit.
+			// Listing continues from cursor if it's not zero, it must be NextCursor of previous page.
+			// Files of the same start time are never split between pages, so page may exceed limit.
+			ArchiveCatalogPage Query(const std::wstring& cameraName, uint64_t from, uint64_t to, uint64_t cursor, size_t limit) const;
+
+		private:
+			// Must be called under mutex_
+			void RemoveEntry(const std::wstring& path, const std::pair<std::wstring, uint64_t>& key);
+
+			mutable std::mutex mutex_;
+			std::unordered_map<std::wstring, VideoEntriesMap> cameras_;
+			// path -> <camera, start time>, to find entry when only path is known
+			std::unordered_map<std::wstring, std::pair<std::wstring, uint64_t>> paths_;
+		};
+	}
+}
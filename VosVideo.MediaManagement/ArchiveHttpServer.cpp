@@ -0,0 +1,741 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <agents.h>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <cpprest/filestream.h>
+#include <cpprest/producerconsumerstream.h>
+
+#include "VosVideo.MediaFile/MediaFileManager.h"
+#include "VosVideo.MediaFile/MediaPackager.h"
+#include "VosVideo.MediaFile/MediaFileException.h"
+#include "ClipExporter.h"
+#include "ThumbnailGenerator.h"
+#include "ArchiveHttpServer.h"
+
+using namespace std;
+using namespace util;
+using namespace web;
+using namespace web::http;
+using namespace web::http::experimental::listener;
+using namespace vosvideo::archive;
+using namespace vosvideo::mediafile;
+
+const std::wstring ArchiveHttpServer::urlPrefix_ = L"archive";
+const std::wstring ArchiveHttpServer::exportPath_ = L"export";
+const std::wstring ArchiveHttpServer::motionPath_ = L"motion";
+const std::wstring ArchiveHttpServer::spriteSuffix_ = L".thumbs.jpg";
+const std::wstring ArchiveHttpServer::sidecarSuffix_ = L".thumbs.json";
+const std::chrono::seconds ArchiveHttpServer::exportStallTimeout_(30);
+const std::chrono::milliseconds ArchiveHttpServer::exportDrainCheckPeriod_(50);
+
+struct ArchiveHttpServer::CachedSegmenter
+{
+	std::shared_ptr<FileSegmenter> Segmenter;
+	// Segmenters are not thread safe, requests of one recording take turns, other recordings don't wait
+	std::mutex Mutex;
+};
+
+struct ArchiveHttpServer::ExportJob
+{
+	std::shared_ptr<ClipExporter> Exporter;
+	concurrency::streams::producer_consumer_buffer<uint8_t> Buffer;
+	std::wstring CameraName;
+	std::chrono::steady_clock::time_point Started;
+	// Last time client kept up with export
+	std::chrono::steady_clock::time_point Drained;
+	// Last time exporter produced anything
+	std::chrono::steady_clock::time_point Produced;
+	size_t Exported = 0;
+};
+
+namespace
+{
+	// Completes after delay, no thread is held meanwhile
+	pplx::task<void> CompleteAfter(std::chrono::milliseconds delay)
+	{
+		pplx::task_completion_event<void> completed;
+		auto callback = new Concurrency::call<int>([completed](int)
+		{
+			completed.set();
+		});
+		auto timer = new Concurrency::timer<int>(static_cast<unsigned int>(delay.count()), 0, callback, false);
+		timer->start();
+		return pplx::create_task(completed).then([callback, timer]
+		{
+			delete timer;
+			delete callback;
+		});
+	}
+}
+
+ArchiveHttpServer::ArchiveHttpServer(const std::vector<std::wstring>& archiveRoots, uint32_t port, const std::wstring& webSiteUri) :
+	archiveRoots_(archiveRoots),
+	port_(port),
+	allowedOrigin_(GetOrigin(webSiteUri)),
+	activeExports_(0),
+	isClosing_(false)
+{
+}
+
+ArchiveHttpServer::~ArchiveHttpServer()
+{
+	Close();
+}
+
+void ArchiveHttpServer::Open()
+{
+	wstring url = L"http://localhost:" + std::to_wstring(port_) + L"/" + urlPrefix_;
+	isClosing_ = false;
+	listener_.reset(new http_listener(url));
+	listener_->support(methods::GET, std::bind(&ArchiveHttpServer::HandleGet, this, std::placeholders::_1));
+
+	try
+	{
+		listener_->open().wait();
+		LOG_TRACE("Archive HTTP server is listening on " << StringUtil::ToString(url));
+	}
+	catch (std::exception& ex)
+	{
+		LOG_ERROR("Archive HTTP server failed to listen on " << StringUtil::ToString(url) << ": " << ex.what());
+		listener_.reset();
+	}
+}
+
+void ArchiveHttpServer::Close()
+{
+	if (listener_)
+	{
+		try
+		{
+			listener_->close().wait();
+		}
+		catch (std::exception& ex)
+		{
+			LOG_WARNING("Archive HTTP server close failed: " << ex.what());
+		}
+		listener_.reset();
+	}
+
+	// Export tasks use this server, they end at their next step once closing is set
+	std::list<pplx::task<void>> exports;
+	{
+		std::lock_guard<std::mutex> lock(exportsMutex_);
+		isClosing_ = true;
+		exports.swap(exports_);
+	}
+	for (auto& exportTask : exports)
+	{
+		exportTask.wait();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	segmenters_.clear();
+}
+
+void ArchiveHttpServer::SetRecordingsProvider(RecordingsProvider provider)
+{
+	recordingsProvider_ = provider;
+}
+
+void ArchiveHttpServer::SetMotionProvider(MotionProvider provider)
+{
+	motionProvider_ = provider;
+}
+
+void ArchiveHttpServer::HandleGet(http_request request)
+{
+	auto segments = uri::split_path(uri::decode(request.relative_uri().path()));
+	if (segments.empty())
+	{
+		request.reply(status_codes::NotFound);
+		return;
+	}
+
+	if (segments.size() == 1 && segments.front() == exportPath_)
+	{
+		ReplyExport(request);
+		return;
+	}
+
+	if (segments.size() == 1 && segments.front() == motionPath_)
+	{
+		ReplyMotion(request);
+		return;
+	}
+
+	wstring name = boost::algorithm::join(segments, L"/");
+	wstring ext = boost::filesystem::path(name).extension().wstring();
+	boost::algorithm::to_lower(ext);
+
+	wstring lowerName = boost::algorithm::to_lower_copy(name);
+	wstring recordingPath;
+	if (boost::algorithm::ends_with(lowerName, spriteSuffix_) || boost::algorithm::ends_with(lowerName, sidecarSuffix_))
+	{
+		bool isSidecar = boost::algorithm::ends_with(lowerName, sidecarSuffix_);
+		size_t suffixLength = isSidecar ? sidecarSuffix_.length() : spriteSuffix_.length();
+		if (!ResolvePath(name.substr(0, name.length() - suffixLength), recordingPath))
+		{
+			request.reply(status_codes::NotFound);
+			return;
+		}
+		ReplySprite(request, recordingPath, isSidecar);
+	}
+	else if (ext == L".mpd" || ext == L".m3u8")
+	{
+		if (!ResolvePath(name.substr(0, name.length() - ext.length()), recordingPath))
+		{
+			request.reply(status_codes::NotFound);
+			return;
+		}
+		ReplyManifest(request, recordingPath, ext == L".m3u8");
+	}
+	else
+	{
+		if (!ResolvePath(name, recordingPath))
+		{
+			request.reply(status_codes::NotFound);
+			return;
+		}
+		ReplyMedia(request, recordingPath);
+	}
+}
+
+void ArchiveHttpServer::ReplyManifest(http_request request, const std::wstring& recordingPath, bool isHls)
+{
+	string body;
+	wstring contentType = GetContentType(recordingPath);
+	string mediaUrl = StringUtil::ToString(uri::encode_uri(boost::filesystem::path(recordingPath).filename().wstring()));
+
+	try
+	{
+		auto cached = GetSegmenter(recordingPath);
+		if (!cached)
+		{
+			request.reply(status_codes::NotFound);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(cached->Mutex);
+		cached->Segmenter->Update();
+		auto manifest = cached->Segmenter->GetManifest();
+		if (manifest->GetClusters().empty())
+		{
+			// Plain mp4 has no fragments to reference
+			request.reply(status_codes::UnsupportedMediaType, L"Recording has no seekable clusters");
+			return;
+		}
+
+		if (isHls)
+		{
+			if (contentType != L"video/mp4")
+			{
+				request.reply(status_codes::UnsupportedMediaType, L"HLS is available for mp4 recordings only");
+				return;
+			}
+			body = MediaPackager::CreateHlsPlaylist(*manifest, mediaUrl);
+		}
+		else
+		{
+			body = MediaPackager::CreateDashManifest(*manifest, mediaUrl, StringUtil::ToString(contentType));
+		}
+	}
+	catch (MediaFileException&)
+	{
+		request.reply(status_codes::InternalError);
+		return;
+	}
+
+	http_response response(status_codes::OK);
+	response.set_body(body, isHls ? "application/vnd.apple.mpegurl" : "application/dash+xml");
+	AddCommonHeaders(response);
+	request.reply(response);
+}
+
+void ArchiveHttpServer::ReplyMedia(http_request request, const std::wstring& recordingPath)
+{
+	boost::system::error_code ec;
+	const int64_t fileSize = static_cast<int64_t>(boost::filesystem::file_size(recordingPath, ec));
+	if (ec)
+	{
+		request.reply(status_codes::NotFound);
+		return;
+	}
+
+	wstring contentType = GetContentType(recordingPath);
+
+	if (!request.headers().has(header_names::range))
+	{
+		ReplyFile(request, recordingPath, status_codes::OK, 0, fileSize, contentType, L"");
+		return;
+	}
+
+	int64_t first = 0;
+	int64_t last = 0;
+	if (!ParseRange(request.headers()[header_names::range], fileSize, first, last))
+	{
+		http_response response(status_codes::RangeNotSatisfiable);
+		response.headers().add(header_names::content_range, L"bytes */" + std::to_wstring(fileSize));
+		AddCommonHeaders(response);
+		request.reply(response);
+		return;
+	}
+
+	last = std::min(last, first + maxRangeSize_ - 1);
+	ReplyFile(request, recordingPath, status_codes::PartialContent, first, last - first + 1, contentType,
+		L"bytes " + std::to_wstring(first) + L"-" + std::to_wstring(last) + L"/" + std::to_wstring(fileSize));
+}
+
+void ArchiveHttpServer::ReplyFile(http_request request, const std::wstring& path, status_code status, 
+	int64_t offset, int64_t length, const std::wstring& contentType, const std::wstring& contentRange)
+{
+	// File is streamed from disk by cpprest, it's not buffered in memory
+	concurrency::streams::fstream::open_istream(path).then([=](pplx::task<concurrency::streams::istream> streamTask)
+	{
+		try
+		{
+			auto stream = streamTask.get();
+			if (offset > 0 && stream.seek(offset) != static_cast<concurrency::streams::istream::pos_type>(offset))
+			{
+				request.reply(status_codes::InternalError);
+				return;
+			}
+
+			http_response response(status);
+			response.set_body(stream, static_cast<utility::size64_t>(length), contentType);
+			if (!contentRange.empty())
+			{
+				response.headers().add(header_names::content_range, contentRange);
+			}
+			AddCommonHeaders(response);
+			request.reply(response);
+		}
+		catch (std::exception& ex)
+		{
+			LOG_WARNING("Failed to open " << StringUtil::ToString(path) << ": " << ex.what());
+			request.reply(status_codes::NotFound);
+		}
+	});
+}
+
+void ArchiveHttpServer::ReplySprite(http_request request, const std::wstring& recordingPath, bool isSidecar)
+{
+	// Sprite is looked up next to its recording, it's missing until generator got to it
+	ReplyMedia(request, isSidecar ? ThumbnailGenerator::GetSidecarPath(recordingPath) : ThumbnailGenerator::GetSpritePath(recordingPath));
+}
+
+void ArchiveHttpServer::ReplyMotion(http_request request)
+{
+	if (!motionProvider_)
+	{
+		request.reply(status_codes::NotFound);
+		return;
+	}
+
+	auto query = uri::split_query(request.relative_uri().query());
+	wstring cameraName = query.count(L"cam") ? uri::decode(query[L"cam"]) : L"";
+	uint64_t from = 0;
+	uint64_t to = 0;
+	uint32_t level = 0;
+	try
+	{
+		from = query.count(L"from") ? std::stoull(query[L"from"]) : 0;
+		to = query.count(L"to") ? std::stoull(query[L"to"]) : 0;
+		level = query.count(L"level") ? std::stoul(query[L"level"]) : 0;
+	}
+	catch (std::exception&)
+	{
+		to = 0;
+	}
+
+	if (cameraName.empty() || to <= from || to - from > maxMotionQueryDuration_ || level > 100)
+	{
+		request.reply(status_codes::BadRequest, L"Motion search needs cam, from and to in milliseconds, up to 7 days, and level in percent");
+		return;
+	}
+
+	const int64_t msToNs = 1000000;
+	auto matches = motionProvider_(cameraName, from * msToNs, to * msToNs, static_cast<uint8_t>(level));
+
+	json::value events = json::value::array(matches.size());
+	for (size_t i = 0; i < matches.size(); ++i)
+	{
+		const auto& event = matches[i].Event;
+		json::value regions = json::value::array(MotionEvent::RegionCount);
+		for (size_t r = 0; r < MotionEvent::RegionCount; ++r)
+		{
+			regions[r] = json::value::number(event.Regions[r]);
+		}
+
+		json::value jEvent;
+		jEvent[L"from"] = json::value::number(event.Start / msToNs);
+		jEvent[L"to"] = json::value::number(event.End / msToNs);
+		jEvent[L"level"] = json::value::number(event.Level);
+		jEvent[L"regions"] = regions;
+		jEvent[L"recording"] = json::value::string(boost::filesystem::path(matches[i].Recording->GetPath()).filename().wstring());
+		events[i] = jEvent;
+	}
+
+	json::value body;
+	body[L"columns"] = json::value::number(MotionEvent::GridColumns);
+	body[L"rows"] = json::value::number(MotionEvent::GridRows);
+	body[L"events"] = events;
+
+	http_response response(status_codes::OK);
+	response.set_body(body);
+	AddCommonHeaders(response);
+	request.reply(response);
+}
+
+void ArchiveHttpServer::ReplyExport(http_request request)
+{
+	if (!recordingsProvider_)
+	{
+		request.reply(status_codes::NotFound);
+		return;
+	}
+
+	auto query = uri::split_query(request.relative_uri().query());
+	wstring cameraName = query.count(L"cam") ? uri::decode(query[L"cam"]) : L"";
+	uint64_t from = 0;
+	uint64_t to = 0;
+	try
+	{
+		from = query.count(L"from") ? std::stoull(query[L"from"]) : 0;
+		to = query.count(L"to") ? std::stoull(query[L"to"]) : 0;
+	}
+	catch (std::exception&)
+	{
+		to = 0;
+	}
+
+	if (cameraName.empty() || to <= from || to - from > maxExportDuration_)
+	{
+		request.reply(status_codes::BadRequest, L"Export needs cam, from and to in milliseconds, up to 4 hours");
+		return;
+	}
+
+	const uint64_t msToNs = 1000000;
+	auto files = recordingsProvider_(cameraName, from * msToNs, to * msToNs);
+	if (files.empty())
+	{
+		request.reply(status_codes::NotFound);
+		return;
+	}
+
+	if (++activeExports_ > maxActiveExports_)
+	{
+		--activeExports_;
+		request.reply(status_codes::ServiceUnavailable, L"Too many exports are running");
+		return;
+	}
+
+	auto job = make_shared<ExportJob>();
+	job->Exporter = make_shared<ClipExporter>(files, from * msToNs, to * msToNs);
+	job->CameraName = cameraName;
+	job->Started = std::chrono::steady_clock::now();
+	job->Drained = job->Started;
+	job->Produced = job->Started;
+	if (!job->Exporter->Start())
+	{
+		--activeExports_;
+		request.reply(status_codes::InternalError, L"Clip export failed to start");
+		return;
+	}
+
+	// Response goes out with chunked encoding while clip is still being made
+	http_response response(status_codes::OK);
+	response.set_body(job->Buffer.create_istream(), job->Exporter->GetContentType());
+	response.headers().add(L"Content-Disposition", GetContentDisposition(cameraName + L"_" + std::to_wstring(from) + job->Exporter->GetExtension()));
+	AddCommonHeaders(response);
+	request.reply(response);
+
+	std::lock_guard<std::mutex> lock(exportsMutex_);
+	if (isClosing_)
+	{
+		job->Buffer.close(std::ios_base::out).wait();
+		--activeExports_;
+		return;
+	}
+	exports_.remove_if([](const pplx::task<void>& exportTask)
+	{
+		return exportTask.is_done();
+	});
+	exports_.push_back(PumpExport(job).then([this, job](pplx::task<bool> pumped)
+	{
+		bool isOk = false;
+		try
+		{
+			isOk = pumped.get();
+		}
+		catch (std::exception& ex)
+		{
+			LOG_WARNING("Clip export of " << StringUtil::ToString(job->CameraName) << " threw: " << ex.what());
+		}
+		job->Buffer.close(std::ios_base::out).wait();
+		--activeExports_;
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - job->Started);
+		LOG_TRACE("Clip export of " << StringUtil::ToString(job->CameraName) << (isOk ? " finished, " : " failed, ") <<
+			job->Exported << " bytes in " << elapsed.count() << " ms");
+	}));
+}
+
+pplx::task<bool> ArchiveHttpServer::PumpExport(std::shared_ptr<ExportJob> job)
+{
+	return pplx::create_task([this, job]() -> pplx::task<bool>
+	{
+		if (isClosing_)
+		{
+			return pplx::task_from_result(false);
+		}
+
+		if (job->Buffer.in_avail() > maxExportBuffered_)
+		{
+			if (std::chrono::steady_clock::now() - job->Drained > exportStallTimeout_)
+			{
+				LOG_WARNING("Clip export of " << StringUtil::ToString(job->CameraName) << " stalled, client doesn't read");
+				return pplx::task_from_result(false);
+			}
+			// Exporter isn't asked for data meanwhile, waiting for client isn't its stall
+			job->Produced = std::chrono::steady_clock::now();
+			return CompleteAfter(exportDrainCheckPeriod_).then([this, job]
+			{
+				return PumpExport(job);
+			});
+		}
+		job->Drained = std::chrono::steady_clock::now();
+
+		auto data = make_shared<std::vector<uint8_t>>();
+		switch (job->Exporter->Pull(*data))
+		{
+		case ClipExporter::PullResult::Finished:
+			return pplx::task_from_result(true);
+		case ClipExporter::PullResult::Failed:
+			return pplx::task_from_result(false);
+		case ClipExporter::PullResult::Pending:
+			if (std::chrono::steady_clock::now() - job->Produced > exportStallTimeout_)
+			{
+				LOG_WARNING("Clip export of " << StringUtil::ToString(job->CameraName) << " stalled, no data is produced");
+				return pplx::task_from_result(false);
+			}
+			return PumpExport(job);
+		default:
+			job->Produced = std::chrono::steady_clock::now();
+			// Data must live until write completes
+			return job->Buffer.putn_nocopy(data->data(), data->size()).then([this, job, data](size_t written)
+			{
+				job->Exported += written;
+				return PumpExport(job);
+			});
+		}
+	});
+}
+
+std::shared_ptr<ArchiveHttpServer::CachedSegmenter> ArchiveHttpServer::GetSegmenter(const std::wstring& recordingPath)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto iter = segmenters_.begin(); iter != segmenters_.end(); ++iter)
+		{
+			if (iter->first == recordingPath)
+			{
+				segmenters_.splice(segmenters_.begin(), segmenters_, iter);
+				return segmenters_.front().second;
+			}
+		}
+	}
+
+	// Initial parse reads whole index of recording, other requests must not wait for it
+	auto cached = std::make_shared<CachedSegmenter>();
+	cached->Segmenter = MediaFileManager::CreateSegmenter(recordingPath);
+	if (!cached->Segmenter)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const auto& entry : segmenters_)
+	{
+		// Concurrent request created it first, keep one segmenter per recording
+		if (entry.first == recordingPath)
+		{
+			return entry.second;
+		}
+	}
+
+	segmenters_.emplace_front(recordingPath, cached);
+	if (segmenters_.size() > maxSegmenters_)
+	{
+		segmenters_.pop_back();
+	}
+	return cached;
+}
+
+bool ArchiveHttpServer::ResolvePath(const std::wstring& name, std::wstring& recordingPath) const
+{
+	boost::filesystem::path relative(name);
+	for (const auto& part : relative)
+	{
+		if (part == L".." || part == L".")
+		{
+			return false;
+		}
+	}
+
+	if (relative.has_root_path() || !IsRecording(relative))
+	{
+		return false;
+	}
+
+	// Recording names are unique across roots, they start with camera name
+	for (const auto& root : archiveRoots_)
+	{
+		boost::filesystem::path fullPath = boost::filesystem::path(root) / relative;
+		boost::system::error_code ec;
+		if (boost::filesystem::is_regular_file(fullPath, ec))
+		{
+			recordingPath = fullPath.wstring();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ArchiveHttpServer::ParseRange(const std::wstring& header, int64_t fileSize, int64_t& first, int64_t& last)
+{
+	// Only single range is supported, it's all media players ask for
+	const wstring unit = L"bytes=";
+	if (header.compare(0, unit.length(), unit) != 0 || header.find(L',') != wstring::npos)
+	{
+		return false;
+	}
+
+	wstring spec = header.substr(unit.length());
+	size_t dash = spec.find(L'-');
+	if (dash == wstring::npos || fileSize == 0)
+	{
+		return false;
+	}
+
+	try
+	{
+		wstring from = spec.substr(0, dash);
+		wstring to = spec.substr(dash + 1);
+		if (from.empty())
+		{
+			// Suffix range, last N bytes
+			int64_t suffix = std::stoll(to);
+			if (suffix <= 0)
+			{
+				return false;
+			}
+			first = std::max<int64_t>(fileSize - suffix, 0);
+			last = fileSize - 1;
+		}
+		else
+		{
+			first = std::stoll(from);
+			last = to.empty() ? fileSize - 1 : std::min<int64_t>(std::stoll(to), fileSize - 1);
+		}
+	}
+	catch (std::exception&)
+	{
+		return false;
+	}
+
+	return first >= 0 && first <= last && first < fileSize;
+}
+
+std::wstring ArchiveHttpServer::GetContentType(const std::wstring& recordingPath)
+{
+	wstring ext = boost::filesystem::path(recordingPath).extension().wstring();
+	boost::algorithm::to_lower(ext);
+	if (ext == L".webm")
+	{
+		return L"video/webm";
+	}
+	if (ext == L".mp4")
+	{
+		return L"video/mp4";
+	}
+	// Timeline sprites and their sidecars
+	if (ext == L".jpg")
+	{
+		return L"image/jpeg";
+	}
+	if (ext == L".json")
+	{
+		return L"application/json";
+	}
+	return L"application/octet-stream";
+}
+
+std::wstring ArchiveHttpServer::GetContentDisposition(const std::wstring& fileName)
+{
+	// Camera names are user defined, quotes and separators would break the header
+	wstring fallback = fileName;
+	for (auto& ch : fallback)
+	{
+		if (ch < 0x20 || ch > 0x7e || ch == L'"' || ch == L'\\' || ch == L';' || ch == L'/')
+		{
+			ch = L'_';
+		}
+	}
+
+	// RFC 5987 attr-char is sent as is, everything else as percent encoded UTF-8
+	const string attrChars = "!#$&+-.^_`|~";
+	std::wostringstream encoded;
+	encoded << std::hex << std::uppercase << std::setfill(L'0');
+	for (unsigned char ch : utility::conversions::to_utf8string(fileName))
+	{
+		if ((ch < 0x80 && isalnum(ch)) || attrChars.find(static_cast<char>(ch)) != string::npos)
+		{
+			encoded << static_cast<wchar_t>(ch);
+		}
+		else
+		{
+			encoded << L'%' << std::setw(2) << static_cast<int>(ch);
+		}
+	}
+	return L"attachment; filename=\"" + fallback + L"\"; filename*=UTF-8''" + encoded.str();
+}
+
+bool ArchiveHttpServer::IsRecording(const boost::filesystem::path& path)
+{
+	wstring ext = path.extension().wstring();
+	boost::algorithm::to_lower(ext);
+	return ext == L".webm" || ext == L".mp4";
+}
+
+std::wstring ArchiveHttpServer::GetOrigin(const std::wstring& uri)
+{
+	try
+	{
+		web::uri webSite(uri);
+		wstring origin = webSite.scheme() + L"://" + webSite.host();
+		if (!webSite.is_port_default())
+		{
+			origin += L":" + std::to_wstring(webSite.port());
+		}
+		return origin;
+	}
+	catch (web::uri_exception& ex)
+	{
+		LOG_ERROR("Web site URI " << StringUtil::ToString(uri) << " is invalid, archive is not shared with players: " << ex.what());
+		return L"";
+	}
+}
+
+void ArchiveHttpServer::AddCommonHeaders(http_response& response) const
+{
+	response.headers().add(header_names::accept_ranges, L"bytes");
+	// Players are loaded from web site, not from this server
+	if (!allowedOrigin_.empty())
+	{
+		response.headers().add(L"Access-Control-Allow-Origin", allowedOrigin_);
+	}
+	response.headers().add(L"Access-Control-Expose-Headers", L"Content-Range, Content-Length");
+}
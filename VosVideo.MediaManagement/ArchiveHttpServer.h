@@ -0,0 +1,114 @@
+#pragma once
+#include <mutex>
+#include <list>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <boost/filesystem/path.hpp>
+#include <cpprest/http_listener.h>
+#include "VosVideo.MediaFile/FileSegmenter.h"
+#include "VideoFile.h"
+#include "MotionIndex.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		// Local HTTP server for archive playback by DASH/HLS players.
+		//   GET /archive/<recording>.mpd   - DASH manifest of recording
+		//   GET /archive/<recording>.m3u8  - HLS playlist of fragmented mp4 recording
+		//   GET /archive/<recording>       - recording itself, Range requests are supported
+		//   GET /archive/<recording>.thumbs.json - timeline sprite sidecar, sprite is <recording>.thumbs.jpg
+		//   GET /archive/export?cam=<camera>&from=<ms>&to=<ms> - clip remuxed from recordings, streamed as it's made
+		//   GET /archive/motion?cam=<camera>&from=<ms>&to=<ms>[&level=<percent>] - motion events as JSON
+		// Manifests reference byte ranges of original files, so playback costs disk reads only.
+		// Only recordings and their sprites are served, catalog and index files stay private.
+		class ArchiveHttpServer final
+		{
+		public:
+			// Recordings of camera overlapping time range ordered by start time, times are nanoseconds from Unix epoch
+			typedef std::function<std::vector<std::shared_ptr<VideoFile>>(const std::wstring& cameraName, uint64_t from, uint64_t to)> RecordingsProvider;
+			typedef std::function<std::vector<MotionMatch>(const std::wstring& cameraName, uint64_t from, uint64_t to, uint8_t minLevel)> MotionProvider;
+
+			// Players are loaded from web site, its origin is the only one allowed to read responses
+			ArchiveHttpServer(const std::vector<std::wstring>& archiveRoots, uint32_t port, const std::wstring& webSiteUri);
+			~ArchiveHttpServer();
+
+			void Open();
+			void Close();
+			// Export is answered with NotFound until provider is set
+			void SetRecordingsProvider(RecordingsProvider provider);
+			// Motion search is answered with NotFound until provider is set
+			void SetMotionProvider(MotionProvider provider);
+
+		private:
+			struct ExportJob;
+			struct CachedSegmenter;
+
+			void HandleGet(web::http::http_request request);
+			void ReplyManifest(web::http::http_request request, const std::wstring& recordingPath, bool isHls);
+			void ReplyMedia(web::http::http_request request, const std::wstring& recordingPath);
+			void ReplySprite(web::http::http_request request, const std::wstring& recordingPath, bool isSidecar);
+			void ReplyExport(web::http::http_request request);
+			// Pulls clip piece by piece, every step is a continuation of the previous write, so no thread waits on client.
+			// Resolves to false if export failed, stalled or server is closing.
+			pplx::task<bool> PumpExport(std::shared_ptr<ExportJob> job);
+			void ReplyMotion(web::http::http_request request);
+			// Segmenters are kept between requests, so manifest of growing file is only extended.
+			// New segmenter parses file outside of server lock.
+			std::shared_ptr<CachedSegmenter> GetSegmenter(const std::wstring& recordingPath);
+			// Streams part of file from disk, nothing is read on listener thread
+			void ReplyFile(web::http::http_request request, const std::wstring& path, web::http::status_code status, 
+				int64_t offset, int64_t length, const std::wstring& contentType, const std::wstring& contentRange);
+			// Maps request path to a recording inside one of archive roots, false if it points outside, doesn't exist or isn't a recording
+			bool ResolvePath(const std::wstring& name, std::wstring& recordingPath) const;
+			void AddCommonHeaders(web::http::http_response& response) const;
+
+			static bool ParseRange(const std::wstring& header, int64_t fileSize, int64_t& first, int64_t& last);
+			static std::wstring GetContentType(const std::wstring& recordingPath);
+			static bool IsRecording(const boost::filesystem::path& path);
+			// Attachment with ASCII fallback name and RFC 5987 encoded original one
+			static std::wstring GetContentDisposition(const std::wstring& fileName);
+			// Origin is scheme, host and port of URI, path is dropped
+			static std::wstring GetOrigin(const std::wstring& uri);
+
+			std::vector<std::wstring> archiveRoots_;
+			uint32_t port_;
+			std::wstring allowedOrigin_;
+			std::unique_ptr<web::http::experimental::listener::http_listener> listener_;
+
+			// Guards segmenters_ lookup only, segmenter is updated under its own lock
+			std::mutex mutex_;
+			// Most recently used first
+			std::list<std::pair<std::wstring, std::shared_ptr<CachedSegmenter>>> segmenters_;
+
+			RecordingsProvider recordingsProvider_;
+			MotionProvider motionProvider_;
+			std::atomic<uint32_t> activeExports_;
+			// Close aborts running exports and waits for them
+			std::mutex exportsMutex_;
+			std::list<pplx::task<void>> exports_;
+			std::atomic<bool> isClosing_;
+
+			static const size_t maxSegmenters_ = 16;
+			// Exports only copy frames, but every one reads disk at full speed
+			static const uint32_t maxActiveExports_ = 2;
+			static const uint64_t maxExportDuration_ = 4ULL * 3600 * 1000;
+			// Export waits for slow client instead of buffering whole clip in memory
+			static const size_t maxExportBuffered_ = 4 * 1024 * 1024;
+			// Export fails if client doesn't read or exporter produces nothing for this long
+			static const std::chrono::seconds exportStallTimeout_;
+			// Buffer doesn't report reads, full one is checked again after this period
+			static const std::chrono::milliseconds exportDrainCheckPeriod_;
+			// Open ended ranges are answered in chunks, players continue from where the chunk ends
+			static const int64_t maxRangeSize_ = 8 * 1024 * 1024;
+			static const std::wstring urlPrefix_;
+			static const std::wstring exportPath_;
+			static const std::wstring motionPath_;
+			static const std::wstring spriteSuffix_;
+			static const std::wstring sidecarSuffix_;
+			// Search reads only motion tracks, a week of one camera is cheap
+			static const uint64_t maxMotionQueryDuration_ = 7ULL * 24 * 3600 * 1000;
+		};
+	}
+}
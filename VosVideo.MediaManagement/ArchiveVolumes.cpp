@@ -0,0 +1,278 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <cpprest/json.h>
+#include "ArchiveVolumes.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::archive;
+using namespace vosvideo::configuration;
+
+const std::wstring ArchiveVolumes::assignmentsFileName_ = L"volumes.json";
+const double ArchiveVolumes::rateSmoothing_ = 0.2;
+
+ArchiveVolumes::ArchiveVolumes(std::shared_ptr<ConfigurationManager> configManager) :
+	configManager_(configManager),
+	roots_(configManager->GetArchivePaths()),
+	policy_(configManager->GetArchivePlacement()),
+	reservedDiskSpace_(configManager->GetReservedDiskSpace())
+{
+	if (roots_.empty())
+	{
+		return;
+	}
+
+	assignmentsPath_ = (boost::filesystem::path(roots_.front()) / assignmentsFileName_).wstring();
+	std::lock_guard<std::mutex> lock(mutex_);
+	LoadAssignments();
+}
+
+ArchiveVolumes::~ArchiveVolumes()
+{
+}
+
+std::vector<std::wstring> ArchiveVolumes::GetRoots() const
+{
+	return roots_;
+}
+
+std::wstring ArchiveVolumes::Assign(const std::wstring& cameraName)
+{
+	if (roots_.empty())
+	{
+		return L"";
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	// Pin in configuration wins over previous placement
+	wstring pin = configManager_->GetArchivePin(cameraName);
+	if (!pin.empty())
+	{
+		if (std::find(roots_.begin(), roots_.end(), pin) != roots_.end())
+		{
+			if (assignments_[cameraName] != pin)
+			{
+				assignments_[cameraName] = pin;
+				SaveAssignments();
+			}
+			return pin;
+		}
+		LOG_WARNING("Camera " << StringUtil::ToString(cameraName) << " is pinned to " << StringUtil::ToString(pin) << " which is not archive root");
+	}
+
+	auto assigned = assignments_.find(cameraName);
+	if (assigned != assignments_.end() && std::find(roots_.begin(), roots_.end(), assigned->second) != roots_.end())
+	{
+		return assigned->second;
+	}
+
+	wstring root = ChooseRoot(cameraName);
+	assignments_[cameraName] = root;
+	SaveAssignments();
+	LOG_TRACE("Camera " << StringUtil::ToString(cameraName) << " records to " << StringUtil::ToString(root));
+	return root;
+}
+
+std::wstring ArchiveVolumes::FindRoot(const std::wstring& path) const
+{
+	// Recordings are kept directly in root
+	boost::filesystem::path folder = boost::filesystem::path(path).parent_path();
+	for (const auto& root : roots_)
+	{
+		boost::system::error_code ec;
+		if (folder == boost::filesystem::path(root) || boost::filesystem::equivalent(folder, root, ec))
+		{
+			return root;
+		}
+	}
+	return L"";
+}
+
+void ArchiveVolumes::OnRecordingAdded(const std::wstring& cameraName, uint64_t fileSize, uint64_t duration)
+{
+	const double nsInSecond = 1000000000.0;
+	if (duration == 0)
+	{
+		return;
+	}
+
+	double rate = fileSize * nsInSecond / duration;
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto cameraRate = cameraRates_.find(cameraName);
+	if (cameraRate == cameraRates_.end())
+	{
+		cameraRates_[cameraName] = rate;
+	}
+	else
+	{
+		cameraRate->second += (rate - cameraRate->second) * rateSmoothing_;
+	}
+}
+
+uint64_t ArchiveVolumes::GetSpaceDeficit(const std::wstring& root) const
+{
+	if (reservedDiskSpace_ == 0)
+	{
+		return 0;
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::space_info si = boost::filesystem::space(root, ec);
+	if (ec || si.available >= reservedDiskSpace_)
+	{
+		return 0;
+	}
+	return reservedDiskSpace_ - si.available;
+}
+
+std::wstring ArchiveVolumes::ChooseRoot(const std::wstring& cameraName)
+{
+	if (roots_.size() == 1)
+	{
+		return roots_.front();
+	}
+
+	// Roots already short of reserved space are used only if every root is
+	vector<wstring> candidates;
+	for (const auto& root : roots_)
+	{
+		if (GetAvailableSpace(root) > reservedDiskSpace_)
+		{
+			candidates.push_back(root);
+		}
+	}
+	if (candidates.empty())
+	{
+		candidates = roots_;
+	}
+
+	if (policy_ == ArchivePlacementPolicy::RoundRobin)
+	{
+		return candidates[nextRoot_++ % candidates.size()];
+	}
+
+	// Camera without recordings yet is expected to write like average camera
+	double cameraRate = GetCameraRate(cameraName);
+	wstring best;
+	double bestTimeToFill = -1.0;
+	for (const auto& root : candidates)
+	{
+		double load = cameraRate;
+		for (const auto& assignment : assignments_)
+		{
+			if (assignment.second == root)
+			{
+				load += GetCameraRate(assignment.first);
+			}
+		}
+
+		uint64_t available = GetAvailableSpace(root);
+		double usable = static_cast<double>(available > reservedDiskSpace_ ? available - reservedDiskSpace_ : 0);
+		double timeToFill = (load > 0.0) ? usable / load : usable;
+		if (timeToFill > bestTimeToFill)
+		{
+			best = root;
+			bestTimeToFill = timeToFill;
+		}
+	}
+	return best;
+}
+
+double ArchiveVolumes::GetCameraRate(const std::wstring& cameraName) const
+{
+	auto cameraRate = cameraRates_.find(cameraName);
+	if (cameraRate != cameraRates_.end())
+	{
+		return cameraRate->second;
+	}
+	if (cameraRates_.empty())
+	{
+		return 0.0;
+	}
+
+	double total = 0.0;
+	for (const auto& rate : cameraRates_)
+	{
+		total += rate.second;
+	}
+	return total / cameraRates_.size();
+}
+
+void ArchiveVolumes::LoadAssignments()
+{
+	boost::system::error_code ec;
+	if (!boost::filesystem::exists(assignmentsPath_, ec))
+	{
+		return;
+	}
+
+	try
+	{
+		std::ifstream file(assignmentsPath_, std::ios::binary);
+		std::stringstream content;
+		content << file.rdbuf();
+		auto json = web::json::value::parse(StringUtil::ToWstring(content.str()));
+		if (!json.has_field(U("cameras")) || !json.at(U("cameras")).is_object())
+		{
+			return;
+		}
+
+		for (const auto& camera : json.at(U("cameras")).as_object())
+		{
+			if (camera.second.is_object() && camera.second.has_field(U("root")) && camera.second.at(U("root")).is_string())
+			{
+				assignments_[camera.first] = camera.second.at(U("root")).as_string();
+				if (camera.second.has_field(U("rate")) && camera.second.at(U("rate")).is_number())
+				{
+					cameraRates_[camera.first] = camera.second.at(U("rate")).as_double();
+				}
+			}
+		}
+	}
+	catch (std::exception& e)
+	{
+		LOG_WARNING("Failed to read archive placement " << StringUtil::ToString(assignmentsPath_) << ": " << e.what());
+	}
+}
+
+void ArchiveVolumes::SaveAssignments()
+{
+	web::json::value cameras = web::json::value::object();
+	for (const auto& assignment : assignments_)
+	{
+		web::json::value camera;
+		camera[L"root"] = web::json::value::string(assignment.second);
+		auto cameraRate = cameraRates_.find(assignment.first);
+		if (cameraRate != cameraRates_.end())
+		{
+			camera[L"rate"] = web::json::value::number(cameraRate->second);
+		}
+		cameras[assignment.first] = camera;
+	}
+	web::json::value json;
+	json[L"cameras"] = cameras;
+
+	const wstring tmpPath = assignmentsPath_ + L".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		file << StringUtil::ToString(json.serialize());
+		if (!file)
+		{
+			LOG_WARNING("Failed to write " << StringUtil::ToString(tmpPath));
+			return;
+		}
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::rename(tmpPath, assignmentsPath_, ec);
+}
+
+uint64_t ArchiveVolumes::GetAvailableSpace(const std::wstring& root)
+{
+	boost::system::error_code ec;
+	boost::filesystem::space_info si = boost::filesystem::space(root, ec);
+	return ec ? 0 : si.available;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <mutex>
+#include "VosVideo.Configuration/ConfigurationManager.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		// Archive spread over several roots, usually one per disk, so every added disk adds recording bandwidth.
+		// Camera is placed on one root and keeps it: its recordings stay together and camera configuration
+		// doesn't change between restarts. Assignments are stored in the first root.
+		// New camera goes to pinned root if configuration has one, otherwise to the root picked by policy.
+		// Least used root is the one that would fill last judging by its free space and write rate of cameras
+		// already placed there, rate is measured from recordings each camera completes.
+		class ArchiveVolumes final
+		{
+		public:
+			ArchiveVolumes(std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager);
+			~ArchiveVolumes();
+
+			std::vector<std::wstring> GetRoots() const;
+			// Recording folder of camera, empty if archive is not configured
+			std::wstring Assign(const std::wstring& cameraName);
+			// Root holding the file, empty if file is outside of archive
+			std::wstring FindRoot(const std::wstring& path) const;
+			// Duration is nanoseconds, complete recordings refine camera write rate
+			void OnRecordingAdded(const std::wstring& cameraName, uint64_t fileSize, uint64_t duration);
+			// Bytes to be freed on root to keep reserved disk space
+			uint64_t GetSpaceDeficit(const std::wstring& root) const;
+
+		private:
+			// Following must be called under mutex_
+			std::wstring ChooseRoot(const std::wstring& cameraName);
+			double GetCameraRate(const std::wstring& cameraName) const;
+			void LoadAssignments();
+			void SaveAssignments();
+
+			static uint64_t GetAvailableSpace(const std::wstring& root);
+
+			std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager_;
+			std::vector<std::wstring> roots_;
+			vosvideo::configuration::ArchivePlacementPolicy policy_;
+			uint64_t reservedDiskSpace_;
+			std::wstring assignmentsPath_;
+
+			mutable std::mutex mutex_;
+			// camera -> root
+			std::unordered_map<std::wstring, std::wstring> assignments_;
+			// camera -> bytes per second
+			std::unordered_map<std::wstring, double> cameraRates_;
+			size_t nextRoot_ = 0;
+
+			static const std::wstring assignmentsFileName_;
+			// Weight of the newest recording in camera rate
+			static const double rateSmoothing_;
+		};
+	}
+}
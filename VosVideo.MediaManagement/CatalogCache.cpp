@@ -0,0 +1,376 @@
+#include "stdafx.h"
+#include <fstream>
+#include <cstring>
+#include <share.h>
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include "LocalVideoFile.h"
+#include "CatalogCache.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::archive;
+
+const char CatalogCache::magic_[4] = { 'V', 'V', 'C', 'T' };
+
+namespace
+{
+	// Record layout: [uint32 payload size][uint32 crc32 of payload][payload]
+	const size_t recordHeaderSize = 2 * sizeof(uint32_t);
+	const size_t fileHeaderSize = 4 + sizeof(uint32_t);
+
+	template <typename T>
+	void Put(std::vector<char>& buffer, const T& value)
+	{
+		const char* p = reinterpret_cast<const char*>(&value);
+		buffer.insert(buffer.end(), p, p + sizeof(T));
+	}
+
+	void PutString(std::vector<char>& buffer, const std::wstring& value)
+	{
+		Put<uint16_t>(buffer, static_cast<uint16_t>(value.length()));
+		const char* p = reinterpret_cast<const char*>(value.data());
+		buffer.insert(buffer.end(), p, p + value.length() * sizeof(wchar_t));
+	}
+
+	template <typename T>
+	bool Get(const char*& data, const char* end, T& value)
+	{
+		if (end - data < static_cast<ptrdiff_t>(sizeof(T)))
+		{
+			return false;
+		}
+		memcpy(&value, data, sizeof(T));
+		data += sizeof(T);
+		return true;
+	}
+
+	bool GetString(const char*& data, const char* end, std::wstring& value)
+	{
+		uint16_t length = 0;
+		if (!Get(data, end, length) || end - data < static_cast<ptrdiff_t>(length * sizeof(wchar_t)))
+		{
+			return false;
+		}
+		value.assign(reinterpret_cast<const wchar_t*>(data), length);
+		data += length * sizeof(wchar_t);
+		return true;
+	}
+
+	uint32_t Checksum(const char* data, size_t size)
+	{
+		boost::crc_32_type crc;
+		crc.process_bytes(data, size);
+		return crc.checksum();
+	}
+}
+
+CatalogCache::CatalogCache(const std::wstring& cachePath) : cachePath_(cachePath)
+{
+}
+
+CatalogCache::~CatalogCache()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (log_ != nullptr)
+	{
+		fclose(log_);
+	}
+}
+
+size_t CatalogCache::Load()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_.clear();
+	recordCount_ = 0;
+
+	vector<char> content;
+	{
+		std::ifstream file(cachePath_, std::ios::binary);
+		if (file)
+		{
+			file.seekg(0, std::ios::end);
+			content.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(content.data(), content.size());
+		}
+	}
+
+	uint32_t version = 0;
+	if (content.size() < fileHeaderSize || memcmp(content.data(), magic_, sizeof(magic_)) != 0 ||
+		(memcpy(&version, content.data() + sizeof(magic_), sizeof(version)), version != version_))
+	{
+		if (!content.empty())
+		{
+			LOG_WARNING("Catalog cache " << StringUtil::ToString(cachePath_) << " has unknown format, it will be rebuilt");
+		}
+		OpenLog(true);
+		return 0;
+	}
+
+	size_t pos = fileHeaderSize;
+	while (pos < content.size())
+	{
+		RecordType type;
+		CatalogCacheEntry entry;
+		uint32_t payloadSize = 0;
+		if (content.size() - pos < recordHeaderSize)
+		{
+			break;
+		}
+		memcpy(&payloadSize, content.data() + pos, sizeof(payloadSize));
+		if (content.size() - pos - recordHeaderSize < payloadSize ||
+			!ParseRecord(content.data() + pos, recordHeaderSize + payloadSize, type, entry))
+		{
+			break;
+		}
+
+		if (type == RecordType::Put)
+		{
+			wstring path = entry.Path;
+			entries_[path] = std::move(entry);
+		}
+		else
+		{
+			entries_.erase(entry.Path);
+		}
+		++recordCount_;
+		pos += recordHeaderSize + payloadSize;
+	}
+
+	if (pos < content.size())
+	{
+		// Process was stopped in the middle of append, the rest of log can't be trusted
+		LOG_WARNING("Catalog cache is damaged at " << pos << ", " << content.size() - pos << " bytes dropped");
+		boost::system::error_code ec;
+		boost::filesystem::resize_file(cachePath_, pos, ec);
+	}
+
+	OpenLog(false);
+	LOG_TRACE("Catalog cache loaded " << entries_.size() << " files from " << recordCount_ << " records");
+	return entries_.size();
+}
+
+bool CatalogCache::Find(const std::wstring& path, int64_t fileSize, int64_t lastWriteTime, CatalogCacheEntry& entry) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto iter = entries_.find(path);
+	if (iter == entries_.end() || iter->second.FileSize != fileSize || iter->second.LastWriteTime != lastWriteTime)
+	{
+		return false;
+	}
+	entry = iter->second;
+	return true;
+}
+
+std::vector<std::wstring> CatalogCache::GetPaths() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	vector<wstring> paths;
+	paths.reserve(entries_.size());
+	for (const auto& entry : entries_)
+	{
+		paths.push_back(entry.first);
+	}
+	return paths;
+}
+
+void CatalogCache::Put(const CatalogCacheEntry& entry)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_[entry.Path] = entry;
+	Append(RecordType::Put, entry);
+}
+
+void CatalogCache::Remove(const std::wstring& path)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (entries_.erase(path) == 0)
+	{
+		return;
+	}
+	CatalogCacheEntry entry;
+	entry.Path = path;
+	Append(RecordType::Remove, entry);
+}
+
+void CatalogCache::Compact()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (recordCount_ < compactMinRecords_ || recordCount_ < entries_.size() * compactRatio_)
+	{
+		return;
+	}
+
+	wstring tmpPath = cachePath_ + L".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		out.write(magic_, sizeof(magic_));
+		out.write(reinterpret_cast<const char*>(&version_), sizeof(version_));
+
+		vector<char> buffer;
+		for (const auto& entry : entries_)
+		{
+			buffer.clear();
+			SerializeRecord(RecordType::Put, entry.second, buffer);
+			out.write(buffer.data(), buffer.size());
+		}
+
+		if (!out)
+		{
+			LOG_WARNING("Failed to compact catalog cache");
+			return;
+		}
+	}
+
+	if (log_ != nullptr)
+	{
+		fclose(log_);
+		log_ = nullptr;
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::rename(tmpPath, cachePath_, ec);
+	if (ec)
+	{
+		LOG_WARNING("Failed to replace catalog cache: " << ec.message());
+	}
+	else
+	{
+		LOG_TRACE("Catalog cache compacted from " << recordCount_ << " to " << entries_.size() << " records");
+		recordCount_ = entries_.size();
+	}
+	OpenLog(false);
+}
+
+void CatalogCache::Flush()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (log_ != nullptr)
+	{
+		fflush(log_);
+	}
+}
+
+CatalogCacheEntry CatalogCache::CreateEntry(std::shared_ptr<VideoFile> videoFile, int64_t fileSize, int64_t lastWriteTime)
+{
+	CatalogCacheEntry entry;
+	entry.Path = videoFile->GetPath();
+	entry.CameraName = videoFile->GetId();
+	entry.FileSize = fileSize;
+	entry.LastWriteTime = lastWriteTime;
+	entry.Duration = videoFile->Duration();
+	entry.StartTime = videoFile->StartTime();
+	entry.IsSeekable = videoFile->IsSeekable();
+	return entry;
+}
+
+std::shared_ptr<VideoFile> CatalogCache::CreateVideoFile(const CatalogCacheEntry& entry)
+{
+	return shared_ptr<VideoFile>(new LocalVideoFile(entry.CameraName, entry.Path, entry.Duration, entry.StartTime, entry.IsSeekable));
+}
+
+void CatalogCache::Append(RecordType type, const CatalogCacheEntry& entry)
+{
+	if (log_ == nullptr)
+	{
+		return;
+	}
+
+	vector<char> buffer;
+	SerializeRecord(type, entry, buffer);
+	// Single write per record, so crash can tear only the last one
+	if (fwrite(buffer.data(), 1, buffer.size(), log_) != buffer.size())
+	{
+		LOG_WARNING("Failed to append to catalog cache " << StringUtil::ToString(cachePath_));
+	}
+	++recordCount_;
+}
+
+bool CatalogCache::OpenLog(bool truncate)
+{
+	if (log_ != nullptr)
+	{
+		fclose(log_);
+		log_ = nullptr;
+	}
+
+	log_ = _wfsopen(cachePath_.c_str(), truncate ? L"wb" : L"ab", _SH_DENYWR);
+	if (log_ == nullptr)
+	{
+		LOG_WARNING("Catalog cache " << StringUtil::ToString(cachePath_) << " can't be opened, files will be rediscovered on next start");
+		return false;
+	}
+
+	if (truncate)
+	{
+		fwrite(magic_, 1, sizeof(magic_), log_);
+		fwrite(&version_, 1, sizeof(version_), log_);
+		fflush(log_);
+	}
+	return true;
+}
+
+void CatalogCache::SerializeRecord(RecordType type, const CatalogCacheEntry& entry, std::vector<char>& buffer)
+{
+	const size_t start = buffer.size();
+	buffer.resize(start + recordHeaderSize);
+
+	Put<uint8_t>(buffer, static_cast<uint8_t>(type));
+	PutString(buffer, entry.Path);
+	if (type == RecordType::Put)
+	{
+		PutString(buffer, entry.CameraName);
+		Put<int64_t>(buffer, entry.FileSize);
+		Put<int64_t>(buffer, entry.LastWriteTime);
+		Put<uint64_t>(buffer, entry.Duration);
+		Put<uint64_t>(buffer, entry.StartTime);
+		Put<uint8_t>(buffer, entry.IsSeekable ? 1 : 0);
+		PutString(buffer, entry.IndexPath);
+	}
+
+	const uint32_t payloadSize = static_cast<uint32_t>(buffer.size() - start - recordHeaderSize);
+	const uint32_t crc = Checksum(buffer.data() + start + recordHeaderSize, payloadSize);
+	memcpy(buffer.data() + start, &payloadSize, sizeof(payloadSize));
+	memcpy(buffer.data() + start + sizeof(payloadSize), &crc, sizeof(crc));
+}
+
+bool CatalogCache::ParseRecord(const char* data, size_t size, RecordType& type, CatalogCacheEntry& entry)
+{
+	uint32_t payloadSize = 0;
+	uint32_t crc = 0;
+	memcpy(&payloadSize, data, sizeof(payloadSize));
+	memcpy(&crc, data + sizeof(payloadSize), sizeof(crc));
+	const char* payload = data + recordHeaderSize;
+	const char* end = payload + payloadSize;
+	if (Checksum(payload, payloadSize) != crc)
+	{
+		return false;
+	}
+
+	uint8_t rawType = 0;
+	if (!Get(payload, end, rawType) || !GetString(payload, end, entry.Path))
+	{
+		return false;
+	}
+	type = static_cast<RecordType>(rawType);
+	if (type == RecordType::Remove)
+	{
+		return true;
+	}
+	if (type != RecordType::Put)
+	{
+		return false;
+	}
+
+	uint8_t seekable = 0;
+	bool ok = GetString(payload, end, entry.CameraName) &&
+		Get(payload, end, entry.FileSize) &&
+		Get(payload, end, entry.LastWriteTime) &&
+		Get(payload, end, entry.Duration) &&
+		Get(payload, end, entry.StartTime) &&
+		Get(payload, end, seekable) &&
+		GetString(payload, end, entry.IndexPath);
+	entry.IsSeekable = seekable != 0;
+	return ok;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <mutex>
+#include <cstdio>
+#include "VideoFile.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		struct CatalogCacheEntry
+		{
+			std::wstring Path;
+			std::wstring CameraName;
+			// Identity of file content when it was discovered
+			int64_t FileSize = 0;
+			int64_t LastWriteTime = 0;
+			uint64_t Duration = 0;
+			uint64_t StartTime = 0;
+			bool IsSeekable = false;
+			// Binary segment index of recording, empty if it has none
+			std::wstring IndexPath;
+		};
+
+		// Discovered files kept between runs, so only new or changed files are rediscovered on start.
+		// Stored in append-only log: every change is one checksummed record, the last record of a path wins.
+		// Torn tail after crash is cut off on load, log is rewritten when it grows much bigger than the catalog.
+		class CatalogCache final
+		{
+		public:
+			CatalogCache(const std::wstring& cachePath);
+			~CatalogCache();
+
+			// Reads log into memory, returns number of cached files
+			size_t Load();
+			// Returns false if file isn't cached or was changed since it was cached
+			bool Find(const std::wstring& path, int64_t fileSize, int64_t lastWriteTime, CatalogCacheEntry& entry) const;
+			std::vector<std::wstring> GetPaths() const;
+
+			void Put(const CatalogCacheEntry& entry);
+			void Remove(const std::wstring& path);
+			// Rewrites log with live entries only if it's worth it
+			void Compact();
+			void Flush();
+
+			static CatalogCacheEntry CreateEntry(std::shared_ptr<VideoFile> videoFile, int64_t fileSize, int64_t lastWriteTime);
+			static std::shared_ptr<VideoFile> CreateVideoFile(const CatalogCacheEntry& entry);
+
+		private:
+			enum class RecordType : uint8_t
+			{
+				Put = 1,
+				Remove = 2
+			};
+
+			void Append(RecordType type, const CatalogCacheEntry& entry);
+			bool OpenLog(bool truncate);
+			static void SerializeRecord(RecordType type, const CatalogCacheEntry& entry, std::vector<char>& buffer);
+			// Returns false on torn or damaged record
+			static bool ParseRecord(const char* data, size_t size, RecordType& type, CatalogCacheEntry& entry);
+
+			std::wstring cachePath_;
+			FILE* log_ = nullptr;
+			mutable std::mutex mutex_;
+			std::unordered_map<std::wstring, CatalogCacheEntry> entries_;
+			size_t recordCount_ = 0;
+
+			static const char magic_[4];
+			static const uint32_t version_ = 1;
+			// Log is compacted when it has this many times more records than live entries
+			static const size_t compactRatio_ = 2;
+			static const size_t compactMinRecords_ = 1024;
+		};
+	}
+}
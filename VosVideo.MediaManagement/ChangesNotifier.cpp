@@ -17,3 +17,8 @@ connection ChangesNotifier::ConnectToChangesSignal(signal<void (const wstring&)>
 {
 	return notifierSignal_.connect(subscriber);
 }
+
+connection ChangesNotifier::ConnectToRemovedSignal(signal<void (const wstring&)>::slot_function_type subscriber)
+{
+	return removedSignal_.connect(subscriber);
+}
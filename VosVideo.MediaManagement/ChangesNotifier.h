@@ -11,8 +11,13 @@ namespace vosvideo
 			ChangesNotifier();
 			virtual ~ChangesNotifier() = 0;
 
+			// Called with full path of recording once it's written
 			boost::signals2::connection ConnectToChangesSignal(boost::signals2::signal<void (const std::wstring&)>::slot_function_type subscriber);
+			// Called with full path of file removed from archive
+			boost::signals2::connection ConnectToRemovedSignal(boost::signals2::signal<void (const std::wstring&)>::slot_function_type subscriber);
+
 			boost::signals2::signal<void (const std::wstring&)> notifierSignal_;
+			boost::signals2::signal<void (const std::wstring&)> removedSignal_;
 		};
 	}
 }
@@ -0,0 +1,310 @@
+#include "stdafx.h"
+#include <boost/filesystem/path.hpp>
+#include <boost/algorithm/string.hpp>
+#include "VosVideo.MediaFile/MediaSegmentIndex.h"
+#include "ClipExporter.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::archive;
+using namespace vosvideo::mediafile;
+
+ClipExporter::ClipExporter(const std::vector<std::shared_ptr<VideoFile>>& files, uint64_t from, uint64_t to) :
+	files_(files),
+	from_(from),
+	to_(to),
+	isWebm_(false)
+{
+	if (!files_.empty())
+	{
+		wstring ext = boost::filesystem::path(files_.front()->GetPath()).extension().wstring();
+		boost::algorithm::to_lower(ext);
+		isWebm_ = (ext == L".webm");
+	}
+}
+
+ClipExporter::~ClipExporter()
+{
+	DestroyPipeline();
+}
+
+std::wstring ClipExporter::GetContentType() const
+{
+	return isWebm_ ? L"video/webm" : L"video/mp4";
+}
+
+std::wstring ClipExporter::GetExtension() const
+{
+	return isWebm_ ? L".webm" : L".mp4";
+}
+
+bool ClipExporter::Start()
+{
+	if (files_.empty() || to_ <= from_)
+	{
+		return false;
+	}
+
+	if (!BuildPipeline())
+	{
+		DestroyPipeline();
+		return false;
+	}
+
+	if (gst_element_set_state(pipeline_, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+	{
+		LOG_ERROR("Unable to start clip export pipeline");
+		DestroyPipeline();
+		return false;
+	}
+
+	// Preroll needs the first recording linked, it fails if parser couldn't read it
+	GstStateChangeReturn preroll = gst_element_get_state(pipeline_, nullptr, nullptr, prerollTimeout_);
+	if (preroll == GST_STATE_CHANGE_FAILURE || !CheckBus() || !segments_.front()->IsLinked)
+	{
+		LOG_ERROR("Clip export of " << StringUtil::ToString(files_.front()->GetPath()) << " didn't preroll");
+		DestroyPipeline();
+		return false;
+	}
+	return true;
+}
+
+ClipExporter::PullResult ClipExporter::Pull(std::vector<uint8_t>& data)
+{
+	if (!pipeline_)
+	{
+		return PullResult::Failed;
+	}
+
+	GstSample* sample = nullptr;
+	g_signal_emit_by_name(appSink_, "try-pull-sample", pullTimeout_, &sample);
+	if (sample)
+	{
+		GstBuffer* buffer = gst_sample_get_buffer(sample);
+		GstMapInfo info;
+		if (buffer && gst_buffer_map(buffer, &info, GST_MAP_READ))
+		{
+			data.assign(info.data, info.data + info.size);
+			gst_buffer_unmap(buffer, &info);
+		}
+		gst_sample_unref(sample);
+		return PullResult::Data;
+	}
+
+	gboolean isEos = FALSE;
+	g_object_get(appSink_, "eos", &isEos, nullptr);
+	if (isEos)
+	{
+		DestroyPipeline();
+		return PullResult::Finished;
+	}
+	if (!CheckBus())
+	{
+		DestroyPipeline();
+		return PullResult::Failed;
+	}
+	return PullResult::Pending;
+}
+
+bool ClipExporter::BuildPipeline()
+{
+	pipeline_ = gst_pipeline_new("clipexport");
+	GstElement* concat = gst_element_factory_make("concat", "concat");
+	GstElement* muxer = isWebm_ ? gst_element_factory_make("webmmux", "muxer") : gst_element_factory_make("mp4mux", "muxer");
+	appSink_ = gst_element_factory_make("appsink", "clipsink");
+	if (!pipeline_ || !concat || !muxer || !appSink_)
+	{
+		LOG_ERROR("Unable to create clip export elements");
+		if (concat) gst_object_unref(concat);
+		if (muxer) gst_object_unref(muxer);
+		if (appSink_) gst_object_unref(appSink_);
+		appSink_ = nullptr;
+		return false;
+	}
+
+	// Output goes to network stream, muxer must never seek back
+	if (isWebm_)
+	{
+		g_object_set(muxer, "streamable", TRUE, nullptr);
+	}
+	else
+	{
+		g_object_set(muxer, "streamable", TRUE, "fragment-duration", fragmentDurationMs_, nullptr);
+	}
+	// Clip is produced as fast as disk allows, not in real time
+	g_object_set(appSink_, "sync", FALSE, "emit-signals", FALSE, "max-buffers", 64, nullptr);
+	gst_object_ref(appSink_);
+
+	gst_bin_add_many(GST_BIN(pipeline_), concat, muxer, appSink_, nullptr);
+	if (!gst_element_link_many(concat, muxer, appSink_, nullptr))
+	{
+		LOG_ERROR("Unable to link clip export elements");
+		return false;
+	}
+
+	for (size_t i = 0; i < files_.size(); ++i)
+	{
+		auto videoFile = files_[i];
+		GstElement* source = gst_element_factory_make("filesrc", nullptr);
+		// Demuxer and parser only, parsebin never plugs decoders
+		GstElement* parser = gst_element_factory_make("parsebin", nullptr);
+		if (!source || !parser)
+		{
+			LOG_ERROR("Unable to create clip export source elements");
+			if (source) gst_object_unref(source);
+			if (parser) gst_object_unref(parser);
+			return false;
+		}
+		g_object_set(source, "location", StringUtil::ToString(videoFile->GetPath()).c_str(), nullptr);
+		gst_bin_add_many(GST_BIN(pipeline_), source, parser, nullptr);
+		gst_element_link(source, parser);
+
+		unique_ptr<SegmentContext> segment(new SegmentContext());
+		segment->Exporter = this;
+		// Pads are requested in file order, concat plays them in that order
+		segment->ConcatPad = gst_element_get_request_pad(concat, "sink_%u");
+		segment->Start = 0;
+		segment->Stop = GST_CLOCK_TIME_NONE;
+		segment->WaitKeyFrame = (i == 0);
+		segment->IsLinked = false;
+
+		const uint64_t fileStart = videoFile->StartTime();
+		if (i == 0 && from_ > fileStart)
+		{
+			segment->Start = FindKeyFrameTime(videoFile, from_ - fileStart);
+		}
+		if (i + 1 == files_.size() && to_ > fileStart)
+		{
+			segment->Stop = to_ - fileStart;
+		}
+
+		g_signal_connect(parser, "pad-added", G_CALLBACK(CbPadAdded), segment.get());
+		g_signal_connect(parser, "no-more-pads", G_CALLBACK(CbNoMorePads), segment.get());
+		segments_.push_back(std::move(segment));
+	}
+	return true;
+}
+
+void ClipExporter::DestroyPipeline()
+{
+	if (pipeline_)
+	{
+		gst_element_set_state(pipeline_, GST_STATE_NULL);
+		for (const auto& segment : segments_)
+		{
+			if (segment->ConcatPad)
+			{
+				gst_object_unref(segment->ConcatPad);
+			}
+		}
+		gst_object_unref(pipeline_);
+		pipeline_ = nullptr;
+	}
+	segments_.clear();
+
+	if (appSink_)
+	{
+		gst_object_unref(appSink_);
+		appSink_ = nullptr;
+	}
+}
+
+bool ClipExporter::CheckBus()
+{
+	GstBus* bus = gst_element_get_bus(pipeline_);
+	GstMessage* msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+	gst_object_unref(bus);
+	if (!msg)
+	{
+		return true;
+	}
+
+	GError* err = nullptr;
+	gchar* debugInfo = nullptr;
+	gst_message_parse_error(msg, &err, &debugInfo);
+	LOG_ERROR("Clip export failed in " << GST_OBJECT_NAME(msg->src) << ": " << (err ? err->message : "unknown"));
+	g_clear_error(&err);
+	g_free(debugInfo);
+	gst_message_unref(msg);
+	return false;
+}
+
+GstClockTime ClipExporter::FindKeyFrameTime(std::shared_ptr<VideoFile> videoFile, GstClockTime time)
+{
+	try
+	{
+		MediaSegmentIndex index(MediaSegmentIndex::GetIndexPath(videoFile->GetPath()));
+		auto entry = index.FindKeyFrame(static_cast<int64_t>(time));
+		if (entry != nullptr)
+		{
+			return static_cast<GstClockTime>(entry->TimeCode);
+		}
+	}
+	catch (std::exception&)
+	{
+		// Without index clip starts at first key frame after the time
+	}
+	return time;
+}
+
+void ClipExporter::CbPadAdded(GstElement* element, GstPad* pad, gpointer data)
+{
+	SegmentContext* segment = static_cast<SegmentContext*>(data);
+	if (segment->IsLinked)
+	{
+		return;
+	}
+
+	GstCaps* caps = gst_pad_query_caps(pad, nullptr);
+	const gchar* mediaType = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+	bool isVideo = g_str_has_prefix(mediaType, "video/");
+	gst_caps_unref(caps);
+	if (!isVideo)
+	{
+		return;
+	}
+
+	if (gst_pad_link(pad, segment->ConcatPad) != GST_PAD_LINK_OK)
+	{
+		LOG_ERROR("Unable to link recording to clip");
+		return;
+	}
+	segment->IsLinked = true;
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, CbTrimBuffer, segment, nullptr);
+}
+
+void ClipExporter::CbNoMorePads(GstElement* element, gpointer data)
+{
+	SegmentContext* segment = static_cast<SegmentContext*>(data);
+	if (!segment->IsLinked)
+	{
+		// Error goes to bus, Pull reports it
+		GST_ELEMENT_ERROR(element, STREAM, WRONG_TYPE, ("Recording has no video to export"), (nullptr));
+	}
+}
+
+GstPadProbeReturn ClipExporter::CbTrimBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+	SegmentContext* segment = static_cast<SegmentContext*>(data);
+	GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	GstClockTime pts = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : GST_BUFFER_DTS(buffer);
+	if (!GST_CLOCK_TIME_IS_VALID(pts))
+	{
+		return segment->WaitKeyFrame ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+	}
+
+	if (GST_CLOCK_TIME_IS_VALID(segment->Stop) && pts >= segment->Stop)
+	{
+		return GST_PAD_PROBE_DROP;
+	}
+
+	if (segment->WaitKeyFrame)
+	{
+		if (pts < segment->Start || GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+		{
+			return GST_PAD_PROBE_DROP;
+		}
+		segment->WaitKeyFrame = false;
+	}
+	return GST_PAD_PROBE_OK;
+}
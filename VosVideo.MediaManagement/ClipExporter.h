@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <gst/gst.h>
+#include "VideoFile.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		// Cuts time range out of consecutive recordings of one camera and remuxes it into one file.
+		// Nothing is decoded or encoded: clip starts at key frame preceding range start, which is taken
+		// from segment index when recording has one, and frames are only copied into new container.
+		class ClipExporter final
+		{
+		public:
+			enum class PullResult
+			{
+				Data,
+				// Nothing muxed yet, pull again
+				Pending,
+				Finished,
+				Failed
+			};
+
+			// Files must be ordered by start time, times are nanoseconds from Unix epoch
+			ClipExporter(const std::vector<std::shared_ptr<VideoFile>>& files, uint64_t from, uint64_t to);
+			~ClipExporter();
+
+			// Starts remuxing and waits for pipeline to preroll, false if pipeline can't be built
+			// or the first recording has no video
+			bool Start();
+			// Waits shortly for next piece of muxed clip, so caller may do other work between pulls.
+			// Pipeline is stopped once clip is finished or failed.
+			PullResult Pull(std::vector<uint8_t>& data);
+			std::wstring GetContentType() const;
+			std::wstring GetExtension() const;
+
+		private:
+			struct SegmentContext
+			{
+				ClipExporter* Exporter;
+				GstPad* ConcatPad;
+				// Window of the file's own time line which goes into clip
+				GstClockTime Start;
+				GstClockTime Stop;
+				bool WaitKeyFrame;
+				// Set from streaming thread once parser exposes video
+				std::atomic<bool> IsLinked;
+			};
+
+			bool BuildPipeline();
+			void DestroyPipeline();
+			// Returns false on pipeline error
+			bool CheckBus();
+			static GstClockTime FindKeyFrameTime(std::shared_ptr<VideoFile> videoFile, GstClockTime time);
+			static void CbPadAdded(GstElement* element, GstPad* pad, gpointer data);
+			// Concat would wait forever for recording without video, it fails export instead
+			static void CbNoMorePads(GstElement* element, gpointer data);
+			static GstPadProbeReturn CbTrimBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+
+			std::vector<std::shared_ptr<VideoFile>> files_;
+			uint64_t from_;
+			uint64_t to_;
+			bool isWebm_;
+
+			GstElement* pipeline_ = nullptr;
+			GstElement* appSink_ = nullptr;
+			std::vector<std::unique_ptr<SegmentContext>> segments_;
+
+			static const GstClockTime pullTimeout_ = 100 * GST_MSECOND;
+			static const GstClockTime prerollTimeout_ = 5 * GST_SECOND;
+			static const guint fragmentDurationMs_ = 1000;
+		};
+	}
+}
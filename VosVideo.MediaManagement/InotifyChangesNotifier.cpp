@@ -0,0 +1,219 @@
+#include "stdafx.h"
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <boost/filesystem/path.hpp>
+#include "InotifyChangesNotifier.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::archive;
+using namespace vosvideo::configuration;
+
+const std::chrono::milliseconds InotifyChangesNotifier::settlePeriod_(500);
+
+InotifyChangesNotifier::InotifyChangesNotifier(std::shared_ptr<ConfigurationManager> configManager) :
+	configManager_(configManager)
+{
+	vector<wstring> roots = configManager_->GetArchivePaths();
+	if (roots.empty())
+	{
+		return;
+	}
+
+	inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd_ == -1)
+	{
+		LOG_ERROR("inotify_init1 failed, archive changes will not be noticed. Error: " << errno);
+		return;
+	}
+
+	for (const auto& root : roots)
+	{
+		string rootPath = boost::filesystem::path(root).string();
+		int watchFd = inotify_add_watch(inotifyFd_, rootPath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF);
+		if (watchFd == -1)
+		{
+			LOG_ERROR("Can't watch archive directory " << rootPath << ". Error: " << errno);
+			continue;
+		}
+		watches_[watchFd] = rootPath;
+	}
+	if (watches_.empty())
+	{
+		return;
+	}
+
+	epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+	stopFd_ = eventfd(0, EFD_CLOEXEC);
+	if (epollFd_ == -1 || stopFd_ == -1)
+	{
+		LOG_ERROR("Can't create epoll for archive watcher. Error: " << errno);
+		return;
+	}
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.fd = inotifyFd_;
+	epoll_ctl(epollFd_, EPOLL_CTL_ADD, inotifyFd_, &ev);
+	ev.data.fd = stopFd_;
+	epoll_ctl(epollFd_, EPOLL_CTL_ADD, stopFd_, &ev);
+
+	watchThr_ = std::thread([this]
+	{
+		this->WatchLoop();
+	});
+}
+
+InotifyChangesNotifier::~InotifyChangesNotifier()
+{
+	if (watchThr_.joinable())
+	{
+		uint64_t one = 1;
+		write(stopFd_, &one, sizeof(one));
+		watchThr_.join();
+	}
+
+	for (int fd : { stopFd_, epollFd_, inotifyFd_ })
+	{
+		if (fd != -1)
+		{
+			close(fd);
+		}
+	}
+}
+
+void InotifyChangesNotifier::WatchLoop()
+{
+	for (;;)
+	{
+		epoll_event events[2];
+		int count = epoll_wait(epollFd_, events, 2, GetWaitTimeout());
+		if (count == -1 && errno != EINTR)
+		{
+			LOG_ERROR("Archive watcher epoll_wait failed. Error: " << errno);
+			break;
+		}
+
+		bool stop = false;
+		for (int i = 0; i < count; ++i)
+		{
+			if (events[i].data.fd == stopFd_)
+			{
+				stop = true;
+			}
+			else if (events[i].data.fd == inotifyFd_ && !ReadEvents())
+			{
+				stop = true;
+			}
+		}
+
+		if (stop)
+		{
+			break;
+		}
+		FirePending(false);
+	}
+
+	// Segments finished right before shutdown still get into catalog
+	FirePending(true);
+}
+
+bool InotifyChangesNotifier::ReadEvents()
+{
+	alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+	for (;;)
+	{
+		ssize_t len = read(inotifyFd_, buffer, sizeof(buffer));
+		if (len <= 0)
+		{
+			return true;
+		}
+
+		for (char* ptr = buffer; ptr < buffer + len; )
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				LOG_WARNING("Archive watcher queue overflow, some archive changes are lost");
+				continue;
+			}
+			auto watch = watches_.find(event->wd);
+			if (watch == watches_.end())
+			{
+				continue;
+			}
+			if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+			{
+				// Other roots are still watched, e.g. when one disk is unmounted
+				LOG_WARNING("Archive directory " << watch->second << " is not watched anymore");
+				watches_.erase(watch);
+				if (watches_.empty())
+				{
+					return false;
+				}
+				continue;
+			}
+			if (event->len == 0 || (event->mask & IN_ISDIR))
+			{
+				continue;
+			}
+
+			string path = (boost::filesystem::path(watch->second) / event->name).string();
+			if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				// Every close restarts settle period, writer reopening the file yields one event
+				pending_[path] = std::chrono::steady_clock::now() + settlePeriod_;
+			}
+			else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+			{
+				pending_.erase(path);
+				removedSignal_(boost::filesystem::path(path).wstring());
+			}
+		}
+	}
+}
+
+void InotifyChangesNotifier::FirePending(bool all)
+{
+	auto now = std::chrono::steady_clock::now();
+	for (auto it = pending_.begin(); it != pending_.end(); )
+	{
+		if (all || it->second <= now)
+		{
+			wstring path = boost::filesystem::path(it->first).wstring();
+			it = pending_.erase(it);
+			LOG_TRACE("Archive file closed: " << StringUtil::ToString(path));
+			notifierSignal_(path);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+int InotifyChangesNotifier::GetWaitTimeout() const
+{
+	if (pending_.empty())
+	{
+		return -1;
+	}
+
+	auto nearest = pending_.begin()->second;
+	for (const auto& p : pending_)
+	{
+		nearest = std::min(nearest, p.second);
+	}
+
+	auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nearest - std::chrono::steady_clock::now()).count();
+	return static_cast<int>(std::max<int64_t>(timeout, 0) + 1);
+}
+
+#endif
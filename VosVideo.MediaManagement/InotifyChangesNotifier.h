@@ -0,0 +1,44 @@
+#pragma once
+#ifndef _WIN32
+#include <chrono>
+#include <thread>
+#include "VosVideo.Configuration/ConfigurationManager.h"
+#include "ChangesNotifier.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		// Watches archive roots with inotify. Only close after write and rename into directory are watched,
+		// so writer produces no events while it's writing. Repeated closes of the same file are coalesced:
+		// file is reported once it stays closed for settle period, that is one event per finished segment.
+		class InotifyChangesNotifier final : public ChangesNotifier
+		{
+		public:
+			InotifyChangesNotifier(std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager);
+			~InotifyChangesNotifier();
+
+		private:
+			typedef std::chrono::steady_clock::time_point TimePoint;
+
+			void WatchLoop();
+			// Returns false when watching must stop
+			bool ReadEvents();
+			void FirePending(bool all);
+			int GetWaitTimeout() const;
+
+			std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager_;
+			int inotifyFd_ = -1;
+			// watch descriptor -> archive root
+			std::unordered_map<int, std::string> watches_;
+			int epollFd_ = -1;
+			int stopFd_ = -1;
+			std::thread watchThr_;
+			// Closed files waiting for settle period to pass, by full path
+			std::unordered_map<std::string, TimePoint> pending_;
+
+			static const std::chrono::milliseconds settlePeriod_;
+		};
+	}
+}
+#endif
@@ -1,4 +1,5 @@
 #include "stdafx.h"
+#include <boost/filesystem.hpp>
 #include "VideoFileDiscovererException.h"
 #include "LocalVideoFileDiscoverer.h"
 
@@ -9,109 +10,99 @@ using namespace vosvideo::archive;
 
 LocalVideoFileDiscoverer::LocalVideoFileDiscoverer()
 {
-/*	GError *err = nullptr;
+	GError *err = nullptr;
 	// Instantiate the Discoverer 
-	data_.discoverer = gst_discoverer_new(5 * GST_SECOND, &err);
-	if (!data_.discoverer)
+	discoverer_ = gst_discoverer_new(discoverTimeout_, &err);
+	if (!discoverer_)
 	{
-		string strErr = "Error creating discoverer instance: " + string(err->message);
+		string strErr = "Error creating discoverer instance: " + string(err != nullptr ? err->message : "unknown");
 		g_clear_error(&err);
-		throw new VideoFileDiscovererException(strErr);
+		throw VideoFileDiscovererException(strErr);
 	}
-
-	// Connect to the interesting signals 
-	g_signal_connect(data_.discoverer, "discovered", G_CALLBACK(&LocalVideoFileDiscoverer::on_discovered_cb), &data_);
-	g_signal_connect(data_.discoverer, "finished", G_CALLBACK(&LocalVideoFileDiscoverer::on_finished_cb), &data_);
-	// Start the discoverer process (nothing to do yet) 
-	gst_discoverer_start(data_.discoverer);*/
 }
 
 LocalVideoFileDiscoverer::~LocalVideoFileDiscoverer()
 {
-	g_object_unref(data_.discoverer);
-	g_main_loop_unref(data_.loop);
+	if (discoverer_ != nullptr)
+	{
+		g_object_unref(discoverer_);
+	}
 }
 
 shared_ptr<VideoFile> LocalVideoFileDiscoverer::Discover(const wstring& path)
 {
-	vector<wstring> vectPath;
-	vectPath.push_back(path);
-	auto lvf = Discover(vectPath);
-	shared_ptr<LocalVideoFile> retFile;
+	string strPath = StringUtil::ToString(path);
+	GError *err = nullptr;
+	gchar* uri = gst_filename_to_uri(strPath.c_str(), &err);
+	if (uri == nullptr)
+	{
+		LOG_ERROR("Invalid path " << strPath << ": " << (err != nullptr ? err->message : "unknown"));
+		g_clear_error(&err);
+		return shared_ptr<LocalVideoFile>(new LocalVideoFile());
+	}
+
+	// Synchronous discovery doesn't need GMainLoop, so every worker thread can have its own discoverer
+	GstDiscovererInfo* info = gst_discoverer_discover_uri(discoverer_, uri, &err);
+	g_free(uri);
+
+	shared_ptr<VideoFile> videoFile;
+	if (info != nullptr)
+	{
+		videoFile = CreateFileInfo(info, path);
+		gst_discoverer_info_unref(info);
+	}
+	else
+	{
+		LOG_ERROR("Discoverer failed for " << strPath << ": " << (err != nullptr ? err->message : "unknown"));
+	}
+	g_clear_error(&err);
 
-	if (lvf.size() == 0) // return in invalid state
+	if (!videoFile) // return in invalid state
 	{
 		return shared_ptr<LocalVideoFile>(new LocalVideoFile());
 	}
-	return lvf[0];
+	return videoFile;
 }
 
 vector<shared_ptr<VideoFile> > LocalVideoFileDiscoverer::Discover(vector<wstring>& vectPath)
 {
 	vector<shared_ptr<VideoFile>> outInfo;
+	outInfo.reserve(vectPath.size());
 
 	for (const auto& vp : vectPath)
 	{
-		string strPath = "file:///" + StringUtil::ToString(vp);
-		const gchar *uri = strPath.c_str();
-//		data_.fileInfo.reset(new LocalVideoFile(*iter));
-
-		if (!gst_discoverer_discover_uri_async(data_.discoverer, uri))
-		{
-			LOG_ERROR("Failed to start discovering URI" << uri);
-			g_object_unref(data_.discoverer);
-		}
-		else
+		auto videoFile = Discover(vp);
+		if (videoFile->IsValid())
 		{
-			/* Create a GLib Main Loop and set it to run, so we can wait for the signals */
-			data_.loop = g_main_loop_new(nullptr, FALSE);
-			g_main_loop_run(data_.loop);
-			outInfo.push_back(data_.fileInfo);
+			outInfo.push_back(videoFile);
 		}
 	}
 
 	return outInfo;
 }
 
-// This function is called when the discoverer has finished examining
-// all the URIs we provided.
-void LocalVideoFileDiscoverer::on_finished_cb(GstDiscoverer *discoverer, LocalVideoFileDiscoverer::CustomData *data)
-{
-	g_main_loop_quit(data->loop);
-}
-
-// This function is called every time the discoverer has information regarding
-// one of the URIs we provided.
-void LocalVideoFileDiscoverer::on_discovered_cb(GstDiscoverer *discoverer, GstDiscovererInfo *info, GError *err, CustomData *data)
+shared_ptr<VideoFile> LocalVideoFileDiscoverer::CreateFileInfo(GstDiscovererInfo* info, const wstring& path)
 {
-	GstDiscovererResult result;
-	const gchar *uri;
-	const GstTagList *tags;
-	GstDiscovererStreamInfo *sinfo;
-
-	uri = gst_discoverer_info_get_uri(info);
-	result = gst_discoverer_info_get_result(info);
+	GstDiscovererResult result = gst_discoverer_info_get_result(info);
+	const gchar* uri = gst_discoverer_info_get_uri(info);
 	switch (result)
 	{
 	case GST_DISCOVERER_URI_INVALID:
 		LOG_ERROR("Invalid URI" << uri);
 		break;
 	case GST_DISCOVERER_ERROR:
-		LOG_ERROR("Discoverer error: " << err->message);
+		LOG_ERROR("Discoverer error: " << uri);
 		break;
 	case GST_DISCOVERER_TIMEOUT:
-		LOG_ERROR("Timeout");
+		LOG_ERROR("Timeout: " << uri);
 		break;
 	case GST_DISCOVERER_BUSY:
-		LOG_ERROR("Busy");
+		LOG_ERROR("Busy: " << uri);
 		break;
 	case GST_DISCOVERER_MISSING_PLUGINS:
 	{
-		const GstStructure *s;
-		gchar *str;
-
-		s = gst_discoverer_info_get_misc(info);
-		str = gst_structure_to_string(s);
+		const GstStructure *s = gst_discoverer_info_get_misc(info);
+		gchar *str = gst_structure_to_string(s);
 		LOG_ERROR("Missing plugins: " << str);
 		g_free(str);
 		break;
@@ -123,52 +114,38 @@ void LocalVideoFileDiscoverer::on_discovered_cb(GstDiscoverer *discoverer, GstDi
 
 	if (result != GST_DISCOVERER_OK)
 	{
-		g_printerr("This URI cannot be played\n");
-		return;
+		return nullptr;
 	}
-	
-	// If we got no error, store the retrieved information 
-	// Duration
+
 	GstClockTime duration = gst_discoverer_info_get_duration(info);
-//	g_print("\nDuration: %" GST_TIME_FORMAT "\n", GST_TIME_ARGS(gst_discoverer_info_get_duration(info)));
+	if (!GST_CLOCK_TIME_IS_VALID(duration))
+	{
+		duration = 0;
+	}
 	bool isSeekable = gst_discoverer_info_get_seekable(info) ? true : false;
 
-	string suri(uri);
-	wstring wuri = StringUtil::ToWstring(suri);
-	data->fileInfo.reset(new LocalVideoFile(wuri, wuri, duration, 0, isSeekable));
-
-	//tags = gst_discoverer_info_get_tags(info);
-	//if (tags) 
-	//{
-	//	g_print("Tags:\n");
-	//	gst_tag_list_foreach(tags, &LocalVideoFileDiscoverer::print_tag_foreach, GINT_TO_POINTER(1));
-	//}
-
-	//g_print("Seekable: %s\n", (gst_discoverer_info_get_seekable(info) ? "yes" : "no"));
-	//sinfo = gst_discoverer_info_get_stream_info(info);
+	// Recorder closes segment when it's complete, so start is the last write time minus its duration
+	boost::system::error_code ec;
+	time_t lastWrite = boost::filesystem::last_write_time(path, ec);
+	uint64_t endTime = ec ? 0 : static_cast<uint64_t>(lastWrite) * GST_SECOND;
+	uint64_t startTime = (endTime > duration) ? endTime - duration : 0;
 
-	//if (sinfo)
-	//{
-	//	gst_discoverer_stream_info_unref(sinfo);
-	//}
+	return shared_ptr<VideoFile>(new LocalVideoFile(GetCameraName(path), path, duration, startTime, isSeekable));
 }
 
-/* Print a tag in a human-readable format (name: value) */
-void LocalVideoFileDiscoverer::print_tag_foreach(const GstTagList *tags, const gchar *tag, gpointer user_data) 
+wstring LocalVideoFileDiscoverer::GetCameraName(const wstring& path)
 {
-	GValue val = { 0, };
-	gchar *str;
-	gint depth = GPOINTER_TO_INT(user_data);
-
-	gst_tag_list_copy_value(&val, tags, tag);
-
-	if (G_VALUE_HOLDS_STRING(&val))
-		str = g_value_dup_string(&val);
-	else
-		str = gst_value_serialize(&val);
-
-	g_print("%*s%s: %s\n", 2 * depth, " ", gst_tag_get_nick(tag), str);
-	g_free(str);
+	wstring stem = boost::filesystem::path(path).stem().wstring();
+	size_t digits = 0;
+	while (digits < 4 && digits < stem.length() && iswdigit(stem[stem.length() - 1 - digits]))
+	{
+		++digits;
+	}
 
-	g_value_unset(&val);
-}
\ No newline at end of file
+	// Not produced by our recorder, keep the whole name as camera
+	if (digits < 4 || digits == stem.length())
+	{
+		return stem;
+	}
+	return stem.substr(0, stem.length() - digits);
+}
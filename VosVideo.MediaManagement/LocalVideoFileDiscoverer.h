@@ -7,6 +7,7 @@ namespace vosvideo
 {
 	namespace archive
 	{
+		// Wraps synchronous GstDiscoverer, one instance must not be used from several threads at once.
 		class LocalVideoFileDiscoverer
 		{
 		public:
@@ -14,22 +15,17 @@ namespace vosvideo
 			~LocalVideoFileDiscoverer();
 
 			std::vector<std::shared_ptr<VideoFile> > Discover(std::vector<std::wstring>& vectPath);
-			std::shared_ptr<VideoFile> Discover(const std::wstring& vectPath);
+			// Returns file in invalid state if it can't be played
+			std::shared_ptr<VideoFile> Discover(const std::wstring& path);
+
+			// Recordings are named <camera name><4 digits sequence>.<ext>
+			static std::wstring GetCameraName(const std::wstring& path);
 
 		private:
-			// Structure to contain all our information, so we can pass it around 
-			struct CustomData 
-			{
-				GstDiscoverer *discoverer;
-				GMainLoop *loop;
-				std::shared_ptr<LocalVideoFile> fileInfo;
-			};
+			std::shared_ptr<VideoFile> CreateFileInfo(GstDiscovererInfo* info, const std::wstring& path);
 
-			LocalVideoFile lf;
-			CustomData data_;
-			static void on_discovered_cb(GstDiscoverer *discoverer, GstDiscovererInfo *info, GError *err, CustomData *data);
-			static void on_finished_cb(GstDiscoverer *discoverer, CustomData *data); 
-			static void print_tag_foreach(const GstTagList *tags, const gchar *tag, gpointer user_data);
+			GstDiscoverer* discoverer_ = nullptr;
+			static const GstClockTime discoverTimeout_ = 5 * GST_SECOND;
 		};
 	}
 }
@@ -1,11 +1,22 @@
 #include "stdafx.h"
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/filesystem.hpp>
 
 #include "VosVideo.Communication/TypeInfoWrapper.h"
 #include "VosVideo.Data/ArchiveCatalogRequestMsg.h"
+#include "VosVideo.Data/ArchiveCatalogAnswerMsg.h"
+#include "VosVideo.MediaFile/MediaSegmentIndex.h"
+#include "VosVideo.MediaFile/MotionTrack.h"
+#include "VosVideo.MediaFile/MediaFileManager.h"
 
+#ifdef _WIN32
 #include "DirectoryChangesNotifier.h"
+#else
+#include "InotifyChangesNotifier.h"
+#endif
 #include "MediaWatcher.h"
 
 using namespace std;
@@ -15,10 +26,17 @@ using namespace vosvideo::archive;
 using namespace vosvideo::data;
 using namespace boost::filesystem;
 
+const std::wstring MediaWatcher::catalogCacheName_ = L"catalog.vvcat";
+
 MediaWatcher::MediaWatcher(std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager,
-							   shared_ptr<vosvideo::communication::PubSubService> pubsubService) :
+							   shared_ptr<vosvideo::communication::PubSubService> pubsubService,
+							   shared_ptr<vosvideo::communication::CommunicationManager> communicationManager,
+							   shared_ptr<ArchiveVolumes> volumes) :
 	configManager_(configManager),
-	pubSubService_(pubsubService)
+	pubSubService_(pubsubService),
+	communicationManager_(communicationManager),
+	volumes_(volumes),
+	retention_(configManager, volumes)
 {
 	vector<TypeInfoWrapper> interestedTypes;
 
@@ -36,78 +54,412 @@ MediaWatcher::MediaWatcher(std::shared_ptr<vosvideo::configuration::Configuratio
 
 	pubSubService_->Subscribe(interestedTypes, *this);	
 //	directoryWatcher_.reset(new std::thread(&ArchiveManager::DoMonitorArchiveDirectory, this ));
+#ifdef _WIN32
 	changesNotifier_.reset(new DirectoryChangesNotifier(configManager_));
+#else
+	changesNotifier_.reset(new InotifyChangesNotifier(configManager_));
+#endif
 	changesNotifier_->ConnectToChangesSignal(boost::bind(&MediaWatcher::OnArchiveChanged, this, _1));
-	ReadVideoCatalogAsync(configManager_->GetArchivePath());
+	changesNotifier_->ConnectToRemovedSignal(boost::bind(&MediaWatcher::OnArchiveRemoved, this, _1));
+
+	// Discovery is mostly waiting on disk and demuxers, a few workers per core keep it busy
+	uint32_t workers = std::min<uint32_t>(std::max<uint32_t>(std::thread::hardware_concurrency(), 1) * 2, maxDiscoveryWorkers_);
+	discoveryPool_.reset(new VideoFileDiscoveryPool(workers));
+	thumbnailGenerator_.reset(new ThumbnailGenerator([this] { return GetThumbnailBacklog(); }));
+
+	// Catalog cache of all roots is kept in the first one
+	vector<wstring> roots = volumes_->GetRoots();
+	if (!roots.empty())
+	{
+		catalogCache_.reset(new CatalogCache((boost::filesystem::path(roots.front()) / catalogCacheName_).wstring()));
+	}
+	catalogTask_ = ReadVideoCatalogAsync(roots);
 }
 
 MediaWatcher::~MediaWatcher()
 {
+	CancelDiscovery();
+	thumbnailGenerator_->Stop();
+	try
+	{
+		catalogTask_.wait();
+	}
+	catch (std::exception& ex)
+	{
+		LOG_WARNING("Catalog reading finished with error: " << ex.what());
+	}
 }
 
-pplx::task<void> MediaWatcher::ReadVideoCatalogAsync(const wstring& path)
+pplx::task<void> MediaWatcher::ReadVideoCatalogAsync(const vector<wstring>& roots)
 {
-	wstring ext = L".webm";
-
 	return Concurrency::create_task([=]
 	{
-		if (exists(path) && is_directory(path))
+		auto started = std::chrono::steady_clock::now();
+		if (catalogCache_)
+		{
+			catalogCache_->Load();
+		}
+
+		// Only files which are new or changed since they were cached go to discovery
+		vector<wstring> paths;
+		std::unordered_set<wstring> existing;
+		std::unordered_set<wstring> unavailableRoots;
+		size_t cached = 0;
+		for (const auto& path : roots)
 		{
+			boost::system::error_code ec;
+			if (!exists(path, ec) || !is_directory(path, ec))
+			{
+				LOG_WARNING("Archive root " << StringUtil::ToString(path) << " is not available");
+				unavailableRoots.insert(path);
+				continue;
+			}
+
 			directory_iterator end_iter;
 
-			for (directory_iterator dir_iter(path); dir_iter != end_iter; ++dir_iter)
+			for (directory_iterator dir_iter(path, ec); !ec && dir_iter != end_iter; dir_iter.increment(ec))
 			{
-				if (is_regular_file(dir_iter->status()))
+				if (is_regular_file(dir_iter->status()) && IsRecording(dir_iter->path()))
 				{
-					if (dir_iter->path().extension().generic_wstring() == ext)
-					{						
-						auto videoFile = videoDiscoverer_.Discover(dir_iter->path().generic_wstring());
-						AddToCatalog(videoFile);
+					wstring filePath = dir_iter->path().wstring();
+					existing.insert(filePath);
+
+					int64_t fileSize = 0, lastWriteTime = 0;
+					CatalogCacheEntry entry;
+					if (catalogCache_ && GetFileStamp(filePath, fileSize, lastWriteTime) &&
+						catalogCache_->Find(filePath, fileSize, lastWriteTime, entry))
+					{
+						AddToCatalog(CatalogCache::CreateVideoFile(entry), static_cast<uint64_t>(entry.FileSize));
+						++cached;
 					}
+					else
+					{
+						paths.push_back(filePath);
+					}
+				}
+			}
+		}
+
+		if (catalogCache_)
+		{
+			for (const auto& cachedPath : catalogCache_->GetPaths())
+			{
+				// Recordings on a missing disk stay cached until it comes back
+				if (existing.find(cachedPath) == existing.end() &&
+					unavailableRoots.find(volumes_->FindRoot(cachedPath)) == unavailableRoots.end())
+				{
+					catalogCache_->Remove(cachedPath);
 				}
 			}
 		}
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+		LOG_TRACE("Archive catalog: " << cached << " files taken from cache in " << elapsed.count() << " ms, " << paths.size() << " to discover");
+		return paths;
+	}).then([this](vector<wstring> paths)
+	{
+		return discoveryPool_->DiscoverAsync(paths, 
+			[this](shared_ptr<VideoFile> videoFile)
+			{
+				AddDiscovered(videoFile);
+			},
+			[](const DiscoveryProgress& progress)
+			{
+				LOG_TRACE("Archive catalog: " << progress.Done << " of " << progress.Total << " files discovered, " << progress.Failed << " failed");
+			});
+	}).then([this]
+	{
+		if (catalogCache_)
+		{
+			catalogCache_->Flush();
+			catalogCache_->Compact();
+		}
+		EnforceRetention();
+		// Sprites missing from earlier runs are made from catalog, not from a queue of every such recording
+		thumbnailGenerator_->RequestBacklog();
 	});
 }
 
-void MediaWatcher::AddToCatalog(shared_ptr<VideoFile> videoFile)
+void MediaWatcher::AddDiscovered(shared_ptr<VideoFile> videoFile)
 {
-	auto entry = videoCatalog_.find(videoFile->GetId());
+	if (!videoFile->IsValid())
+	{
+		return;
+	}
 
-	if (entry != videoCatalog_.end())
+	int64_t fileSize = 0, lastWriteTime = 0;
+	if (!GetFileStamp(videoFile->GetPath(), fileSize, lastWriteTime))
 	{
-		entry->second.insert(make_pair(videoFile->StartTime(), videoFile));
+		return;
 	}
-	else
+
+	AddToCatalog(videoFile, static_cast<uint64_t>(fileSize));
+	thumbnailGenerator_->Enqueue(videoFile, lastWriteTime);
+	// Recording name may be reused, its track is read again
+	motionIndex_.Remove(videoFile->GetPath());
+
+	if (catalogCache_)
 	{
-		VideoEntriesMap sameIdMap;
-		sameIdMap.insert(make_pair(videoFile->StartTime(), videoFile));
-		videoCatalog_.insert(make_pair(videoFile->GetId(), sameIdMap));
+		auto entry = CatalogCache::CreateEntry(videoFile, fileSize, lastWriteTime);
+		boost::system::error_code ec;
+		wstring indexPath = vosvideo::mediafile::MediaSegmentIndex::GetIndexPath(entry.Path);
+		// Index lets catalog queries point inside recording. It's rebuilt once recording was written after it,
+		// name of a deleted recording may be reused by a new one.
+		time_t indexTime = last_write_time(indexPath, ec);
+		bool isIndexed = !ec && static_cast<int64_t>(indexTime) >= lastWriteTime;
+		if (!isIndexed)
+		{
+			try
+			{
+				isIndexed = vosvideo::mediafile::MediaFileManager::BuildIndex(entry.Path);
+			}
+			catch (std::exception& e)
+			{
+				LOG_WARNING("Failed to index " << StringUtil::ToString(entry.Path) << ": " << e.what());
+			}
+		}
+		if (isIndexed)
+		{
+			entry.IndexPath = indexPath;
+		}
+		else
+		{
+			// Players and exporter read index by recording name, stale one would point them to wrong offsets
+			remove(indexPath, ec);
+		}
+		catalogCache_->Put(entry);
+	}
+}
+
+bool MediaWatcher::GetFileStamp(const std::wstring& path, int64_t& fileSize, int64_t& lastWriteTime)
+{
+	boost::system::error_code ec;
+	fileSize = static_cast<int64_t>(file_size(path, ec));
+	if (ec)
+	{
+		return false;
+	}
+	lastWriteTime = static_cast<int64_t>(last_write_time(path, ec));
+	return !ec;
+}
+
+DiscoveryProgress MediaWatcher::GetDiscoveryProgress() const
+{
+	return discoveryPool_->GetProgress();
+}
+
+void MediaWatcher::CancelDiscovery()
+{
+	discoveryPool_->Cancel();
+}
+
+bool MediaWatcher::IsRecording(const boost::filesystem::path& path)
+{
+	wstring ext = path.extension().wstring();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::towlower);
+	return ext == L".webm" || ext == L".mp4";
+}
+
+void MediaWatcher::AddToCatalog(shared_ptr<VideoFile> videoFile, uint64_t fileSize)
+{
+	catalog_.Add(videoFile);
+	retention_.Add(videoFile, fileSize);
+	volumes_->OnRecordingAdded(videoFile->GetId(), fileSize, videoFile->Duration());
+}
+
+std::vector<std::shared_ptr<VideoFile>> MediaWatcher::GetThumbnailBacklog()
+{
+	if (backlogCameras_.empty())
+	{
+		backlogCameras_ = catalog_.GetCameras();
+		backlogCamera_ = 0;
+		backlogCursor_ = 0;
+	}
+
+	while (backlogCamera_ < backlogCameras_.size())
+	{
+		ArchiveCatalogPage page = catalog_.Query(backlogCameras_[backlogCamera_], 0, 0, backlogCursor_, thumbnailBacklogBatch_);
+		if (page.HasMore)
+		{
+			backlogCursor_ = page.NextCursor;
+			return page.Files;
+		}
+		++backlogCamera_;
+		backlogCursor_ = 0;
+		if (!page.Files.empty())
+		{
+			return page.Files;
+		}
+	}
+
+	// Walk is over, the next one starts from the beginning
+	backlogCameras_.clear();
+	return vector<shared_ptr<VideoFile>>();
+}
+
+void MediaWatcher::EnforceRetention()
+{
+	for (const auto& path : retention_.Enforce(RetentionManager::GetNow()))
+	{
+		// Notifier reports the removal too, it's ignored for files already out of catalog
+		OnArchiveRemoved(path);
 	}
 }
 
 void MediaWatcher::OnMessageReceived(std::shared_ptr<vosvideo::data::ReceivedData> receivedMessage)
 {
-	auto srvPeer = receivedMessage->GetToPeer();
-	auto clientPeer = receivedMessage->GetFromPeer();
+	auto catalogRequest = dynamic_pointer_cast<ArchiveCatalogRequestMsg>(receivedMessage);
+	if (catalogRequest)
+	{
+		Concurrency::create_task([this, catalogRequest]
+		{
+			AnswerCatalogRequest(catalogRequest);
+		});
+	}
+}
+
+std::vector<std::wstring> MediaWatcher::GetCameras() const
+{
+	return catalog_.GetCameras();
+}
+
+ArchiveCatalogPage MediaWatcher::GetCameraCatalog(const std::wstring& cameraName, uint64_t from, uint64_t to, uint64_t cursor, size_t limit) const
+{
+	return catalog_.Query(cameraName, from, to, cursor, limit);
+}
 
-	if(dynamic_pointer_cast<ArchiveCatalogRequestMsg>(receivedMessage))
+std::vector<std::shared_ptr<VideoFile>> MediaWatcher::GetRecordings(const std::wstring& cameraName, uint64_t from, uint64_t to) const
+{
+	vector<shared_ptr<VideoFile>> files;
+	ArchiveCatalogPage page;
+	uint64_t cursor = 0;
+	do
 	{
-		//receivedMessage->
+		page = catalog_.Query(cameraName, from, to, cursor, 100);
+		files.insert(files.end(), page.Files.begin(), page.Files.end());
+		cursor = page.NextCursor;
 	}
+	while (page.HasMore);
+	return files;
+}
+
+std::vector<MotionMatch> MediaWatcher::GetMotion(const std::wstring& cameraName, uint64_t from, uint64_t to, uint8_t minLevel)
+{
+	return motionIndex_.Query(GetRecordings(cameraName, from, to), from, to, minLevel);
 }
 
-void MediaWatcher::GetCatalog()
+void MediaWatcher::AnswerCatalogRequest(shared_ptr<ArchiveCatalogRequestMsg> request)
 {
+	const uint64_t msToNs = 1000000;
+	const uint64_t from = static_cast<uint64_t>(request->GetFrom()) * msToNs;
+	const uint64_t to = static_cast<uint64_t>(request->GetTo()) * msToNs;
 
+	uint64_t cursor = 0;
+	try
+	{
+		cursor = request->GetCursor().empty() ? 0 : std::stoull(request->GetCursor());
+	}
+	catch (std::exception&)
+	{
+		LOG_WARNING("Wrong catalog cursor " << StringUtil::ToString(request->GetCursor()));
+	}
+
+	uint32_t pageNum = 0;
+	ArchiveCatalogPage page;
+	do
+	{
+		page = catalog_.Query(request->GetCameraName(), from, to, cursor, request->GetPageSize());
+
+		web::json::value segments = web::json::value::array(page.Files.size());
+		for (size_t i = 0; i < page.Files.size(); ++i)
+		{
+			auto videoFile = page.Files[i];
+			web::json::value segment;
+			segment[L"file"] = web::json::value::string(boost::filesystem::path(videoFile->GetPath()).filename().wstring());
+			segment[L"start"] = web::json::value::number(static_cast<int64_t>(videoFile->StartTime() / msToNs));
+			segment[L"duration"] = web::json::value::number(static_cast<int64_t>(videoFile->Duration() / msToNs));
+			segment[L"seekable"] = web::json::value::boolean(videoFile->IsSeekable());
+			// Playback of the file overlapping range start begins inside it
+			int64_t offset = (videoFile->StartTime() < from) ? FindStartOffset(videoFile, from - videoFile->StartTime()) : 0;
+			segment[L"offset"] = web::json::value::number(offset);
+			segments[i] = segment;
+		}
+
+		const bool isLast = !page.HasMore || pageNum + 1 >= request->GetMaxPages();
+		wstring nextCursor = page.HasMore ? std::to_wstring(page.NextCursor) : L"";
+		shared_ptr<ArchiveCatalogAnswerMsg> answer(new ArchiveCatalogAnswerMsg(request->GetRequestId(), request->GetCameraName(),
+			pageNum, segments, nextCursor, isLast));
+
+		string respRtbc;
+		CommunicationManager::CreateWebsocketMessageString(request->GetToPeer(), request->GetFromPeer(), answer, respRtbc);
+		communicationManager_->WebsocketSend(respRtbc);
+
+		cursor = page.NextCursor;
+		++pageNum;
+	}
+	// Client continues with cursor when page limit is reached, it keeps send queue short
+	while (page.HasMore && pageNum < request->GetMaxPages());
 }
 
-void MediaWatcher::GetCameraCatalog(uint32_t cameraId)
+int64_t MediaWatcher::FindStartOffset(shared_ptr<VideoFile> videoFile, uint64_t time)
 {
+	wstring indexPath = vosvideo::mediafile::MediaSegmentIndex::GetIndexPath(videoFile->GetPath());
+	boost::system::error_code ec;
+	if (!exists(indexPath, ec))
+	{
+		return 0;
+	}
+
+	try
+	{
+		vosvideo::mediafile::MediaSegmentIndex index(indexPath);
+		auto entry = index.FindKeyFrame(static_cast<int64_t>(time));
+		return (entry != nullptr) ? entry->Offset : 0;
+	}
+	catch (std::exception&)
+	{
+		return 0;
+	}
 }
 
 void MediaWatcher::OnArchiveChanged(const wstring& path)
 {
-	AddToCatalog(videoDiscoverer_.Discover(path));
-	LOG_TRACE("Archive was changed, new file added " << path);
+	if (!IsRecording(path))
+	{
+		return;
+	}
+
+	AddDiscovered(videoDiscoverer_.Discover(path));
+	if (catalogCache_)
+	{
+		catalogCache_->Flush();
+	}
+	EnforceRetention();
+	LOG_TRACE("Archive was changed, new file added " << StringUtil::ToString(path));
+}
+
+void MediaWatcher::OnArchiveRemoved(const wstring& path)
+{
+	if (!IsRecording(path))
+	{
+		return;
+	}
+
+	retention_.Remove(path);
+	if (!catalog_.Remove(path))
+	{
+		return;
+	}
+	if (catalogCache_)
+	{
+		catalogCache_->Remove(path);
+		catalogCache_->Flush();
+	}
+
+	boost::system::error_code ec;
+	remove(vosvideo::mediafile::MediaSegmentIndex::GetIndexPath(path), ec);
+	remove(vosvideo::mediafile::MotionTrack::GetTrackPath(path), ec);
+	motionIndex_.Remove(path);
+	ThumbnailGenerator::Remove(path);
+	LOG_TRACE("Archive was changed, file removed " << StringUtil::ToString(path));
 }
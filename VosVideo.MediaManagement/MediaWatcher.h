@@ -1,7 +1,18 @@
 #pragma once
 #include "VosVideo.Configuration/ConfigurationManager.h"
 #include "VosVideo.Communication/PubSubService.h"
+#include "VosVideo.Communication/CommunicationManager.h"
+#include "VosVideo.Data/ArchiveCatalogRequestMsg.h"
+#include <mutex>
+#include <boost/filesystem/path.hpp>
 #include "VideoFileDiscoverer.h"
+#include "VideoFileDiscoveryPool.h"
+#include "CatalogCache.h"
+#include "ArchiveCatalog.h"
+#include "RetentionManager.h"
+#include "ArchiveVolumes.h"
+#include "MotionIndex.h"
+#include "ThumbnailGenerator.h"
 #include "ChangesNotifier.h"
 
 namespace vosvideo
@@ -11,28 +22,65 @@ namespace vosvideo
 		class MediaWatcher : public vosvideo::communication::MessageReceiver
 		{
 		public:
-			// Proposed structure: <camera_name <beginning_time, VideoFile>>
-			typedef std::unordered_map<std::wstring, std::map<uint64_t, std::shared_ptr<VideoFile>> > VideoCatalogMap;
-			typedef std::map<uint64_t, std::shared_ptr<VideoFile>> VideoEntriesMap;
-
 			MediaWatcher(std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager,
-				std::shared_ptr<vosvideo::communication::PubSubService> pubsubService);
+				std::shared_ptr<vosvideo::communication::PubSubService> pubsubService,
+				std::shared_ptr<vosvideo::communication::CommunicationManager> communicationManager,
+				std::shared_ptr<ArchiveVolumes> volumes);
 			virtual ~MediaWatcher();
-			virtual void GetCatalog();
-			virtual void GetCameraCatalog(uint32_t cameraId);
+			// Names of cameras having recordings
+			virtual std::vector<std::wstring> GetCameras() const;
+			// Times are nanoseconds from Unix epoch, see ArchiveCatalog::Query
+			virtual ArchiveCatalogPage GetCameraCatalog(const std::wstring& cameraName, uint64_t from, uint64_t to, uint64_t cursor, size_t limit) const;
+			// All recordings overlapping range, used for clip export
+			std::vector<std::shared_ptr<VideoFile>> GetRecordings(const std::wstring& cameraName, uint64_t from, uint64_t to) const;
+			// Motion events of camera overlapping range with level not below minLevel percent
+			std::vector<MotionMatch> GetMotion(const std::wstring& cameraName, uint64_t from, uint64_t to, uint8_t minLevel);
 			virtual void OnMessageReceived(std::shared_ptr<vosvideo::data::ReceivedData> receivedMessage);
 
+			DiscoveryProgress GetDiscoveryProgress() const;
+			void CancelDiscovery();
+
 		protected:
 			void OnArchiveChanged(const std::wstring& path);
-			pplx::task<void> ReadVideoCatalogAsync(const std::wstring& path);
-			void AddToCatalog(std::shared_ptr<VideoFile> vf);
+			void OnArchiveRemoved(const std::wstring& path);
+			// Scans every archive root
+			pplx::task<void> ReadVideoCatalogAsync(const std::vector<std::wstring>& roots);
+			void AddToCatalog(std::shared_ptr<VideoFile> vf, uint64_t fileSize);
+			// Removes oldest recordings if archive is over quota
+			void EnforceRetention();
+			// Adds freshly discovered file to catalog and its persistent cache
+			void AddDiscovered(std::shared_ptr<VideoFile> vf);
+			// Next recordings of catalog walk for thumbnail generator, see ThumbnailGenerator::BacklogSource
+			std::vector<std::shared_ptr<VideoFile>> GetThumbnailBacklog();
+			static bool IsRecording(const boost::filesystem::path& path);
+			static bool GetFileStamp(const std::wstring& path, int64_t& fileSize, int64_t& lastWriteTime);
+			// Sends answer pages, every page is separate message so big range never becomes one huge JSON
+			void AnswerCatalogRequest(std::shared_ptr<vosvideo::data::ArchiveCatalogRequestMsg> request);
+			// Byte offset of key frame preceding given time inside recording, 0 if recording has no index
+			static int64_t FindStartOffset(std::shared_ptr<VideoFile> videoFile, uint64_t time);
 
-			VideoCatalogMap videoCatalog_;
+			std::shared_ptr<ArchiveVolumes> volumes_;
+			ArchiveCatalog catalog_;
+			MotionIndex motionIndex_;
+			RetentionManager retention_;
+			std::unique_ptr<ThumbnailGenerator> thumbnailGenerator_;
+			// Position of thumbnail backlog walk, only generator thread touches it
+			std::vector<std::wstring> backlogCameras_;
+			size_t backlogCamera_ = 0;
+			uint64_t backlogCursor_ = 0;
 
 			VideoFileDiscoverer videoDiscoverer_;
+			std::unique_ptr<VideoFileDiscoveryPool> discoveryPool_;
+			std::unique_ptr<CatalogCache> catalogCache_;
+			pplx::task<void> catalogTask_;
 			std::shared_ptr<vosvideo::communication::PubSubService> pubSubService_;
 			std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager_;
+			std::shared_ptr<vosvideo::communication::CommunicationManager> communicationManager_;
 			std::shared_ptr<vosvideo::archive::ChangesNotifier> changesNotifier_;
+
+			static const uint32_t maxDiscoveryWorkers_ = 8;
+			static const size_t thumbnailBacklogBatch_ = 32;
+			static const std::wstring catalogCacheName_;
 		};
 	}
 }
@@ -0,0 +1,97 @@
+#include "stdafx.h"
+#include <boost/filesystem.hpp>
+#include "VosVideo.MediaFile/MediaFileException.h"
+#include "MotionIndex.h"
+
+using namespace std;
+using namespace vosvideo::archive;
+using namespace vosvideo::mediafile;
+
+MotionIndex::MotionIndex()
+{
+}
+
+MotionIndex::~MotionIndex()
+{
+}
+
+std::vector<MotionMatch> MotionIndex::Query(const std::vector<std::shared_ptr<VideoFile>>& recordings, uint64_t from, uint64_t to, uint8_t minLevel)
+{
+	vector<MotionMatch> matches;
+	for (const auto& recording : recordings)
+	{
+		auto events = GetEvents(recording->GetPath());
+		if (!events)
+		{
+			continue;
+		}
+
+		for (const auto& event : *events)
+		{
+			if (static_cast<uint64_t>(event.End) < from || static_cast<uint64_t>(event.Start) >= to || event.Level < minLevel)
+			{
+				continue;
+			}
+			MotionMatch match = { recording, event };
+			matches.push_back(match);
+		}
+	}
+	return matches;
+}
+
+void MotionIndex::Remove(const std::wstring& recordingPath)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto position = trackPositions_.find(recordingPath);
+	if (position != trackPositions_.end())
+	{
+		tracks_.erase(position->second);
+		trackPositions_.erase(position);
+	}
+}
+
+MotionIndex::MotionEvents MotionIndex::GetEvents(const std::wstring& recordingPath)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto position = trackPositions_.find(recordingPath);
+		if (position != trackPositions_.end())
+		{
+			tracks_.splice(tracks_.begin(), tracks_, position->second);
+			return tracks_.front().second;
+		}
+	}
+
+	wstring trackPath = MotionTrack::GetTrackPath(recordingPath);
+	boost::system::error_code ec;
+	if (!boost::filesystem::exists(trackPath, ec))
+	{
+		return nullptr;
+	}
+
+	MotionEvents events;
+	try
+	{
+		events = make_shared<const vector<MotionEvent>>(MotionTrack::Read(trackPath));
+	}
+	catch (MediaFileException&)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	// Concurrent query could read the track meanwhile
+	auto position = trackPositions_.find(recordingPath);
+	if (position != trackPositions_.end())
+	{
+		tracks_.erase(position->second);
+	}
+	tracks_.emplace_front(recordingPath, events);
+	trackPositions_[recordingPath] = tracks_.begin();
+	if (tracks_.size() > maxTracks_)
+	{
+		trackPositions_.erase(tracks_.back().first);
+		tracks_.pop_back();
+	}
+	return events;
+}
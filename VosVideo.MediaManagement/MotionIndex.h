@@ -0,0 +1,49 @@
+#pragma once
+#include <mutex>
+#include <list>
+#include "VosVideo.MediaFile/MotionTrack.h"
+#include "VideoFile.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		struct MotionMatch
+		{
+			std::shared_ptr<VideoFile> Recording;
+			vosvideo::mediafile::MotionEvent Event;
+		};
+
+		// Motion events of archive recordings. Tracks are read on first query of their recording and the most recently
+		// queried ones are kept, so searching a night of recordings reads a few small files once and never decodes video.
+		// Recording without track yet is checked again on next query, its track is written right after it's closed.
+		// Event times are deviceworker wall clock taken when frame is analyzed, while recording times of catalog come
+		// from file modification time and length. They are matched as is, so event may be off from recording timeline
+		// by encoder and muxer latency plus clock drift between file system and deviceworker, usually under a second.
+		class MotionIndex final
+		{
+		public:
+			MotionIndex();
+			~MotionIndex();
+
+			// Events overlapping [from, to) with level not below minLevel, in recordings order.
+			// Times are nanoseconds from Unix epoch, recordings come from catalog.
+			std::vector<MotionMatch> Query(const std::vector<std::shared_ptr<VideoFile>>& recordings, uint64_t from, uint64_t to, uint8_t minLevel);
+			void Remove(const std::wstring& recordingPath);
+
+		private:
+			typedef std::shared_ptr<const std::vector<vosvideo::mediafile::MotionEvent>> MotionEvents;
+
+			// nullptr if recording has no readable track
+			MotionEvents GetEvents(const std::wstring& recordingPath);
+
+			std::mutex mutex_;
+			// Most recently used first
+			std::list<std::pair<std::wstring, MotionEvents>> tracks_;
+			std::unordered_map<std::wstring, std::list<std::pair<std::wstring, MotionEvents>>::iterator> trackPositions_;
+
+			// Day of one minute recordings of a few cameras, track of a recording is a few KB
+			static const size_t maxTracks_ = 8192;
+		};
+	}
+}
@@ -0,0 +1,295 @@
+#include "stdafx.h"
+#include <chrono>
+#include <boost/filesystem.hpp>
+#include "RetentionManager.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::archive;
+using namespace vosvideo::configuration;
+
+RetentionManager::RetentionManager(std::shared_ptr<ConfigurationManager> configManager, std::shared_ptr<ArchiveVolumes> volumes) :
+	configManager_(configManager),
+	volumes_(volumes),
+	quota_(configManager->GetArchiveQuota())
+{
+}
+
+RetentionManager::~RetentionManager()
+{
+}
+
+void RetentionManager::Add(std::shared_ptr<VideoFile> videoFile, uint64_t fileSize)
+{
+	if (!videoFile->IsValid())
+	{
+		return;
+	}
+
+	const wstring path = videoFile->GetPath();
+	const uint64_t startTime = videoFile->StartTime();
+	RetentionEntry entry = { path, volumes_->FindRoot(path), fileSize, startTime + videoFile->Duration() };
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	RemoveEntry(path);
+	AddEntry(videoFile->GetId(), startTime, entry);
+}
+
+void RetentionManager::AddEntry(const std::wstring& cameraName, uint64_t startTime, const RetentionEntry& entry)
+{
+	auto camera = cameras_.find(cameraName);
+	if (camera == cameras_.end())
+	{
+		camera = cameras_.insert(make_pair(cameraName, CameraFiles())).first;
+		camera->second.MinRetention = configManager_->GetRetentionMinimum(cameraName);
+	}
+
+	auto& files = camera->second.Files;
+	auto replaced = files.find(startTime);
+	if (replaced != files.end())
+	{
+		LOG_WARNING("Recordings " << StringUtil::ToString(replaced->second.Path) << " and " << StringUtil::ToString(entry.Path) <<
+			" have the same start time, retention keeps the latter only");
+		RemoveEntry(wstring(replaced->second.Path));
+	}
+
+	auto file = files.insert(make_pair(startTime, entry)).first;
+	camera->second.Size += entry.Size;
+	totalSize_ += entry.Size;
+	paths_[entry.Path] = make_pair(cameraName, startTime);
+
+	// The newest file of camera may be still recorded, it's evicted once a newer one appears
+	if (std::next(file) != files.end())
+	{
+		AddToEvictionOrder(cameraName, camera->second, file->second, file->first);
+	}
+	else if (file != files.begin())
+	{
+		auto previous = std::prev(file);
+		AddToEvictionOrder(cameraName, camera->second, previous->second, previous->first);
+	}
+}
+
+void RetentionManager::Remove(const std::wstring& path)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	RemoveEntry(path);
+}
+
+uint64_t RetentionManager::GetTotalSize() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return totalSize_;
+}
+
+void RetentionManager::RemoveEntry(const std::wstring& path)
+{
+	auto pathEntry = paths_.find(path);
+	if (pathEntry == paths_.end())
+	{
+		return;
+	}
+
+	auto camera = cameras_.find(pathEntry->second.first);
+	if (camera != cameras_.end())
+	{
+		auto& files = camera->second.Files;
+		auto file = files.find(pathEntry->second.second);
+		if (file != files.end())
+		{
+			if (std::next(file) != files.end())
+			{
+				RemoveFromEvictionOrder(camera->first, camera->second, file->second, file->first);
+			}
+			else if (file != files.begin())
+			{
+				// Previous file becomes the newest one
+				auto previous = std::prev(file);
+				RemoveFromEvictionOrder(camera->first, camera->second, previous->second, previous->first);
+			}
+			camera->second.Size -= file->second.Size;
+			totalSize_ -= file->second.Size;
+			files.erase(file);
+		}
+	}
+	paths_.erase(pathEntry);
+}
+
+void RetentionManager::AddToEvictionOrder(const std::wstring& cameraName, const CameraFiles& camera, const RetentionEntry& entry, uint64_t startTime)
+{
+	EvictionKey key(startTime, cameraName);
+	for (const auto& root : { wstring(), entry.Root })
+	{
+		auto& order = evictionOrders_[root];
+		if (camera.MinRetention > 0)
+		{
+			order.Retained.insert(make_pair(entry.EndTime + camera.MinRetention, key));
+		}
+		else
+		{
+			order.Evictable.insert(key);
+		}
+		if (entry.Root.empty())
+		{
+			break;
+		}
+	}
+}
+
+void RetentionManager::RemoveFromEvictionOrder(const std::wstring& cameraName, const CameraFiles& camera, const RetentionEntry& entry, uint64_t startTime)
+{
+	EvictionKey key(startTime, cameraName);
+	for (const auto& root : { wstring(), entry.Root })
+	{
+		auto order = evictionOrders_.find(root);
+		if (order != evictionOrders_.end() && order->second.Evictable.erase(key) == 0)
+		{
+			auto retained = order->second.Retained.equal_range(entry.EndTime + camera.MinRetention);
+			for (auto iter = retained.first; iter != retained.second; ++iter)
+			{
+				if (iter->second == key)
+				{
+					order->second.Retained.erase(iter);
+					break;
+				}
+			}
+		}
+		if (entry.Root.empty())
+		{
+			break;
+		}
+	}
+}
+
+std::vector<std::wstring> RetentionManager::Enforce(uint64_t now)
+{
+	vector<EvictedFile> evictedEntries;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		uint64_t overQuota = GetBytesOverQuota();
+		if (overQuota > 0)
+		{
+			Evict(now, L"", overQuota, evictedEntries);
+		}
+	}
+
+	for (const auto& root : volumes_->GetRoots())
+	{
+		uint64_t deficit = volumes_->GetSpaceDeficit(root);
+		// Files evicted for quota are not deleted yet, their space still counts as used
+		for (const auto& evictedFile : evictedEntries)
+		{
+			if (evictedFile.Entry.Root == root)
+			{
+				deficit -= std::min(deficit, evictedFile.Entry.Size);
+			}
+		}
+		if (deficit == 0)
+		{
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		Evict(now, root, deficit, evictedEntries);
+	}
+
+	// Files are deleted outside the lock, catalog may be queried meanwhile
+	vector<wstring> removed;
+	vector<EvictedFile> failed;
+	for (const auto& evictedFile : evictedEntries)
+	{
+		const wstring& path = evictedFile.Entry.Path;
+		boost::system::error_code ec;
+		boost::filesystem::remove(path, ec);
+		if (ec)
+		{
+			// E.g. recording is being played back, it's still on disk and is evicted first next time
+			LOG_WARNING("Failed to remove " << StringUtil::ToString(path) << ": " << ec.message());
+			failed.push_back(evictedFile);
+		}
+		else
+		{
+			LOG_TRACE("Retention removed " << StringUtil::ToString(path));
+			removed.push_back(path);
+		}
+	}
+
+	if (!failed.empty())
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& evictedFile : failed)
+		{
+			// Watcher may have added it again meanwhile
+			if (paths_.find(evictedFile.Entry.Path) == paths_.end())
+			{
+				AddEntry(evictedFile.Key.second, evictedFile.Key.first, evictedFile.Entry);
+			}
+		}
+	}
+	return removed;
+}
+
+void RetentionManager::Evict(uint64_t now, const std::wstring& root, uint64_t toFree, std::vector<EvictedFile>& evicted)
+{
+	while (toFree > 0)
+	{
+		EvictedFile file;
+		if (!FindEvictionCandidate(now, root, file))
+		{
+			if (root.empty())
+			{
+				LOG_WARNING("Archive is over quota by " << toFree << " bytes, but remaining recordings are within minimum retention");
+			}
+			else
+			{
+				LOG_WARNING("Archive root " << StringUtil::ToString(root) << " lacks " << toFree << " bytes of reserved space, but remaining recordings are within minimum retention");
+			}
+			break;
+		}
+
+		toFree -= std::min(toFree, file.Entry.Size);
+		evicted.push_back(file);
+		RemoveEntry(file.Entry.Path);
+	}
+}
+
+bool RetentionManager::FindEvictionCandidate(uint64_t now, const std::wstring& root, EvictedFile& candidate)
+{
+	auto order = evictionOrders_.find(root);
+	if (order == evictionOrders_.end())
+	{
+		return false;
+	}
+
+	auto& retained = order->second.Retained;
+	while (!retained.empty() && retained.begin()->first <= now)
+	{
+		order->second.Evictable.insert(retained.begin()->second);
+		retained.erase(retained.begin());
+	}
+
+	auto& evictable = order->second.Evictable;
+	if (evictable.empty())
+	{
+		return false;
+	}
+
+	candidate.Key = *evictable.begin();
+	candidate.Entry = cameras_[candidate.Key.second].Files[candidate.Key.first];
+	return true;
+}
+
+uint64_t RetentionManager::GetBytesOverQuota()
+{
+	if (quota_ > 0 && totalSize_ > quota_)
+	{
+		return totalSize_ - quota_;
+	}
+	return 0;
+}
+
+uint64_t RetentionManager::GetNow()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count());
+}
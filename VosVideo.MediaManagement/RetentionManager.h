@@ -0,0 +1,96 @@
+#pragma once
+#include <mutex>
+#include <set>
+#include "VosVideo.Configuration/ConfigurationManager.h"
+#include "VideoFile.h"
+#include "ArchiveVolumes.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		// Keeps archive within disk quota across all cameras. Oldest recordings are removed first
+		// whatever camera they belong to, so cameras with high bitrate don't fill the disk at the cost of others.
+		// Camera may have minimum retention: its recordings younger than that are kept even if quota is exceeded.
+		// Reserved disk space is kept on every archive root, by removing oldest recordings of that root.
+		// Files are tracked per camera in start time order. Eviction order of all files but the newest of each camera
+		// is kept per root and for the whole archive, so next file to evict is the head of one set and archive
+		// directory is never scanned.
+		class RetentionManager final
+		{
+		public:
+			RetentionManager(std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager,
+				std::shared_ptr<ArchiveVolumes> volumes);
+			~RetentionManager();
+
+			// Replaces previous entry of the same file
+			void Add(std::shared_ptr<VideoFile> videoFile, uint64_t fileSize);
+			void Remove(const std::wstring& path);
+			uint64_t GetTotalSize() const;
+
+			// Removes oldest recordings until archive fits quota and reserved disk space, returns removed paths.
+			// Recording which can't be deleted stays tracked and is tried again by the next call.
+			// Time is nanoseconds from Unix epoch.
+			std::vector<std::wstring> Enforce(uint64_t now);
+			static uint64_t GetNow();
+
+		private:
+			struct RetentionEntry
+			{
+				std::wstring Path;
+				std::wstring Root;
+				uint64_t Size;
+				uint64_t EndTime;
+			};
+
+			struct CameraFiles
+			{
+				// <start_time, file>
+				std::map<uint64_t, RetentionEntry> Files;
+				uint64_t Size = 0;
+				uint64_t MinRetention = 0;
+			};
+
+			// <start_time, camera>
+			typedef std::pair<uint64_t, std::wstring> EvictionKey;
+
+			struct EvictedFile
+			{
+				EvictionKey Key;
+				RetentionEntry Entry;
+			};
+
+			struct EvictionOrder
+			{
+				// Files which can be removed now
+				std::set<EvictionKey> Evictable;
+				// Files kept by minimum retention, <time they can be removed at, file>
+				std::multimap<uint64_t, EvictionKey> Retained;
+			};
+
+			// Must be called under mutex_
+			void AddEntry(const std::wstring& cameraName, uint64_t startTime, const RetentionEntry& entry);
+			void RemoveEntry(const std::wstring& path);
+			void AddToEvictionOrder(const std::wstring& cameraName, const CameraFiles& camera, const RetentionEntry& entry, uint64_t startTime);
+			void RemoveFromEvictionOrder(const std::wstring& cameraName, const CameraFiles& camera, const RetentionEntry& entry, uint64_t startTime);
+			// Oldest file on root which can be removed, false if none. Empty root matches any root.
+			// Time only grows, files whose minimum retention passed stay evictable.
+			bool FindEvictionCandidate(uint64_t now, const std::wstring& root, EvictedFile& candidate);
+			// Evicts oldest files on root until toFree bytes are released
+			void Evict(uint64_t now, const std::wstring& root, uint64_t toFree, std::vector<EvictedFile>& evicted);
+			uint64_t GetBytesOverQuota();
+
+			std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager_;
+			std::shared_ptr<ArchiveVolumes> volumes_;
+			uint64_t quota_;
+
+			mutable std::mutex mutex_;
+			std::unordered_map<std::wstring, CameraFiles> cameras_;
+			// path -> <camera, start time>
+			std::unordered_map<std::wstring, std::pair<std::wstring, uint64_t>> paths_;
+			// root -> eviction order of its files, empty root holds files of all roots
+			std::unordered_map<std::wstring, EvictionOrder> evictionOrders_;
+			uint64_t totalSize_ = 0;
+		};
+	}
+}
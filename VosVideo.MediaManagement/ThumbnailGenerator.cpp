@@ -0,0 +1,661 @@
+#include "stdafx.h"
+#include <chrono>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include <cpprest/json.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "ThumbnailGenerator.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::archive;
+
+const double ThumbnailGenerator::cpuBudget_ = 0.25;
+
+namespace
+{
+	// Key frame filter state, lives on generator thread stack while pipeline runs
+	struct KeyFrameFilter
+	{
+		GstElement* Decoder;
+		GstElement* Converter;
+		GstClockTime NextTime;
+		bool IsLinked;
+	};
+
+	// CPU time used by threads of one pipeline since they joined it.
+	// Streaming threads join from their stream status message, they may come from a pool and be reused.
+	class PipelineCpuTime final
+	{
+	public:
+		~PipelineCpuTime()
+		{
+#ifdef _WIN32
+			for (const auto& thread : threads_)
+			{
+				CloseHandle(thread.Handle);
+			}
+#endif
+		}
+
+		// Called on the joining thread
+		void AddCurrentThread()
+		{
+			PipelineThread thread;
+#ifdef _WIN32
+			thread.Id = GetCurrentThreadId();
+			if (!DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread.Handle,
+				THREAD_QUERY_LIMITED_INFORMATION, FALSE, 0))
+			{
+				return;
+			}
+#else
+			thread.Id = pthread_self();
+			if (pthread_getcpuclockid(thread.Id, &thread.Clock) != 0)
+			{
+				return;
+			}
+#endif
+			GetCpuTime(thread, thread.Joined);
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (const auto& joined : threads_)
+			{
+				if (joined.Id == thread.Id)
+				{
+#ifdef _WIN32
+					CloseHandle(thread.Handle);
+#endif
+					return;
+				}
+			}
+			threads_.push_back(thread);
+		}
+
+		std::chrono::nanoseconds Get()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::chrono::nanoseconds total(0);
+			for (const auto& thread : threads_)
+			{
+				std::chrono::nanoseconds cpuTime;
+				if (GetCpuTime(thread, cpuTime) && cpuTime > thread.Joined)
+				{
+					total += cpuTime - thread.Joined;
+				}
+			}
+			return total;
+		}
+
+	private:
+		struct PipelineThread
+		{
+#ifdef _WIN32
+			DWORD Id;
+			HANDLE Handle;
+#else
+			pthread_t Id;
+			clockid_t Clock;
+#endif
+			std::chrono::nanoseconds Joined;
+		};
+
+		static bool GetCpuTime(const PipelineThread& thread, std::chrono::nanoseconds& cpuTime)
+		{
+			cpuTime = std::chrono::nanoseconds(0);
+#ifdef _WIN32
+			// Times of ended thread stay available through its handle
+			FILETIME creation, exit, kernel, user;
+			if (!GetThreadTimes(thread.Handle, &creation, &exit, &kernel, &user))
+			{
+				return false;
+			}
+			auto toTicks = [](const FILETIME& time)
+			{
+				return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+			};
+			// FILETIME ticks are 100 ns
+			cpuTime = std::chrono::nanoseconds((toTicks(kernel) + toTicks(user)) * 100);
+#else
+			// Clock of ended thread is gone, the little it used after last read isn't counted
+			timespec ts;
+			if (clock_gettime(thread.Clock, &ts) != 0)
+			{
+				return false;
+			}
+			cpuTime = std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+			return true;
+		}
+
+		std::mutex mutex_;
+		std::vector<PipelineThread> threads_;
+	};
+}
+
+ThumbnailGenerator::ThumbnailGenerator(BacklogSource backlogSource) : backlogSource_(backlogSource)
+{
+	workThr_ = std::thread([this]
+	{
+		LowerThreadPriority();
+		WorkLoop();
+	});
+}
+
+ThumbnailGenerator::~ThumbnailGenerator()
+{
+	Stop();
+}
+
+void ThumbnailGenerator::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		isStopped_ = true;
+		queue_.clear();
+	}
+	queueCond_.notify_all();
+	if (workThr_.joinable())
+	{
+		workThr_.join();
+	}
+}
+
+void ThumbnailGenerator::Enqueue(std::shared_ptr<VideoFile> videoFile, int64_t recordingTime)
+{
+	if (IsUpToDate(videoFile->GetPath(), recordingTime))
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (isStopped_)
+		{
+			return;
+		}
+		for (const auto& queued : queue_)
+		{
+			if (queued->GetPath() == videoFile->GetPath())
+			{
+				return;
+			}
+		}
+		if (queue_.size() >= maxQueued_)
+		{
+			isBacklogRequested_ = true;
+			return;
+		}
+		queue_.push_back(videoFile);
+	}
+	queueCond_.notify_one();
+}
+
+void ThumbnailGenerator::RequestBacklog()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		isBacklogRequested_ = true;
+	}
+	queueCond_.notify_one();
+}
+
+std::wstring ThumbnailGenerator::GetSpritePath(const std::wstring& recordingPath)
+{
+	return recordingPath + L".thumbs.jpg";
+}
+
+std::wstring ThumbnailGenerator::GetSidecarPath(const std::wstring& recordingPath)
+{
+	return recordingPath + L".thumbs.json";
+}
+
+void ThumbnailGenerator::Remove(const std::wstring& recordingPath)
+{
+	boost::system::error_code ec;
+	boost::filesystem::remove(GetSpritePath(recordingPath), ec);
+	boost::filesystem::remove(GetSidecarPath(recordingPath), ec);
+}
+
+void ThumbnailGenerator::WorkLoop()
+{
+	for (;;)
+	{
+		bool isBacklog = false;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			queueCond_.wait(lock, [this] { return isStopped_ || !queue_.empty() || isBacklogRequested_; });
+			if (isStopped_)
+			{
+				return;
+			}
+			if (queue_.empty())
+			{
+				// Recordings dropped meanwhile request another walk
+				isBacklogRequested_ = false;
+				isBacklog = true;
+			}
+		}
+
+		if (isBacklog)
+		{
+			WalkBacklog();
+		}
+		else
+		{
+			GenerateQueued();
+		}
+	}
+}
+
+void ThumbnailGenerator::GenerateQueued()
+{
+	for (;;)
+	{
+		shared_ptr<VideoFile> videoFile;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (isStopped_ || queue_.empty())
+			{
+				return;
+			}
+			videoFile = queue_.front();
+			queue_.pop_front();
+		}
+
+		auto started = std::chrono::steady_clock::now();
+		if (Generate(videoFile))
+		{
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+			LOG_TRACE("Thumbnails of " << StringUtil::ToString(videoFile->GetPath()) << " made in " << elapsed.count() << " ms");
+		}
+	}
+}
+
+void ThumbnailGenerator::WalkBacklog()
+{
+	size_t generated = 0;
+	for (;;)
+	{
+		auto batch = backlogSource_();
+		if (batch.empty())
+		{
+			break;
+		}
+
+		for (const auto& videoFile : batch)
+		{
+			// New recordings don't wait for the walk
+			GenerateQueued();
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (isStopped_)
+				{
+					return;
+				}
+			}
+
+			boost::system::error_code ec;
+			time_t recordingTime = boost::filesystem::last_write_time(videoFile->GetPath(), ec);
+			if (!ec && !IsUpToDate(videoFile->GetPath(), static_cast<int64_t>(recordingTime)) && Generate(videoFile))
+			{
+				++generated;
+			}
+		}
+	}
+	LOG_TRACE("Thumbnail backlog walked, " << generated << " sprites made");
+}
+
+bool ThumbnailGenerator::Generate(std::shared_ptr<VideoFile> videoFile)
+{
+	vector<Thumbnail> thumbnails;
+	if (!DecodeKeyFrames(videoFile->GetPath(), thumbnails) || thumbnails.empty())
+	{
+		return false;
+	}
+
+	// Sidecar is written last, its presence means sprite is complete
+	return WriteSprite(GetSpritePath(videoFile->GetPath()), thumbnails) && WriteSidecar(videoFile, thumbnails);
+}
+
+bool ThumbnailGenerator::DecodeKeyFrames(const std::wstring& recordingPath, std::vector<Thumbnail>& thumbnails)
+{
+	GstElement* pipeline = gst_pipeline_new("thumbnails");
+	GstElement* source = gst_element_factory_make("filesrc", nullptr);
+	GstElement* parser = gst_element_factory_make("parsebin", nullptr);
+	GstElement* decoder = gst_element_factory_make("decodebin", nullptr);
+	GstElement* converter = gst_element_factory_make("videoconvert", nullptr);
+	GstElement* scaler = gst_element_factory_make("videoscale", nullptr);
+	GstElement* capsFilter = gst_element_factory_make("capsfilter", nullptr);
+	GstElement* sink = gst_element_factory_make("appsink", nullptr);
+	if (!pipeline || !source || !parser || !decoder || !converter || !scaler || !capsFilter || !sink)
+	{
+		LOG_ERROR("Unable to create thumbnail elements");
+		for (GstElement* element : { pipeline, source, parser, decoder, converter, scaler, capsFilter, sink })
+		{
+			if (element)
+			{
+				gst_object_unref(element);
+			}
+		}
+		return false;
+	}
+
+	g_object_set(source, "location", StringUtil::ToString(recordingPath).c_str(), nullptr);
+	GstCaps* caps = gst_caps_new_simple("video/x-raw",
+		"format", G_TYPE_STRING, "RGB",
+		"width", G_TYPE_INT, thumbWidth_,
+		"height", G_TYPE_INT, thumbHeight_,
+		"pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+		nullptr);
+	g_object_set(capsFilter, "caps", caps, nullptr);
+	gst_caps_unref(caps);
+	// One frame at a time, decoder waits while generator sleeps for CPU budget
+	g_object_set(sink, "sync", FALSE, "emit-signals", FALSE, "max-buffers", 1, nullptr);
+
+	gst_bin_add_many(GST_BIN(pipeline), source, parser, decoder, converter, scaler, capsFilter, sink, nullptr);
+	gst_element_link(source, parser);
+	gst_element_link_many(converter, scaler, capsFilter, sink, nullptr);
+
+	KeyFrameFilter filter = { decoder, converter, 0, false };
+	g_signal_connect(parser, "pad-added", G_CALLBACK(CbParsedPadAdded), &filter);
+	g_signal_connect(decoder, "pad-added", G_CALLBACK(CbDecodedPadAdded), &filter);
+
+	// Decoding happens on streaming threads, generator thread only copies thumbnails
+	PipelineCpuTime cpuTime;
+	cpuTime.AddCurrentThread();
+	GstBus* bus = gst_element_get_bus(pipeline);
+	gst_bus_set_sync_handler(bus, CbStreamStatus, &cpuTime, nullptr);
+
+	bool isOk = gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE;
+	const size_t stride = GST_ROUND_UP_4(thumbWidth_ * 3);
+	std::chrono::nanoseconds cpuUsed(0);
+
+	while (isOk)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (isStopped_)
+			{
+				isOk = false;
+				break;
+			}
+		}
+
+		GstSample* sample = nullptr;
+		g_signal_emit_by_name(sink, "try-pull-sample", 100 * GST_MSECOND, &sample);
+		if (sample)
+		{
+			GstBuffer* buffer = gst_sample_get_buffer(sample);
+			GstMapInfo info;
+			if (buffer && gst_buffer_map(buffer, &info, GST_MAP_READ))
+			{
+				if (info.size >= stride * thumbHeight_)
+				{
+					Thumbnail thumbnail;
+					thumbnail.Time = GST_BUFFER_PTS(buffer);
+					thumbnail.Pixels.resize(thumbWidth_ * 3 * thumbHeight_);
+					for (int row = 0; row < thumbHeight_; ++row)
+					{
+						memcpy(&thumbnail.Pixels[row * thumbWidth_ * 3], info.data + row * stride, thumbWidth_ * 3);
+					}
+					thumbnails.push_back(std::move(thumbnail));
+				}
+				gst_buffer_unmap(buffer, &info);
+			}
+			gst_sample_unref(sample);
+
+			auto cpuNow = cpuTime.Get();
+			Throttle(cpuNow - cpuUsed);
+			cpuUsed = cpuNow;
+			continue;
+		}
+
+		gboolean isEos = FALSE;
+		g_object_get(sink, "eos", &isEos, nullptr);
+		if (isEos)
+		{
+			break;
+		}
+
+		GstMessage* msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+		if (msg)
+		{
+			GError* err = nullptr;
+			gst_message_parse_error(msg, &err, nullptr);
+			LOG_WARNING("Thumbnails of " << StringUtil::ToString(recordingPath) << " failed: " << (err ? err->message : "unknown"));
+			g_clear_error(&err);
+			gst_message_unref(msg);
+			isOk = false;
+		}
+	}
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
+	gst_object_unref(bus);
+	gst_object_unref(pipeline);
+	return isOk;
+}
+
+bool ThumbnailGenerator::WriteSprite(const std::wstring& spritePath, const std::vector<Thumbnail>& thumbnails)
+{
+	const int columns = std::min<int>(spriteColumns_, static_cast<int>(thumbnails.size()));
+	const int rows = static_cast<int>((thumbnails.size() + spriteColumns_ - 1) / spriteColumns_);
+	const int width = columns * thumbWidth_;
+	const int height = rows * thumbHeight_;
+	const size_t stride = GST_ROUND_UP_4(width * 3);
+
+	GstBuffer* buffer = gst_buffer_new_allocate(nullptr, stride * height, nullptr);
+	GstMapInfo info;
+	gst_buffer_map(buffer, &info, GST_MAP_WRITE);
+	memset(info.data, 0, info.size);
+	for (size_t i = 0; i < thumbnails.size(); ++i)
+	{
+		const size_t x = (i % spriteColumns_) * thumbWidth_;
+		const size_t y = (i / spriteColumns_) * thumbHeight_;
+		for (int row = 0; row < thumbHeight_; ++row)
+		{
+			memcpy(info.data + (y + row) * stride + x * 3, &thumbnails[i].Pixels[row * thumbWidth_ * 3], thumbWidth_ * 3);
+		}
+	}
+	gst_buffer_unmap(buffer, &info);
+
+	GstElement* pipeline = gst_pipeline_new("sprite");
+	GstElement* source = gst_element_factory_make("appsrc", nullptr);
+	GstElement* encoder = gst_element_factory_make("jpegenc", nullptr);
+	GstElement* sink = gst_element_factory_make("filesink", nullptr);
+	if (!pipeline || !source || !encoder || !sink)
+	{
+		LOG_ERROR("Unable to create sprite elements");
+		for (GstElement* element : { pipeline, source, encoder, sink })
+		{
+			if (element)
+			{
+				gst_object_unref(element);
+			}
+		}
+		gst_buffer_unref(buffer);
+		return false;
+	}
+
+	const wstring tmpPath = spritePath + L".tmp";
+	GstCaps* caps = gst_caps_new_simple("video/x-raw",
+		"format", G_TYPE_STRING, "RGB",
+		"width", G_TYPE_INT, width,
+		"height", G_TYPE_INT, height,
+		"framerate", GST_TYPE_FRACTION, 0, 1,
+		nullptr);
+	g_object_set(source, "caps", caps, "format", GST_FORMAT_TIME, nullptr);
+	gst_caps_unref(caps);
+	g_object_set(encoder, "quality", 75, nullptr);
+	g_object_set(sink, "location", StringUtil::ToString(tmpPath).c_str(), nullptr);
+
+	gst_bin_add_many(GST_BIN(pipeline), source, encoder, sink, nullptr);
+	gst_element_link_many(source, encoder, sink, nullptr);
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+	GstFlowReturn flowRet;
+	GST_BUFFER_PTS(buffer) = 0;
+	g_signal_emit_by_name(source, "push-buffer", buffer, &flowRet);
+	gst_buffer_unref(buffer);
+	g_signal_emit_by_name(source, "end-of-stream", &flowRet);
+
+	GstBus* bus = gst_element_get_bus(pipeline);
+	GstMessage* msg = gst_bus_timed_pop_filtered(bus, 10 * GST_SECOND, static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+	bool isOk = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+	if (msg)
+	{
+		gst_message_unref(msg);
+	}
+	gst_object_unref(bus);
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+
+	boost::system::error_code ec;
+	if (isOk)
+	{
+		boost::filesystem::rename(tmpPath, spritePath, ec);
+	}
+	if (!isOk || ec)
+	{
+		LOG_WARNING("Failed to write sprite " << StringUtil::ToString(spritePath));
+		boost::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+	return true;
+}
+
+bool ThumbnailGenerator::WriteSidecar(std::shared_ptr<VideoFile> videoFile, const std::vector<Thumbnail>& thumbnails)
+{
+	const uint64_t msToNs = 1000000;
+	web::json::value sidecar;
+	sidecar[L"sprite"] = web::json::value::string(boost::filesystem::path(GetSpritePath(videoFile->GetPath())).filename().wstring());
+	sidecar[L"start"] = web::json::value::number(static_cast<int64_t>(videoFile->StartTime() / msToNs));
+	sidecar[L"width"] = web::json::value::number(thumbWidth_);
+	sidecar[L"height"] = web::json::value::number(thumbHeight_);
+	sidecar[L"columns"] = web::json::value::number(spriteColumns_);
+
+	web::json::value thumbs = web::json::value::array(thumbnails.size());
+	for (size_t i = 0; i < thumbnails.size(); ++i)
+	{
+		web::json::value thumb;
+		// Offset from recording start
+		thumb[L"time"] = web::json::value::number(static_cast<int64_t>(thumbnails[i].Time / msToNs));
+		thumb[L"x"] = web::json::value::number(static_cast<int32_t>((i % spriteColumns_) * thumbWidth_));
+		thumb[L"y"] = web::json::value::number(static_cast<int32_t>((i / spriteColumns_) * thumbHeight_));
+		thumbs[i] = thumb;
+	}
+	sidecar[L"thumbs"] = thumbs;
+
+	const wstring sidecarPath = GetSidecarPath(videoFile->GetPath());
+	const wstring tmpPath = sidecarPath + L".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		file << StringUtil::ToString(sidecar.serialize());
+		if (!file)
+		{
+			LOG_WARNING("Failed to write " << StringUtil::ToString(tmpPath));
+			return false;
+		}
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::rename(tmpPath, sidecarPath, ec);
+	return !ec;
+}
+
+void ThumbnailGenerator::Throttle(std::chrono::nanoseconds cpuTime)
+{
+	auto pause = std::chrono::duration_cast<std::chrono::milliseconds>(cpuTime * ((1.0 - cpuBudget_) / cpuBudget_));
+	std::unique_lock<std::mutex> lock(mutex_);
+	queueCond_.wait_for(lock, pause, [this] { return isStopped_; });
+}
+
+bool ThumbnailGenerator::IsUpToDate(const std::wstring& recordingPath, int64_t recordingTime)
+{
+	boost::system::error_code ec;
+	time_t sidecarTime = boost::filesystem::last_write_time(GetSidecarPath(recordingPath), ec);
+	return !ec && static_cast<int64_t>(sidecarTime) >= recordingTime;
+}
+
+void ThumbnailGenerator::LowerThreadPriority()
+{
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#else
+	setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+}
+
+void ThumbnailGenerator::CbParsedPadAdded(GstElement* element, GstPad* pad, gpointer data)
+{
+	KeyFrameFilter* filter = static_cast<KeyFrameFilter*>(data);
+	if (filter->IsLinked)
+	{
+		return;
+	}
+
+	GstCaps* caps = gst_pad_query_caps(pad, nullptr);
+	bool isVideo = g_str_has_prefix(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/");
+	gst_caps_unref(caps);
+	if (!isVideo)
+	{
+		return;
+	}
+
+	GstPad* decoderPad = gst_element_get_static_pad(filter->Decoder, "sink");
+	if (gst_pad_link(pad, decoderPad) == GST_PAD_LINK_OK)
+	{
+		filter->IsLinked = true;
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, CbKeyFrameFilter, filter, nullptr);
+	}
+	gst_object_unref(decoderPad);
+}
+
+void ThumbnailGenerator::CbDecodedPadAdded(GstElement* element, GstPad* pad, gpointer data)
+{
+	KeyFrameFilter* filter = static_cast<KeyFrameFilter*>(data);
+	GstPad* converterPad = gst_element_get_static_pad(filter->Converter, "sink");
+	if (!gst_pad_is_linked(converterPad))
+	{
+		gst_pad_link(pad, converterPad);
+	}
+	gst_object_unref(converterPad);
+}
+
+GstPadProbeReturn ThumbnailGenerator::CbKeyFrameFilter(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+	KeyFrameFilter* filter = static_cast<KeyFrameFilter*>(data);
+	GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	// Decoder sees only key frames a thumbnail interval apart, everything else costs nothing
+	if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT) || !GST_BUFFER_PTS_IS_VALID(buffer) ||
+		GST_BUFFER_PTS(buffer) < filter->NextTime)
+	{
+		return GST_PAD_PROBE_DROP;
+	}
+	filter->NextTime = GST_BUFFER_PTS(buffer) + thumbInterval_;
+	return GST_PAD_PROBE_OK;
+}
+
+GstBusSyncReply ThumbnailGenerator::CbStreamStatus(GstBus* bus, GstMessage* msg, gpointer data)
+{
+	// Posted from new streaming thread itself, decoder threads get the same low priority as generator
+	if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_STREAM_STATUS)
+	{
+		GstStreamStatusType type;
+		GstElement* owner = nullptr;
+		gst_message_parse_stream_status(msg, &type, &owner);
+		if (type == GST_STREAM_STATUS_TYPE_ENTER)
+		{
+			LowerThreadPriority();
+			static_cast<PipelineCpuTime*>(data)->AddCurrentThread();
+		}
+	}
+	return GST_BUS_PASS;
+}
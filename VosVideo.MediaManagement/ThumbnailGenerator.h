@@ -0,0 +1,88 @@
+#pragma once
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <gst/gst.h>
+#include "VideoFile.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		// Makes timeline sprite for every recording: thumbnails of key frames taken every few seconds,
+		// laid out in grid of one JPEG, with JSON sidecar telling time and place of each thumbnail.
+		// Delta frames are dropped before decoder, so only key frames are ever decoded.
+		// Runs on one thread with the lowest priority and keeps CPU time of its pipeline threads within a budget,
+		// live cameras are always served first.
+		// Only new recordings are queued, up to a limit. The rest of archive is walked in small batches
+		// once queue is empty, so recordings waiting for sprite are never all held in memory.
+		class ThumbnailGenerator final
+		{
+		public:
+			// Next batch of recordings to check, empty once the whole archive was offered.
+			// Called on generator thread only.
+			typedef std::function<std::vector<std::shared_ptr<VideoFile>>()> BacklogSource;
+
+			ThumbnailGenerator(BacklogSource backlogSource);
+			~ThumbnailGenerator();
+
+			// Queues recording if its sprite is missing or older than recording,
+			// recordingTime is last write time of recording known to caller.
+			// Recording is left for the next backlog walk if queue is full.
+			void Enqueue(std::shared_ptr<VideoFile> videoFile, int64_t recordingTime);
+			// Walks backlog once queue is empty
+			void RequestBacklog();
+			void Stop();
+
+			static std::wstring GetSpritePath(const std::wstring& recordingPath);
+			static std::wstring GetSidecarPath(const std::wstring& recordingPath);
+			// Removes sprite and sidecar of recording
+			static void Remove(const std::wstring& recordingPath);
+
+		private:
+			struct Thumbnail
+			{
+				// Nanoseconds from recording start
+				GstClockTime Time;
+				std::vector<uint8_t> Pixels;
+			};
+
+			void WorkLoop();
+			// Following return once generator is stopped
+			void GenerateQueued();
+			void WalkBacklog();
+			bool Generate(std::shared_ptr<VideoFile> videoFile);
+			bool DecodeKeyFrames(const std::wstring& recordingPath, std::vector<Thumbnail>& thumbnails);
+			bool WriteSprite(const std::wstring& spritePath, const std::vector<Thumbnail>& thumbnails);
+			bool WriteSidecar(std::shared_ptr<VideoFile> videoFile, const std::vector<Thumbnail>& thumbnails);
+			// Sleeps so that CPU time used stays within budget
+			void Throttle(std::chrono::nanoseconds cpuTime);
+			static bool IsUpToDate(const std::wstring& recordingPath, int64_t recordingTime);
+			static void LowerThreadPriority();
+
+			static void CbParsedPadAdded(GstElement* element, GstPad* pad, gpointer data);
+			static void CbDecodedPadAdded(GstElement* element, GstPad* pad, gpointer data);
+			static GstPadProbeReturn CbKeyFrameFilter(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+			static GstBusSyncReply CbStreamStatus(GstBus* bus, GstMessage* msg, gpointer data);
+
+			std::mutex mutex_;
+			std::condition_variable queueCond_;
+			std::deque<std::shared_ptr<VideoFile>> queue_;
+			BacklogSource backlogSource_;
+			bool isBacklogRequested_ = false;
+			bool isStopped_ = false;
+			std::thread workThr_;
+
+			static const size_t maxQueued_ = 64;
+
+			static const int thumbWidth_ = 132;
+			static const int thumbHeight_ = 96;
+			static const int spriteColumns_ = 10;
+			static const GstClockTime thumbInterval_ = 10 * GST_SECOND;
+			// Share of one core the generator and its pipeline threads may use together
+			static const double cpuBudget_;
+		};
+	}
+}
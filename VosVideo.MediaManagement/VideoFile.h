@@ -13,6 +13,7 @@ namespace vosvideo
 			MegaDrive
 		};
 
+		// Duration and start time are in nanoseconds, start time is counted from Unix epoch
 		class VideoFile
 		{
 		public:
@@ -22,6 +23,7 @@ namespace vosvideo
 				uint64_t duration, 
 				uint64_t startTime, 
 				bool isSeekable) : 
+				isValid_(true),
 				id_(id),
 				path_(path),
 				duration_(duration),
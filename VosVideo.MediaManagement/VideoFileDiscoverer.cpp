@@ -14,10 +14,12 @@ VideoFileDiscoverer::~VideoFileDiscoverer()
 
 shared_ptr<VideoFile> VideoFileDiscoverer::Discover(const wstring& path)
 {
+	std::lock_guard<std::mutex> lock(mutex_);
 	return localDiscoverer_.Discover(path);
 }
 
 vector<shared_ptr<VideoFile>> VideoFileDiscoverer::Discover(vector<wstring>& pathVect)
 {
+	std::lock_guard<std::mutex> lock(mutex_);
 	return localDiscoverer_.Discover(pathVect);
 }
\ No newline at end of file
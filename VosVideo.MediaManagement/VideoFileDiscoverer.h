@@ -1,10 +1,13 @@
 #pragma once
+#include <mutex>
 #include "LocalVideoFileDiscoverer.h"
 
 namespace vosvideo
 {
 	namespace archive
 	{
+		// Thread safe front of local discoverer, calls are serialized.
+		// Bulk discovery should go through VideoFileDiscoveryPool instead.
 		class VideoFileDiscoverer
 		{
 		public:
@@ -15,6 +18,7 @@ namespace vosvideo
 			std::vector<std::shared_ptr<VideoFile>> Discover(std::vector<std::wstring>& pathVect);
 
 		private:
+			std::mutex mutex_;
 			LocalVideoFileDiscoverer localDiscoverer_;
 		};
 	}
@@ -0,0 +1,154 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "VideoFileDiscovererException.h"
+#include "LocalVideoFileDiscoverer.h"
+#include "VideoFileDiscoveryPool.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::archive;
+
+const std::chrono::milliseconds VideoFileDiscoveryPool::progressPeriod_(1000);
+
+VideoFileDiscoveryPool::VideoFileDiscoveryPool(uint32_t maxWorkers) :
+	maxWorkers_(std::max<uint32_t>(maxWorkers, 1)),
+	discoveryTask_(pplx::task_from_result()),
+	isCancelled_(false),
+	next_(0),
+	total_(0),
+	done_(0),
+	failed_(0),
+	lastReport_(0)
+{
+}
+
+VideoFileDiscoveryPool::~VideoFileDiscoveryPool()
+{
+	Cancel();
+	try
+	{
+		discoveryTask_.wait();
+	}
+	catch (std::exception& ex)
+	{
+		LOG_WARNING("Discovery finished with error: " << ex.what());
+	}
+}
+
+pplx::task<void> VideoFileDiscoveryPool::DiscoverAsync(const std::vector<std::wstring>& paths, DiscoveredCallback onDiscovered, ProgressCallback onProgress)
+{
+	if (!discoveryTask_.is_done())
+	{
+		throw VideoFileDiscovererException("Discovery is already running");
+	}
+
+	isCancelled_ = false;
+	next_ = 0;
+	total_ = paths.size();
+	done_ = 0;
+	failed_ = 0;
+	lastReport_ = 0;
+
+	auto sharedPaths = std::make_shared<vector<wstring>>(paths);
+	discoveryTask_ = pplx::create_task([this, sharedPaths, onDiscovered, onProgress]
+	{
+		Run(*sharedPaths, onDiscovered, onProgress);
+	});
+	return discoveryTask_;
+}
+
+void VideoFileDiscoveryPool::Cancel()
+{
+	isCancelled_ = true;
+}
+
+DiscoveryProgress VideoFileDiscoveryPool::GetProgress() const
+{
+	DiscoveryProgress progress;
+	progress.Total = total_;
+	progress.Done = done_;
+	progress.Failed = failed_;
+	progress.IsCancelled = isCancelled_;
+	return progress;
+}
+
+void VideoFileDiscoveryPool::Run(const std::vector<std::wstring>& paths, DiscoveredCallback onDiscovered, ProgressCallback onProgress)
+{
+	auto started = std::chrono::steady_clock::now();
+	const size_t workerCount = std::min<size_t>(maxWorkers_, paths.size());
+	LOG_TRACE("Discovering " << paths.size() << " files with " << workerCount << " workers");
+
+	vector<std::thread> workers;
+	workers.reserve(workerCount);
+	for (size_t i = 0; i < workerCount; ++i)
+	{
+		workers.emplace_back(&VideoFileDiscoveryPool::WorkerLoop, this, std::cref(paths), onDiscovered, onProgress);
+	}
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	ReportProgress(onProgress, true);
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+	LOG_TRACE("Discovery " << (isCancelled_ ? "cancelled" : "finished") << " after " << elapsed.count() << " ms, "
+		<< done_ << " of " << total_ << " files, " << failed_ << " failed");
+}
+
+void VideoFileDiscoveryPool::WorkerLoop(const std::vector<std::wstring>& paths, DiscoveredCallback onDiscovered, ProgressCallback onProgress)
+{
+	unique_ptr<LocalVideoFileDiscoverer> discoverer;
+	try
+	{
+		discoverer.reset(new LocalVideoFileDiscoverer());
+	}
+	catch (VideoFileDiscovererException&)
+	{
+		return;
+	}
+
+	while (!isCancelled_)
+	{
+		// Files are pulled one by one, so long discoveries don't stall the other workers
+		size_t idx = next_++;
+		if (idx >= paths.size())
+		{
+			break;
+		}
+
+		auto videoFile = discoverer->Discover(paths[idx]);
+		if (videoFile->IsValid())
+		{
+			if (onDiscovered)
+			{
+				onDiscovered(videoFile);
+			}
+		}
+		else
+		{
+			++failed_;
+		}
+		++done_;
+
+		ReportProgress(onProgress, false);
+	}
+}
+
+void VideoFileDiscoveryPool::ReportProgress(ProgressCallback onProgress, bool force)
+{
+	if (!onProgress)
+	{
+		return;
+	}
+
+	const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	int64_t last = lastReport_;
+	if (!force && (now - last < progressPeriod_.count() || !lastReport_.compare_exchange_strong(last, now)))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(reportMutex_);
+	onProgress(GetProgress());
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include "VideoFile.h"
+
+namespace vosvideo
+{
+	namespace archive
+	{
+		struct DiscoveryProgress
+		{
+			size_t Total = 0;
+			size_t Done = 0;
+			size_t Failed = 0;
+			bool IsCancelled = false;
+		};
+
+		// Discovers many files on a bounded set of worker threads, every worker owns its own discoverer.
+		class VideoFileDiscoveryPool final
+		{
+		public:
+			typedef std::function<void(std::shared_ptr<VideoFile>)> DiscoveredCallback;
+			typedef std::function<void(const DiscoveryProgress&)> ProgressCallback;
+
+			VideoFileDiscoveryPool(uint32_t maxWorkers);
+			// Cancels running discovery and waits for workers
+			~VideoFileDiscoveryPool();
+
+			// Callbacks are invoked from worker threads. Progress is reported at most once per progressPeriod_ and once at the end.
+			// Only one discovery can run at a time.
+			pplx::task<void> DiscoverAsync(const std::vector<std::wstring>& paths, DiscoveredCallback onDiscovered, ProgressCallback onProgress);
+			// Workers stop after the file they are discovering now
+			void Cancel();
+			DiscoveryProgress GetProgress() const;
+
+		private:
+			void Run(const std::vector<std::wstring>& paths, DiscoveredCallback onDiscovered, ProgressCallback onProgress);
+			void WorkerLoop(const std::vector<std::wstring>& paths, DiscoveredCallback onDiscovered, ProgressCallback onProgress);
+			void ReportProgress(ProgressCallback onProgress, bool force);
+
+			uint32_t maxWorkers_;
+			pplx::task<void> discoveryTask_;
+			std::atomic<bool> isCancelled_;
+			std::atomic<size_t> next_;
+			std::atomic<size_t> total_;
+			std::atomic<size_t> done_;
+			std::atomic<size_t> failed_;
+			std::atomic<int64_t> lastReport_;
+			std::mutex reportMutex_;
+
+			static const std::chrono::milliseconds progressPeriod_;
+		};
+	}
+}
@@ -18,8 +18,7 @@ DWORD WINAPI LocalDirectoryMonitorStarter(LPVOID lpParam)
 
 WinDirectoryMonitor::WinDirectoryMonitor(std::shared_ptr<ConfigurationManager> configManager, DirectoryChangesNotifier* changesNotifier) :
 		changesNotifier_(changesNotifier),
-		configManager_(configManager),
-		inRemovingState_(false)
+		configManager_(configManager)
 {
 	thrHandle_ = CreateThread(nullptr, 0, &LocalDirectoryMonitorStarter, this, 0, nullptr);
 }
@@ -40,7 +39,8 @@ WinDirectoryMonitor::~WinDirectoryMonitor()
 
 void WinDirectoryMonitor::DoMonitorArchiveDirectory()
 {
-	if (configManager_->GetArchivePath() == L"")
+	vector<wstring> roots = configManager_->GetArchivePaths();
+	if (roots.empty())
 	{
 		return;
 	}
@@ -51,7 +51,11 @@ void WinDirectoryMonitor::DoMonitorArchiveDirectory()
 		| FILE_NOTIFY_CHANGE_FILE_NAME;
 
 	CReadDirectoryChanges changes;
-	changes.AddDirectory(configManager_->GetArchivePath(), false, dwNotificationFlags);
+	// One change queue serves all archive roots, reported names are full paths
+	for (const auto& root : roots)
+	{
+		changes.AddDirectory(root, false, dwNotificationFlags);
+	}
 	endLocalDirectoryEvent_ = CreateEvent(
 		nullptr,               // default security attributes
 		TRUE,               // manual-reset event
@@ -80,13 +84,13 @@ void WinDirectoryMonitor::DoMonitorArchiveDirectory()
 			if (!changes.CheckOverflow())
 			{
 				changes.Pop(dwAction, wstrFilename);
-				if (dwAction == FILE_ACTION_MODIFIED)
+				if (dwAction == FILE_ACTION_ADDED)
 				{
-					ChangeDiskSpace(wstrFilename);
+					changesNotifier_->notifierSignal_(wstrFilename);
 				}
-				else if (dwAction == FILE_ACTION_ADDED)
+				else if (dwAction == FILE_ACTION_REMOVED)
 				{
-					changesNotifier_->notifierSignal_(wstrFilename);
+					changesNotifier_->removedSignal_(wstrFilename);
 				}
 			}
 		}
@@ -99,48 +103,3 @@ void WinDirectoryMonitor::DoMonitorArchiveDirectory()
 
 	changes.Terminate();
 }
-
-void WinDirectoryMonitor::ChangeDiskSpace(const wstring& wstrDir)
-{
-	if (inRemovingState_ == true)
-	{
-		inRemovingState_ = false;
-		return;
-	}
-
-	LOG_TRACE("Created new file in video archive: " << StringUtil::ToString(wstrDir));
-
-	boost::filesystem::path p(wstrDir);
-	if (!p.empty())
-	{
-		boost::filesystem::path::iterator it = p.begin();
-		boost::filesystem::space_info si = boost::filesystem::space(*it);
-
-		// Check if time to remove old files
-		if (si.available < reservedDiskSpace_)
-		{
-			LOG_TRACE("Available disk space is less then 10G, will remove oldest file");
-			boost::posix_time::ptime nowTime(boost::posix_time::second_clock::local_time());
-			boost::filesystem::directory_iterator dirIter(p), dirIterEnd;
-			map<time_t, boost::filesystem::path> files;
-
-			while (dirIter != dirIterEnd)
-			{
-				if (boost::filesystem::exists(*dirIter) && !boost::filesystem::is_directory(*dirIter))
-				{
-					time_t t = boost::filesystem::last_write_time(*dirIter);
-					auto p = dirIter->path();
-					files.insert(make_pair(t, dirIter->path()));
-				}
-				++dirIter;
-			}
-
-			if (!files.empty())
-			{
-				LOG_TRACE("File was removed: " << files.begin()->second);
-				boost::filesystem::remove(files.begin()->second);
-				inRemovingState_ = true;
-			}
-		}
-	}
-}
@@ -18,14 +18,9 @@ namespace vosvideo
 			void DoMonitorArchiveDirectory();
 
 		private:
-			void ChangeDiskSpace(const std::wstring& wstrDir);
-
-			static const uint64_t reservedDiskSpace_ = 10737418240;
-
 			DirectoryChangesNotifier* changesNotifier_;
 			std::shared_ptr<vosvideo::configuration::ConfigurationManager> configManager_;
 			CReadDirectoryChanges changes_;
-			bool inRemovingState_;
 			HANDLE endLocalDirectoryEvent_;
 			HANDLE thrHandle_;
 		};
@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include "CallSetupTrace.h"
+
+using namespace std;
+using namespace metrics;
+using namespace vosvideo::vvwebrtc;
+
+CallSetupTrace::CallSetupTrace(const std::string& peer, const std::string& connection) : peer_(peer), connection_(connection), isFinished_(false)
+{
+	for (auto& stageTime : stageTimes_)
+	{
+		stageTime.store(0);
+	}
+}
+
+void CallSetupTrace::Mark(CallSetupStage stage, int64_t time)
+{
+	int64_t expected = 0;
+	if (!stageTimes_[static_cast<size_t>(stage)].compare_exchange_strong(expected, time))
+	{
+		return;
+	}
+	if (stage == CallSetupStage::FirstFrameSent)
+	{
+		Complete();
+	}
+}
+
+bool CallSetupTrace::IsMarked(CallSetupStage stage) const
+{
+	return stageTimes_[static_cast<size_t>(stage)].load() != 0;
+}
+
+void CallSetupTrace::Abandon()
+{
+	if (isFinished_.exchange(true))
+	{
+		return;
+	}
+	LOG_TRACE("Call of peer " << peer_ << " closed before first frame, setup trace in ms from offer: " << Format());
+}
+
+void CallSetupTrace::Complete()
+{
+	if (isFinished_.exchange(true))
+	{
+		return;
+	}
+
+	// Stage took time since the last stage reached before it, stage is skipped if it was never marked
+	auto& registry = MetricsRegistry::Instance();
+	int64_t first = 0;
+	int64_t previous = 0;
+	for (size_t i = 0; i < stageTimes_.size(); i++)
+	{
+		int64_t stageTime = stageTimes_[i].load();
+		if (stageTime == 0)
+		{
+			continue;
+		}
+		const char* stageName = GetStageName(static_cast<CallSetupStage>(i));
+		if (previous == 0)
+		{
+			first = stageTime;
+		}
+		else
+		{
+			registry.GetHistogram("vosvideo_call_setup_stage_seconds", "Time call setup stage took since previous one", { { "stage", stageName } })
+				->Record(static_cast<uint64_t>(std::max<int64_t>(stageTime - previous, 0)));
+		}
+		registry.GetGauge("vosvideo_call_setup_trace_microseconds", "Time stage of peer call setup was reached at since offer", { { "peer", peer_ }, { "connection", connection_ }, { "stage", stageName } })
+			->Set(stageTime - first);
+		previous = stageTime;
+	}
+
+	int64_t totalUs = previous - first;
+	registry.GetHistogram("vosvideo_call_setup_seconds", "Time from offer till first frame was sent to peer")->Record(static_cast<uint64_t>(std::max<int64_t>(totalUs, 0)));
+	if (totalUs > slowCallThresholdUs_)
+	{
+		LOG_WARNING("Slow call setup of peer " << peer_ << ", " << totalUs / 1000 << " ms, trace in ms from offer: " << Format());
+	}
+	else
+	{
+		LOG_TRACE("Call setup of peer " << peer_ << " took " << totalUs / 1000 << " ms, trace in ms from offer: " << Format());
+	}
+}
+
+std::string CallSetupTrace::Format() const
+{
+	std::ostringstream trace;
+	int64_t first = 0;
+	for (size_t i = 0; i < stageTimes_.size(); i++)
+	{
+		int64_t stageTime = stageTimes_[i].load();
+		if (first == 0)
+		{
+			first = stageTime;
+		}
+		trace << (i ? " " : "") << GetStageName(static_cast<CallSetupStage>(i)) << " ";
+		if (stageTime == 0)
+		{
+			trace << "-";
+		}
+		else
+		{
+			trace << (stageTime - first) / 1000;
+		}
+	}
+	return trace.str();
+}
+
+int64_t CallSetupTrace::GetNow()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* CallSetupTrace::GetStageName(CallSetupStage stage)
+{
+	switch (stage)
+	{
+	case CallSetupStage::OfferReceived:
+		return "offer_received";
+	case CallSetupStage::OfferDelivered:
+		return "offer_delivered";
+	case CallSetupStage::SdpInitialized:
+		return "sdp_initialized";
+	case CallSetupStage::AnswerSent:
+		return "answer_sent";
+	case CallSetupStage::IceConnected:
+		return "ice_connected";
+	case CallSetupStage::FirstFrameSent:
+		return "first_frame_sent";
+	default:
+		return "unknown";
+	}
+}
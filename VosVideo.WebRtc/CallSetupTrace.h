@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <string>
+#include "VosVideo.Common/Metrics.h"
+
+namespace vosvideo
+{
+	namespace vvwebrtc
+	{
+		enum class CallSetupStage
+		{
+			// Offer came to rtbcserver from websocket
+			OfferReceived = 0,
+			// Offer reached deviceworker through interprocess queue
+			OfferDelivered,
+			// Peer connection is being created for the offer
+			SdpInitialized,
+			AnswerSent,
+			// First ICE candidate pair connected
+			IceConnected,
+			// First encoded video was sent to peer
+			FirstFrameSent,
+			Count
+		};
+
+		// Times of steps between offer and first frame of one call. Stages are marked from signaling,
+		// WebRTC and manager threads, first mark of every stage is kept. Once first frame was sent,
+		// time each stage took goes to histograms and call trace is written to log and exported per peer connection.
+		class CallSetupTrace final
+		{
+		public:
+			CallSetupTrace(const std::string& peer, const std::string& connection);
+
+			// Time is Unix microseconds, stages reported by rtbcserver come with their own time
+			void Mark(CallSetupStage stage, int64_t time = GetNow());
+			bool IsMarked(CallSetupStage stage) const;
+			// Writes trace of call which was closed before first frame, no-op if it was completed
+			void Abandon();
+
+			static int64_t GetNow();
+			static const char* GetStageName(CallSetupStage stage);
+
+		private:
+			void Complete();
+			std::string Format() const;
+
+			std::string peer_;
+			std::string connection_;
+			std::array<std::atomic<int64_t>, static_cast<size_t>(CallSetupStage::Count)> stageTimes_;
+			std::atomic<bool> isFinished_;
+
+			static const int64_t slowCallThresholdUs_ = 3000000;
+		};
+	}
+}
@@ -9,6 +9,9 @@
 #include "VosVideo.Data/LiveVideoOfferMsg.h"
 #include "VosVideo.Data/CameraConfMsg.h"
 #include "VosVideo.Data/ShutdownCameraProcessRequestMsg.h"
+#include "VosVideo.Data/DeviceWorkerStatusMsg.h"
+#include "VosVideo.Data/ArchivePlaybackMsg.h"
+#include "VosVideo.Data/RtbcDeviceErrorOutMsg.h"
 #include "VosVideo.CameraPlayer/CameraPlayerBase.h"
 #include "VosVideo.Camera/CameraPlayerFactory.h"
 #include "VosVideo.Camera/CameraException.h"
@@ -31,8 +34,8 @@ using boost::wformat;
 
 WebRtcManager::WebRtcManager(
     std::shared_ptr<vosvideo::communication::PubSubService> pubsubService, 
-	std::shared_ptr<vosvideo::communication::InterprocessQueueEngine> queueEng) 
-    : pubSubService_(pubsubService), queueEng_(queueEng), inShutdown_(false)
+	std::shared_ptr<vosvideo::communication::InterprocessQueueEngine> queueEng, int32_t parentPid) 
+    : pubSubService_(pubsubService), queueEng_(queueEng), inShutdown_(false), parentPid_(parentPid)
 {
 	vector<TypeInfoWrapper> interestedTypes;
 
@@ -54,16 +57,30 @@ WebRtcManager::WebRtcManager(
 	typeInfo = typeid(ShutdownCameraProcessRequestMsg);
 	interestedTypes.push_back(typeInfo);
 
+	typeInfo = typeid(ArchivePlaybackMsg);
+	interestedTypes.push_back(typeInfo);
+
 	pubSubService_->Subscribe(interestedTypes, *this);
-	// Prepare timer
+	peersActiveMetric_ = metrics::MetricsRegistry::Instance().GetGauge("vosvideo_peers_active", "Open peer connections");
+	// Runs from launch, worker waiting in pool for camera must notice that parent is gone too
 	auto callback = new call<WebRtcManager*>([this](WebRtcManager*)
 	{
-		if (this->player_->GetState() == PlayerState::Stopped)
+		if (this->inShutdown_)
+		{
+			return;
+		}
+		if (!this->IsParentAlive())
+		{
+			LOG_WARNING("Parent process " << this->parentPid_ << " is gone, shutting down.");
+			Shutdown();
+		}
+		else if (this->player_ != nullptr && this->player_->GetState() == PlayerState::Stopped)
 		{
 			Shutdown();
 		}
 	});
 	isaliveTimer_ = new Concurrency::timer<WebRtcManager*>(isaliveTimeout_, 0, callback, true);
+	isaliveTimer_->start();
 
     rtc::AutoThread auto_thread;
     physicalSocketServer_ = new rtc::PhysicalSocketServer();
@@ -106,6 +123,7 @@ void WebRtcManager::OnMessageReceived(std::shared_ptr<ReceivedData> receivedMess
 		if(dynamic_pointer_cast<CameraConfMsg>(receivedMessage))
 		{
 			shared_ptr<CameraConfMsg> cameraConf = dynamic_pointer_cast<CameraConfMsg>(receivedMessage);			
+			cameraConf_ = cameraConf;
 			// COM pointer can not use shared_ptr
 			player_ = CameraPlayerFactory::CreateCameraPlayer();
 			auto hr = player_->OpenURL(*cameraConf.get());		
@@ -114,7 +132,11 @@ void WebRtcManager::OnMessageReceived(std::shared_ptr<ReceivedData> receivedMess
 			{
 				LOG_CRITICAL("Failed to create camera");
 			}
-			isaliveTimer_->start();
+			else
+			{
+				DeviceWorkerStatusMsg startedMsg(L"", DeviceWorkerStatus::CameraStarted, activeDeviseId_);
+				queueEng_->Send(startedMsg.ToString());
+			}
 		}
 		return;
 	}
@@ -133,8 +155,31 @@ void WebRtcManager::OnMessageReceived(std::shared_ptr<ReceivedData> receivedMess
 	{
 		shared_ptr<LiveVideoOfferMsg> liveVideoDto = dynamic_pointer_cast<LiveVideoOfferMsg>(receivedMessage);
 
+		// Offer with "Archive" object plays recording instead of live video
+		auto mediaInfo = liveVideoDto->GetMediaInfo();
+		shared_ptr<ArchivePlayerBase> archivePlayer;
+		if (mediaInfo.is_object() && mediaInfo.has_field(U("Archive")))
+		{
+			archivePlayer = CreateArchivePlayer(mediaInfo.at(U("Archive")));
+			if (archivePlayer == nullptr)
+			{
+				shared_ptr<RtbcDeviceErrorOutMsg> playbackErr(new RtbcDeviceErrorOutMsg(activeDeviseId_, L"Failed to open recording"));
+				string respRtbc;
+				CommunicationManager::CreateWebsocketMessageString(srvPeer, clientPeer, playbackErr, respRtbc);
+				queueEng_->Send(respRtbc);
+				return;
+			}
+		}
+
 		LOG_TRACE("Create new peer connection with key:" << StringUtil::ToString(clientPeerKey));
-        conn = new rtc::RefCountedObject<WebRtcPeerConnection>(clientPeer, srvPeer, player_, queueEng_);
+		if (archivePlayer != nullptr)
+		{
+			conn = new rtc::RefCountedObject<WebRtcPeerConnection>(clientPeer, srvPeer, archivePlayer, queueEng_);
+		}
+		else
+		{
+			conn = new rtc::RefCountedObject<WebRtcPeerConnection>(clientPeer, srvPeer, player_, queueEng_);
+		}
         conn->SetCurrentThread(mainThread_);
 
 		// Check if peer with camera id doesnt exists. 
@@ -143,9 +188,15 @@ void WebRtcManager::OnMessageReceived(std::shared_ptr<ReceivedData> receivedMess
 		{
 			DeletePeerConnection(clientPeerKey);
 		}
+		if (archivePlayer != nullptr)
+		{
+			archivePlayers_[clientPeerKey] = archivePlayer;
+		}
 		// Add SDP
 		peer_connections_.insert(make_pair(clientPeerKey, conn));
+		peersActiveMetric_->Set(peer_connections_.size());
 		// Process connection
+		conn->OnOfferDelivered(receivedMessage->GetReceivedTime());
 		shared_ptr<SdpOffer> sdpOffer = dynamic_pointer_cast<SdpOffer>(receivedMessage);
 		conn->InitSdp(sdpOffer);
 	}
@@ -181,6 +232,10 @@ void WebRtcManager::OnMessageReceived(std::shared_ptr<ReceivedData> receivedMess
 			}
 		}
 	}
+	else if (dynamic_pointer_cast<ArchivePlaybackMsg>(receivedMessage))
+	{
+		ControlArchivePlayer(clientPeerKey, dynamic_pointer_cast<ArchivePlaybackMsg>(receivedMessage));
+	}
 	else if(dynamic_pointer_cast<WebsocketConnectionClosedMsg>(receivedMessage))
 	{
 		auto jsonMsg = receivedMessage->ToJsonValue();
@@ -210,17 +265,51 @@ void WebRtcManager::Shutdown()
 		}
 	}
 
-	player_->Stop();
-	player_->Shutdown();
+	// Idle pooled worker can be stopped before it got camera configuration
+	if (player_ != nullptr)
+	{
+		player_->Stop();
+		player_->Shutdown();
 
 		//Check if it derives from IUnknown
-	IUnknown* iUnknownPlayer = dynamic_cast<IUnknown*>(player_);
-	if(iUnknownPlayer)
-		iUnknownPlayer->Release();
+		IUnknown* iUnknownPlayer = dynamic_cast<IUnknown*>(player_);
+		if(iUnknownPlayer)
+			iUnknownPlayer->Release();
+	}
 
 	queueEng_->StopReceive();
 }
 
+bool WebRtcManager::IsParentAlive() const
+{
+	if (parentPid_ < 0)
+	{
+		return true;
+	}
+	HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, parentPid_);
+	if (process == nullptr)
+	{
+		return false;
+	}
+	DWORD ret = WaitForSingleObject(process, 0);
+	CloseHandle(process);
+	return ret == WAIT_TIMEOUT;
+}
+
+void WebRtcManager::PostRoundTrip(std::function<void()> done)
+{
+	mainThread_->Post(RTC_FROM_HERE, this, roundTripMessage_, new rtc::TypedMessageData<std::function<void()>>(done));
+}
+
+void WebRtcManager::OnMessage(rtc::Message* message)
+{
+	if (message->message_id == roundTripMessage_)
+	{
+		shared_ptr<rtc::TypedMessageData<std::function<void()>>> data(static_cast<rtc::TypedMessageData<std::function<void()>>*>(message->pdata));
+		data->data()();
+	}
+}
+
 void WebRtcManager::DeleteAllPeerConnections()
 {
 	LOG_TRACE("Query for deletion all peer connections");	
@@ -234,6 +323,8 @@ void WebRtcManager::DeleteAllPeerConnections()
 	}
 
 	peer_connections_.clear();
+	peersActiveMetric_->Set(0);
+	archivePlayers_.clear();
 }
 
 void WebRtcManager::DeletePeerConnection(const wstring& fromPeer)
@@ -256,11 +347,75 @@ void WebRtcManager::DeletePeerConnection(const wstring& fromPeer)
 			++iter;
 		}
 	}
+	peersActiveMetric_->Set(peer_connections_.size());
+
+	ArchivePlayerMap::iterator playerIter = archivePlayers_.lower_bound(fromPeer);
+	while (playerIter != archivePlayers_.end() && playerIter->first.compare(0, fromPeer.length(), fromPeer) == 0)
+	{
+		playerIter = archivePlayers_.erase(playerIter);
+	}
 
 	// Periodically check for garbage
 	RemoveFinishedPeerConnections();
 }
 
+shared_ptr<ArchivePlayerBase> WebRtcManager::CreateArchivePlayer(const web::json::value& archiveInfo)
+{
+	if (cameraConf_ == nullptr || !archiveInfo.is_object() || 
+		!archiveInfo.has_field(U("File")) || !archiveInfo.at(U("File")).is_string())
+	{
+		LOG_ERROR("Recording playback requested without recording file");
+		return nullptr;
+	}
+
+	shared_ptr<ArchivePlayerBase> archivePlayer(CameraPlayerFactory::CreateArchivePlayer(archiveInfo.at(U("File")).as_string()));
+	if (archivePlayer->OpenURL(*cameraConf_.get()) != 0)
+	{
+		return nullptr;
+	}
+
+	if (archiveInfo.has_field(U("Rate")) && archiveInfo.at(U("Rate")).is_number())
+	{
+		archivePlayer->SetRate(archiveInfo.at(U("Rate")).as_integer());
+	}
+	if (archiveInfo.has_field(U("Position")) && archiveInfo.at(U("Position")).is_number())
+	{
+		archivePlayer->Seek(archiveInfo.at(U("Position")).as_number().to_int64());
+	}
+	return archivePlayer;
+}
+
+void WebRtcManager::ControlArchivePlayer(const wstring& clientPeerKey, shared_ptr<ArchivePlaybackMsg> playbackMsg)
+{
+	ArchivePlayerMap::iterator iter = archivePlayers_.find(clientPeerKey);
+	shared_ptr<ArchivePlayerBase> archivePlayer;
+	if (iter == archivePlayers_.end() || (archivePlayer = iter->second.lock()) == nullptr)
+	{
+		LOG_DEBUG("No recording is played for peer connection with key:" << StringUtil::ToString(clientPeerKey));
+		return;
+	}
+
+	if (playbackMsg->GetRate() != 0)
+	{
+		archivePlayer->SetRate(playbackMsg->GetRate());
+	}
+	if (playbackMsg->HasPosition())
+	{
+		archivePlayer->Seek(playbackMsg->GetPosition());
+	}
+	if (playbackMsg->HasPause())
+	{
+		if (playbackMsg->IsPause())
+		{
+			archivePlayer->Pause();
+		}
+		else
+		{
+			archivePlayer->Play();
+		}
+	}
+}
+
 int WebRtcManager::RemoveFinishedPeerConnections()
 {
 	WebRtcPeerConnectionVector::iterator iter = finishing_peer_connections_.begin();
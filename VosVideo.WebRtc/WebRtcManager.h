@@ -1,5 +1,7 @@
 #pragma once
+#include <functional>
 #include <webrtc/base/scoped_ref_ptr.h>
+#include <webrtc/base/messagehandler.h>
 #include <webrtc/api/peerconnectioninterface.h>
 #include <webrtc/base/physicalsocketserver.h>
 #include "VosVideo.Communication/CommunicationManager.h"
@@ -7,7 +9,11 @@
 #include "VosVideo.Communication.InterprocessQueue/InterprocessQueueEngine.h"
 #include "VosVideo.Camera/CameraDeviceManager.h"
 #include "VosVideo.CameraPlayer/CameraPlayerBase.h"
+#include "VosVideo.CameraPlayer/ArchivePlayerBase.h"
 #include "VosVideo.Data/DtoFactory.h"
+#include "VosVideo.Data/CameraConfMsg.h"
+#include "VosVideo.Data/ArchivePlaybackMsg.h"
+#include "VosVideo.Common/Metrics.h"
 #include "WebRtcPeerConnection.h"
 
 
@@ -15,25 +21,36 @@ namespace vosvideo
 {
 	namespace vvwebrtc
 	{
-		class WebRtcManager : public vosvideo::communication::MessageReceiver
+		class WebRtcManager : public vosvideo::communication::MessageReceiver, public rtc::MessageHandler
 		{
 		public:
 			WebRtcManager(std::shared_ptr<vosvideo::communication::PubSubService> pubsubService, 
-				std::shared_ptr<vosvideo::communication::InterprocessQueueEngine> queueEng);
+				std::shared_ptr<vosvideo::communication::InterprocessQueueEngine> queueEng, int32_t parentPid);
 			virtual ~WebRtcManager();
 
 			virtual void OnMessageReceived(std::shared_ptr<vosvideo::data::ReceivedData> receivedMessage);
+			// Calls done from WebRTC thread, never if it is hung. Doesn't block the caller.
+			void PostRoundTrip(std::function<void()> done);
+
+		protected:
+			// MessageHandler implementation, runs round trips posted to WebRTC thread
+			virtual void OnMessage(rtc::Message* message) override;
 
 		private:
 			using WebRtcPeerConnectionMap = std::map<std::wstring, rtc::scoped_refptr<WebRtcPeerConnection> >;
 			using WebRtcPeerConnectionVector = std::vector<rtc::scoped_refptr<WebRtcPeerConnection>>;
 			using  WebRtcDeferredIceMap = std::unordered_map<std::wstring, std::vector<std::shared_ptr<vosvideo::data::ReceivedData> >>;
+			using ArchivePlayerMap = std::map<std::wstring, std::weak_ptr<vosvideo::cameraplayer::ArchivePlayerBase>>;
 
 			void CreatePeerConnectionFactory();
 			void DeleteAllPeerConnections();
 			void DeletePeerConnection(const std::wstring& fromPeer);
 			int RemoveFinishedPeerConnections();
+			// Opens recording requested by "Archive" object of offer media info, nullptr if it can't be played
+			std::shared_ptr<vosvideo::cameraplayer::ArchivePlayerBase> CreateArchivePlayer(const web::json::value& archiveInfo);
+			void ControlArchivePlayer(const std::wstring& clientPeerKey, std::shared_ptr<vosvideo::data::ArchivePlaybackMsg> playbackMsg);
 			void Shutdown();
+			bool IsParentAlive() const;
 
 			std::shared_ptr<vosvideo::communication::PubSubService> pubSubService_;
 			int activeDeviseId_;
@@ -44,13 +61,20 @@ namespace vosvideo
 			WebRtcPeerConnectionMap peer_connections_;
 			WebRtcPeerConnectionVector finishing_peer_connections_;
 			WebRtcDeferredIceMap deferredIce_;
+			// Recording players are owned by their peer connections
+			ArchivePlayerMap archivePlayers_;
+			std::shared_ptr<vosvideo::data::CameraConfMsg> cameraConf_;
 			rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> peer_connection_factory_;
 			std::shared_ptr<vosvideo::communication::InterprocessQueueEngine> queueEng_;
 			vosvideo::cameraplayer::CameraPlayerBase* player_ = nullptr;
 			std::mutex mutex_;
+			std::shared_ptr<metrics::Gauge> peersActiveMetric_;
 			bool inShutdown_ = false;
+			// Process which launched us, idle pooled worker has nothing else telling it parent is gone
+			int32_t parentPid_ = -1;
 			Concurrency::timer<WebRtcManager*>* isaliveTimer_ = nullptr; 
 			const static int isaliveTimeout_ = 60000; // 1 min
+			const static uint32_t roundTripMessage_ = 1;
 		};
 	}
 }
@@ -31,6 +31,8 @@ const char kCandidateSdpName[] = "candidate";
 const char kSessionDescriptionTypeName[] = "type";
 const char kSessionDescriptionSdpName[] = "sdp";
 
+std::atomic<uint64_t> WebRtcPeerConnection::nextConnectionId_(1);
+
 
 WebRtcPeerConnection::WebRtcPeerConnection(wstring clientPeer,
 										   wstring srvPeer,
@@ -43,13 +45,32 @@ WebRtcPeerConnection::WebRtcPeerConnection(wstring clientPeer,
 	player_(player),
 	queueEng_(queueEng),
 	isPeerConnectionFinished_(false),
-	isShutdownOnClose_(false)
+	isShutdownOnClose_(false),
+	connectionId_(std::to_string(nextConnectionId_++)),
+	callSetupTrace_(StringUtil::ToString(clientPeer), connectionId_)
+{
+	auto& registry = metrics::MetricsRegistry::Instance();
+	string peer = StringUtil::ToString(clientPeer_);
+	iceSentMetric_ = registry.GetCounter("vosvideo_peer_ice_candidates_total", "ICE candidates exchanged with peer",
+		{ { "peer", peer }, { "connection", connectionId_ }, { "direction", "sent" } });
+	iceReceivedMetric_ = registry.GetCounter("vosvideo_peer_ice_candidates_total", "ICE candidates exchanged with peer",
+		{ { "peer", peer }, { "connection", connectionId_ }, { "direction", "received" } });
+}
+
+WebRtcPeerConnection::WebRtcPeerConnection(wstring clientPeer,
+										   wstring srvPeer,
+										   shared_ptr<CameraPlayerBase> ownedPlayer,
+										   std::shared_ptr<vosvideo::communication::InterprocessQueueEngine> queueEng): 
+	WebRtcPeerConnection(clientPeer, srvPeer, ownedPlayer.get(), queueEng)
 {
+	ownedPlayer_ = ownedPlayer;
 }
 
 WebRtcPeerConnection::~WebRtcPeerConnection()
 {
 	peer_connection_ = nullptr;
+	// Connection which replaced this one for the same peer keeps its series
+	metrics::MetricsRegistry::Instance().RemoveSeries("connection", connectionId_);
 }
 
 void WebRtcPeerConnection::SetCurrentThread(rtc::Thread* commandThr)
@@ -92,9 +113,20 @@ void WebRtcPeerConnection::OnMessage(rtc::Message* message)
 			Close_r();
 			break;
 		}
+	case (uint32_t)PeerConnectionMessages::DoPollFirstFrame:
+		{
+			PollFirstFrame_r();
+			break;
+		}
 	}
 }
 
+void WebRtcPeerConnection::OnOfferDelivered(int64_t receivedTime)
+{
+	callSetupTrace_.Mark(CallSetupStage::OfferReceived, receivedTime);
+	callSetupTrace_.Mark(CallSetupStage::OfferDelivered);
+}
+
 void WebRtcPeerConnection::InitSdp(std::shared_ptr<SdpOffer> sdp)
 {
 	auto wpayload = sdp->GetSdpOffer();
@@ -105,6 +137,7 @@ void WebRtcPeerConnection::InitSdp(std::shared_ptr<SdpOffer> sdp)
 
 void WebRtcPeerConnection::InitSdp_r(const std::string& sdpPayload) 
 {
+	callSetupTrace_.Mark(CallSetupStage::SdpInitialized);
 	webrtc::PeerConnectionInterface::RTCConfiguration config;
 	webrtc::PeerConnectionInterface::IceServer server;
 
@@ -137,6 +170,7 @@ void WebRtcPeerConnection::InitIce(std::shared_ptr<vosvideo::data::WebRtcIceCand
 	{
 		throw WebRtcException("Received unknown message: " + payload);
 	}
+	iceReceivedMetric_->Increment();
 
 	commandThr_->Send(RTC_FROM_HERE, this, static_cast<uint32_t>(PeerConnectionMessages::DoInitIce),
 		new rtc::TypedMessageData<Json::Value>(jmessage));
@@ -201,6 +235,7 @@ void WebRtcPeerConnection::OnSuccess(webrtc::SessionDescriptionInterface* desc)
 	string respSdp = StringUtil::ToString(wrespSdp);
 
 	queueEng_->Send(respSdp);
+	callSetupTrace_.Mark(CallSetupStage::AnswerSent);
 }
 
 void WebRtcPeerConnection::OnIceCandidate(const webrtc::IceCandidateInterface* icecandidate) 
@@ -226,6 +261,7 @@ void WebRtcPeerConnection::OnIceCandidate(const webrtc::IceCandidateInterface* i
 	string respIce = StringUtil::ToString(wrespIce);
 
 	queueEng_->Send(respIce);
+	iceSentMetric_->Increment();
 }
 
 
@@ -249,6 +285,51 @@ void WebRtcPeerConnection::OnFailure(const std::string& error)
 	LOG(LERROR) << __FUNCTION__ << " " << error;
 }
 
+void WebRtcPeerConnection::OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state)
+{
+	if ((new_state != webrtc::PeerConnectionInterface::kIceConnectionConnected &&
+		new_state != webrtc::PeerConnectionInterface::kIceConnectionCompleted) ||
+		callSetupTrace_.IsMarked(CallSetupStage::IceConnected))
+	{
+		return;
+	}
+	callSetupTrace_.Mark(CallSetupStage::IceConnected);
+	commandThr_->Post(RTC_FROM_HERE, this, static_cast<uint32_t>(PeerConnectionMessages::DoPollFirstFrame));
+}
+
+void WebRtcPeerConnection::PollFirstFrame_r()
+{
+	if (isPeerConnectionFinished_ || !peer_connection_.get() || callSetupTrace_.IsMarked(CallSetupStage::FirstFrameSent))
+	{
+		return;
+	}
+	if (firstFramePolls_++ == maxFirstFramePolls_)
+	{
+		LOG_WARNING("No video was sent to peer " << StringUtil::ToString(clientPeer_) << " since ICE connected");
+		return;
+	}
+	peer_connection_->GetStats(this, nullptr, webrtc::PeerConnectionInterface::kStatsOutputLevelStandard);
+}
+
+void WebRtcPeerConnection::OnComplete(const webrtc::StatsReports& reports)
+{
+	for (const auto* report : reports)
+	{
+		if (report->type() != webrtc::StatsReport::kStatsReportTypeSsrc)
+		{
+			continue;
+		}
+		const auto* trackId = report->FindValue(webrtc::StatsReport::kStatsValueNameTrackId);
+		const auto* bytesSent = report->FindValue(webrtc::StatsReport::kStatsValueNameBytesSent);
+		if (trackId && bytesSent && trackId->ToString() == kVideoLabel && bytesSent->int64_val() > 0)
+		{
+			callSetupTrace_.Mark(CallSetupStage::FirstFrameSent);
+			return;
+		}
+	}
+	commandThr_->PostDelayed(RTC_FROM_HERE, firstFramePollIntervalMs_, this, static_cast<uint32_t>(PeerConnectionMessages::DoPollFirstFrame));
+}
+
 void WebRtcPeerConnection::ProcessSdpMessage(const string& message)
 {
 	Json::Reader reader;
@@ -415,6 +496,7 @@ void WebRtcPeerConnection::Close()
 
 void WebRtcPeerConnection::Close_r()
 {
+	callSetupTrace_.Abandon();
 	if (videoCapturer_ != nullptr)
 	{
 		videoCapturer_->Stop();
@@ -16,9 +16,11 @@
 #include "VosVideo.Camera/CameraDeviceManager.h"
 #include "VosVideo.Camera/CameraVideoCapturer.h"
 #include "VosVideo.CameraPlayer/CameraPlayerBase.h"
+#include "VosVideo.Common/Metrics.h"
 
 #include "PeerConnectionObserver.h"
 #include "WebRtcMessageWrapper.h"
+#include "CallSetupTrace.h"
 
 namespace vosvideo
 {
@@ -32,7 +34,8 @@ namespace vosvideo
 			DoOnIceCandidate,
 			DoAddStreams,
 			DoOnSignalChange,
-			DoCloseCapturer
+			DoCloseCapturer,
+			DoPollFirstFrame
 		};
 
 		class DummySetSessionDescriptionObserver
@@ -63,6 +66,7 @@ namespace vosvideo
 			public rtc::MessageHandler,
 			public webrtc::PeerConnectionObserver,
 			public webrtc::CreateSessionDescriptionObserver,
+			public webrtc::StatsObserver,
 			public PeerConnectionClientObserver
 		{
 		public:
@@ -71,10 +75,17 @@ namespace vosvideo
 								 vosvideo::cameraplayer::CameraPlayerBase* player,
 //								 rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> peer_connection_factory,
 								 std::shared_ptr<vosvideo::communication::InterprocessQueueEngine> queueEng);
+			// Player created for this connection only, like recording playback, lives as long as connection
+			WebRtcPeerConnection(std::wstring clientPeer, 
+								 std::wstring srvPeer, 
+								 std::shared_ptr<vosvideo::cameraplayer::CameraPlayerBase> ownedPlayer,
+								 std::shared_ptr<vosvideo::communication::InterprocessQueueEngine> queueEng);
 
 			virtual ~WebRtcPeerConnection();
 
 			bool IsPeerConnectionFinished();
+			// Offer came to rtbcserver at receivedTime and was just handed to this connection
+			void OnOfferDelivered(int64_t receivedTime);
 			void InitSdp(std::shared_ptr<vosvideo::data::SdpOffer> sdp);
 			void InitIce(std::shared_ptr<vosvideo::data::WebRtcIceCandidateMsg> ice);
 			void SetCurrentThread(rtc::Thread* commandThr);
@@ -92,7 +103,7 @@ namespace vosvideo
 			// Triggered when a remote peer open a data channel.
 			virtual void OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel) {}
 			virtual void OnRenegotiationNeeded() {}
-			virtual void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) {}
+			virtual void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state);
 			virtual void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) {}
 			virtual void OnIceCandidate(const webrtc::IceCandidateInterface* candidate);
 			virtual void OnIceChange() {}
@@ -101,6 +112,9 @@ namespace vosvideo
 			virtual void OnSuccess(webrtc::SessionDescriptionInterface* desc);
 			virtual void OnFailure(const std::string& error);
 
+			// StatsObserver implementation, tells when first video was sent
+			virtual void OnComplete(const webrtc::StatsReports& reports);
+
 			// PeerConnectionClientObserver implementation.
 			virtual void OnSignedIn();
 			virtual void OnDisconnected();
@@ -129,6 +143,7 @@ namespace vosvideo
 			void InitIce_r(const Json::Value& jmessage);
 			void AddStreams_r();
 			void Close_r();
+			void PollFirstFrame_r();
             void CreatePeerConnectionFactory();
 
 			vosvideo::camera::CameraVideoCapturer* OpenVideoCaptureDevice();
@@ -146,8 +161,20 @@ namespace vosvideo
 			rtc::Thread* commandThr_ = nullptr;
 			vosvideo::camera::CameraVideoCapturer* videoCapturer_ = nullptr;
 			vosvideo::cameraplayer::CameraPlayerBase* player_ = nullptr;
+			std::shared_ptr<vosvideo::cameraplayer::CameraPlayerBase> ownedPlayer_;
 			bool isPeerConnectionFinished_ = false;
 			bool isShutdownOnClose_ = false;
+			// Metric label of this connection, reconnected peer comes with the same peer id
+			std::string connectionId_;
+			std::shared_ptr<metrics::Counter> iceSentMetric_;
+			std::shared_ptr<metrics::Counter> iceReceivedMetric_;
+
+			CallSetupTrace callSetupTrace_;
+			static std::atomic<uint64_t> nextConnectionId_;
+			// Stats are polled once ICE is connected till video bytes were sent
+			uint32_t firstFramePolls_ = 0;
+			static const int firstFramePollIntervalMs_ = 50;
+			static const uint32_t maxFirstFramePolls_ = 400;
 		};
 	}
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "VosVideo.Communication/PubSubService.h"
 #include "VosVideo.Communication.InterprocessQueue/InterprocessQueueEngine.h"
 #include "VosVideo.Camera/CameraPlayerFactory.h"
+#include "VosVideo.Data/DeviceWorkerStatusMsg.h"
 #include "DeviceWorkerApp.h"
 
 using namespace std;
@@ -12,8 +13,9 @@ using namespace loggers;
 using namespace vosvideo::communication;
 using namespace vosvideo::vvwebrtc;
 using namespace vosvideo::camera;
+using namespace vosvideo::data;
 
-DeviceWorkerApp::DeviceWorkerApp(const wstring& wqueueName, bool isLogging)
+DeviceWorkerApp::DeviceWorkerApp(const wstring& wqueueName, bool isLogging, int32_t parentPid) : queueName_(wqueueName)
 {	
 	if (isLogging)
 	{
@@ -23,7 +25,7 @@ DeviceWorkerApp::DeviceWorkerApp(const wstring& wqueueName, bool isLogging)
 	}
 	std::shared_ptr<PubSubService> communicationPubSub(new PubSubService());
 	std::shared_ptr<InterprocessQueueEngine> queueEngine(new InterprocessQueueEngine(communicationPubSub, wqueueName));
-	devBroker_.reset(new WebRtcManager(communicationPubSub, queueEngine));
+	devBroker_.reset(new WebRtcManager(communicationPubSub, queueEngine, parentPid));
 	interprocCommManager_.reset(new InterprocessComm(queueEngine));
 
 	if (HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED) != S_OK)
@@ -38,6 +40,14 @@ DeviceWorkerApp::DeviceWorkerApp(const wstring& wqueueName, bool isLogging)
 
 DeviceWorkerApp::~DeviceWorkerApp()
 {
+	if (metricsReporter_)
+	{
+		metricsReporter_->Stop();
+	}
+	if (heartbeat_)
+	{
+		heartbeat_->StopBeating();
+	}
 	CameraPlayerFactory::Shutdown();
 	CoUninitialize();
 }
@@ -47,12 +57,27 @@ bool DeviceWorkerApp::Start()
 	try
 	{
 		interprocCommManager_->OpenAsChild();
+		heartbeat_.reset(new InterprocessHeartbeat(queueName_ + L"_hb", false));
 	}
 	catch(exception &ex)
 	{
 		LOG_CRITICAL(ex.what());
 		return false;
 	}
+	auto devBroker = devBroker_;
+	heartbeat_->StartBeating(heartbeatPeriod_, [devBroker](std::function<void()> answer)
+	{
+		devBroker->PostRoundTrip(answer);
+	});
+
+	// Tell parent that initialization is over and worker can take camera immediately
+	DeviceWorkerStatusMsg readyMsg(queueName_, DeviceWorkerStatus::Ready);
+	interprocCommManager_->Send(readyMsg.ToString());
+
+	// Parent serves metrics of all cameras, it gets ours periodically
+	metricsReporter_.reset(new MetricsReporter(interprocCommManager_, queueName_, metricsReportPeriod_));
+	metricsReporter_->Start();
+
 	interprocCommManager_->Receive();
 	return true;
 }
\ No newline at end of file
@@ -1,12 +1,15 @@
 #pragma once
 #include "VosVideo.Common/StdLogger.h"
 #include "VosVideo.Communication/InterprocessComm.h"
+#include "VosVideo.Communication/MetricsReporter.h"
+#include "VosVideo.Communication.InterprocessQueue/InterprocessHeartbeat.h"
 #include "VosVideo.WebRtc/WebRtcManager.h"
 
 class DeviceWorkerApp
 {
 public:
-	DeviceWorkerApp(const std::wstring& wqueueName, bool isLogging);
+	// Worker shuts down once process parentPid exits, -1 means parent is not watched
+	DeviceWorkerApp(const std::wstring& wqueueName, bool isLogging, int32_t parentPid);
 	virtual ~DeviceWorkerApp();
 
 	bool Start();
@@ -16,7 +19,11 @@ private:
 	std::shared_ptr<vosvideo::communication::InterprocessComm> interprocCommManager_;
 	std::shared_ptr<loggers::SeverityLogger> _log;
 	std::unique_ptr<loggers::StdLogger> _stdlog;
-	std::string queueName_;
+	std::wstring queueName_;
 	std::shared_ptr<vosvideo::vvwebrtc::WebRtcManager> devBroker_;
+	std::shared_ptr<vosvideo::communication::InterprocessHeartbeat> heartbeat_;
+	std::unique_ptr<vosvideo::communication::MetricsReporter> metricsReporter_;
+	const std::chrono::milliseconds heartbeatPeriod_ = std::chrono::milliseconds(500);
+	const std::chrono::milliseconds metricsReportPeriod_ = std::chrono::milliseconds(5000);
 };
 
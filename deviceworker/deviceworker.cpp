@@ -14,6 +14,7 @@ using util::StringUtil;
 static wstring deviceId_ = L"-deviceid";
 static wstring logging_ = L"-logging";
 static wstring debug_ = L"-debug";
+static wstring parentPid_ = L"-parentpid";
 
 
 int main(int argc, char* argv[])
@@ -28,6 +29,7 @@ int main(int argc, char* argv[])
 
 	wstring wqueueName;
 	bool isLogging = false;
+	int32_t parentPid = -1;
 
 	for (const auto& arg : argVect)
 	{
@@ -39,11 +41,15 @@ int main(int argc, char* argv[])
 		{
 			(arg.substr(logging_.length() + 1, arg.length()) == L"true") ?  isLogging = true : isLogging = false;
 		}
+		else if (arg.substr(0, parentPid_.length()) == parentPid_)
+		{
+			parentPid = std::stoi(arg.substr(parentPid_.length() + 1, arg.length()));
+		}
 	}
 
 	if (wqueueName.length() > 0)
 	{
-		DeviceWorkerApp app(wqueueName, isLogging);
+		DeviceWorkerApp app(wqueueName, isLogging, parentPid);
 		app.Start();
 	}
 
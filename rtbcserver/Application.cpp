@@ -118,6 +118,11 @@ Application::~Application()
 		return; // Nothing to stop
 	}
 
+	if (archiveServer_)
+	{
+		archiveServer_->Close();
+	}
+
 	LOG_TRACE("Shutdown runnig devices");
 	if (ipDevManager_)
 	{
@@ -223,6 +228,7 @@ bool Application::Main()
 	if (configManager->IsLoggerOn())
 	{
 		log_.reset(new SeverityLogger(L".", L"rtbc", L"rtbc"));
+		AsyncLogQueue::SetMinSeverity(configManager->GetLogLevel());
 	}
 	
 	std::wstring restServiceUri = configManager->GetRestServiceUri();
@@ -255,7 +261,9 @@ bool Application::Main()
 	wstring accountId = userManager->GetAccountId();
 	wstring siteId = configManager->GetSiteId();
 	std::shared_ptr<DeviceConfigurationManager> devManager(new DeviceConfigurationManager(commManager, communicationPubSub, accountId, siteId));
-	ipDevManager_.reset(new CameraDeviceManager(commManager, devManager, communicationPubSub, userManager, configManager));
+	// Cameras and archive share placement of recordings over archive roots
+	std::shared_ptr<ArchiveVolumes> volumes(new ArchiveVolumes(configManager));
+	ipDevManager_.reset(new CameraDeviceManager(commManager, devManager, communicationPubSub, userManager, configManager, volumes));
 	try
 	{
 		auto devRespAsync = devManager->RequestDeviceConfigurationAsync();
@@ -270,7 +278,30 @@ bool Application::Main()
 		return false;
 	}
 
-	archiveManager_.reset(new MediaWatcher(configManager, communicationPubSub));	 	
+	archiveManager_.reset(new MediaWatcher(configManager, communicationPubSub, commManager, volumes));	 	
+
+	uint32_t archivePort = configManager->GetArchiveHttpPort();
+	if (archivePort != 0)
+	{
+		archiveServer_.reset(new ArchiveHttpServer(volumes->GetRoots(), archivePort, configManager->GetWebSiteUri()));
+		auto archiveManager = archiveManager_;
+		archiveServer_->SetRecordingsProvider([archiveManager](const wstring& cameraName, uint64_t from, uint64_t to)
+		{
+			return archiveManager->GetRecordings(cameraName, from, to);
+		});
+		archiveServer_->SetMotionProvider([archiveManager](const wstring& cameraName, uint64_t from, uint64_t to, uint8_t minLevel)
+		{
+			return archiveManager->GetMotion(cameraName, from, to, minLevel);
+		});
+		archiveServer_->Open();
+	}
+
+	uint32_t metricsPort = configManager->GetMetricsHttpPort();
+	if (metricsPort != 0)
+	{
+		metricsServer_.reset(new CbMetricsHttpServer(metricsPort));
+		metricsServer_->Open();
+	}
 
 	LOG_TRACE("RTBC server is ready.");
 	return true;
@@ -2,6 +2,8 @@
 #include "VosVideo.Camera/CameraDeviceManager.h"
 #include "VosVideo.UserManagement/UserManager.h"
 #include "VosVideo.MediaManagement/MediaWatcher.h"
+#include "VosVideo.MediaManagement/ArchiveHttpServer.h"
+#include "VosVideo.Communication.Casablanca/CbMetricsHttpServer.h"
 
 class Application
 {
@@ -26,6 +28,8 @@ private:
 	std::shared_ptr<loggers::SeverityLogger> log_;
 	std::shared_ptr<vosvideo::camera::CameraDeviceManager> ipDevManager_;
 	std::shared_ptr<vosvideo::archive::MediaWatcher> archiveManager_;
+	std::shared_ptr<vosvideo::archive::ArchiveHttpServer> archiveServer_;
+	std::shared_ptr<vosvideo::communication::casablanca::CbMetricsHttpServer> metricsServer_;
 
 	bool runApplication_;
 	bool runAsService_;
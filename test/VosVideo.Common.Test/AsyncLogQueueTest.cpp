@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include <thread>
+#include <gtest/gtest.h>
+#include "VosVideo.Common/AsyncLogQueue.h"
+#include "VosVideo.Common/AsyncLogRing.h"
+
+using namespace std;
+using namespace loggers;
+
+namespace
+{
+	const int capacity = static_cast<int>(LogRing::Capacity);
+
+	bool PushNumber(LogRing& ring, int number)
+	{
+		string text = to_string(number);
+		return ring.Push(number, vv_trace, "PushNumber", text.data(), text.size(), nullptr);
+	}
+
+	// Drains ring expecting numbers starting from next, returns number expected after them
+	int DrainNumbers(LogRing& ring, int next)
+	{
+		ring.Drain([&next](const LogSlot& slot, const std::thread::id&)
+		{
+			EXPECT_EQ(next, slot.Time);
+			EXPECT_EQ(to_string(next), string(slot.Text, slot.Size));
+			++next;
+		});
+		return next;
+	}
+
+	size_t CommitRecords(severity_level level, size_t count)
+	{
+		size_t committed = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			AsyncLogRecorder recorder(level, "CommitRecords");
+			if (recorder.IsActive())
+			{
+				recorder.Stream() << "record " << i;
+				recorder.Commit();
+				++committed;
+			}
+		}
+		return committed;
+	}
+}
+
+TEST(VosVideoCommonAsyncLog, RingWrapsAround)
+{
+	LogRing ring;
+	int pushed = 0;
+	int next = 0;
+	// Batches not dividing capacity, so slots are reused at every offset
+	for (int round = 0; round < 10; ++round)
+	{
+		for (int i = 0; i < 100; ++i)
+		{
+			ASSERT_TRUE(PushNumber(ring, pushed++));
+		}
+		next = DrainNumbers(ring, next);
+	}
+	EXPECT_EQ(pushed, next);
+	EXPECT_EQ(0u, ring.GetDropped());
+}
+
+TEST(VosVideoCommonAsyncLog, FullRingDropsAndCounts)
+{
+	LogRing ring;
+	for (int i = 0; i < capacity; ++i)
+	{
+		ASSERT_TRUE(PushNumber(ring, i));
+	}
+	EXPECT_TRUE(ring.IsFull());
+	EXPECT_FALSE(PushNumber(ring, -1));
+	EXPECT_FALSE(ring.Push(0, vv_trace, "FullRingDropsAndCounts", nullptr, 0, new string(1000, 'x')));
+	EXPECT_EQ(2u, ring.GetDropped());
+
+	EXPECT_EQ(capacity, DrainNumbers(ring, 0));
+	EXPECT_FALSE(ring.IsFull());
+	EXPECT_TRUE(PushNumber(ring, capacity));
+	EXPECT_EQ(capacity + 1, DrainNumbers(ring, capacity));
+	EXPECT_EQ(2u, ring.GetDropped());
+}
+
+TEST(VosVideoCommonAsyncLog, LongTextIsWritten)
+{
+	LogRing ring;
+	string text(LogSlot::TextCapacity * 3, 'x');
+	ASSERT_TRUE(ring.Push(1, vv_error, "LongTextIsWritten", nullptr, 0, new string(text)));
+
+	size_t written = ring.Drain([&text](const LogSlot& slot, const std::thread::id&)
+	{
+		ASSERT_NE(nullptr, slot.LongText);
+		EXPECT_EQ(text, *slot.LongText);
+		EXPECT_EQ(vv_error, slot.Level);
+	});
+	EXPECT_EQ(1u, written);
+}
+
+TEST(VosVideoCommonAsyncLog, OrphanRingIsDoneOnceDrained)
+{
+	LogRing ring;
+	PushNumber(ring, 0);
+	ring.SetOrphan();
+	EXPECT_FALSE(ring.IsDone());
+	DrainNumbers(ring, 0);
+	EXPECT_TRUE(ring.IsDone());
+}
+
+TEST(VosVideoCommonAsyncLog, ExitedThreadIsUnregistered)
+{
+	size_t before = AsyncLogQueue::GetThreadCount();
+	size_t during = 0;
+	std::thread thr([&during]
+	{
+		// Registers thread's ring, nothing is committed
+		AsyncLogRecorder recorder(vv_trace, "ExitedThreadIsUnregistered");
+		during = AsyncLogQueue::GetThreadCount();
+	});
+	thr.join();
+
+	EXPECT_EQ(before + 1, during);
+	EXPECT_EQ(before, AsyncLogQueue::GetThreadCount());
+}
+
+TEST(VosVideoCommonAsyncLog, ExitedThreadIsKeptUntilWritten)
+{
+	size_t before = AsyncLogQueue::GetThreadCount();
+	std::thread thr([]
+	{
+		CommitRecords(vv_trace, 1);
+	});
+	thr.join();
+	EXPECT_EQ(before + 1, AsyncLogQueue::GetThreadCount());
+
+	// Writer drains everything on stop
+	AsyncLogQueue::Start(vv_trace);
+	AsyncLogQueue::Stop();
+	EXPECT_EQ(before, AsyncLogQueue::GetThreadCount());
+}
+
+TEST(VosVideoCommonAsyncLog, ErrorsBypassFullRing)
+{
+	uint64_t droppedBefore = AsyncLogQueue::GetDroppedCount();
+	size_t trace = 0;
+	size_t errors = 0;
+	std::thread thr([&trace, &errors]
+	{
+		// Writer is stopped, nothing leaves the ring
+		trace = CommitRecords(vv_trace, capacity + 5);
+		errors = CommitRecords(vv_error, 2) + CommitRecords(vv_critical, 1);
+	});
+	thr.join();
+
+	EXPECT_EQ(static_cast<size_t>(capacity), trace);
+	EXPECT_EQ(3u, errors);
+	EXPECT_EQ(droppedBefore + 5, AsyncLogQueue::GetDroppedCount());
+
+	AsyncLogQueue::Start(vv_trace);
+	AsyncLogQueue::Stop();
+}
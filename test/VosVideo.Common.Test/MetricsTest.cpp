@@ -0,0 +1,176 @@
+#include "stdafx.h"
+#include <sstream>
+#include <gtest/gtest.h>
+#include "VosVideo.Common/Metrics.h"
+
+using namespace std;
+using namespace metrics;
+
+namespace
+{
+	// Registry is process wide, so every test uses its own metric names
+	string WritePrometheus()
+	{
+		ostringstream out;
+		MetricsRegistry::Instance().WritePrometheus(out);
+		return out.str();
+	}
+
+	bool HasLine(const string& text, const string& line)
+	{
+		return text.find(line + "\n") != string::npos;
+	}
+
+	// Values of name_bucket lines in output order
+	vector<uint64_t> GetBucketValues(const string& text, const string& name)
+	{
+		vector<uint64_t> values;
+		istringstream in(text);
+		string line;
+		while (getline(in, line))
+		{
+			if (line.compare(0, name.size() + 8, name + "_bucket{") == 0)
+			{
+				values.push_back(stoull(line.substr(line.rfind(' ') + 1)));
+			}
+		}
+		return values;
+	}
+}
+
+TEST(VosVideoCommonMetrics, HistogramBucketBounds)
+{
+	for (uint64_t value : { 0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123456ull, 30000000ull })
+	{
+		uint32_t index = Histogram::GetBucketIndex(value);
+		EXPECT_LE(value, Histogram::GetBucketUpperBound(index));
+		if (index > 0)
+		{
+			EXPECT_GT(value, Histogram::GetBucketUpperBound(index - 1));
+		}
+	}
+}
+
+TEST(VosVideoCommonMetrics, HistogramExactBucketsEndAt32)
+{
+	EXPECT_EQ(31u, Histogram::GetBucketIndex(31));
+	EXPECT_EQ(31u, Histogram::GetBucketUpperBound(31));
+	// From 32 on buckets are two values wide
+	EXPECT_EQ(32u, Histogram::GetBucketIndex(32));
+	EXPECT_EQ(32u, Histogram::GetBucketIndex(33));
+	EXPECT_EQ(33u, Histogram::GetBucketUpperBound(32));
+	EXPECT_EQ(33u, Histogram::GetBucketIndex(34));
+}
+
+TEST(VosVideoCommonMetrics, HistogramPowerOfTwoStartsBucket)
+{
+	for (uint32_t bit = 6; bit < Histogram::maxValueBits_; ++bit)
+	{
+		uint64_t power = 1ULL << bit;
+		uint32_t index = Histogram::GetBucketIndex(power);
+		EXPECT_EQ(index - 1, Histogram::GetBucketIndex(power - 1)) << "2^" << bit;
+		EXPECT_EQ(index, Histogram::GetBucketIndex(power + 1)) << "2^" << bit;
+		EXPECT_EQ(power - 1, Histogram::GetBucketUpperBound(index - 1)) << "2^" << bit;
+		// Every power of two range has 16 buckets, so bucket is 1/16 of power wide
+		EXPECT_EQ(power + (power >> Histogram::subBucketBits_) - 1, Histogram::GetBucketUpperBound(index)) << "2^" << bit;
+	}
+}
+
+TEST(VosVideoCommonMetrics, HistogramClampsLargeValues)
+{
+	const uint32_t lastBucket = Histogram::bucketCount_ - 1;
+	const uint64_t maxValue = (1ULL << Histogram::maxValueBits_) - 1;
+	EXPECT_EQ(lastBucket, Histogram::GetBucketIndex(maxValue));
+	EXPECT_EQ(lastBucket, Histogram::GetBucketIndex(maxValue + 1));
+	EXPECT_EQ(lastBucket, Histogram::GetBucketIndex(UINT64_MAX));
+	EXPECT_EQ(maxValue, Histogram::GetBucketUpperBound(lastBucket));
+
+	Histogram histogram;
+	histogram.Record(UINT64_MAX);
+	MetricSample sample;
+	histogram.Fill(sample);
+	ASSERT_EQ(1u, sample.Buckets.size());
+	EXPECT_EQ(lastBucket, sample.Buckets[0].first);
+}
+
+TEST(VosVideoCommonMetrics, PrometheusBucketsAreCumulative)
+{
+	auto histogram = MetricsRegistry::Instance().GetHistogram("test_cumulative_seconds", "Cumulative");
+	// Buckets end at 20, 207 and 3071 us
+	histogram->Record(20);
+	histogram->Record(200);
+	histogram->Record(3000);
+
+	string text = WritePrometheus();
+	EXPECT_TRUE(HasLine(text, "# TYPE test_cumulative_seconds histogram"));
+	EXPECT_TRUE(HasLine(text, "test_cumulative_seconds_bucket{le=\"0.0001\"} 1"));
+	EXPECT_TRUE(HasLine(text, "test_cumulative_seconds_bucket{le=\"0.00025\"} 2"));
+	EXPECT_TRUE(HasLine(text, "test_cumulative_seconds_bucket{le=\"0.0025\"} 2"));
+	EXPECT_TRUE(HasLine(text, "test_cumulative_seconds_bucket{le=\"0.005\"} 3"));
+	EXPECT_TRUE(HasLine(text, "test_cumulative_seconds_bucket{le=\"30\"} 3"));
+	EXPECT_TRUE(HasLine(text, "test_cumulative_seconds_bucket{le=\"+Inf\"} 3"));
+	EXPECT_TRUE(HasLine(text, "test_cumulative_seconds_count 3"));
+	EXPECT_TRUE(HasLine(text, "test_cumulative_seconds_sum 0.00322"));
+
+	auto values = GetBucketValues(text, "test_cumulative_seconds");
+	ASSERT_EQ(18u, values.size());
+	for (size_t i = 1; i < values.size(); ++i)
+	{
+		EXPECT_LE(values[i - 1], values[i]);
+	}
+}
+
+TEST(VosVideoCommonMetrics, RemoteSourcesAreSummed)
+{
+	auto counter = MetricsRegistry::MakeSample("test_merge_total", "Merge", MetricType::Counter, { { "camera", "c1" } }, 5);
+	auto histogramSample = MetricsRegistry::MakeSample("test_merge_seconds", "Merge", MetricType::Histogram, LabelSet(), 0);
+
+	Histogram first;
+	first.Record(20);
+	first.Record(200);
+	first.Fill(histogramSample);
+	MetricsRegistry::Instance().MergeRemote("dw1", LabelSet(), { counter, histogramSample });
+
+	Histogram second;
+	second.Record(200);
+	second.Record(3000);
+	second.Fill(histogramSample);
+	counter.Value = 7;
+	MetricsRegistry::Instance().MergeRemote("dw2", LabelSet(), { counter, histogramSample });
+
+	string text = WritePrometheus();
+	EXPECT_TRUE(HasLine(text, "test_merge_total{camera=\"c1\"} 12"));
+	EXPECT_TRUE(HasLine(text, "test_merge_seconds_bucket{le=\"0.0001\"} 1"));
+	EXPECT_TRUE(HasLine(text, "test_merge_seconds_bucket{le=\"0.00025\"} 3"));
+	EXPECT_TRUE(HasLine(text, "test_merge_seconds_bucket{le=\"0.005\"} 4"));
+	EXPECT_TRUE(HasLine(text, "test_merge_seconds_count 4"));
+	EXPECT_TRUE(HasLine(text, "test_merge_seconds_sum 0.00342"));
+
+	// Next report of the same source replaces previous one
+	counter.Value = 1;
+	MetricsRegistry::Instance().MergeRemote("dw1", LabelSet(), { counter });
+	EXPECT_TRUE(HasLine(WritePrometheus(), "test_merge_total{camera=\"c1\"} 8"));
+}
+
+TEST(VosVideoCommonMetrics, RemoteLabelsAreAdded)
+{
+	auto sample = MetricsRegistry::MakeSample("test_labels_total", "Labels", MetricType::Counter, { { "worker", "own" } }, 3);
+	MetricsRegistry::Instance().MergeRemote("dw1", { { "camera", "c1" }, { "worker", "dw1" } }, { sample });
+
+	// Label of sample wins over the one of report
+	EXPECT_TRUE(HasLine(WritePrometheus(), "test_labels_total{camera=\"c1\",worker=\"own\"} 3"));
+}
+
+TEST(VosVideoCommonMetrics, SilentRemoteSeriesExpire)
+{
+	auto now = std::chrono::steady_clock::now();
+	auto stale = MetricsRegistry::MakeSample("test_expiry_stale_total", "Expiry", MetricType::Counter, LabelSet(), 1);
+	auto fresh = MetricsRegistry::MakeSample("test_expiry_fresh_total", "Expiry", MetricType::Counter, LabelSet(), 2);
+	// Remote series live 30 seconds after last report
+	MetricsRegistry::Instance().MergeRemote("dw1", LabelSet(), { stale }, now - std::chrono::seconds(31));
+	MetricsRegistry::Instance().MergeRemote("dw2", LabelSet(), { fresh }, now - std::chrono::seconds(20));
+
+	string text = WritePrometheus();
+	EXPECT_EQ(string::npos, text.find("test_expiry_stale_total"));
+	EXPECT_TRUE(HasLine(text, "test_expiry_fresh_total 2"));
+}
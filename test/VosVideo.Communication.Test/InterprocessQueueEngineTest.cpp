@@ -0,0 +1,56 @@
+#include "stdafx.h"
+#include "VosVideo.Communication.InterprocessQueue/InterprocessQueueEngine.h"
+
+using namespace std;
+using namespace vosvideo::communication;
+
+TEST(VosVideoCommunicationInterprocessQueue, BatchRoundTrip)
+{
+	vector<string> sent = { "{\"mt\":1}", "", string(300, 'x') };
+	string transfer = InterprocessQueueEngine::PackTransfer(sent);
+	EXPECT_EQ('\x1e', transfer[0]);
+	EXPECT_EQ(1 + 3 * sizeof(uint32_t) + 8 + 300, transfer.size());
+
+	vector<string> received;
+	InterprocessQueueEngine::UnpackTransfer(transfer, received);
+	EXPECT_EQ(sent, received);
+}
+
+TEST(VosVideoCommunicationInterprocessQueue, SingleMessageIsNotFramed)
+{
+	vector<string> sent = { "{\"mt\":1}" };
+	string transfer = InterprocessQueueEngine::PackTransfer(sent);
+	EXPECT_EQ(sent[0], transfer);
+
+	vector<string> received;
+	InterprocessQueueEngine::UnpackTransfer(transfer, received);
+	EXPECT_EQ(sent, received);
+}
+
+TEST(VosVideoCommunicationInterprocessQueue, TruncatedBatchKeepsCompleteMessages)
+{
+	vector<string> sent = { "first", "second" };
+	string transfer = InterprocessQueueEngine::PackTransfer(sent);
+
+	vector<string> received;
+	InterprocessQueueEngine::UnpackTransfer(transfer.substr(0, transfer.size() - 1), received);
+	ASSERT_EQ(1u, received.size());
+	EXPECT_EQ("first", received[0]);
+
+	// Cut inside length prefix of second message
+	InterprocessQueueEngine::UnpackTransfer(transfer.substr(0, 1 + sizeof(uint32_t) + 5 + 2), received);
+	ASSERT_EQ(1u, received.size());
+	EXPECT_EQ("first", received[0]);
+}
+
+TEST(VosVideoCommunicationInterprocessQueue, OversizedLengthIsRejected)
+{
+	string transfer(1, '\x1e');
+	uint32_t len = 0xffffffff;
+	transfer.append(reinterpret_cast<const char*>(&len), sizeof(len));
+	transfer.append("short");
+
+	vector<string> received;
+	InterprocessQueueEngine::UnpackTransfer(transfer, received);
+	EXPECT_TRUE(received.empty());
+}
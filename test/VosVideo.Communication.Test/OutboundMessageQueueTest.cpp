@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include <future>
+#include <atomic>
+#include "VosVideo.Communication/OutboundMessageQueue.h"
+
+using namespace std;
+using namespace vosvideo::communication;
+
+OutboundQueueStats CoalesceStateNotifications();
+OutboundQueueStats DropIceWhenCongested(bool& isSdpAccepted);
+
+TEST(VosVideoCommunicationOutboundQueue, CoalesceStateNotifications)
+{
+	auto stats = CoalesceStateNotifications();
+	EXPECT_EQ(1u, stats.Coalesced);
+	EXPECT_EQ(3u, stats.Sent);
+	EXPECT_EQ(0u, stats.Dropped);
+}
+
+TEST(VosVideoCommunicationOutboundQueue, DropIceWhenCongested)
+{
+	bool isSdpAccepted = false;
+	auto stats = DropIceWhenCongested(isSdpAccepted);
+	EXPECT_TRUE(isSdpAccepted);
+	EXPECT_LT(0u, stats.Dropped);
+}
+
+// First message blocks writer, rest of them wait in queue till gate is opened
+OutboundQueueStats CoalesceStateNotifications()
+{
+	promise<void> gate;
+	shared_future<void> gateFuture = gate.get_future().share();
+	atomic<int> sent(0);
+
+	OutboundMessageQueue queue([gateFuture, &sent](const string&)
+	{
+		gateFuture.wait();
+		sent++;
+	});
+
+	queue.Push("{\"fp\":\"srv\",\"tp\":\"peer1\",\"mt\":101,\"m\":{}}");
+	this_thread::sleep_for(chrono::milliseconds(100));
+	queue.Push("{\"fp\":\"srv\",\"tp\":\"peer1\",\"mt\":105,\"m\":{\"state\":1}}");
+	queue.Push("{\"fp\":\"srv\",\"tp\":\"peer1\",\"mt\":105,\"m\":{\"state\":2}}");
+	queue.Push("{\"fp\":\"srv\",\"tp\":\"peer2\",\"mt\":105,\"m\":{\"state\":1}}");
+	gate.set_value();
+
+	for (int i = 0; i < 100 && sent < 3; i++)
+	{
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	queue.Stop();
+	return queue.GetStats();
+}
+
+OutboundQueueStats DropIceWhenCongested(bool& isSdpAccepted)
+{
+	promise<void> gate;
+	shared_future<void> gateFuture = gate.get_future().share();
+
+	OutboundMessageQueue queue([gateFuture](const string&)
+	{
+		gateFuture.wait();
+	}, 1024);
+
+	queue.Push("{\"fp\":\"srv\",\"tp\":\"peer1\",\"mt\":101,\"m\":{}}");
+	this_thread::sleep_for(chrono::milliseconds(100));
+
+	string ice = "{\"fp\":\"srv\",\"tp\":\"peer1\",\"mt\":102,\"m\":{\"candidate\":\"" + string(200, 'c') + "\"}}";
+	for (int i = 0; i < 5; i++)
+	{
+		queue.Push(ice);
+	}
+	string sdp = "{\"fp\":\"srv\",\"tp\":\"peer2\",\"mt\":101,\"m\":{\"sdp\":\"" + string(500, 's') + "\"}}";
+	isSdpAccepted = queue.Push(sdp);
+
+	gate.set_value();
+	queue.Stop();
+	return queue.GetStats();
+}
@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include <cpprest/json.h>
+#include "VosVideo.Common/Metrics.h"
+#include "VosVideo.Data/MetricsReportMsg.h"
+
+using namespace std;
+using namespace metrics;
+using namespace vosvideo::data;
+
+TEST(Metrics, ReportRoundTrip)
+{
+	Histogram histogram;
+	histogram.Record(100);
+	histogram.Record(250000);
+
+	vector<MetricSample> samples;
+	samples.push_back(MetricsRegistry::MakeSample("vosvideo_frames_in_total", "Frames", MetricType::Counter, { { "queue", "q" } }, 42));
+	MetricSample histogramSample = MetricsRegistry::MakeSample("vosvideo_convert_time_seconds", "Convert", MetricType::Histogram, LabelSet(), 0);
+	histogram.Fill(histogramSample);
+	samples.push_back(histogramSample);
+
+	MetricsReportMsg report(L"dw1_1", samples);
+	MetricsReportMsg parsed;
+	parsed.FromJsonValue(report.ToJsonValue());
+
+	EXPECT_EQ(L"dw1_1", parsed.GetWorkerName());
+	ASSERT_EQ(2u, parsed.GetSamples().size());
+	EXPECT_EQ(42, parsed.GetSamples()[0].Value);
+	EXPECT_EQ("q", parsed.GetSamples()[0].Labels[0].second);
+	EXPECT_EQ(2u, parsed.GetSamples()[1].Count);
+	EXPECT_EQ(250100u, parsed.GetSamples()[1].Sum);
+	EXPECT_EQ(histogramSample.Buckets, parsed.GetSamples()[1].Buckets);
+}
+
+TEST(Metrics, ReportSplitKeepsSize)
+{
+	vector<MetricSample> samples;
+	for (int i = 0; i < 200; i++)
+	{
+		samples.push_back(MetricsRegistry::MakeSample("vosvideo_peer_ice_candidates_total", "ICE candidates", MetricType::Counter,
+			{ { "peer", "peer" + to_string(i) } }, i));
+	}
+
+	auto reports = MetricsReportMsg::Split(L"dw1_1", samples, 2048);
+	EXPECT_LT(1u, reports.size());
+	size_t total = 0;
+	for (const auto& report : reports)
+	{
+		EXPECT_GE(2048u, report.ToJsonValue().serialize().size());
+		total += report.GetSamples().size();
+	}
+	EXPECT_EQ(samples.size(), total);
+}
@@ -0,0 +1,19 @@
+#include "stdafx.h"
+#include <cpprest/json.h>
+#include "VosVideo.Data/WebSocketMessageParser.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::data;
+
+TEST(WebSocketMessageParser, KeepsReceivedTimeWhenPassedOn)
+{
+	string msg = "{\"mt\":" + to_string(static_cast<int>(MsgType::LiveVideoOfferMsg)) + ",\"fp\":\"client\",\"tp\":\"server\",\"m\":[{\"type\":\"offer\"}]}";
+	WebSocketMessageParser received(msg);
+	EXPECT_LT(0, received.GetReceivedTime());
+
+	WebSocketMessageParser passed(StringUtil::ToString(received.GetMessageWithReceivedTime()));
+	EXPECT_EQ(received.GetReceivedTime(), passed.GetReceivedTime());
+	EXPECT_EQ(L"client", passed.GetFromPeer());
+	EXPECT_EQ(MsgType::LiveVideoOfferMsg, passed.GetMessageType());
+}
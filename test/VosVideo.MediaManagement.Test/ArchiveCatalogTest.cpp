@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include <gtest/gtest.h>
+#include "VosVideo.MediaManagement/ArchiveCatalog.h"
+#include "VosVideo.MediaManagement/LocalVideoFile.h"
+
+using namespace std;
+using namespace vosvideo::archive;
+
+namespace
+{
+	std::shared_ptr<VideoFile> CreateVideoFile(const std::wstring& camera, const std::wstring& path, uint64_t startTime, uint64_t duration)
+	{
+		return make_shared<LocalVideoFile>(camera, path, duration, startTime, true);
+	}
+}
+
+TEST(VosVideoMediaManagementArchiveCatalog, QueryPagesInStartOrder)
+{
+	ArchiveCatalog catalog;
+	// Added out of order, as discovery finds them
+	for (uint64_t start : { 300, 100, 500, 200, 400 })
+	{
+		catalog.Add(CreateVideoFile(L"Camera1", L"c1_" + std::to_wstring(start) + L".webm", start, 100));
+	}
+	catalog.Add(CreateVideoFile(L"Camera2", L"c2_100.webm", 100, 100));
+
+	ArchiveCatalogPage page = catalog.Query(L"Camera1", 0, 0, 0, 2);
+	ASSERT_EQ(2, page.Files.size());
+	EXPECT_EQ(100, page.Files[0]->StartTime());
+	EXPECT_EQ(200, page.Files[1]->StartTime());
+	EXPECT_TRUE(page.HasMore);
+	EXPECT_EQ(300, page.NextCursor);
+
+	page = catalog.Query(L"Camera1", 0, 0, page.NextCursor, 2);
+	ASSERT_EQ(2, page.Files.size());
+	EXPECT_EQ(300, page.Files[0]->StartTime());
+	EXPECT_EQ(400, page.Files[1]->StartTime());
+
+	page = catalog.Query(L"Camera1", 0, 0, page.NextCursor, 2);
+	ASSERT_EQ(1, page.Files.size());
+	EXPECT_EQ(500, page.Files[0]->StartTime());
+	EXPECT_FALSE(page.HasMore);
+
+	EXPECT_EQ(6, catalog.GetCount());
+	EXPECT_EQ(2, catalog.GetCameras().size());
+	EXPECT_TRUE(catalog.Query(L"Camera3", 0, 0, 0, 10).Files.empty());
+}
+
+TEST(VosVideoMediaManagementArchiveCatalog, QueryIncludesFileOverlappingRange)
+{
+	ArchiveCatalog catalog;
+	catalog.Add(CreateVideoFile(L"Camera1", L"a.webm", 100, 100));
+	catalog.Add(CreateVideoFile(L"Camera1", L"b.webm", 200, 100));
+	catalog.Add(CreateVideoFile(L"Camera1", L"c.webm", 300, 100));
+
+	// b.webm covers [200, 300) and overlaps the beginning of range, c.webm starts at its end
+	ArchiveCatalogPage page = catalog.Query(L"Camera1", 250, 300, 0, 10);
+	ASSERT_EQ(1, page.Files.size());
+	EXPECT_EQ(L"b.webm", page.Files[0]->GetPath());
+
+	// a.webm ends exactly where range begins
+	page = catalog.Query(L"Camera1", 200, 0, 0, 10);
+	ASSERT_EQ(2, page.Files.size());
+	EXPECT_EQ(L"b.webm", page.Files[0]->GetPath());
+	EXPECT_EQ(L"c.webm", page.Files[1]->GetPath());
+}
+
+TEST(VosVideoMediaManagementArchiveCatalog, AddReplacesSameFile)
+{
+	ArchiveCatalog catalog;
+	catalog.Add(CreateVideoFile(L"Camera1", L"a.webm", 100, 0));
+	// Recording is rediscovered once it's complete and its start time is known precisely
+	catalog.Add(CreateVideoFile(L"Camera1", L"a.webm", 150, 100));
+
+	EXPECT_EQ(1, catalog.GetCount());
+	ArchiveCatalogPage page = catalog.Query(L"Camera1", 0, 0, 0, 10);
+	ASSERT_EQ(1, page.Files.size());
+	EXPECT_EQ(150, page.Files[0]->StartTime());
+}
+
+TEST(VosVideoMediaManagementArchiveCatalog, SameStartTimeKeepsBothFiles)
+{
+	ArchiveCatalog catalog;
+	catalog.Add(CreateVideoFile(L"Camera1", L"a.webm", 100, 100));
+	catalog.Add(CreateVideoFile(L"Camera1", L"copy_of_a.webm", 100, 100));
+	catalog.Add(CreateVideoFile(L"Camera1", L"b.webm", 200, 100));
+	EXPECT_EQ(3, catalog.GetCount());
+
+	// Cursor can't point between files of the same start time
+	ArchiveCatalogPage page = catalog.Query(L"Camera1", 0, 0, 0, 1);
+	ASSERT_EQ(2, page.Files.size());
+	EXPECT_EQ(L"a.webm", page.Files[0]->GetPath());
+	EXPECT_EQ(L"copy_of_a.webm", page.Files[1]->GetPath());
+	EXPECT_TRUE(page.HasMore);
+	EXPECT_EQ(200, page.NextCursor);
+
+	// Both overlap beginning of range
+	page = catalog.Query(L"Camera1", 150, 0, 0, 10);
+	EXPECT_EQ(3, page.Files.size());
+
+	EXPECT_TRUE(catalog.Remove(L"copy_of_a.webm"));
+	page = catalog.Query(L"Camera1", 0, 0, 0, 10);
+	ASSERT_EQ(2, page.Files.size());
+	EXPECT_EQ(L"a.webm", page.Files[0]->GetPath());
+	EXPECT_EQ(L"b.webm", page.Files[1]->GetPath());
+}
+
+TEST(VosVideoMediaManagementArchiveCatalog, RemoveDropsEmptyCamera)
+{
+	ArchiveCatalog catalog;
+	catalog.Add(CreateVideoFile(L"Camera1", L"a.webm", 100, 100));
+	catalog.Add(std::make_shared<LocalVideoFile>());
+
+	EXPECT_EQ(1, catalog.GetCount());
+	EXPECT_TRUE(catalog.Remove(L"a.webm"));
+	EXPECT_FALSE(catalog.Remove(L"a.webm"));
+	EXPECT_EQ(0, catalog.GetCount());
+	EXPECT_TRUE(catalog.GetCameras().empty());
+}
@@ -0,0 +1,93 @@
+#include "stdafx.h"
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include "VosVideo.MediaManagement/ArchiveVolumes.h"
+#include "TestArchive.h"
+
+using namespace std;
+using namespace vosvideo::archive;
+
+namespace
+{
+	// Two archive roots created in temporary directory, both on the same disk
+	std::shared_ptr<vosvideo::configuration::ConfigurationManager> CreateRoots(const TempDirectory& temp,
+		const std::wstring& placement, const std::wstring& reservedGb = L"0", std::vector<std::pair<std::wstring, std::wstring>> pins = {})
+	{
+		boost::filesystem::create_directories(temp.GetPath(L"root1"));
+		boost::filesystem::create_directories(temp.GetPath(L"root2"));
+		std::vector<std::pair<std::wstring, std::wstring>> settings = {
+			{ L"ArchivePath", temp.GetPath(L"root1") + L";" + temp.GetPath(L"root2") },
+			{ L"ArchivePlacement", placement },
+			{ L"ReservedDiskSpaceGB", reservedGb }
+		};
+		settings.insert(settings.end(), pins.begin(), pins.end());
+		return CreateConfiguration(temp, settings);
+	}
+}
+
+TEST(VosVideoMediaManagementArchiveVolumes, AssignmentSurvivesRestart)
+{
+	TempDirectory temp;
+	auto configManager = CreateRoots(temp, L"RoundRobin");
+	{
+		ArchiveVolumes volumes(configManager);
+		ASSERT_EQ(2, volumes.GetRoots().size());
+		EXPECT_EQ(temp.GetPath(L"root1"), volumes.Assign(L"Camera1"));
+		EXPECT_EQ(temp.GetPath(L"root2"), volumes.Assign(L"Camera2"));
+		EXPECT_EQ(temp.GetPath(L"root1"), volumes.Assign(L"Camera1"));
+	}
+
+	// Round robin would start from the first root again, stored placement wins
+	ArchiveVolumes volumes(configManager);
+	EXPECT_EQ(temp.GetPath(L"root2"), volumes.Assign(L"Camera2"));
+	EXPECT_EQ(temp.GetPath(L"root1"), volumes.Assign(L"Camera1"));
+}
+
+TEST(VosVideoMediaManagementArchiveVolumes, PinOverridesPolicy)
+{
+	TempDirectory temp;
+	auto configManager = CreateRoots(temp, L"RoundRobin", L"0", {
+		{ L"ArchivePin.Camera1", temp.GetPath(L"root2") },
+		{ L"ArchivePin.Camera2", temp.GetPath(L"missing") }
+	});
+	ArchiveVolumes volumes(configManager);
+
+	EXPECT_EQ(temp.GetPath(L"root2"), volumes.Assign(L"Camera1"));
+	// Pin to folder which is not archive root is ignored
+	EXPECT_EQ(temp.GetPath(L"root1"), volumes.Assign(L"Camera2"));
+}
+
+TEST(VosVideoMediaManagementArchiveVolumes, LeastUsedAvoidsBusyRoot)
+{
+	TempDirectory temp;
+	auto configManager = CreateRoots(temp, L"LeastUsed");
+	ArchiveVolumes volumes(configManager);
+
+	// Both roots are on the same disk, any of them suits the first camera
+	const wstring busyRoot = volumes.Assign(L"Camera1");
+	// Camera1 writes 1 GB per second, Camera2 is expected to write as much
+	volumes.OnRecordingAdded(L"Camera1", 60ULL * 1024 * 1024 * 1024, 60ULL * 1000000000ULL);
+	const wstring root = volumes.Assign(L"Camera2");
+	EXPECT_FALSE(root.empty());
+	EXPECT_NE(busyRoot, root);
+}
+
+TEST(VosVideoMediaManagementArchiveVolumes, FindRootOfRecording)
+{
+	TempDirectory temp;
+	ArchiveVolumes volumes(CreateRoots(temp, L"RoundRobin"));
+
+	EXPECT_EQ(temp.GetPath(L"root2"), volumes.FindRoot(temp.GetPath(L"root2") + L"\\Camera1.webm"));
+	EXPECT_EQ(L"", volumes.FindRoot(temp.GetPath(L"other") + L"\\Camera1.webm"));
+}
+
+TEST(VosVideoMediaManagementArchiveVolumes, SpaceDeficit)
+{
+	TempDirectory temp;
+	ArchiveVolumes volumes(CreateRoots(temp, L"RoundRobin"));
+	EXPECT_EQ(0, volumes.GetSpaceDeficit(temp.GetPath(L"root1")));
+
+	// No disk has billion gigabytes free
+	ArchiveVolumes reserved(CreateRoots(temp, L"RoundRobin", L"1000000000"));
+	EXPECT_GT(reserved.GetSpaceDeficit(temp.GetPath(L"root1")), 0);
+}
@@ -0,0 +1,185 @@
+#include "stdafx.h"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include "VosVideo.MediaManagement/CatalogCache.h"
+#include "VosVideo.Test.Common/TempDirectory.h"
+
+using namespace std;
+using namespace vosvideo::archive;
+
+namespace
+{
+	CatalogCacheEntry CreateEntry(const std::wstring& path, uint64_t startTime)
+	{
+		CatalogCacheEntry entry;
+		entry.Path = path;
+		entry.CameraName = L"Camera1";
+		entry.FileSize = 1000;
+		entry.LastWriteTime = 42;
+		entry.Duration = 60000000000ULL;
+		entry.StartTime = startTime;
+		entry.IsSeekable = true;
+		return entry;
+	}
+}
+
+TEST(VosVideoMediaManagementCatalogCache, ReloadKeepsLastRecordOfPath)
+{
+	TempDirectory temp;
+	const wstring cachePath = temp.GetPath(L"catalog.cache");
+	{
+		CatalogCache cache(cachePath);
+		EXPECT_EQ(0, cache.Load());
+		cache.Put(CreateEntry(L"a.webm", 1));
+		cache.Put(CreateEntry(L"b.webm", 2));
+		CatalogCacheEntry changed = CreateEntry(L"a.webm", 1);
+		changed.FileSize = 2000;
+		cache.Put(changed);
+		cache.Remove(L"b.webm");
+	}
+
+	CatalogCache cache(cachePath);
+	EXPECT_EQ(1, cache.Load());
+	CatalogCacheEntry entry;
+	EXPECT_TRUE(cache.Find(L"a.webm", 2000, 42, entry));
+	EXPECT_EQ(1, entry.StartTime);
+	EXPECT_TRUE(entry.IsSeekable);
+	// Changed file must be rediscovered
+	EXPECT_FALSE(cache.Find(L"a.webm", 1000, 42, entry));
+	EXPECT_FALSE(cache.Find(L"a.webm", 2000, 43, entry));
+	EXPECT_FALSE(cache.Find(L"b.webm", 1000, 42, entry));
+}
+
+TEST(VosVideoMediaManagementCatalogCache, TornTailIsCutOff)
+{
+	TempDirectory temp;
+	const wstring cachePath = temp.GetPath(L"catalog.cache");
+	{
+		CatalogCache cache(cachePath);
+		cache.Load();
+		cache.Put(CreateEntry(L"a.webm", 1));
+		cache.Put(CreateEntry(L"b.webm", 2));
+	}
+	const uintmax_t completeSize = boost::filesystem::file_size(cachePath);
+	{
+		// Record header promises more payload than was written before crash
+		std::ofstream file(cachePath, std::ios::binary | std::ios::app);
+		const uint32_t header[] = { 200, 0 };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write("torn", 4);
+	}
+
+	{
+		CatalogCache cache(cachePath);
+		EXPECT_EQ(2, cache.Load());
+		EXPECT_EQ(completeSize, boost::filesystem::file_size(cachePath));
+		// Appending goes on from the last complete record
+		cache.Put(CreateEntry(L"c.webm", 3));
+	}
+
+	CatalogCache cache(cachePath);
+	EXPECT_EQ(3, cache.Load());
+	CatalogCacheEntry entry;
+	EXPECT_TRUE(cache.Find(L"c.webm", 1000, 42, entry));
+}
+
+TEST(VosVideoMediaManagementCatalogCache, ChecksumMismatchDropsRestOfLog)
+{
+	TempDirectory temp;
+	const wstring cachePath = temp.GetPath(L"catalog.cache");
+	{
+		CatalogCache cache(cachePath);
+		cache.Load();
+		cache.Put(CreateEntry(L"a.webm", 1));
+		cache.Put(CreateEntry(L"b.webm", 2));
+	}
+	const uintmax_t corruptedSize = boost::filesystem::file_size(cachePath);
+	{
+		CatalogCache cache(cachePath);
+		cache.Load();
+		cache.Put(CreateEntry(L"c.webm", 3));
+	}
+	{
+		// Damage payload of the middle record, it and everything after it can't be trusted
+		std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(corruptedSize - 1);
+		file.put('\x7f');
+	}
+
+	CatalogCache cache(cachePath);
+	EXPECT_EQ(1, cache.Load());
+	CatalogCacheEntry entry;
+	EXPECT_TRUE(cache.Find(L"a.webm", 1000, 42, entry));
+	EXPECT_FALSE(cache.Find(L"b.webm", 1000, 42, entry));
+	EXPECT_FALSE(cache.Find(L"c.webm", 1000, 42, entry));
+}
+
+TEST(VosVideoMediaManagementCatalogCache, UnknownFormatIsRebuilt)
+{
+	TempDirectory temp;
+	const wstring cachePath = temp.GetPath(L"catalog.cache");
+	{
+		std::ofstream file(cachePath, std::ios::binary);
+		file << "not a catalog cache";
+	}
+
+	{
+		CatalogCache cache(cachePath);
+		EXPECT_EQ(0, cache.Load());
+		cache.Put(CreateEntry(L"a.webm", 1));
+	}
+
+	CatalogCache cache(cachePath);
+	EXPECT_EQ(1, cache.Load());
+}
+
+TEST(VosVideoMediaManagementCatalogCache, CompactionKeepsLiveEntries)
+{
+	TempDirectory temp;
+	const wstring cachePath = temp.GetPath(L"catalog.cache");
+	uintmax_t sizeBefore = 0;
+	{
+		CatalogCache cache(cachePath);
+		cache.Load();
+		cache.Put(CreateEntry(L"b.webm", 2));
+		for (int i = 0; i < 2000; ++i)
+		{
+			CatalogCacheEntry entry = CreateEntry(L"a.webm", 1);
+			entry.FileSize = i;
+			cache.Put(entry);
+		}
+		cache.Flush();
+		sizeBefore = boost::filesystem::file_size(cachePath);
+
+		cache.Compact();
+		EXPECT_LT(boost::filesystem::file_size(cachePath) * 100, sizeBefore);
+		// Log stays open for appending after it's replaced
+		cache.Put(CreateEntry(L"c.webm", 3));
+	}
+
+	CatalogCache cache(cachePath);
+	EXPECT_EQ(3, cache.Load());
+	CatalogCacheEntry entry;
+	EXPECT_TRUE(cache.Find(L"a.webm", 1999, 42, entry));
+	EXPECT_TRUE(cache.Find(L"b.webm", 1000, 42, entry));
+	EXPECT_TRUE(cache.Find(L"c.webm", 1000, 42, entry));
+}
+
+TEST(VosVideoMediaManagementCatalogCache, SmallLogIsNotCompacted)
+{
+	TempDirectory temp;
+	const wstring cachePath = temp.GetPath(L"catalog.cache");
+	CatalogCache cache(cachePath);
+	cache.Load();
+	for (int i = 0; i < 10; ++i)
+	{
+		cache.Put(CreateEntry(L"a.webm", 1));
+	}
+	cache.Flush();
+	const uintmax_t sizeBefore = boost::filesystem::file_size(cachePath);
+
+	cache.Compact();
+	cache.Flush();
+	EXPECT_EQ(sizeBefore, boost::filesystem::file_size(cachePath));
+}
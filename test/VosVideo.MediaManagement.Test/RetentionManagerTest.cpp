@@ -0,0 +1,167 @@
+#include "stdafx.h"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include "VosVideo.MediaManagement/RetentionManager.h"
+#include "VosVideo.MediaManagement/LocalVideoFile.h"
+#include "TestArchive.h"
+
+using namespace std;
+using namespace vosvideo::archive;
+
+namespace
+{
+	const uint64_t nsInSecond = 1000000000ULL;
+	const uint64_t nsInHour = 3600ULL * nsInSecond;
+	// ArchiveQuotaGB of 0.000001 is 1073 bytes, two recordings of this size fit it, three don't
+	const size_t recordingSize = 500;
+
+	// Archive of one root holding recordings of given size
+	class TestRetention
+	{
+	public:
+		TestRetention(const std::vector<std::pair<std::wstring, std::wstring>>& extraSettings = {}) :
+			root_(temp_.GetPath(L"archive"))
+		{
+			boost::filesystem::create_directories(root_);
+			std::vector<std::pair<std::wstring, std::wstring>> settings = {
+				{ L"ArchivePath", root_ },
+				{ L"ArchiveQuotaGB", L"0.000001" },
+				{ L"ReservedDiskSpaceGB", L"0" }
+			};
+			settings.insert(settings.end(), extraSettings.begin(), extraSettings.end());
+			auto configManager = CreateConfiguration(temp_, settings);
+			manager_.reset(new RetentionManager(configManager, make_shared<ArchiveVolumes>(configManager)));
+		}
+
+		std::wstring AddRecording(const std::wstring& camera, uint64_t startTime)
+		{
+			wstring path = root_ + L"\\" + camera + L"_" + std::to_wstring(startTime) + L".webm";
+			CreateRecording(path, recordingSize);
+			manager_->Add(make_shared<LocalVideoFile>(camera, path, nsInSecond, startTime, true), recordingSize);
+			return path;
+		}
+
+		RetentionManager& GetManager()
+		{
+			return *manager_;
+		}
+
+	private:
+		TempDirectory temp_;
+		std::wstring root_;
+		std::unique_ptr<RetentionManager> manager_;
+	};
+}
+
+TEST(VosVideoMediaManagementRetention, OldestRecordingsAreRemovedAcrossCameras)
+{
+	TestRetention archive;
+	wstring oldest = archive.AddRecording(L"Camera1", 1 * nsInSecond);
+	wstring second = archive.AddRecording(L"Camera2", 2 * nsInSecond);
+	wstring third = archive.AddRecording(L"Camera1", 3 * nsInSecond);
+	wstring newest = archive.AddRecording(L"Camera2", 4 * nsInSecond);
+	EXPECT_EQ(4 * recordingSize, archive.GetManager().GetTotalSize());
+
+	vector<wstring> removed = archive.GetManager().Enforce(10 * nsInSecond);
+	ASSERT_EQ(2, removed.size());
+	EXPECT_EQ(oldest, removed[0]);
+	EXPECT_EQ(second, removed[1]);
+	EXPECT_FALSE(boost::filesystem::exists(oldest));
+	EXPECT_FALSE(boost::filesystem::exists(second));
+	EXPECT_TRUE(boost::filesystem::exists(third));
+	EXPECT_TRUE(boost::filesystem::exists(newest));
+	EXPECT_EQ(2 * recordingSize, archive.GetManager().GetTotalSize());
+
+	EXPECT_TRUE(archive.GetManager().Enforce(10 * nsInSecond).empty());
+}
+
+TEST(VosVideoMediaManagementRetention, NewestRecordingOfCameraIsKept)
+{
+	TestRetention archive;
+	// Camera may be still writing its newest recording
+	wstring recording = archive.AddRecording(L"Camera1", 1 * nsInSecond);
+	archive.GetManager().Add(make_shared<LocalVideoFile>(L"Camera1", recording, nsInSecond, 1 * nsInSecond, true), 4 * recordingSize);
+
+	EXPECT_TRUE(archive.GetManager().Enforce(10 * nsInSecond).empty());
+	EXPECT_EQ(4 * recordingSize, archive.GetManager().GetTotalSize());
+}
+
+TEST(VosVideoMediaManagementRetention, MinimumRetentionKeepsRecentRecordings)
+{
+	TestRetention archive({ { L"RetentionMinHours.Camera1", L"1" } });
+	wstring retained = archive.AddRecording(L"Camera1", 1 * nsInSecond);
+	wstring evictable = archive.AddRecording(L"Camera2", 2 * nsInSecond);
+	archive.AddRecording(L"Camera1", 3 * nsInSecond);
+	archive.AddRecording(L"Camera2", 4 * nsInSecond);
+
+	// Archive stays over quota, the rest is within minimum retention
+	vector<wstring> removed = archive.GetManager().Enforce(10 * nsInSecond);
+	ASSERT_EQ(1, removed.size());
+	EXPECT_EQ(evictable, removed[0]);
+	EXPECT_TRUE(boost::filesystem::exists(retained));
+
+	removed = archive.GetManager().Enforce(2 * nsInSecond + nsInHour + 1);
+	ASSERT_EQ(1, removed.size());
+	EXPECT_EQ(retained, removed[0]);
+	EXPECT_EQ(2 * recordingSize, archive.GetManager().GetTotalSize());
+}
+
+TEST(VosVideoMediaManagementRetention, RemovedRecordingIsNotEvicted)
+{
+	TestRetention archive;
+	wstring deleted = archive.AddRecording(L"Camera1", 1 * nsInSecond);
+	wstring oldest = archive.AddRecording(L"Camera1", 2 * nsInSecond);
+	archive.AddRecording(L"Camera1", 3 * nsInSecond);
+	archive.AddRecording(L"Camera1", 4 * nsInSecond);
+	archive.GetManager().Remove(deleted);
+	EXPECT_EQ(3 * recordingSize, archive.GetManager().GetTotalSize());
+
+	vector<wstring> removed = archive.GetManager().Enforce(10 * nsInSecond);
+	ASSERT_EQ(1, removed.size());
+	EXPECT_EQ(oldest, removed[0]);
+}
+
+TEST(VosVideoMediaManagementRetention, LockedRecordingIsRetried)
+{
+	TestRetention archive;
+	wstring locked = archive.AddRecording(L"Camera1", 1 * nsInSecond);
+	wstring second = archive.AddRecording(L"Camera2", 2 * nsInSecond);
+	archive.AddRecording(L"Camera1", 3 * nsInSecond);
+	archive.AddRecording(L"Camera2", 4 * nsInSecond);
+
+	vector<wstring> removed;
+	{
+		// Open file isn't shared for delete, like recording being played back
+		std::ifstream reader(locked, std::ios::binary);
+		removed = archive.GetManager().Enforce(10 * nsInSecond);
+	}
+	ASSERT_EQ(1, removed.size());
+	EXPECT_EQ(second, removed[0]);
+	EXPECT_TRUE(boost::filesystem::exists(locked));
+	EXPECT_EQ(3 * recordingSize, archive.GetManager().GetTotalSize());
+
+	removed = archive.GetManager().Enforce(10 * nsInSecond);
+	ASSERT_EQ(1, removed.size());
+	EXPECT_EQ(locked, removed[0]);
+	EXPECT_FALSE(boost::filesystem::exists(locked));
+}
+
+TEST(VosVideoMediaManagementRetention, WrongAmountsAreRejected)
+{
+	TempDirectory temp;
+	auto configManager = CreateConfiguration(temp, {
+		{ L"ArchiveQuotaGB", L"-1" },
+		{ L"ReservedDiskSpaceGB", L"1e300" },
+		{ L"RetentionMinHours", L"-2" },
+		{ L"RetentionMinHours.Camera1", L"nan" },
+		{ L"RetentionMinHours.Camera2", L"0.5" }
+	});
+
+	EXPECT_EQ(0, configManager->GetArchiveQuota());
+	// Default of 10 GB
+	EXPECT_EQ(10ULL * 1024 * 1024 * 1024, configManager->GetReservedDiskSpace());
+	EXPECT_EQ(0, configManager->GetRetentionMinimum(L"Camera1"));
+	EXPECT_EQ(0, configManager->GetRetentionMinimum(L"Camera3"));
+	EXPECT_EQ(nsInHour / 2, configManager->GetRetentionMinimum(L"Camera2"));
+}
@@ -0,0 +1,29 @@
+#include "stdafx.h"
+#include <fstream>
+#include "TestArchive.h"
+
+using namespace std;
+using namespace util;
+using namespace vosvideo::configuration;
+
+std::shared_ptr<ConfigurationManager> CreateConfiguration(const TempDirectory& temp,
+	const std::vector<std::pair<std::wstring, std::wstring>>& settings)
+{
+	const wstring configPath = temp.GetPath(L"rtbcserver.config.xml");
+	{
+		std::ofstream file(configPath, std::ios::binary | std::ios::trunc);
+		file << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<configuration>\n<appSettings>\n";
+		for (const auto& setting : settings)
+		{
+			file << "<add key=\"" << StringUtil::ToString(setting.first) << "\" value=\"" << StringUtil::ToString(setting.second) << "\"/>\n";
+		}
+		file << "</appSettings>\n</configuration>\n";
+	}
+	return make_shared<ConfigurationManager>(configPath);
+}
+
+void CreateRecording(const std::wstring& path, size_t size)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file << string(size, '\0');
+}
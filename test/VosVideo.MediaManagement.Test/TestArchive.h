@@ -0,0 +1,10 @@
+#pragma once
+#include "VosVideo.Configuration/ConfigurationManager.h"
+#include "VosVideo.Test.Common/TempDirectory.h"
+
+// Configuration file holding only given settings, written to temporary directory of test
+std::shared_ptr<vosvideo::configuration::ConfigurationManager> CreateConfiguration(const TempDirectory& temp,
+	const std::vector<std::pair<std::wstring, std::wstring>>& settings);
+
+// Recording file of given size, content doesn't matter to archive bookkeeping
+void CreateRecording(const std::wstring& path, size_t size);
@@ -0,0 +1,19 @@
+#include "stdafx.h"
+#include "TempDirectory.h"
+
+TempDirectory::TempDirectory() : 
+	dir_(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path(L"vosvideo_test_%%%%-%%%%-%%%%"))
+{
+	boost::filesystem::create_directories(dir_);
+}
+
+TempDirectory::~TempDirectory()
+{
+	boost::system::error_code ec;
+	boost::filesystem::remove_all(dir_, ec);
+}
+
+std::wstring TempDirectory::GetPath(const std::wstring& fileName) const
+{
+	return (dir_ / fileName).wstring();
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <boost/filesystem.hpp>
+
+// Unique directory under system temp directory, removed with everything in it once test is over
+class TempDirectory final
+{
+public:
+	TempDirectory();
+	~TempDirectory();
+
+	std::wstring GetPath(const std::wstring& fileName) const;
+
+private:
+	boost::filesystem::path dir_;
+};
@@ -0,0 +1,31 @@
+#include "stdafx.h"
+#include <gtest/gtest.h>
+#include "VosVideo.MediaFile/MotionTrack.h"
+#include "VosVideo.Test.Common/TempDirectory.h"
+
+using namespace std;
+using namespace vosvideo::mediafile;
+
+TEST(MotionTrack, RoundTrip)
+{
+	MotionEvent first = {};
+	first.Start = 5000000000;
+	first.End = 7000000000;
+	first.Level = 12;
+	first.Regions[5] = 40;
+	MotionEvent second = {};
+	second.Start = 1000000000;
+	second.End = 2000000000;
+	second.Level = 3;
+
+	TempDirectory temp;
+	wstring trackPath = MotionTrack::GetTrackPath(temp.GetPath(L"motion_test.mp4"));
+	MotionTrack::Write(trackPath, { first, second });
+
+	auto events = MotionTrack::Read(trackPath);
+	ASSERT_EQ(2u, events.size());
+	EXPECT_EQ(1000000000, events[0].Start);
+	EXPECT_EQ(7000000000, events[1].End);
+	EXPECT_EQ(12, events[1].Level);
+	EXPECT_EQ(40, events[1].Regions[5]);
+}
@@ -3,11 +3,76 @@
 #include "stdafx.h"
 #include <winerror.h>
 #include <gtest/gtest.h>
+#include <boost/filesystem/fstream.hpp>
 #include "VosVideo.MediaFile/WebmSegmenter.h"
+#include "VosVideo.MediaFile/MediaSegmentIndex.h"
+#include "VosVideo.MediaFile/MediaPackager.h"
+#include "VosVideo.MediaFile/MediaFileException.h"
+#include "VosVideo.Test.Common/TempDirectory.h"
 
 using namespace std;
 using namespace vosvideo::mediafile;
 
+namespace
+{
+	// Minimal EBML writer, every size takes 8 bytes, which is allowed by EBMLMaxSizeLength
+	string EbmlElement(uint32_t id, const string& payload)
+	{
+		string out;
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			if ((id >> shift) != 0)
+			{
+				out.push_back(static_cast<char>((id >> shift) & 0xff));
+			}
+		}
+		uint64_t size = payload.size();
+		out.push_back(0x01);
+		for (int shift = 48; shift >= 0; shift -= 8)
+		{
+			out.push_back(static_cast<char>((size >> shift) & 0xff));
+		}
+		return out + payload;
+	}
+
+	string EbmlUInt(uint32_t id, uint64_t value)
+	{
+		string payload;
+		for (int shift = 56; shift >= 0; shift -= 8)
+		{
+			payload.push_back(static_cast<char>((value >> shift) & 0xff));
+		}
+		return EbmlElement(id, payload);
+	}
+
+	// Header of webm being recorded: segment size is unknown, there are no cues and no duration
+	string CreateLiveWebmHeader()
+	{
+		string ebml = EbmlElement(0x1A45DFA3, EbmlUInt(0x4286, 1) + EbmlUInt(0x42F7, 1) + EbmlUInt(0x42F2, 4) + EbmlUInt(0x42F3, 8) + 
+			EbmlElement(0x4282, "webm") + EbmlUInt(0x4287, 2) + EbmlUInt(0x4285, 2));
+		string info = EbmlElement(0x1549A966, EbmlUInt(0x2AD7B1, 1000000));
+		string video = EbmlElement(0xE0, EbmlUInt(0xB0, 2) + EbmlUInt(0xBA, 2));
+		string track = EbmlElement(0xAE, EbmlUInt(0xD7, 1) + EbmlUInt(0x73C5, 1) + EbmlUInt(0x83, 1) + EbmlElement(0x86, "V_VP8") + video);
+		string tracks = EbmlElement(0x1654AE6B, track);
+		string unknownSize("\x18\x53\x80\x67\x01\xff\xff\xff\xff\xff\xff\xff", 12);
+		return ebml + unknownSize + info + tracks;
+	}
+
+	string CreateWebmCluster(uint64_t timeCodeMs, bool isKeyFrame)
+	{
+		string block("\x81\x00\x00", 3);
+		block.push_back(isKeyFrame ? '\x80' : '\x00');
+		block += "frame";
+		return EbmlElement(0x1F43B675, EbmlUInt(0xE7, timeCodeMs) + EbmlElement(0xA3, block));
+	}
+
+	void AppendToFile(const wstring& path, const string& data)
+	{
+		boost::filesystem::ofstream out(boost::filesystem::path(path), std::ios::binary | std::ios::app);
+		out.write(data.data(), data.size());
+	}
+}
+
 TEST(WebmSegmenterInit, WebmSegmenterTest)
 {
 	WebmSegmenter wmseg(L"c:\\temp\\small.webm");
@@ -15,6 +80,113 @@ TEST(WebmSegmenterInit, WebmSegmenterTest)
 	auto jsonObj = manifest->ToJsonObject();
 }
 
+TEST(WebmSegmenterGrowingFile, WebmSegmenterTest)
+{
+	TempDirectory temp;
+	wstring path = temp.GetPath(L"growing.webm");
+	AppendToFile(path, CreateLiveWebmHeader() + CreateWebmCluster(0, true));
+
+	WebmSegmenter wmseg(path);
+	auto manifest = wmseg.GetManifest();
+	ASSERT_EQ(1u, manifest->GetClusters().size());
+	EXPECT_FALSE(wmseg.IsComplete());
+	EXPECT_EQ(0u, wmseg.Update());
+
+	// Cluster still being written is picked up by the update after it is complete
+	string second = CreateWebmCluster(1000, false);
+	string third = CreateWebmCluster(2000, true);
+	AppendToFile(path, second + third.substr(0, 10));
+	EXPECT_EQ(1u, wmseg.Update());
+	AppendToFile(path, third.substr(10));
+	EXPECT_EQ(1u, wmseg.Update());
+	EXPECT_EQ(0u, wmseg.Update());
+
+	const auto& clusters = manifest->GetClusters();
+	ASSERT_EQ(3u, clusters.size());
+	EXPECT_EQ(1000000000, clusters[1].GetTimeCode());
+	EXPECT_FALSE(clusters[1].IsKeyFrame());
+	EXPECT_TRUE(clusters[2].IsKeyFrame());
+	EXPECT_EQ(clusters[1].GetOffset() + static_cast<int64_t>(second.size()), clusters[2].GetOffset());
+	EXPECT_EQ(2000000000, manifest->GetDuration());
+	EXPECT_FALSE(wmseg.IsComplete());
+}
+
+TEST(MediaSegmentIndexRoundTrip, WebmSegmenterTest)
+{
+	TempDirectory temp;
+	MediaFileManifest manifest(4096, 3000000000, temp.GetPath(L"index_test.webm"));
+	manifest.AddMediaCluster(MediaCluster(0, 100, true));
+	manifest.AddMediaCluster(MediaCluster(1000, 1200, false));
+	manifest.AddMediaCluster(MediaCluster(2000, 2300, true));
+	manifest.SaveIndex();
+
+	MediaSegmentIndex index(MediaSegmentIndex::GetIndexPath(manifest.GetFileName()));
+	ASSERT_EQ(3u, index.GetEntryCount());
+	EXPECT_EQ(4096, index.GetTotalSize());
+	EXPECT_EQ(3000000000, index.GetDuration());
+
+	EXPECT_EQ(nullptr, index.Find(-1));
+	EXPECT_EQ(1200, index.Find(1500)->Offset);
+	EXPECT_EQ(100, index.FindKeyFrame(1500)->Offset);
+	EXPECT_EQ(2300, index.FindKeyFrame(5000)->Offset);
+}
+
+TEST(MediaSegmentIndexReplaceWhileMapped, WebmSegmenterTest)
+{
+	TempDirectory temp;
+	MediaFileManifest manifest(4096, 3000000000, temp.GetPath(L"index_replace_\u00e9.webm"));
+	manifest.AddMediaCluster(MediaCluster(0, 100, true));
+	manifest.SaveIndex();
+	MediaSegmentIndex oldIndex(MediaSegmentIndex::GetIndexPath(manifest.GetFileName()));
+
+	manifest.AddMediaCluster(MediaCluster(1000, 1200, true));
+	ASSERT_NO_THROW(manifest.SaveIndex());
+
+	MediaSegmentIndex newIndex(MediaSegmentIndex::GetIndexPath(manifest.GetFileName()));
+	EXPECT_EQ(2u, newIndex.GetEntryCount());
+	// Reader which mapped old index keeps reading it
+	EXPECT_EQ(1u, oldIndex.GetEntryCount());
+	EXPECT_EQ(100, oldIndex.Find(5000)->Offset);
+}
+
+TEST(MediaSegmentIndexHugeEntryCount, WebmSegmenterTest)
+{
+	TempDirectory temp;
+	MediaFileManifest manifest(4096, 3000000000, temp.GetPath(L"index_damaged.webm"));
+	manifest.AddMediaCluster(MediaCluster(0, 100, true));
+	manifest.SaveIndex();
+
+	// Count which overflows size check if it is multiplied by entry size
+	wstring indexPath = MediaSegmentIndex::GetIndexPath(manifest.GetFileName());
+	{
+		boost::filesystem::fstream file(indexPath, std::ios::in | std::ios::out | std::ios::binary);
+		uint64_t entryCount = 0x2000000000000000ull;
+		file.seekp(offsetof(SegmentIndexHeader, EntryCount));
+		file.write(reinterpret_cast<const char*>(&entryCount), sizeof(entryCount));
+	}
+	EXPECT_THROW(MediaSegmentIndex index(indexPath), MediaFileException);
+}
+
+TEST(MediaPackagerKeyFrameSegments, WebmSegmenterTest)
+{
+	MediaFileManifest manifest(5000, 3000000000, L"c:\\temp\\packager_test.webm");
+	manifest.AddMediaCluster(MediaCluster(0, 200, true));
+	manifest.AddMediaCluster(MediaCluster(1000000000, 1500, false));
+	manifest.AddMediaCluster(MediaCluster(2000000000, 3000, true));
+
+	auto segments = MediaPackager::GetSegments(manifest);
+	ASSERT_EQ(2u, segments.size());
+	EXPECT_EQ(200, segments[0].Offset);
+	EXPECT_EQ(2800, segments[0].Size);
+	EXPECT_EQ(2000000000, segments[0].Duration);
+	EXPECT_EQ(2000, segments[1].Size);
+	EXPECT_EQ(200, MediaPackager::GetInitializationSize(manifest));
+
+	auto mpd = MediaPackager::CreateDashManifest(manifest, "packager_test.webm", "video/webm");
+	EXPECT_NE(std::string::npos, mpd.find("<Initialization range=\"0-199\"/>"));
+	EXPECT_NE(std::string::npos, mpd.find("<SegmentURL mediaRange=\"3000-4999\"/>"));
+}
+
 int main(int argc, char* argv[])
 {
 	testing::InitGoogleTest(&argc, argv);